@@ -307,6 +307,20 @@ struct SPIDriver {
    * @brief Maximum DMA chunk size
    */
   uint32_t		chunk;
+#if NRF5_SPI_USE_DMA == TRUE
+  /**
+   * @brief Segment size for repeated sends
+   */
+  uint32_t		replen;
+  /**
+   * @brief Number of times to send each segment, 0 for normal sends
+   */
+  uint8_t		rep;
+  /**
+   * @brief Sends left for the current segment
+   */
+  uint8_t		repleft;
+#endif
 };
 
 /*===========================================================================*/
@@ -342,6 +356,10 @@ extern "C" {
   void spi_lld_exchange(SPIDriver *spip, size_t n,
                         const void *txbuf, void *rxbuf);
   void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf);
+#if NRF5_SPI_USE_DMA == TRUE
+  void spi_lld_send_repeat(SPIDriver *spip, size_t seglen, size_t nseg,
+                           uint8_t rep, const void *txbuf);
+#endif
   void spi_lld_receive(SPIDriver *spip, size_t n, void *rxbuf);
   uint16_t spi_lld_polled_exchange(SPIDriver *spip, uint16_t frame);
 #ifdef __cplusplus
@@ -128,6 +128,29 @@ static void serve_interrupt(SPIDriver *spip)
 		NRF_PPI->CHENCLR = 1 << NRF5_ANOM58_PPI;
 #endif
 
+		/*
+		 * For repeated sends, point the DMA engine back at
+		 * the start of the current segment until it's been
+		 * sent the requested number of times, then move on
+		 * to the next one.
+		 */
+
+		if (spip->rep != 0) {
+			if (spip->txcnt == 0) {
+				spip->rep = 0;
+				_spi_isr_code(spip);
+				return;
+			}
+			if (--spip->repleft == 0) {
+				spip->repleft = spip->rep;
+				spip->txptr = (const uint8_t *)spip->txptr +
+				    spip->replen;
+			}
+			port->TXD.PTR = (uint32_t)spip->txptr;
+			port->TASKS_START = 1;
+			return;
+		}
+
 		/*
 		 * Check if there's more data left to send. The NRF52
 		 * SPI controller can only DMA up to 255 bytes in a
@@ -523,6 +546,43 @@ void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf)
 	return;
 }
 
+/**
+ * @brief   Sends data over the SPI bus, repeating each segment.
+ * @details This asynchronous function starts a transmit operation in
+ *          which each @p seglen byte segment of @p txbuf is sent
+ *          @p rep times in a row before moving on to the next one.
+ *          This lets the video player double its output vertically
+ *          without copying each line twice.
+ * @post    At the end of the operation the configured callback is invoked.
+ * @note    @p seglen must not be larger than the DMA chunk size.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] seglen    size of each segment in bytes
+ * @param[in] nseg      number of segments
+ * @param[in] rep       number of times to send each segment
+ * @param[in] txbuf     the pointer to the transmit buffer
+ *
+ * @notapi
+ */
+
+void spi_lld_send_repeat(SPIDriver *spip, size_t seglen, size_t nseg,
+                         uint8_t rep, const void *txbuf)
+{
+	spip->rxptr = NULL;
+	spip->txptr = txbuf;
+	spip->rxcnt = 0;
+	spip->txcnt = seglen * nseg * rep;
+	spip->replen = seglen;
+	spip->rep = rep;
+	spip->repleft = rep;
+	spip->port->TXD.PTR = (uint32_t)txbuf;
+	spip->port->TXD.MAXCNT = seglen;
+	spip->port->RXD.PTR = 0;
+	spip->port->RXD.MAXCNT = 0;
+	spip->port->TASKS_START = 1;
+	return;
+}
+
 /**
  * @brief   Receives data from the SPI bus.
  * @details This asynchronous function starts a receive operation.
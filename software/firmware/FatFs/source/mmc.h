@@ -6,6 +6,7 @@
 #define _MMC_DEFINED
 
 #include "diskio.h"
+#include "ff.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,6 +22,23 @@ DRESULT mmc_disk_write (const BYTE* buff, DWORD sector, UINT count);
 DRESULT mmc_disk_ioctl (BYTE cmd, void* buff);
 void mmc_disk_timerproc (void);
 
+/*---------------------------------------*/
+/* Streaming reads                       */
+
+typedef struct {
+	DWORD	cmds;		/* READ_MULTIPLE_BLOCK commands issued */
+	DWORD	joins;		/* Requests that continued an open stream */
+	DWORD	sectors;	/* Sectors read from the card */
+	DWORD	hits;		/* Sectors served from the read-ahead cache */
+	DWORD	stops;		/* Streams closed */
+} MMC_STATS;
+
+extern MMC_STATS mmc_stats;
+
+void mmc_disk_stream_stop (void);
+void mmc_disk_stream_enable (int on);
+UINT mmc_disk_map (FIL* fp, DWORD* tbl, UINT len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,7 @@
 #include "strutil.h"
 
 #include "slaballoc.h"
+#include "netframe.h"
 
 // debugging defines ---------------------------------------
 // debugs the discovery process
@@ -86,7 +87,8 @@ static ISPRITESYS *sprites = NULL;
 static ENEMY * player        = NULL;
 static ENEMY * current_enemy = NULL;
 static ENEMY * last_near     = NULL;
-static ENTITY *bullet[MAX_BULLETS];
+static ENTITY_POOL bullets;
+static NETFRAME    netframe;   // this tick's outgoing records
 
 // time left in combat (or in various related states)
 static uint8_t state_time_left = 0;
@@ -105,12 +107,13 @@ static void changeState(battle_state nextstate);
 static void render_all_enemies(void);
 static void send_ship_type(uint16_t type, bool final);
 static void state_vs_draw_enemy(ENEMY *e, bool is_player);
-static void send_position_update(uint16_t id, uint8_t opcode, uint8_t type, ENTITY *e);
+static void send_position_update(ENTITY *e);
 static void send_bullet_create(ENTITY *e, int16_t dir_x, int16_t dir_y, uint8_t is_free);
 static void send_state_update(uint16_t opcode, uint16_t operand);
 static void redraw_combat_clock(void);
 static void set_ship_sprite(ENEMY *e);
 static void send_mine_create(ENTITY *e);
+static void send_frame(void);
 bool entity_OOB(ENTITY *e);
 /* end protos */
 
@@ -121,32 +124,12 @@ bool entity_OOB(ENTITY *e);
 static
 int getMapTile(ENTITY *e)
 {
-  // we have to cast to int or math will be very wrong
-  int x = (int)e->vecPosition.x;
-  int y = (int)e->vecPosition.y;
+  int x = FIX16_TO_INT(e->vecPosition.x);
+  int y = FIX16_TO_INT(e->vecPosition.y);
 
   return(((y / TILE_H) * 4) + (x / TILE_W));
 }
 
-/* approach lets us interpolate smoothly between positions */
-static float
-approach(float flGoal, float flCurrent, float dt)
-{
-  float flDifference = flGoal - flCurrent;
-
-  if (flDifference > dt)
-  {
-    return(flCurrent + dt);
-  }
-
-  if (flDifference < -dt)
-  {
-    return(flCurrent - dt);
-  }
-
-  return(flGoal);
-}
-
 static bool
 check_land_collision(ENTITY *p)
 {
@@ -210,7 +193,7 @@ static void redraw_enemy_bars(void) {
 }
 
 
-static void entity_update(ENTITY *p, float dt)
+static void entity_update(ENTITY *p, fix16_t dt)
 {
   if ((p->ttl > -1) && (p->visible))
   {
@@ -226,19 +209,7 @@ static void entity_update(ENTITY *p, float dt)
   p->prevPos.x = p->vecPosition.x;
   p->prevPos.y = p->vecPosition.y;
 
-  p->vecVelocity.x = approach(p->vecVelocityGoal.x,
-                              p->vecVelocity.x,
-                              dt * p->vapproach);
-
-  p->vecVelocity.y = approach(p->vecVelocityGoal.y,
-                              p->vecVelocity.y,
-                              dt * p->vapproach);
-
-  p->vecPosition.x = p->vecPosition.x + p->vecVelocity.x * dt * p->vmult;
-  p->vecPosition.y = p->vecPosition.y + p->vecVelocity.y * dt * p->vmult;
-
-  p->vecVelocity.x = p->vecVelocity.x + p->vecGravity.x * dt;
-  p->vecVelocity.y = p->vecVelocity.y + p->vecGravity.y * dt;
+  entity_physics(p, dt);
 
   if (p->prevPos.x != p->vecPosition.x ||
       p->prevPos.y != p->vecPosition.y)
@@ -246,8 +217,8 @@ static void entity_update(ENTITY *p, float dt)
     // check for collision with land
     isp_set_sprite_xy(sprites,
                       p->sprite_id,
-                      p->vecPosition.x,
-                      p->vecPosition.y);
+                      FIX16_TO_INT(p->vecPosition.x),
+                      FIX16_TO_INT(p->vecPosition.y));
 
     if (p->type == T_PLAYER || p->type == T_ENEMY) {
       if (check_land_collision(p) || entity_OOB(p))
@@ -274,14 +245,26 @@ static void entity_update(ENTITY *p, float dt)
 
     isp_set_sprite_xy(sprites,
                       p->sprite_id,
-                      p->vecPosition.x,
-                      p->vecPosition.y);
+                      FIX16_TO_INT(p->vecPosition.x),
+                      FIX16_TO_INT(p->vecPosition.y));
   }
 }
 
 static uint32_t
 battle_init(OrchardAppContext *context)
 {
+  /*
+   * At boot, set up the transmit pool. It's never reset after this:
+   * the SoftDevice can still be holding buffers from the last battle,
+   * and they come back through ble_l2cap_tx_release whenever it's
+   * done with them.
+   */
+  if (context == NULL)
+  {
+    sl_pool_init(&nf_txpool);
+    ble_l2cap_tx_release = nf_tx_release;
+  }
+
   // don't allocate any stack space
   return(0);
 }
@@ -369,10 +352,6 @@ battle_start(OrchardAppContext *context)
   bh->cid   = BLE_L2CAP_CID_INVALID;
   mycontext = context;
 
-  // initialize the slab allocator
-
-  sl_init();
-
   // turn off the LEDs
   ledSetPattern(LED_PATTERN_WORLDMAP);
   led_clear();
@@ -411,8 +390,8 @@ battle_start(OrchardAppContext *context)
   geventAttachSource (&bh->gl2, gs, GLISTEN_MOUSEMETA);
   geventRegisterCallback(&bh->gl2, orchardAppUgfxCallback, &bh->gl2);
 
-  // clear the bullet array
-  memset(bullet, 0, sizeof(bullet));
+  // clear the bullet store
+  entity_pool_init(&bullets);
 
   // stand us up.
   copy_config_to_player();
@@ -471,11 +450,12 @@ draw_hud(OrchardAppContext *context)
 
 static void
 lay_mine(ENEMY *e) {
+  ENTITY *b;
   int count = 0;
 
   if (e == player) {
     for (int i = 0; i < MAX_BULLETS; i++) {
-      if (bullet[i] != NULL && bullet[i]->type == T_PLAYER_MINE) {
+      if (bullets.live[i] != NULL && bullets.live[i]->type == T_PLAYER_MINE) {
         count++;
       }
     }
@@ -490,57 +470,56 @@ lay_mine(ENEMY *e) {
     i2sPlay("sound/click.snd");
   }
 
-  for (int i = 0; i < MAX_BULLETS; i++)
-  {
-    // find the first available bullet structure
-    // create a new entity and fire something from it.
-    if (bullet[i] == NULL) {
-      bullet[i] = malloc(sizeof(ENTITY));
-      entity_init(bullet[i],
-        sprites,
-        MINE_SIZE,
-        MINE_SIZE,
-        e == player ? T_PLAYER_MINE : T_ENEMY_MINE);
-      bullet[i]->visible = TRUE;
-      bullet[i]->vecPosition.x = e->e.vecPosition.x;
-      bullet[i]->vecPosition.y = e->e.vecPosition.y;
-
-      // center the mine under the ship.
-      bullet[i]->vecPosition.x += ((SHIP_SIZE_ZOOMED/2) - (MINE_SIZE/2));
-      bullet[i]->vecPosition.y += ((SHIP_SIZE_ZOOMED/2) - (MINE_SIZE/2));
-
-      // mines have a TTL.
-      bullet[i]->ttl  = 5 * FPS;
+  // create a new entity and fire something from it.
+  b = entity_alloc(&bullets);
+  if (b == NULL) {
+    return;
+  }
 
-      isp_set_sprite_xy(sprites,
-                        bullet[i]->sprite_id,
-                        bullet[i]->vecPosition.x,
-                        bullet[i]->vecPosition.y);
+  entity_init(b,
+    sprites,
+    MINE_SIZE,
+    MINE_SIZE,
+    e == player ? T_PLAYER_MINE : T_ENEMY_MINE);
+  b->visible = TRUE;
+  b->vecPosition.x = e->e.vecPosition.x;
+  b->vecPosition.y = e->e.vecPosition.y;
 
-      if (e == player) {
-        send_mine_create(bullet[i]);
-      }
+  // center the mine under the ship.
+  b->vecPosition.x += FIX16_FROM_INT((SHIP_SIZE_ZOOMED/2) - (MINE_SIZE/2));
+  b->vecPosition.y += FIX16_FROM_INT((SHIP_SIZE_ZOOMED/2) - (MINE_SIZE/2));
+
+  // mines have a TTL.
+  b->ttl  = 5 * FPS;
+
+  isp_set_sprite_xy(sprites,
+                    b->sprite_id,
+                    FIX16_TO_INT(b->vecPosition.x),
+                    FIX16_TO_INT(b->vecPosition.y));
+  entity_pool_move(&bullets, b);
+
+  if (e == player) {
+    send_mine_create(b);
+  }
 #ifdef DEBUG_WEAPONS
-      printf("lay mine at %f, %f with ttl %d\n",
-        bullet[i]->vecPosition.x,
-        bullet[i]->vecPosition.x,
-        bullet[i]->ttl);
+  printf("lay mine at %f, %f with ttl %d\n",
+    FIX16_TO_FLOAT(b->vecPosition.x),
+    FIX16_TO_FLOAT(b->vecPosition.y),
+    b->ttl);
 #endif
-      return;
-    }
-  }
 }
 
 static void
 fire_bullet(ENEMY *e, int16_t dir_x, int16_t dir_y, uint8_t is_free)
 {
+  ENTITY *b;
   int count = 0;
 
   // if this is local (i.e. the player) we count to see if any more are
   // possible for the player's current ship type.
   if (e == player) {
     for (int i = 0; i < MAX_BULLETS; i++) {
-      if (bullet[i] != NULL && bullet[i]->type == T_PLAYER_BULLET) {
+      if (bullets.live[i] != NULL && bullets.live[i]->type == T_PLAYER_BULLET) {
         count++;
       }
     }
@@ -565,82 +544,79 @@ fire_bullet(ENEMY *e, int16_t dir_x, int16_t dir_y, uint8_t is_free)
     }
   }
 
-  for (int i = 0; i < MAX_BULLETS; i++)
-  {
-    // find the first available bullet structure
-    // create a new entity and fire something from it.
-    if (bullet[i] == NULL) {
-      bullet[i] = malloc(sizeof(ENTITY));
-      entity_init(bullet[i],
-        sprites,
-        shiptable[e->ship_type].shot_size,
-        shiptable[e->ship_type].shot_size,
-        e == player ? T_PLAYER_BULLET : T_ENEMY_BULLET);
-      bullet[i]->visible = TRUE;
-
-      // bullets don't use TTL, they are ranged (see update_bullets)
-      bullet[i]->ttl     = -1;
-
-      // bullets start from the edge of the direction of fire.
-      bullet[i]->vecPosition.x = e->e.vecPosition.x;
-      bullet[i]->vecPosition.y = e->e.vecPosition.y;
-
-      // and it's fired from the ship, so that velocity is added in.
-      bullet[i]->vecVelocity.x = e->e.vecVelocity.x;
-      bullet[i]->vecVelocity.y = e->e.vecVelocity.y;
-
-      if (dir_x < 0) {
-        bullet[i]->vecPosition.x = e->e.vecPosition.x - shiptable[e->ship_type].shot_size;
-      }
+  // create a new entity and fire something from it.
+  b = entity_alloc(&bullets);
+  if (b == NULL) {
+    // We failed to fire the shot becasue we're out of bullet memory.
+    // this shouldn't ever happen, but we'll make some noise anyway.
+    i2sPlay("game/error.snd");
+    return;
+  }
 
-      if (dir_x > 0) {
-        bullet[i]->vecPosition.x = e->e.vecPosition.x + SHIP_SIZE_ZOOMED;
-      }
+  entity_init(b,
+    sprites,
+    shiptable[e->ship_type].shot_size,
+    shiptable[e->ship_type].shot_size,
+    e == player ? T_PLAYER_BULLET : T_ENEMY_BULLET);
+  b->visible = TRUE;
 
-      if (dir_y < 0) {
-        bullet[i]->vecPosition.y = e->e.vecPosition.y - shiptable[e->ship_type].shot_size;
-      }
+  // bullets don't use TTL, they are ranged (see update_bullets)
+  b->ttl     = -1;
 
-      if (dir_y > 0) {
-        bullet[i]->vecPosition.y = e->e.vecPosition.y + SHIP_SIZE_ZOOMED;
-      }
+  // bullets start from the edge of the direction of fire.
+  b->vecPosition.x = e->e.vecPosition.x;
+  b->vecPosition.y = e->e.vecPosition.y;
 
-      // center the bullet
-      if (dir_x == 0) { bullet[i]->vecPosition.x += ((SHIP_SIZE_ZOOMED/2) - (shiptable[e->ship_type].shot_size/2)); }
-      if (dir_y == 0) { bullet[i]->vecPosition.y += ((SHIP_SIZE_ZOOMED/2) - (shiptable[e->ship_type].shot_size/2)); }
+  // and it's fired from the ship, so that velocity is added in.
+  b->vecVelocity.x = e->e.vecVelocity.x;
+  b->vecVelocity.y = e->e.vecVelocity.y;
 
-      // the goal and the current V should be the same.
-      bullet[i]->vecVelocityGoal.x = dir_x * shiptable[e->ship_type].shot_speed;
-      bullet[i]->vecVelocityGoal.y = dir_y * shiptable[e->ship_type].shot_speed;
+  if (dir_x < 0) {
+    b->vecPosition.x = e->e.vecPosition.x - FIX16_FROM_INT(shiptable[e->ship_type].shot_size);
+  }
 
-      bullet[i]->vecVelocity.x += dir_x * shiptable[e->ship_type].shot_speed;
-      bullet[i]->vecVelocity.y += dir_y * shiptable[e->ship_type].shot_speed;
+  if (dir_x > 0) {
+    b->vecPosition.x = e->e.vecPosition.x + FIX16_FROM_INT(SHIP_SIZE_ZOOMED);
+  }
 
-      // used for ranging
-      bullet[i]->vecPosOrigin.x = bullet[i]->vecPosition.x;
-      bullet[i]->vecPosOrigin.y = bullet[i]->vecPosition.y;
+  if (dir_y < 0) {
+    b->vecPosition.y = e->e.vecPosition.y - FIX16_FROM_INT(shiptable[e->ship_type].shot_size);
+  }
 
-      isp_set_sprite_xy(sprites,
-                        bullet[i]->sprite_id,
-                        bullet[i]->vecPosition.x,
-                        bullet[i]->vecPosition.y);
+  if (dir_y > 0) {
+    b->vecPosition.y = e->e.vecPosition.y + FIX16_FROM_INT(SHIP_SIZE_ZOOMED);
+  }
 
-      // record the shot
-      e->last_shot_ms = chVTGetSystemTime();
+  // center the bullet
+  if (dir_x == 0) { b->vecPosition.x += FIX16_FROM_INT((SHIP_SIZE_ZOOMED/2) - (shiptable[e->ship_type].shot_size/2)); }
+  if (dir_y == 0) { b->vecPosition.y += FIX16_FROM_INT((SHIP_SIZE_ZOOMED/2) - (shiptable[e->ship_type].shot_size/2)); }
 
-      if (e == player) {
-        // fire across network if the player is firing
-        send_bullet_create(bullet[i], dir_x, dir_y, is_free);
-      }
+  // the goal and the current V should be the same.
+  b->vecVelocityGoal.x = FIX16_FROM_INT(dir_x * shiptable[e->ship_type].shot_speed);
+  b->vecVelocityGoal.y = FIX16_FROM_INT(dir_y * shiptable[e->ship_type].shot_speed);
 
-      i2sPlay("game/shot.snd");
-      return;
-    }
+  b->vecVelocity.x += FIX16_FROM_INT(dir_x * shiptable[e->ship_type].shot_speed);
+  b->vecVelocity.y += FIX16_FROM_INT(dir_y * shiptable[e->ship_type].shot_speed);
+
+  // used for ranging
+  b->vecPosOrigin.x = b->vecPosition.x;
+  b->vecPosOrigin.y = b->vecPosition.y;
+
+  isp_set_sprite_xy(sprites,
+                    b->sprite_id,
+                    FIX16_TO_INT(b->vecPosition.x),
+                    FIX16_TO_INT(b->vecPosition.y));
+  entity_pool_move(&bullets, b);
+
+  // record the shot
+  e->last_shot_ms = chVTGetSystemTime();
+
+  if (e == player) {
+    // fire across network if the player is firing
+    send_bullet_create(b, dir_x, dir_y, is_free);
   }
-  // We failed to fire the shot becasue we're out of bullet memory.
-  // this shouldn't ever happen, but we'll make some noise anyway.
-  i2sPlay("game/error.snd");
 
+  i2sPlay("game/shot.snd");
 }
 
 void show_hit(ENEMY *e) {
@@ -672,143 +648,161 @@ void show_hit(ENEMY *e) {
   }
 }
 
+static void expire_bullet(ENTITY *b) {
+  isp_destroy_sprite(sprites, b->sprite_id);
+  entity_free(&bullets, b);
+}
+
+/* fills hits (MAX_BULLETS long) with the bullets and mines of the given
+ * types touching this ship, and returns how many */
+static int bullets_hitting(ENEMY *e, entity_type t1, entity_type t2,
+                           ENTITY **hits) {
+  RECT r;
+  int i, n, cnt = 0;
+
+  // the grid narrows it down to the few cells around the ship first.
+  r.x  = FIX16_TO_INT(e->e.vecPosition.x);
+  r.y  = FIX16_TO_INT(e->e.vecPosition.y);
+  r.xr = r.x + e->e.size_x;
+  r.yb = r.y + e->e.size_y;
+
+  n = entity_pool_query(&bullets, r, hits, MAX_BULLETS);
+  for (i = 0; i < n; i++) {
+    if ((hits[i]->type == t1 || hits[i]->type == t2) &&
+        isp_check_sprites_pixel_collision(sprites,
+                                          e->e.sprite_id,
+                                          hits[i]->sprite_id,
+                                          FALSE)) {
+      hits[cnt++] = hits[i];
+    }
+  }
+
+  return cnt;
+}
+
 void update_bullets(void) {
-  int i;
+  int i, n;
   uint16_t dmg;
-  uint16_t max_range = 0,travelled = 0;
+  int32_t max_range;
+  fix16_t dx, dy;
+  ENTITY *b;
+  ENTITY *hits[MAX_BULLETS];
 
   for (i = 0; i < MAX_BULLETS; i++) {
-    if (bullet[i]) {
-      entity_update(bullet[i], FRAME_DELAY);
+    b = bullets.live[i];
+    if (b == NULL) {
+      continue;
+    }
 
-      // figure out how far away the bullet is using Pythagorean theorem.
-      if (bullet[i]->type == T_PLAYER_BULLET) {
-          max_range = shiptable[player->ship_type].shot_range;
-      } else {
-          max_range = shiptable[current_enemy->ship_type].shot_range;
-      }
+    entity_update(b, FRAME_DELAY_FX);
+    entity_pool_move(&bullets, b);
 
-      travelled = sqrt(
-        pow(bullet[i]->vecPosOrigin.x - bullet[i]->vecPosition.x, 2) +
-        pow(bullet[i]->vecPosOrigin.y - bullet[i]->vecPosition.y, 2));
-
-      // manage the mine, first handle TTL. both sides can do that.
-      if (bullet[i] && ( bullet[i]->type == T_ENEMY_MINE ||
-                         bullet[i]->type == T_PLAYER_MINE) ) {
-        if (bullet[i]->ttl == 0) {
-          // mine has expired
-          i2sPlay("game/splash.snd");
-          isp_destroy_sprite(sprites, bullet[i]->sprite_id);
-          free(bullet[i]);
-          bullet[i] = NULL;
-        }
-      }
+    // manage the mine, first handle TTL. both sides can do that.
+    if ((b->type == T_ENEMY_MINE || b->type == T_PLAYER_MINE) &&
+        b->ttl == 0) {
+      // mine has expired
+      i2sPlay("game/splash.snd");
+      expire_bullet(b);
+    }
+  }
 
-      // did this bullet hit anything? if so we remove it. The enemy will
-      // tell us the damage in a few.
-      if (bullet[i] && (bullet[i]->type == T_ENEMY_BULLET ||
-                        bullet[i]->type == T_ENEMY_MINE)) {
-        if (isp_check_sprites_collision(sprites,
-                                        player->e.sprite_id,
-                                        bullet[i]->sprite_id,
-                                        FALSE,
-                                        FALSE)) {
-          isp_destroy_sprite(sprites, bullet[i]->sprite_id);
-          free(bullet[i]);
-          bullet[i] = NULL;
-        }
-      }
+  // did this bullet hit anything? if so we remove it. The enemy will
+  // tell us the damage in a few.
+  n = bullets_hitting(player, T_ENEMY_BULLET, T_ENEMY_MINE, hits);
+  for (i = 0; i < n; i++) {
+    expire_bullet(hits[i]);
+  }
 
-      if (bullet[i] && (bullet[i]->type == T_PLAYER_BULLET ||
-                        bullet[i]->type == T_PLAYER_MINE)) {
-        if (isp_check_sprites_collision(sprites,
-                                        current_enemy->e.sprite_id,
-                                        bullet[i]->sprite_id,
-                                        FALSE,
-                                        FALSE)) {
-
-          // TODO: calc random damage amount, send damage over to other side.
-          // players are authoratitive for thier own objects, so if they hit,
-          // we tell the other side to update their damage.
-
-          // damage is random, half to full damage.
-
-          if (current_enemy->is_shielded) {
-            dmg = 0;
-          } else {
-            dmg = randRange(shiptable[player->ship_type].max_dmg * .75,
-                            shiptable[player->ship_type].max_dmg);
-          }
+  n = bullets_hitting(current_enemy, T_PLAYER_BULLET, T_PLAYER_MINE, hits);
+  for (i = 0; i < n; i++) {
+    // TODO: calc random damage amount, send damage over to other side.
+    // players are authoratitive for thier own objects, so if they hit,
+    // we tell the other side to update their damage.
 
-          // if you are submerged, then you get hit for 1.5 x
-          if (current_enemy->is_cloaked) {
-            dmg = dmg * 1.5;
-          }
+    // damage is random, half to full damage.
 
-          // mines do the ship's damage and 25% more!
-          if (bullet[i]->type == T_PLAYER_MINE) {
-              dmg = dmg * 1.25;
-          }
+    if (current_enemy->is_shielded) {
+      dmg = 0;
+    } else {
+      dmg = randRange(shiptable[player->ship_type].max_dmg * .75,
+                      shiptable[player->ship_type].max_dmg);
+    }
 
-          // handle unlocks
-          if (current_enemy->unlocks & UL_PLUSDEF) {
-            dmg = dmg * .9;
+    // if you are submerged, then you get hit for 1.5 x
+    if (current_enemy->is_cloaked) {
+      dmg = dmg * 1.5;
+    }
 
-          }
-          if (player->unlocks & UL_PLUSDMG) {
-            dmg = dmg * 1.1;
-          }
+    // mines do the ship's damage and 25% more!
+    if (hits[i]->type == T_PLAYER_MINE) {
+        dmg = dmg * 1.25;
+    }
+
+    // handle unlocks
+    if (current_enemy->unlocks & UL_PLUSDEF) {
+      dmg = dmg * .9;
+
+    }
+    if (player->unlocks & UL_PLUSDMG) {
+      dmg = dmg * 1.1;
+    }
 
-          current_enemy->hp = current_enemy->hp - dmg;
+    current_enemy->hp = current_enemy->hp - dmg;
 
-          i2sPlay("game/explode2.snd");
+    i2sPlay("game/explode2.snd");
 
-          send_state_update(BATTLE_OP_TAKE_DMG, dmg);
+    send_state_update(BATTLE_OP_TAKE_DMG, dmg);
 #ifdef DEBUG_WEAPONS
-          printf("HIT for %d Damage, HP: %d / %d\n",
-            dmg,
-            current_enemy->hp,
-            ENEMY_MAX_HP
-          );
+    printf("HIT for %d Damage, HP: %d / %d\n",
+      dmg,
+      current_enemy->hp,
+      ENEMY_MAX_HP
+    );
 #endif
-          isp_destroy_sprite(sprites, bullet[i]->sprite_id);
-          free(bullet[i]);
-          bullet[i] = NULL;
+    expire_bullet(hits[i]);
 
-          redraw_enemy_bars();
-          show_hit(current_enemy);
-         }
-        }
-      }
+    redraw_enemy_bars();
+    show_hit(current_enemy);
+  }
 
-      // check for oob or max distance
-      if (bullet[i]) {
-        if (bullet[i]->type != T_PLAYER_MINE &&
-            bullet[i]->type != T_ENEMY_MINE) {
-          // bullets can max out their range
-          if ((travelled > max_range) ||
-              (entity_OOB(bullet[i])) ||
-              (check_land_collision(bullet[i]))) {
-            // expire bullet
-            isp_destroy_sprite(sprites, bullet[i]->sprite_id);
-            i2sPlay("game/splash.snd");
-            free(bullet[i]);
-            bullet[i] = NULL;
-            continue;
-          }
-        }
-      }
+  // check for oob or max distance
+  for (i = 0; i < MAX_BULLETS; i++) {
+    b = bullets.live[i];
+    if (b == NULL || b->type == T_PLAYER_MINE || b->type == T_ENEMY_MINE) {
+      continue;
+    }
+
+    if (b->type == T_PLAYER_BULLET) {
+        max_range = shiptable[player->ship_type].shot_range;
+    } else {
+        max_range = shiptable[current_enemy->ship_type].shot_range;
     }
+
+    // bullets can max out their range. compare squared distances, no
+    // need for a sqrt() to know which is further.
+    dx = b->vecPosOrigin.x - b->vecPosition.x;
+    dy = b->vecPosOrigin.y - b->vecPosition.y;
+
+    if (((int64_t)dx * dx) + ((int64_t)dy * dy) >
+        (int64_t)FIX16_FROM_INT(max_range) * FIX16_FROM_INT(max_range) ||
+        (entity_OOB(b)) ||
+        (check_land_collision(b))) {
+      // expire bullet
+      isp_destroy_sprite(sprites, b->sprite_id);
+      i2sPlay("game/splash.snd");
+      entity_free(&bullets, b);
+    }
+  }
 }
 
 bool
 entity_OOB(ENTITY *e)
 {
   // returns TRUE if entity is out of bounds
-  if ((e->vecPosition.x >= (SCREEN_W-1) - e->size_x) ||
+  if ((e->vecPosition.x >= FIX16_FROM_INT((SCREEN_W-1) - e->size_x)) ||
       (e->vecPosition.x < 0) ||
       (e->vecPosition.y < 0) ||
-      (e->vecPosition.y >= (SCREEN_H-1) - e->size_y))
+      (e->vecPosition.y >= FIX16_FROM_INT((SCREEN_H-1) - e->size_y)))
   {
     return(TRUE);
   }
@@ -816,25 +810,40 @@ entity_OOB(ENTITY *e)
   return(FALSE);
 }
 
-void expire_enemies(void *e)
+static void expire_enemies(void)
 {
-  ENEMY *en = e;
-  int    position;
-
-  // we expire 3 seconds earlier than the ble peer checker...
-  if (en->ttl < 3)
+  gll_node_t *node;
+  ENEMY      *en;
+  int         position = 0;
+
+  // walk the list once and drop expired enemies by position as we go,
+  // rather than searching for each one again by address.
+  node = enemies->first;
+  while (node != NULL)
   {
-    // erase the old position
+    en   = node->data;
+    node = node->next;
+
+    // we expire 3 seconds earlier than the ble peer checker...
+    if (en->ttl < 3)
+    {
 #ifdef DEBUG_ENEMY_TTL
-    printf("remove enemy due to ttl was: %d \n", en->ttl);
+      printf("remove enemy due to ttl was: %d \n", en->ttl);
 #endif
-    isp_destroy_sprite(sprites, en->e.sprite_id);
+      // erase the old position
+      isp_destroy_sprite(sprites, en->e.sprite_id);
 
-    // remove it from the linked list.
-    position = enemy_find_ll_pos(enemies, &(en->ble_peer_addr));
-    if (position > -1)
-    {
+      // remove it from the linked list.
       gll_remove(enemies, position);
+      if (last_near == en)
+      {
+        last_near = NULL;
+      }
+      free(en);
+    }
+    else
+    {
+      position++;
     }
   }
 }
@@ -919,8 +928,8 @@ static void set_ship_sprite(ENEMY *e) {
     if (e->hp <= 0) {
       putImageFile(getAvatarImage(e->ship_type,
         TRUE, 'd', e->e.faces_right),
-        e->e.vecPosition.x,
-        e->e.vecPosition.y);
+        FIX16_TO_INT(e->e.vecPosition.x),
+        FIX16_TO_INT(e->e.vecPosition.y));
       chThdSleepMilliseconds(500);
       return;
     }
@@ -1067,6 +1076,123 @@ getNextShip(ENEMY *e) {
   return 0;
 }
 
+/* act on one record from a frame the other badge sent us */
+static void
+apply_record(NF_RECORD *rec)
+{
+  switch (rec->op)
+  {
+    case BATTLE_OP_TAKE_DMG:
+      // take damage from opponent.
+      player->hp = player->hp - rec->operand;
+#ifdef DEBUG_WEAPONS
+      printf("TAKEDMG: %d (%d / %d)\n",
+        rec->operand,
+        player->hp,
+        PLAYER_MAX_HP);
+#endif
+      i2sPlay("game/explode2.snd");
+      if (! player->is_shielded) {
+        show_hit(player);
+      } else {
+        // blink the sheild.
+        putImageFile(getAvatarImage(player->ship_type,
+          TRUE, 'n', player->e.faces_right),
+          FIX16_TO_INT(player->e.vecPosition.x),
+          FIX16_TO_INT(player->e.vecPosition.y));
+        chThdSleepMilliseconds(100);
+        set_ship_sprite(player);
+      }
+      redraw_player_bars();
+
+      // u dead.
+      if (player->hp <= 0)
+        chThdSleepMilliseconds(250);
+    break;
+    // really we should have replaced all of these with a single
+    // SPECIAL_FLAGS call. oh well.
+    case BATTLE_OP_SET_SHIELD:
+      current_enemy->is_shielded = rec->operand;
+      current_enemy->special_started_at = chVTGetSystemTime();
+      set_ship_sprite(current_enemy);
+      break;
+    case BATTLE_OP_SET_HEAL:
+      current_enemy->is_healing = rec->operand;
+      current_enemy->special_started_at = chVTGetSystemTime();
+      set_ship_sprite(current_enemy);
+      break;
+    case BATTLE_OP_SET_CLOAK:
+      current_enemy->is_cloaked = rec->operand;
+      current_enemy->special_started_at = chVTGetSystemTime();
+      // if we're coming out of cloak we have to update.
+      if (!current_enemy->is_cloaked) {
+        isp_show_sprite(sprites,current_enemy->e.sprite_id);
+      }
+      set_ship_sprite(current_enemy);
+      break;
+    case BATTLE_OP_SET_TELEPORT:
+      current_enemy->is_teleporting = rec->operand;
+      // woooosh
+      if (current_enemy->is_teleporting)
+        i2sPlay("sound/levelup.snd");
+      current_enemy->special_started_at = chVTGetSystemTime();
+      set_ship_sprite(current_enemy);
+      break;
+    case BATTLE_OP_ENG_UPDATE:
+      current_enemy->energy = rec->operand;
+      redraw_enemy_bars();
+      break;
+    case BATTLE_OP_HP_UPDATE:
+      current_enemy->hp = rec->operand;
+      redraw_enemy_bars();
+      break;
+    case BATTLE_OP_CLOCKUPDATE:
+      // we are receiving clock from the other badge.
+      state_time_left = rec->operand;
+#ifdef DEBUG_BATTLE_STATE
+      printf("OP_CLOCKUPDATE: 0x%02x %d\n",
+        rec->op,
+        rec->operand);
+#endif
+      redraw_combat_clock();
+      break;
+    case BATTLE_OP_MINE_CREATE:
+      lay_mine(current_enemy);
+      break;
+    case BATTLE_OP_ENTITY_CREATE:
+      // enemy is firing a bullet from their current position.
+      fire_bullet(current_enemy,
+        rec->dir_x,
+        rec->dir_y,
+        rec->is_free);
+
+      // update enemy eng bar
+      if (! rec->is_free) {
+        current_enemy->energy = current_enemy->energy - shiptable[current_enemy->ship_type].shot_cost;
+        // redraw energy bar.
+        redraw_enemy_bars();
+      }
+    break;
+    case BATTLE_OP_ENDGAME:
+      changeState(SHOW_RESULTS);
+      break;
+    case BATTLE_OP_ENTITY_UPDATE:
+      // the enemy is updating their position and velocity.
+      // players are authoratitive for themselves, always.
+      nf_apply_entity(&netframe, &current_enemy->e);
+
+      if (current_enemy->e.faces_right != netframe.rx.faces_right) {
+        current_enemy->e.faces_right = netframe.rx.faces_right;
+        set_ship_sprite(current_enemy);
+      }
+
+      isp_set_sprite_xy(sprites,
+                        current_enemy->e.sprite_id,
+                        FIX16_TO_INT(current_enemy->e.vecPosition.x),
+                        FIX16_TO_INT(current_enemy->e.vecPosition.y));
+      break;
+    }
+}
 
 static void
 battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
@@ -1082,12 +1208,11 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
   ble_evt_t *           evt;
   ble_gatts_evt_rw_authorize_request_t *rw;
   ble_gatts_evt_write_t *req;
-  ble_l2cap_evt_ch_tx_t * tx;
 
   bp_vs_pkt_t     *pkt_vs;
-  bp_state_pkt_t  *pkt_state;
-  bp_entity_pkt_t *pkt_entity;
-  bp_bullet_pkt_t *pkt_bullet;
+  bp_frame_pkt_t  *pkt_frame;
+  NF_RECORD        rec;
+  int              off, used;
 
   char tmp[40];
   bh = (BattleHandles *)context->priv;
@@ -1110,10 +1235,10 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
       {
         // refresh world map enemy positions every 500mS
         enemy_list_refresh(enemies, sprites, current_battle_state);
-        gll_each(enemies, expire_enemies);
+        expire_enemies();
       }
 
-      entity_update(&(player->e), FRAME_DELAY);
+      entity_update(&(player->e), FRAME_DELAY_FX);
 
       enemy_clearall_blink(enemies);
       nearest = getNearestEnemy(enemies, player);
@@ -1148,8 +1273,8 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
     if (current_battle_state == COMBAT)
     {
       // in combat we only have to render the player and enemy */
-      entity_update(&(player->e), FRAME_DELAY);
-      entity_update(&(current_enemy->e), FRAME_DELAY);
+      entity_update(&(player->e), FRAME_DELAY_FX);
+      entity_update(&(current_enemy->e), FRAME_DELAY_FX);
 
       // move bullets if any
       update_bullets();
@@ -1164,6 +1289,9 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
         }
       }
       isp_draw_all_sprites(sprites);
+
+      // everything we said this tick goes out in one packet
+      send_frame();
     }
   } /* timerEvent */
 
@@ -1355,148 +1483,26 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
       }
 
       // COMBAT
-      if (current_battle_state == COMBAT)
+      if (current_battle_state == COMBAT &&
+          ph->bp_opcode == BATTLE_OP_FRAME)
       {
-        switch (ph->bp_opcode)
+        pkt_frame = (bp_frame_pkt_t *)&bh->rxbuf;
+        off = 0;
+        while (off < pkt_frame->bp_len &&
+               current_battle_state == COMBAT)
         {
-          case BATTLE_OP_TAKE_DMG:
-            // take damage from opponent.
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            player->hp = player->hp - pkt_state->bp_operand;
-#ifdef DEBUG_WEAPONS
-            printf("TAKEDMG: %d (%d / %d)\n",
-              pkt_state->bp_operand,
-              player->hp,
-              PLAYER_MAX_HP);
-#endif
-            i2sPlay("game/explode2.snd");
-            if (! player->is_shielded) {
-              show_hit(player);
-            } else {
-              // blink the sheild.
-              putImageFile(getAvatarImage(player->ship_type,
-                TRUE, 'n', player->e.faces_right),
-                player->e.vecPosition.x,
-                player->e.vecPosition.y);
-              chThdSleepMilliseconds(100);
-              set_ship_sprite(player);
-            }
-            redraw_player_bars();
-
-            // u dead.
-            if (player->hp <= 0)
-              chThdSleepMilliseconds(250);
-          break;
-          // really we should have replaced all of these with a single
-          // SPECIAL_FLAGS call. oh well.
-          case BATTLE_OP_SET_SHIELD:
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            current_enemy->is_shielded = pkt_state->bp_operand;
-            current_enemy->special_started_at = chVTGetSystemTime();
-            set_ship_sprite(current_enemy);
-            break;
-          case BATTLE_OP_SET_HEAL:
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            current_enemy->is_healing = pkt_state->bp_operand;
-            current_enemy->special_started_at = chVTGetSystemTime();
-            set_ship_sprite(current_enemy);
-            break;
-          case BATTLE_OP_SET_CLOAK:
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            current_enemy->is_cloaked = pkt_state->bp_operand;
-            current_enemy->special_started_at = chVTGetSystemTime();
-            // if we're coming out of cloak we have to update.
-            if (!current_enemy->is_cloaked) {
-              isp_show_sprite(sprites,current_enemy->e.sprite_id);
-            }
-            set_ship_sprite(current_enemy);
-            break;
-          case BATTLE_OP_SET_TELEPORT:
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            current_enemy->is_teleporting = pkt_state->bp_operand;
-            // woooosh
-            if (current_enemy->is_teleporting)
-              i2sPlay("sound/levelup.snd");
-            current_enemy->special_started_at = chVTGetSystemTime();
-            set_ship_sprite(current_enemy);
-            break;
-          case BATTLE_OP_ENG_UPDATE:
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            current_enemy->energy = pkt_state->bp_operand;
-            redraw_enemy_bars();
-            break;
-          case BATTLE_OP_HP_UPDATE:
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            current_enemy->hp = pkt_state->bp_operand;
-            redraw_enemy_bars();
-            break;
-          case BATTLE_OP_CLOCKUPDATE:
-            // we are receiving clock from the other badge.
-            pkt_state = (bp_state_pkt_t *)&bh->rxbuf;
-            state_time_left = pkt_state->bp_operand;
-#ifdef DEBUG_BATTLE_STATE
-            printf("OP_CLOCKUPDATE: 0x%02x %d\n",
-              ph->bp_opcode,
-              pkt_state->bp_operand);
-#endif
-            redraw_combat_clock();
+          used = nf_decode(&netframe, &pkt_frame->bp_data[off],
+                           pkt_frame->bp_len - off, &rec);
+          if (used == 0)
             break;
-          case BATTLE_OP_MINE_CREATE:
-            pkt_bullet = (bp_bullet_pkt_t *)&bh->rxbuf;
-            lay_mine(current_enemy);
-            break;
-          case BATTLE_OP_ENTITY_CREATE:
-            // enemy is firing a bullet from their current position.
-            pkt_bullet = (bp_bullet_pkt_t *)&bh->rxbuf;
-            fire_bullet(current_enemy,
-              pkt_bullet->bp_dir_x,
-              pkt_bullet->bp_dir_y,
-              pkt_bullet->bp_is_free);
-
-            // update enemy eng bar
-            if (! pkt_bullet->bp_is_free) {
-              current_enemy->energy = current_enemy->energy - shiptable[current_enemy->ship_type].shot_cost;
-              // redraw energy bar.
-              redraw_enemy_bars();
-            }
-          break;
-          case BATTLE_OP_ENDGAME:
-            changeState(SHOW_RESULTS);
-            break;
-          case BATTLE_OP_ENTITY_UPDATE:
-            // the enemy is updating their position and velocity
-            pkt_entity = (bp_entity_pkt_t *)&bh->rxbuf;
-            if (pkt_entity->bp_header.bp_type == T_ENEMY)
-            {
-              // copy the packet in to the current_enemy.
-              // players are authoratitive for themselves, always.
-              current_enemy->e.vecPosition.x     = pkt_entity->bp_x;
-              current_enemy->e.vecPosition.y     = pkt_entity->bp_y;
-              current_enemy->e.vecVelocity.x     = pkt_entity->bp_velocity_x;
-              current_enemy->e.vecVelocity.y     = pkt_entity->bp_velocity_y;
-              current_enemy->e.vecVelocityGoal.x = pkt_entity->bp_velogoal_x;
-              current_enemy->e.vecVelocityGoal.y = pkt_entity->bp_velogoal_y;
-
-              if (current_enemy->e.faces_right != pkt_entity->bp_faces_right) {
-                current_enemy->e.faces_right = pkt_entity->bp_faces_right;
-                set_ship_sprite(current_enemy);
-              }
-
-              isp_set_sprite_xy(sprites,
-                                current_enemy->e.sprite_id,
-                                current_enemy->e.vecPosition.x,
-                                current_enemy->e.vecPosition.y);
-            }
-            break;
-          }
+          off += used;
+          apply_record(&rec);
+        }
       }
       break;
 
     case l2capTxEvent:
-      // after transmit, release the buffer.
-      tx = &evt->evt.l2cap_evt.params.tx;
-      // And then look at tx->sdu_buf.p_data, tx->sdu_buf.len.
-      sl_release(tx->sdu_buf.p_data);
+      // the buffer has already gone back to nf_txpool
       break;
 
     case l2capConnectEvent:
@@ -1614,7 +1620,7 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
         switch (event->key.code)
         {
         case keyALeft:
-          player->e.vecVelocityGoal.x = -player->e.vgoal;
+          player->e.vecVelocityGoal.x = -FIX16_FROM_INT(player->e.vgoal);
           player->e.faces_right       = false;
 
           if (current_battle_state == COMBAT) {
@@ -1624,7 +1630,7 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
 
         case keyARight:
           player->e.faces_right       = true;
-          player->e.vecVelocityGoal.x = player->e.vgoal;
+          player->e.vecVelocityGoal.x = FIX16_FROM_INT(player->e.vgoal);
 
           if (current_battle_state == COMBAT) {
             set_ship_sprite(player);
@@ -1632,11 +1638,11 @@ battle_event(OrchardAppContext *context, const OrchardAppEvent *event)
           break;
 
         case keyAUp:
-          player->e.vecVelocityGoal.y = -player->e.vgoal;
+          player->e.vecVelocityGoal.y = -FIX16_FROM_INT(player->e.vgoal);
           break;
 
         case keyADown:
-          player->e.vecVelocityGoal.y = player->e.vgoal;
+          player->e.vecVelocityGoal.y = FIX16_FROM_INT(player->e.vgoal);
           break;
 
         case keyASelect:
@@ -1829,14 +1835,7 @@ static void battle_exit(OrchardAppContext *context)
     current_enemy = NULL;
   }
 
-  for (int i = 0; i < MAX_BULLETS; i++)
-  {
-    if (bullet[i])
-    {
-      free(bullet[i]);
-      bullet[i] = NULL;
-    }
-  }
+  entity_pool_init(&bullets);
 
   last_near = NULL;
 
@@ -1913,14 +1912,14 @@ void state_worldmap_enter(void)
 
   // draw player for first time.
   entity_init(&player->e, sprites, SHIP_SIZE_WORLDMAP, SHIP_SIZE_WORLDMAP, T_PLAYER);
-  player->e.vecPosition.x = config->last_x;
-  player->e.vecPosition.y = config->last_y;
+  player->e.vecPosition.x = FIX16_FROM_INT(config->last_x);
+  player->e.vecPosition.y = FIX16_FROM_INT(config->last_y);
   player->e.visible       = TRUE;
 
   isp_set_sprite_xy(sprites,
                     player->e.sprite_id,
-                    player->e.vecPosition.x,
-                    player->e.vecPosition.y);
+                    FIX16_TO_INT(player->e.vecPosition.x),
+                    FIX16_TO_INT(player->e.vecPosition.y));
 
   sprites->list[player->e.sprite_id].status = ISP_STAT_DIRTY_BOTH;
   isp_draw_all_sprites(sprites);
@@ -1952,8 +1951,8 @@ void state_worldmap_tick(void)
   if (player->e.vecPosition.x != player->e.prevPos.x ||
       player->e.vecPosition.y != player->e.prevPos.y)
   {
-    bleGapUpdateState((uint16_t)player->e.vecPosition.x,
-                      (uint16_t)player->e.vecPosition.y,
+    bleGapUpdateState((uint16_t)FIX16_TO_INT(player->e.vecPosition.x),
+                      (uint16_t)FIX16_TO_INT(player->e.vecPosition.y),
                       config->xp,
                       config->level,
                       config->current_ship,
@@ -1970,8 +1969,8 @@ void state_worldmap_exit(void)
   bh = (BattleHandles *)mycontext->priv;
 
   // store our last position for later.
-  config->last_x = player->e.vecPosition.x;
-  config->last_y = player->e.vecPosition.y;
+  config->last_x = FIX16_TO_INT(player->e.vecPosition.x);
+  config->last_y = FIX16_TO_INT(player->e.vecPosition.y);
   configSave(config);
 
   if (bh->ghTitleL)
@@ -2231,8 +2230,8 @@ void state_combat_enter(void)
 #ifdef DEBUG_BLE_MAPS
     printf("BLECENTRAL: map %d from player at %f, %f\n",
            newmap,
-           player->e.vecPosition.x,
-           player->e.vecPosition.y
+           FIX16_TO_FLOAT(player->e.vecPosition.x),
+           FIX16_TO_FLOAT(player->e.vecPosition.y)
            );
 #endif
   }
@@ -2242,8 +2241,8 @@ void state_combat_enter(void)
 #ifdef DEBUG_BLE_MAPS
     printf("BLEPREPH: map %d from player at %f, %f\n",
            newmap,
-           current_enemy->e.vecPosition.x,
-           current_enemy->e.vecPosition.y
+           FIX16_TO_FLOAT(current_enemy->e.vecPosition.x),
+           FIX16_TO_FLOAT(current_enemy->e.vecPosition.y)
            );
 #endif
   }
@@ -2254,6 +2253,8 @@ void state_combat_enter(void)
 
   // re-init the sprite system
   sprites = isp_init();
+  isp_set_compositor(sprites, SPRITE_COMPOSITOR);
+  nf_init(&netframe);
   // PERFORMANCE: this call is VERY SLOW. NEEDS WORK.
   isp_scan_screen_for_water(sprites);
 
@@ -2262,17 +2263,17 @@ void state_combat_enter(void)
   entity_init(&current_enemy->e, sprites, SHIP_SIZE_ZOOMED, SHIP_SIZE_ZOOMED, T_ENEMY);
 
   // set velocity params according to the ship
-  player->e.vecGravity.x  = shiptable[player->ship_type].vdrag;
-  player->e.vecGravity.y  = shiptable[player->ship_type].vdrag;
+  player->e.vecGravity.x  = FIX16_FROM_FLOAT(shiptable[player->ship_type].vdrag);
+  player->e.vecGravity.y  = FIX16_FROM_FLOAT(shiptable[player->ship_type].vdrag);
   player->e.vgoal         =
     player->unlocks & UL_SPEED ? (int)((float)shiptable[player->ship_type].vgoal * 1.2) :
                                  shiptable[player->ship_type].vgoal;
-  player->e.vdrag         = shiptable[player->ship_type].vdrag;
+  player->e.vdrag         = FIX16_FROM_FLOAT(shiptable[player->ship_type].vdrag);
   player->e.vapproach     = shiptable[player->ship_type].vapproach;
   player->e.vmult         = shiptable[player->ship_type].vmult;
 
-  current_enemy->e.vecGravity.x  = shiptable[current_enemy->ship_type].vdrag;
-  current_enemy->e.vecGravity.y  = shiptable[current_enemy->ship_type].vdrag;
+  current_enemy->e.vecGravity.x  = FIX16_FROM_FLOAT(shiptable[current_enemy->ship_type].vdrag);
+  current_enemy->e.vecGravity.y  = FIX16_FROM_FLOAT(shiptable[current_enemy->ship_type].vdrag);
 
   current_enemy->e.vgoal         =
     current_enemy->unlocks & UL_SPEED ? (int)((float)shiptable[current_enemy->ship_type].vgoal * 1.2) :
@@ -2280,7 +2281,7 @@ void state_combat_enter(void)
 
   current_enemy->e.vapproach     = shiptable[current_enemy->ship_type].vapproach;
   current_enemy->e.vmult         = shiptable[current_enemy->ship_type].vmult;
-  current_enemy->e.vdrag         = shiptable[current_enemy->ship_type].vdrag;
+  current_enemy->e.vdrag         = FIX16_FROM_FLOAT(shiptable[current_enemy->ship_type].vdrag);
 
   combat_load_sprites();
 
@@ -2288,21 +2289,21 @@ void state_combat_enter(void)
   if (ble_gap_role == BLE_GAP_ROLE_CENTRAL)
   {
     // Attacker (the central) gets left side, and faces right.
-    player->e.vecPosition.x        = ship_init_pos_table[newmap].attacker.x;
-    player->e.vecPosition.y        = ship_init_pos_table[newmap].attacker.y;
+    player->e.vecPosition.x        = FIX16_FROM_INT(ship_init_pos_table[newmap].attacker.x);
+    player->e.vecPosition.y        = FIX16_FROM_INT(ship_init_pos_table[newmap].attacker.y);
     player->e.faces_right          = true;
 
-    current_enemy->e.vecPosition.x = ship_init_pos_table[newmap].defender.x;
-    current_enemy->e.vecPosition.y = ship_init_pos_table[newmap].defender.y;
+    current_enemy->e.vecPosition.x = FIX16_FROM_INT(ship_init_pos_table[newmap].defender.x);
+    current_enemy->e.vecPosition.y = FIX16_FROM_INT(ship_init_pos_table[newmap].defender.y);
     current_enemy->e.faces_right   = false;
   }
   else
   {
     // Defender gets the right side, and faces left.
-    player->e.vecPosition.x        = ship_init_pos_table[newmap].defender.x;
-    player->e.vecPosition.y        = ship_init_pos_table[newmap].defender.y;
-    current_enemy->e.vecPosition.x = ship_init_pos_table[newmap].attacker.x;
-    current_enemy->e.vecPosition.y = ship_init_pos_table[newmap].attacker.y;
+    player->e.vecPosition.x        = FIX16_FROM_INT(ship_init_pos_table[newmap].defender.x);
+    player->e.vecPosition.y        = FIX16_FROM_INT(ship_init_pos_table[newmap].defender.y);
+    current_enemy->e.vecPosition.x = FIX16_FROM_INT(ship_init_pos_table[newmap].attacker.x);
+    current_enemy->e.vecPosition.y = FIX16_FROM_INT(ship_init_pos_table[newmap].attacker.y);
     player->e.faces_right          = false;
     current_enemy->e.faces_right   = true;
   }
@@ -2312,16 +2313,16 @@ void state_combat_enter(void)
 
   isp_set_sprite_xy(sprites,
                     player->e.sprite_id,
-                    player->e.vecPosition.x,
-                    player->e.vecPosition.y);
+                    FIX16_TO_INT(player->e.vecPosition.x),
+                    FIX16_TO_INT(player->e.vecPosition.y));
 
   // draw enemy
   set_ship_sprite(current_enemy);
 
   isp_set_sprite_xy(sprites,
                     current_enemy->e.sprite_id,
-                    current_enemy->e.vecPosition.x,
-                    current_enemy->e.vecPosition.y);
+                    FIX16_TO_INT(current_enemy->e.vecPosition.x),
+                    FIX16_TO_INT(current_enemy->e.vecPosition.y));
 
   isp_draw_all_sprites(sprites);
 
@@ -2471,8 +2472,8 @@ void check_special_timeouts(ENEMY *e) {
 
               // much like asteroids, you can teleport into oblivion...
               // figure out if we've died.
-              e->e.vecPosition.x = r.x;
-              e->e.vecPosition.y = r.y;
+              e->e.vecPosition.x = FIX16_FROM_INT(r.x);
+              e->e.vecPosition.y = FIX16_FROM_INT(r.y);
 #ifdef SAFE_TELEPORT
             } while (wm_check_box_for_land_collision(sprites->wm, r) ||
                 entity_OOB(&(e->e)));
@@ -2491,16 +2492,11 @@ void check_special_timeouts(ENEMY *e) {
               // position for our sprite
               isp_set_sprite_xy(sprites,
                                 e->e.sprite_id,
-                                e->e.vecPosition.x,
-                                e->e.vecPosition.y);
+                                FIX16_TO_INT(e->e.vecPosition.x),
+                                FIX16_TO_INT(e->e.vecPosition.y));
 
               // transmit our new position so the other guy gets it.
-              send_position_update(
-                player->e.id,
-                BATTLE_OP_ENTITY_UPDATE,
-                T_ENEMY,
-                &(player->e)
-              );
+              send_position_update(&(player->e));
             }
           }
           set_ship_sprite(e);
@@ -2542,10 +2538,10 @@ void check_ship_collisions(void) {
                                   FALSE,
                                   FALSE)) {
         // ping-pong ball style simulation with lossage
-        player->e.vecVelocity.x     = -player->e.vecVelocity.x * .85;
-        player->e.vecVelocity.y     = -player->e.vecVelocity.y * .85;
-        player->e.vecVelocityGoal.x = -player->e.vecVelocityGoal.x * .85;
-        player->e.vecVelocityGoal.y = -player->e.vecVelocityGoal.y * .85;
+        player->e.vecVelocity.x     = -fix16_mul(player->e.vecVelocity.x, FIX16_FROM_FLOAT(.85f));
+        player->e.vecVelocity.y     = -fix16_mul(player->e.vecVelocity.y, FIX16_FROM_FLOAT(.85f));
+        player->e.vecVelocityGoal.x = -fix16_mul(player->e.vecVelocityGoal.x, FIX16_FROM_FLOAT(.85f));
+        player->e.vecVelocityGoal.y = -fix16_mul(player->e.vecVelocityGoal.y, FIX16_FROM_FLOAT(.85f));
         // sound
         // take damage
         if (!player->is_shielded) {
@@ -2565,17 +2561,8 @@ void state_combat_tick(void)
   if (player == NULL)
     return;
 
-  // update motion
-  if (player->e.vecPosition.x != player->e.prevPos.x ||
-      player->e.vecPosition.y != player->e.prevPos.y)
-  {
-    send_position_update(
-      player->e.id,
-      BATTLE_OP_ENTITY_UPDATE,
-      T_ENEMY,
-      &(player->e)
-      );
-  }
+  // update motion. only what changed goes out.
+  send_position_update(&(player->e));
 
   // regen energy
   regen_energy(player);
@@ -2666,6 +2653,7 @@ void state_combat_exit(void)
   bh->ce_t_right = NULL;
 
   /* tear down sprite system */
+  isp_print_stats(sprites, "combat", FRAME_BUDGET_US);
   isp_shutdown(sprites);
   sprites = NULL;
 }
@@ -3009,39 +2997,50 @@ static void state_vs_draw_enemy(ENEMY *e, bool is_player)
   }
 }
 
+static void send_failed(char *msg)
+{
+  screen_alert_draw(TRUE, msg);
+  chThdSleepMilliseconds(ALERT_DELAY);
+  orchardAppExit();
+}
+
+/*
+ * An empty TX pool only means the link is behind, and what we queued
+ * waits for a later tick; only a failed send ends the battle.
+ */
+static void send_check(int r)
+{
+  if (r == NF_XMIT)
+    send_failed("BLE XMIT FAILED!");
+}
+
+/* send whatever this tick queued up, as one packet */
+static void send_frame(void)
+{
+  send_check(nf_flush(&netframe));
+}
+
 static void send_state_update(uint16_t opcode, uint16_t operand)
 {
-  bp_state_pkt_t pkt;
-  uint8_t *buf;
-  buf = sl_alloc();
+  int i, r;
 
-  if (buf == NULL) {
-    screen_alert_draw(TRUE, "PKT ALLOC FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
+  // the other side needs this one, so give the link a moment to catch up
+  for (i = 0; (r = nf_add_state(&netframe, opcode, operand)) == NF_NOMEM &&
+         i < SEND_RETRIES; i++)
+    chThdSleepMilliseconds(SEND_RETRY_MS);
 
-  pkt.bp_header.bp_opcode = opcode;
-  pkt.bp_header.bp_type   = T_ENEMY; // always enemy.
-  pkt.bp_operand = operand;
-  pkt.bp_pad = 0xffff;
-  memcpy(buf, &pkt, sizeof(bp_state_pkt_t));
+  send_check(r);
 
-  if (bleL2CapSend((uint8_t *)buf, sizeof(bp_state_pkt_t)) != NRF_SUCCESS)
-  {
-    screen_alert_draw(TRUE, "BLE XMIT FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
+  // the game is over once this goes out, so don't wait for the tick
+  if (r == NF_OK && opcode == BATTLE_OP_ENDGAME)
+    send_frame();
 }
 
 static void send_ship_type(uint16_t type, bool final)
 {
   bp_vs_pkt_t pkt;
   uint8_t *buf;
-  buf = sl_alloc();
+  buf = sl_pool_alloc(&nf_txpool);
   userconfig *config = getConfig();
 
   if (buf == NULL) {
@@ -3060,6 +3059,7 @@ static void send_ship_type(uint16_t type, bool final)
 
   if (bleL2CapSend((uint8_t *)buf, sizeof(bp_vs_pkt_t)) != NRF_SUCCESS)
   {
+    sl_pool_free(&nf_txpool, buf);
     screen_alert_draw(TRUE, "BLE XMIT FAILED!");
     chThdSleepMilliseconds(ALERT_DELAY);
     orchardAppExit();
@@ -3067,103 +3067,32 @@ static void send_ship_type(uint16_t type, bool final)
   }
 }
 
-static void send_position_update(uint16_t id, uint8_t opcode, uint8_t type, ENTITY *e)
+static void send_position_update(ENTITY *e)
 {
-  bp_entity_pkt_t pkt;
-  uint8_t *buf;
-  buf = sl_alloc();
-
-  if (buf == NULL) {
-    screen_alert_draw(TRUE, "PKT ALLOC FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
-
-  pkt.bp_header.bp_id = id;
-
-  // pkt.bp_header.bp_shiptype = 0x0; // we ignore this on update/create
-  pkt.bp_header.bp_opcode = opcode;
-  pkt.bp_header.bp_type   = type; // always enemy.
-
-  pkt.bp_x          = e->vecPosition.x;
-  pkt.bp_y          = e->vecPosition.y;
-  pkt.bp_velocity_x = e->vecVelocity.x;
-  pkt.bp_velocity_y = e->vecVelocity.y;
-  pkt.bp_velogoal_x = e->vecVelocityGoal.x;
-  pkt.bp_velogoal_y = e->vecVelocityGoal.y;
-  pkt.bp_faces_right = e->faces_right;
-
-  memcpy(buf, &pkt, sizeof(bp_entity_pkt_t));
-
-  if (bleL2CapSend((uint8_t *)buf, sizeof(bp_entity_pkt_t)) != NRF_SUCCESS)
-  {
-    screen_alert_draw(TRUE, "BLE XMIT FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
+  // if this doesn't fit, the next update carries the same changes
+  send_check(nf_add_entity(&netframe, e));
 }
 
 static void send_mine_create(ENTITY *e)
 {
-  bp_bullet_pkt_t *pkt;
-  uint8_t *buf;
-  buf = sl_alloc();
-
-  if (buf == NULL) {
-    screen_alert_draw(TRUE, "PKT ALLOC FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
-
-  // get private memory
-  pkt = (bp_bullet_pkt_t *)buf;
+  int i, r;
 
-  pkt->bp_header.bp_opcode = BATTLE_OP_MINE_CREATE;
-  pkt->bp_header.bp_type   = T_ENEMY; // always enemy.
-  pkt->bp_header.bp_id     = e->id;
-  pkt->bp_origin_x         = (uint16_t)e->vecPosition.x;
-  pkt->bp_origin_y         = (uint16_t)e->vecPosition.y;
+  for (i = 0; (r = nf_add_mine(&netframe)) == NF_NOMEM &&
+         i < SEND_RETRIES; i++)
+    chThdSleepMilliseconds(SEND_RETRY_MS);
 
-  if (bleL2CapSend((uint8_t *)buf, sizeof(bp_bullet_pkt_t)) != NRF_SUCCESS) {
-    screen_alert_draw(TRUE, "BLE XMIT FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
+  send_check(r);
 }
 
 static void send_bullet_create(ENTITY *e, int16_t dir_x, int16_t dir_y, uint8_t is_free)
 {
-  bp_bullet_pkt_t *pkt;
-  uint8_t *buf;
-  buf = sl_alloc();
+  int i, r;
 
-  if (buf == NULL) {
-    screen_alert_draw(TRUE, "PKT ALLOC FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
+  for (i = 0; (r = nf_add_bullet(&netframe, dir_x, dir_y, is_free)) == NF_NOMEM &&
+         i < SEND_RETRIES; i++)
+    chThdSleepMilliseconds(SEND_RETRY_MS);
 
-  // get private memory
-  pkt = (bp_bullet_pkt_t *)buf;
-
-  pkt->bp_header.bp_opcode = BATTLE_OP_ENTITY_CREATE;
-  pkt->bp_header.bp_type   = T_ENEMY; // always enemy.
-  pkt->bp_header.bp_id = e->id;
-  pkt->bp_dir_x      = dir_x;
-  pkt->bp_dir_y      = dir_y;
-  pkt->bp_is_free    = is_free;
-
-  if (bleL2CapSend((uint8_t *)buf, sizeof(bp_bullet_pkt_t)) != NRF_SUCCESS) {
-    screen_alert_draw(TRUE, "BLE XMIT FAILED!");
-    chThdSleepMilliseconds(ALERT_DELAY);
-    orchardAppExit();
-    return;
-  }
+  send_check(r);
 }
 
 static void state_vs_enter(void)
@@ -3258,6 +3187,6 @@ static void state_vs_tick(void)
 
 orchard_app("Sea Battle",
             "icons/ship.rgb",
-            0,
+            APP_FLAG_AUTOINIT,
             battle_init, battle_start,
             battle_event, battle_exit, 1);
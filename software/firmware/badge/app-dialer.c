@@ -4,11 +4,11 @@
 
 #include "nrf52i2s_lld.h"
 #include "ble_lld.h"
+#include "dds.h"
 
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <math.h>
 
 typedef struct dialer_button {
 	coord_t		button_x;
@@ -16,16 +16,15 @@ typedef struct dialer_button {
 	char *		button_text;
 	uint16_t	button_freq_a;
 	uint16_t	button_freq_b;
-	uint16_t	button_samples;
 } DIALER_BUTTON;
 
 #define DIALER_MAXBUTTONS 19
 #define DIALER_BLUEBOX
 
 /*
- * Pre-computed sample counts are based on a sample rate of
- * 30303 Hz. The original DC25 code used 29700Hz. 30303Hz is as close
- * as we can get with the nRF52 I2S module.
+ * Tones are synthesized at a sample rate of 30303 Hz. The original
+ * DC25 code used 29700Hz. 30303Hz is as close as we can get with the
+ * nRF52 I2S module.
  *
  * What is DIALER_OFFSET for, you ask? I'm actually not sure why, but
  * there seems to be a discrepancy between the programmed sample rate
@@ -45,57 +44,57 @@ typedef struct dialer_button {
 #define DIALER_SAMPLERATE	(DIALER_I2SRATE + DIALER_OFFSET)
 
 static const DIALER_BUTTON buttons[] =  {
-	{ 0,   0,   "1",     1209, 697,  1100 },
-	{ 60,  0,   "2",     1336, 697,  1012 },
-	{ 120, 0,   "3",     1477, 697,  924  },
-	{ 180, 0,   "A",     1633, 697,  836  }, 
-
-	{ 0,   60,  "4",     1209, 770,  200  },
-	{ 60,  60,  "5",     1336, 770,  920  },
-	{ 120, 60,  "6",     1477, 770,  840  },
-	{ 180, 60,  "B",     1633, 770,  760  }, 
-
-	{ 0,   120, "7",     1209, 852,  900  },
-	{ 60,  120, "8",     1336, 852,  828  },
-	{ 120, 120, "9",     1477, 852,  252  },
-	{ 180, 120, "C",     1633, 852,  684  }, 
-
-	{ 0,   180, "*",     1209, 941,  825  },
-	{ 60,  180, "0",     1336, 941,  759  },
-        { 120, 180, "#",     1477, 941,  231  },
-	{ 180, 180, "D",     1633, 941,  627  },
-
-	{ 0,   240, "2600",  2600, 2600, 110  },
+	{ 0,   0,   "1",     1209, 697 },
+	{ 60,  0,   "2",     1336, 697 },
+	{ 120, 0,   "3",     1477, 697 },
+	{ 180, 0,   "A",     1633, 697 }, 
+
+	{ 0,   60,  "4",     1209, 770 },
+	{ 60,  60,  "5",     1336, 770 },
+	{ 120, 60,  "6",     1477, 770 },
+	{ 180, 60,  "B",     1633, 770 }, 
+
+	{ 0,   120, "7",     1209, 852 },
+	{ 60,  120, "8",     1336, 852 },
+	{ 120, 120, "9",     1477, 852 },
+	{ 180, 120, "C",     1633, 852 }, 
+
+	{ 0,   180, "*",     1209, 941 },
+	{ 60,  180, "0",     1336, 941 },
+        { 120, 180, "#",     1477, 941 },
+	{ 180, 180, "D",     1633, 941 },
+
+	{ 0,   240, "2600",  2600, 2600 },
 #ifdef DIALER_BLUEBOX
-	{ 130, 240, "Blue Box", 0, 0,    0    },
+	{ 130, 240, "Blue Box", 0, 0 },
 #else
-	{ 130, 240, "",      0,    0,    0    },
+	{ 130, 240, "",      0,    0 },
 #endif
-	{ 70,  280, "Exit",  0,    0,    0    },
+	{ 70,  280, "Exit",  0,    0 },
 #ifdef DIALER_BLUEBOX
-	{ 0,   0,   "1",     700,  900,  748  },
-	{ 60,  0,   "2",     700,  1100, 308  },
-	{ 120, 0,   "3",     900,  1100, 476  },
-	{ 180, 0,   "KP1",   1100, 1700, 252  }, 
-
-	{ 0,   60,  "4",     700,  1300, 1012 },
-	{ 60,  60,  "5",     900,  1300, 2346 },
-	{ 120, 60,  "6",     1100, 1300, 644  },
-	{ 180, 60,  "KP2",   1300, 1700, 414  }, 
-
-	{ 0,   120, "7",     700,  1500, 220  },
-	{ 60,  120, "8",     900,  1500, 340  },
-	{ 120, 120, "9",     1100, 1500, 140  },
-	{ 180, 120, "ST",    1500, 1700, 180  }, 
-
-	{ 0,   180, "Code1", 700,  1700, 396  },
-	{ 60,  180, "0",     1300, 1500, 460  },
-        { 120, 180, "Code2", 900,  1700, 918  },
-	{ 180, 180,  "",     0,    0,    0    },
-
-	{ 0,   240, "2600",  2600, 2600, 110  },
-	{ 130, 240, "Silver Box",0,0,    0    },
-	{ 70,  280, "Exit",  0,    0,    0    }
+	{ 0,   0,   "1",     700,  900 },
+	{ 60,  0,   "2",     700,  1100 },
+	{ 120, 0,   "3",     900,  1100 },
+	{ 180, 0,   "KP1",   1100, 1700 }, 
+
+	{ 0,   60,  "4",     700,  1300 },
+	{ 60,  60,  "5",     900,  1300 },
+	{ 120, 60,  "6",     1100, 1300 },
+	{ 180, 60,  "KP2",   1300, 1700 }, 
+
+	{ 0,   120, "7",     700,  1500 },
+	{ 60,  120, "8",     900,  1500 },
+	{ 120, 120, "9",     1100, 1500 },
+	{ 180, 120, "ST",    1500, 1700 }, 
+
+	{ 0,   180, "Code1", 700,  1700 },
+	{ 60,  180, "0",     1300, 1500 },
+        { 120, 180, "Code2", 900,  1700 },
+	{ 180, 180,  "",     0,    0 },
+
+	{ 0,   240, "2600",  2600, 2600 },
+	{ 130, 240, "Silver Box",0,0 },
+	{ 70,  280, "Exit",  0,    0 }
 #endif
 };
 
@@ -114,65 +113,6 @@ typedef struct _DHandles {
 	orientation_t		o;
 } DHandles;
 
-#ifdef CALIBRATION
-
-#include "badge.h"
-
-#define DIALER_MATCHES 6
-#define DIALER_SAMPLES 4096
-
-static uint16_t buf[DIALER_SAMPLES];
-
-void
-calc (uint8_t b)
-{
-	uint32_t i;
-	double fract1;
-	double fract2;
-	double point1;
-	double point2;
-	double result;
-	double pi;
-	uint16_t freqa;
-	uint16_t freqb;
-	uint16_t matches[DIALER_MATCHES];
-
-	freqa = buttons[b].button_freq_a;
-	freqb = buttons[b].button_freq_b;
-
-	if (freqa == 0 && freqa == 0)
-		return;
-
-	pi = (3.14159265358979323846264338327950288 * 2);
-
-	fract1 = (double)(pi)/(double)(DIALER_SAMPLERATE/freqa);
-	fract2 = (double)(pi)/(double)(DIALER_SAMPLERATE/freqb);
-
-	for (i = 0; i < DIALER_SAMPLES; i++) {
-		point1 = fract1 * i;
-		result = 16383 + (sin (point1) * 16383);
-		point2 = fract2 * i;
-		result += 16383 + (sin (point2) * 16383);
-		result /= 2.0;
-		buf[i] = (uint16_t)round (result);
-		buf[i] = ~(buf[i]) + 1;
-		if (i < DIALER_MATCHES)
-			matches[i] = buf[i];
-		if (i > 50) {
-			if (memcmp (&buf[i - DIALER_MATCHES], matches,
-			    sizeof(uint16_t) * DIALER_MATCHES) == 0)
-				break;
-		}
-	}
-
-	i -= DIALER_MATCHES;
-
-	printf ("SAMPLES: %d\r\n", i);
-
-	return;
-}
-#endif
-
 static void
 dialer_i2s_init (void)
 {
@@ -241,71 +181,65 @@ dialer_i2s_restore (void)
 	return;
 }
 
+/*
+ * Tones are synthesized a block at a time while the previous block
+ * plays, so a key press starts making noise right away. The short
+ * attack and release keep the tones from clicking.
+ */
+
+#define DIALER_BLOCK		256
+#define DIALER_AMP		(DDS_AMP_MAX / 2)
+#define DIALER_RAMP		(DIALER_SAMPLERATE / 500)	/* 2ms */
+
+static int16_t dialer_buf[2][DIALER_BLOCK];
+
 void
 tonePlay (GWidgetObject * w, uint8_t b, uint32_t duration)
 {
-	uint32_t i;
-	double fract1;
-	double fract2;
-	double point1;
-	double point2;
-	double result;
-	double pi;
-	uint16_t * buf;
+	DDS_TONE t;
 	uint16_t freqa;
 	uint16_t freqb;
-	uint16_t samples;
+	int16_t * p;
+	int cnt;
 
 	freqa = buttons[b].button_freq_a;
 	freqb = buttons[b].button_freq_b;
 
-	if (freqa == 0 && freqa == 0)
+	if (freqa == 0 && freqb == 0)
 		return;
 
-	samples = buttons[b].button_samples;
+	ddsInit (&t, DIALER_SAMPLERATE, freqa, freqb, DIALER_AMP);
+	if (w == NULL)
+		ddsEnvelope (&t, (duration * DIALER_SAMPLERATE) / 1000,
+		    DIALER_RAMP, DIALER_RAMP);
+	else
+		ddsEnvelope (&t, 0, DIALER_RAMP, DIALER_RAMP);
 
-	buf = malloc (samples * sizeof(uint16_t));
+	chThdSetPriority (HIGHPRIO - 5);
+	dialer_i2s_init ();
 
-	pi = (3.14159265358979323846264338327950288 * 2);
+	p = dialer_buf[0];
+	cnt = ddsFill (&t, p, DIALER_BLOCK, 1);
 
-	fract1 = (double)(pi)/(double)(DIALER_SAMPLERATE/freqa);
-	fract2 = (double)(pi)/(double)(DIALER_SAMPLERATE/freqb);
+	while (cnt != 0) {
+		i2sSamplesPlay (p, cnt);
 
-	for (i = 0; i < samples; i++) {
-		point1 = fract1 * i;
-		result = 16383 + (sin (point1) * 16383);
-		point2 = fract2 * i;
-		result += 16383 + (sin (point2) * 16383);
-		result /= 2.0;
-		buf[i] = (uint16_t)round (result);
-		buf[i] = ~(buf[i]) + 1;
-	}
+		if (w != NULL && (w->g.flags & GBUTTON_FLG_PRESSED) == 0)
+			ddsRelease (&t);
 
-	chThdSetPriority (HIGHPRIO - 5);
-	dialer_i2s_init ();
+		/* Make the next block while this one plays. */
+
+		p = (p == dialer_buf[0]) ? dialer_buf[1] : dialer_buf[0];
+		cnt = ddsFill (&t, p, DIALER_BLOCK, 1);
 
-	i = 0;
-	while (1) {
-		i2sSamplesPlay (buf, samples);
-		if (w == NULL) {
-			i += samples;
-			if (i > (duration * (DIALER_SAMPLERATE / 1000)))
-				break;
-		} else {
-			if ((w->g.flags & GBUTTON_FLG_PRESSED) == 0)
-				break;
-		}
 		i2sSamplesWait ();
 	}
 
-	i2sSamplesWait ();
 	i2sSamplesStop ();
 
 	dialer_i2s_restore ();
 	chThdSetPriority (ORCHARD_APP_PRIO);
 
-	free (buf);
-
 	return;
 }
 
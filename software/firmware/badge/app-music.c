@@ -41,9 +41,7 @@
 
 #include "async_io_lld.h"
 
-#include "fix_fft.h"
-
-#include "src/gdisp/gdisp_driver.h"
+#include "spectrum.h"
 
 #include "fontlist.h"
 
@@ -56,11 +54,13 @@
 
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
 
 #define MUSIC_SAMPLES 2048
 #define MUSIC_BYTES (MUSIC_SAMPLES * 2)
 #define MUSIC_FFT_MAX_AMPLITUDE 128
+#define MUSIC_BANDS 64
+#define MUSIC_BAND_STEP 5
+#define MUSIC_BAND_WIDTH 4
 
 #define BACKGROUND HTML2COLOR(0x470b67)
 #define MUSICDIR "/sound"
@@ -69,8 +69,10 @@ typedef struct _MusicHandles {
 	char **			listitems;
 	int			itemcnt;
 	OrchardUiContext	uiCtx;
-	short			real[MUSIC_SAMPLES / 2];
-	short			imaginary[MUSIC_SAMPLES / 2];
+	SPECTRUM		sp;
+	SPECTRUM_BARS		bars;
+	uint8_t			rows[MUSIC_BANDS];
+	uint8_t			peaks[MUSIC_BANDS];
 } MusicHandles;
 
 
@@ -144,49 +146,13 @@ music_start (OrchardAppContext *context)
 	return;
 }
 
-static void
-columnDraw (int col, short amp)
-{
-	int y;
-
-	/* Clamp the amplitude at 128 pixels */
-
-	if (amp > MUSIC_FFT_MAX_AMPLITUDE)
-		amp = MUSIC_FFT_MAX_AMPLITUDE;
-
-	GDISP->p.x = col;
-
-	/* Now draw the column */
-
-	gdisp_lld_write_start (GDISP);
-	for (y = MUSIC_FFT_MAX_AMPLITUDE; y > 0; y--) {
-		if (y > amp)
-			GDISP->p.color = Black;
-		else {
-			if (y >= 0 && y < 32)
-				GDISP->p.color = Lime;
-			if (y >= 32 && y < 64)
-				GDISP->p.color = Yellow;
-			if (y >= 64 && y <= 128)
-				GDISP->p.color = Red;
-		}
-		gdisp_lld_write_color (GDISP);
-	}
-	gdisp_lld_write_stop (GDISP);
-
-	return;
-}
-
 static void
 musicVisualize (MusicHandles * p, uint16_t * samples)
 {
-	unsigned int sum;
-	short b;
 	int i;
-	int r;
 
 	/*
-	 * Gather up one channel's worth of samples.
+	 * Analyse one channel's worth of samples.
 	 *
 	 * Note: each sample is supposed to be a raw signed integer.
 	 * Technically we're using the 2s complement values here. We
@@ -195,66 +161,28 @@ musicVisualize (MusicHandles * p, uint16_t * samples)
 	 * save some CPU cycles here and just don't bother.
 	 */
 
-	for (i = 0; i < MUSIC_SAMPLES / 2; i++) {
-		p->real[i] = samples[i * 2];
-		p->imaginary[i] = 0;
-	}
+	spectrumRun (&p->sp, (int16_t *)samples, 2);
 
-	/* Perform FFT calculation. 1<<10 is 1024, so m here is 10. */
+	/* Use the overall level to frob the LEDs. */
 
-	fix_fft (p->real, p->imaginary, 10, 0);
+	ledDraw ((p->sp.sp_loud * LED_COUNT_INTERNAL) /
+	    (SPECTRUM_LEVEL_MAX + 1));
 
 	/*
-	 * Combine real and imaginary parts into absolute values. This
-	 * is done by summing the square of the real portion and the
-	 * square of the imaginary portion, then taking the square
-	 * root.
-	 *
-	 * Note: we only use half the array in the output compared to
-	 * the input. That is, we fed in 1024 samples, but we only use
-	 * 512 output bins. It looks like the remaining 512 bins are
-	 * just a mirror image of the first 512.
-	 *
-	 * We also apply some scaling by dividing the amplitude values
-	 * by 14. This seems to yield a reasonable range.
+	 * Draw the bar graph, one column per band, with the peak
+	 * sitting on top. Levels run to 255 and the columns are 128
+	 * pixels tall. Only columns that changed get redrawn.
 	 */
 
-	r = 0;
-
-	for (i = 0; i < MUSIC_SAMPLES / 4; i++) {
-		sum = ((p->real[i] * p->real[i]) +
-		    (p->imaginary[i] * p->imaginary[i]));
-		p->real[i] = (short)(sqrt (sum) / 14.0);
-		r += p->real[i];
+	for (i = 0; i < MUSIC_BANDS; i++) {
+		p->rows[i] = p->sp.sp_level[i] >> 1;
+		if (p->sp.sp_peak[i] == 0)
+			p->peaks[i] = SPECTRUM_NOPEAK;
+		else
+			p->peaks[i] = p->sp.sp_peak[i] >> 1;
 	}
 
-	/*
-	 * Take an average of the sample amplitudes and use it to
-	 * frob the LEDs.
-	 */
-
-	r >>= 9;
-	b = r;
-	ledDraw (b);
-
-	/*
-	 * Draw the bar graph. We draw 160 bars that are each one pixel
-	 * wide with one pixel of spacing in between. Each bar contains 3
-	 * adjacent bins averaged together, which ads up to 480 bins.
-	 * This leaves 32 bins left over. We start from the 16th bin
-	 * so that the lowest and highest 16 bins are ones that are
-	 * left undisplayed.
-	 */
-
-	r = 16;
-	for (i = 0; i < 320; i += 2) {
-		b = p->real[r];
-		b += p->real[r + 1];
-		b += p->real[r + 2];
-		b /= 3;
-		r += 3;
-		columnDraw (i, b);
-	}
+	spectrumBarsDraw (&p->bars, p->rows, p->peaks);
 
 	return;
 }
@@ -282,11 +210,31 @@ musicPlay (MusicHandles * p, char * fname)
 	i2sEnabled = FALSE;
         ledStop();
 
-	/* Initialize some of the display write window info. */
+	/*
+	 * Set up the analysis and the bar graph. The bands run from
+	 * bin 2 to the top of the spectrum, about 30Hz to 7.8KHz.
+	 */
 
-	GDISP->p.y = 240 - MUSIC_FFT_MAX_AMPLITUDE;
-	GDISP->p.cx = 1;
-	GDISP->p.cy = MUSIC_FFT_MAX_AMPLITUDE;
+	spectrumInit (&p->sp, MUSIC_BANDS, 2, SPECTRUM_BINS);
+
+	p->bars.sb_x = (gdispGetWidth () -
+	    (MUSIC_BANDS * MUSIC_BAND_STEP)) / 2;
+	p->bars.sb_y = gdispGetHeight () - MUSIC_FFT_MAX_AMPLITUDE;
+	p->bars.sb_step = MUSIC_BAND_STEP;
+	p->bars.sb_width = MUSIC_BAND_WIDTH;
+	p->bars.sb_height = MUSIC_FFT_MAX_AMPLITUDE;
+	p->bars.sb_count = MUSIC_BANDS;
+	p->bars.sb_bg = Black;
+	p->bars.sb_peakcolor = White;
+	p->bars.sb_color[0] = Lime;
+	p->bars.sb_color[1] = Yellow;
+	p->bars.sb_color[2] = Red;
+	p->bars.sb_zone[0] = 32;
+	p->bars.sb_zone[1] = 64;
+
+	gdispFillArea (0, p->bars.sb_y, gdispGetWidth (),
+	    MUSIC_FFT_MAX_AMPLITUDE, Black);
+	spectrumBarsReset (&p->bars);
 
 	if (f_open (&f, fname, FA_READ) != FR_OK)
 		return (0);
@@ -35,26 +35,297 @@
 
 #include "ble_lld.h"
 #include "ble_gap_lld.h"
+#include "ble_l2cap_lld.h"
 #include "ble_gattc_lld.h"
 #include "ble_gatts_lld.h"
 #include "nrf52i2s_lld.h"
 #include "ides_gfx.h"
 #include "ff.h"
 #include "crc32.h"
+#include "ota.h"
 
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 
+#define OTA_POLL_US	100000	/* How often we check on the writer */
+#define OTA_ACK_CHUNKS	2	/* Acknowledge at least this often */
+#define OTA_SYNC_BYTES	32768	/* Checkpoint interval */
+#define OTA_SHOW_BYTES	16384	/* Screen update interval */
+
+/*
+ * OTA.RES records how much of OTA.BIN is safely on the card, and
+ * for which image, so that a transfer that gets cut off can pick up
+ * where it left off instead of starting over.
+ */
+
+#define OTA_RESUME_MAGIC	0x4F544152	/* "OTAR" */
+
+typedef struct _OtaResume {
+	uint32_t		or_magic;
+	uint32_t		or_size;
+	uint32_t		or_imgcrc;
+	uint32_t		or_off;
+	uint32_t		or_crc;		/* Running CRC up to or_off */
+} OtaResume;
+
+#define OTA_RX_BUSY	0
+#define OTA_RX_DONE	1	/* Image complete and CRC good */
+#define OTA_RX_FAILED	2	/* Bad image CRC or write error */
+
+OTA_STATS ota_rx_stats;
+
+/*
+ * Chunks that pass their checks are queued in a small ring and
+ * written to the SD card by a separate thread, so the radio events
+ * keep being serviced while FatFs is busy.
+ */
+
 typedef struct _OtaHandles {
 	FIL			f;
-	uint32_t		total;
-	uint32_t		crc;
-	uint32_t		sent_crc;
+	uint8_t			ring[OTA_WINDOW][OTA_PKT];
+	semaphore_t		ring_free;
+	semaphore_t		ring_full;
+	volatile uint32_t	ring_head;
+	volatile uint32_t	ring_tail;
+	thread_t *		pThread;
+	uint32_t		size;
+	uint32_t		imgcrc;
+	uint32_t		rx_next;	/* Next offset we'll accept */
+	uint32_t		nak_off;	/* Offset we last NAKed */
+	uint32_t		synced;		/* Offset in OTA.RES */
+	uint32_t		shown;
+	CRC32_CTX		crc;
+	uint8_t			started;
+	volatile uint8_t	rx_state;
 	int			status;
 	GListener		gl;
 } OtaHandles;
-	
+
+static THD_WORKING_AREA(waOtaWriteThread, 1024);
+
+/*
+ * ACKs and NAKs go out of a pair of buffers. The SoftDevice keeps a
+ * buffer until the reply in it has been sent, so one isn't reused
+ * until it comes back through ble_l2cap_tx_release. They're static
+ * so that a reply still queued when we exit isn't freed under the
+ * SoftDevice. Both the writer thread and the event handler reply,
+ * so picking a buffer is done under ota_reply_mtx.
+ */
+
+#define OTA_REPLIES	2
+#define OTA_REPLY_WAIT	50	/* ms to wait for a buffer to come back */
+
+static ota_hdr_t ota_reply[OTA_REPLIES];
+static volatile uint8_t ota_reply_busy[OTA_REPLIES];
+static MUTEX_DECL(ota_reply_mtx);
+static void (*ota_tx_release_prev)(void *);
+
+static void
+otaTxRelease (void * buf)
+{
+	int i;
+
+	for (i = 0; i < OTA_REPLIES; i++) {
+		if (buf == &ota_reply[i]) {
+			ota_reply_busy[i] = FALSE;
+			return;
+		}
+	}
+
+	/* Not ours; pass it on to whoever had the hook before us */
+
+	if (ota_tx_release_prev != NULL)
+		ota_tx_release_prev (buf);
+
+	return;
+}
+
+static void
+otaResumeSave (OtaHandles * p)
+{
+	OtaResume r;
+	FIL f;
+	UINT bw;
+
+	r.or_magic = OTA_RESUME_MAGIC;
+	r.or_size = p->size;
+	r.or_imgcrc = p->imgcrc;
+	r.or_off = p->crc.len;
+	r.or_crc = p->crc.crc;
+
+	if (f_open (&f, "OTA.RES", FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+		return;
+	f_write (&f, &r, sizeof(r), &bw);
+	f_close (&f);
+
+	p->synced = r.or_off;
+
+	return;
+}
+
+/*
+ * The sender has announced an image. If we have part of that same
+ * image from last time, carry on from the last checkpoint, otherwise
+ * start from scratch. Returns the offset to start from.
+ */
+
+static uint32_t
+otaResumeLoad (OtaHandles * p)
+{
+	OtaResume r;
+	FIL f;
+	UINT br;
+
+	crc32_init (&p->crc, CRC_INIT);
+
+	if (f_open (&f, "OTA.RES", FA_READ) == FR_OK) {
+		if (f_read (&f, &r, sizeof(r), &br) != FR_OK)
+			br = 0;
+		f_close (&f);
+		if (br == sizeof(r) && r.or_magic == OTA_RESUME_MAGIC &&
+		    r.or_size == p->size && r.or_imgcrc == p->imgcrc &&
+		    r.or_off <= r.or_size && r.or_off <= f_size (&p->f)) {
+			p->crc.crc = r.or_crc;
+			p->crc.len = r.or_off;
+		}
+	}
+
+	f_lseek (&p->f, p->crc.len);
+	f_truncate (&p->f);
+	p->synced = p->crc.len;
+
+	return (p->crc.len);
+}
+
+/*
+ * If both buffers are still queued for longer than OTA_REPLY_WAIT,
+ * the link has stalled and the reply is dropped. The sender times
+ * out and resends, and that gets another reply.
+ */
+
+static void
+otaReply (uint8_t op, uint8_t flags, uint32_t off)
+{
+	ota_hdr_t * h;
+	int i, wait;
+
+	chMtxLock (&ota_reply_mtx);
+
+	for (wait = 0; ; wait++) {
+		for (i = 0; i < OTA_REPLIES; i++) {
+			if (ota_reply_busy[i] == FALSE)
+				break;
+		}
+		if (i < OTA_REPLIES || wait == OTA_REPLY_WAIT)
+			break;
+		chThdSleepMilliseconds (1);
+	}
+
+	if (i == OTA_REPLIES) {
+		chMtxUnlock (&ota_reply_mtx);
+		return;
+	}
+
+	h = &ota_reply[i];
+	h->ota_op = op;
+	h->ota_flags = flags;
+	h->ota_len = 0;
+	h->ota_off = off;
+	h->ota_crc = 0;
+	h->ota_size = 0;
+
+	ota_reply_busy[i] = TRUE;
+	if (bleL2CapSend ((uint8_t *)h, sizeof(ota_hdr_t)) != NRF_SUCCESS)
+		ota_reply_busy[i] = FALSE;
+
+	chMtxUnlock (&ota_reply_mtx);
+
+	return;
+}
+
+static THD_FUNCTION(otaWriteThread, arg)
+{
+	OtaHandles * p;
+	ota_hdr_t * h;
+	uint8_t * buf;
+	uint32_t unacked;
+	UINT bw;
+
+	p = arg;
+	unacked = 0;
+
+	chRegSetThreadName ("OtaWrite");
+
+	while (1) {
+		chSemWait (&p->ring_full);
+
+		/* Woken with nothing queued means we're being told to stop */
+
+		if (p->ring_tail == p->ring_head)
+			break;
+
+		buf = p->ring[p->ring_tail % OTA_WINDOW];
+		h = (ota_hdr_t *)buf;
+
+		if (p->rx_state == OTA_RX_BUSY) {
+			if (f_write (&p->f, buf + sizeof(ota_hdr_t),
+			    h->ota_len, &bw) != FR_OK || bw != h->ota_len) {
+				p->rx_state = OTA_RX_FAILED;
+				otaReply (OTA_OP_FAIL, 0, p->crc.len);
+			} else
+				crc32_update (&p->crc, buf + sizeof(ota_hdr_t),
+				    h->ota_len);
+		}
+
+		p->ring_tail++;
+		chSemSignal (&p->ring_free);
+
+		if (p->rx_state != OTA_RX_BUSY)
+			continue;
+
+		unacked++;
+
+		if (p->crc.len == p->size) {
+			f_sync (&p->f);
+			ota_rx_stats.st_off = p->crc.len;
+			ota_rx_stats.st_end = chVTGetSystemTime ();
+			if (crc32_final (&p->crc) == p->imgcrc) {
+				p->rx_state = OTA_RX_DONE;
+				otaReply (OTA_OP_ACK, OTA_ACK_DONE, p->crc.len);
+			} else {
+				p->rx_state = OTA_RX_FAILED;
+				otaReply (OTA_OP_FAIL, 0, p->crc.len);
+			}
+			continue;
+		}
+
+		/* Checkpoint so an interrupted transfer can resume */
+
+		if (p->crc.len - p->synced >= OTA_SYNC_BYTES) {
+			f_sync (&p->f);
+			otaResumeSave (p);
+		}
+
+		/*
+		 * Acknowledge what's been written. Batch them up a little
+		 * while there's more in the ring, but never sit on more
+		 * than OTA_ACK_CHUNKS or the sender's window stalls.
+		 */
+
+		if (p->ring_tail == p->ring_head ||
+		    unacked >= OTA_ACK_CHUNKS) {
+			ota_rx_stats.st_off = p->crc.len;
+			otaReply (OTA_OP_ACK, 0, p->crc.len);
+			unacked = 0;
+		}
+	}
+
+	chThdExit (MSG_OK);
+
+	return;
+}
+
 static uint32_t
 ota_init (OrchardAppContext *context)
 {
@@ -77,38 +348,98 @@ ota_start (OrchardAppContext *context)
 	putImageFile ("images/fwupdate.rgb", 0, 0);
 
 	p = malloc (sizeof (OtaHandles));
+	memset (p, 0, sizeof (OtaHandles));
 	context->priv = p;
-	p->total = 0;
-	p->status = 0;
-	p->crc = CRC_INIT;
+	p->nak_off = 0xFFFFFFFF;
+
+	chSemObjectInit (&p->ring_free, OTA_WINDOW);
+	chSemObjectInit (&p->ring_full, 0);
+
+	/*
+	 * The last session's link is gone, and the SoftDevice gave up
+	 * its buffers with it.
+	 */
+
+	memset ((void *)ota_reply_busy, 0, sizeof(ota_reply_busy));
+	ota_tx_release_prev = ble_l2cap_tx_release;
+	ble_l2cap_tx_release = otaTxRelease;
 
 	gs = ginputGetMouse (0);
 	geventListenerInit (&p->gl);
 	geventAttachSource (&p->gl, gs, GLISTEN_MOUSEMETA);
 	geventRegisterCallback (&p->gl, orchardAppUgfxCallback, &p->gl);
 
-	f_unlink ("OTA.BIN");
-	if (f_open (&p->f, "OTA.BIN", FA_WRITE|FA_CREATE_NEW) != FR_OK) {
+	/* Keep any partial image around in case we can resume it */
+
+	if (f_open (&p->f, "OTA.BIN", FA_READ|FA_WRITE|FA_OPEN_ALWAYS)
+	    != FR_OK) {
 		screen_alert_draw (FALSE, "Opening firmware file failed!");
 		chThdSleepMilliseconds (2000);
 		p->status = -1;
 		orchardAppExit ();
 	} else {
+		p->pThread = chThdCreateStatic (waOtaWriteThread,
+		    sizeof(waOtaWriteThread), NORMALPRIO - 10,
+		    otaWriteThread, p);
+		orchardAppTimer (context, OTA_POLL_US, TRUE);
 		screen_alert_draw (FALSE, "Starting...");
 	}
 
 	return;
 }
 
+/*
+ * Check a chunk from the sender and queue it for the writer. Anything
+ * that isn't the next chunk we expect, or that fails its CRC, is
+ * dropped, and the sender gets one NAK telling it where to go back
+ * to. Further strays before it gets there are dropped quietly.
+ */
+
+static void
+otaData (OtaHandles * p, uint8_t * pkt, uint16_t len)
+{
+	ota_hdr_t * h;
+
+	h = (ota_hdr_t *)pkt;
+
+	if (h->ota_len != len - sizeof(ota_hdr_t) ||
+	    h->ota_off != p->rx_next ||
+	    h->ota_off + h->ota_len > p->size ||
+	    crc32_le (pkt + sizeof(ota_hdr_t), h->ota_len,
+	    CRC_INIT) != h->ota_crc) {
+		if (h->ota_off == p->rx_next)
+			ota_rx_stats.st_badcrc++;
+		if (p->nak_off != p->rx_next) {
+			p->nak_off = p->rx_next;
+			ota_rx_stats.st_naks++;
+			otaReply (OTA_OP_NAK, 0, p->rx_next);
+		}
+		return;
+	}
+
+	/* Wait for the writer if it's fallen behind */
+
+	chSemWait (&p->ring_free);
+	memcpy (p->ring[p->ring_head % OTA_WINDOW], pkt, len);
+	p->ring_head++;
+	chSemSignal (&p->ring_full);
+
+	p->rx_next += h->ota_len;
+	p->nak_off = 0xFFFFFFFF;
+	ota_rx_stats.st_chunks++;
+
+	return;
+}
+
 static void
 ota_event (OrchardAppContext *context,
 	const OrchardAppEvent *event)
 {
 	OrchardAppRadioEvent *	radio;
-	char			buf[32];
+	char			buf[64];
 	uint8_t			reply;
-	UINT			br;
 	OtaHandles *		p;
+	ota_hdr_t *		h;
 	GEventMouse *		me;
 
 	p = context->priv;
@@ -138,6 +469,30 @@ ota_event (OrchardAppContext *context,
 		}
 	}
 
+	/* See how the writer is getting on */
+
+	if (event->type == timerEvent && p->started == TRUE) {
+		if (p->rx_state == OTA_RX_DONE) {
+			sprintf (buf, "Received %ld bytes, %ldKB/s",
+			    p->size, otaRate (&ota_rx_stats) / 1024);
+			screen_alert_draw (FALSE, buf);
+			chThdSleepMilliseconds (1000);
+			p->started = FALSE;
+			orchardAppExit ();
+		} else if (p->rx_state == OTA_RX_FAILED) {
+			screen_alert_draw (FALSE, "Bad checksum - aborting");
+			chThdSleepMilliseconds (2000);
+			p->started = FALSE;
+			p->status = -1;
+			orchardAppExit ();
+		} else if (ota_rx_stats.st_off - p->shown >= OTA_SHOW_BYTES) {
+			p->shown = ota_rx_stats.st_off;
+			sprintf (buf, "Received %ld bytes, %ldKB/s",
+			    p->shown, otaRate (&ota_rx_stats) / 1024);
+			screen_alert_draw (FALSE, buf);
+		}
+	}
+
 	if (event->type == radioEvent) {
 		radio = (OrchardAppRadioEvent *)&event->radio;
 
@@ -146,40 +501,60 @@ ota_event (OrchardAppContext *context,
 			case l2capConnectEvent:
 				screen_alert_draw (FALSE, "Receiving...");
 				break;
-			/* Data received, write it to the file */
+			/* Protocol packet from the sender */
 			case l2capRxEvent:
-				p->total += radio->pktlen;
-				sprintf (buf, "Received %ld bytes", p->total);
-				screen_alert_draw (FALSE, buf);
+				if (radio->pktlen < sizeof(ota_hdr_t))
+					break;
+				h = (ota_hdr_t *)radio->pkt;
+				if (h->ota_op == OTA_OP_DATA &&
+				    p->started == TRUE &&
+				    p->rx_state == OTA_RX_BUSY)
+					otaData (p, radio->pkt, radio->pktlen);
 				/*
-				 * If we receive exactly 4 bytes, it's the
-				 * data checksum, and we don't need to write
-				 * it to the file.
+				 * The START may be repeated if our ACK
+				 * was slow, but once data is flowing
+				 * we stay where we are.
 				 */
-				if (radio->pktlen == 4)
-					memcpy (&p->sent_crc, radio->pkt, 4);
-				else {
-					p->crc = crc32_le (radio->pkt,
-					    radio->pktlen, p->crc);
-					if (f_write (&p->f, radio->pkt,
-					    radio->pktlen, &br) != FR_OK) {
-						screen_alert_draw (FALSE,
-						    "Writing failed!");
-						p->status = -1;
-						orchardAppExit ();
+				else if (h->ota_op == OTA_OP_START &&
+				    p->ring_head == 0) {
+					p->size = h->ota_size;
+					p->imgcrc = h->ota_crc;
+					p->rx_next = otaResumeLoad (p);
+					p->started = TRUE;
+					memset (&ota_rx_stats, 0,
+					    sizeof(ota_rx_stats));
+					ota_rx_stats.st_size = p->size;
+					ota_rx_stats.st_resume = p->rx_next;
+					ota_rx_stats.st_off = p->rx_next;
+					ota_rx_stats.st_start =
+					    chVTGetSystemTime ();
+					p->shown = p->rx_next;
+					if (p->rx_next) {
+						sprintf (buf,
+						    "Resuming at %ld bytes",
+						    p->rx_next);
+						screen_alert_draw (FALSE, buf);
 					}
+					otaReply (OTA_OP_ACK, 0, p->rx_next);
 				}
 				break;
-			/* L2CAP link closed -- transfer complete */
+			/* L2CAP link closed */
 			case l2capDisconnectEvent:
-				sprintf (buf, "Received %ld bytes", p->total);
-				screen_alert_draw (FALSE, buf);
-				chThdSleepMilliseconds (3000);
+				if (p->rx_state == OTA_RX_BUSY) {
+					ota_rx_stats.st_end =
+					    chVTGetSystemTime ();
+					sprintf (buf, "Stopped at %ld bytes",
+					    ota_rx_stats.st_off);
+					screen_alert_draw (FALSE, buf);
+					chThdSleepMilliseconds (3000);
+				}
 				break;
 			/* For any of these events, bail out. */
 			case l2capConnectRefusedEvent:
 			case disconnectEvent:
 			case connectTimeoutEvent:
+				if (p->rx_state != OTA_RX_DONE)
+					p->status = -1;
 				orchardAppExit ();
 				break;
 			default:
@@ -195,31 +570,49 @@ ota_exit (OrchardAppContext *context)
 {
 	OtaHandles * p;
 	int status;
-	uint32_t crc, sent_crc;
+	uint8_t rx_state;
 
 	p = context->priv;
+
+	/* Let the writer finish what's queued, then stop it */
+
+	if (p->pThread != NULL) {
+		chSemSignal (&p->ring_full);
+		chThdWait (p->pThread);
+	}
+
+	rx_state = p->rx_state;
 	status = p->status;
-	crc = p->crc;
-	sent_crc = p->sent_crc;
+
+	/*
+	 * If we were cut off part way, checkpoint what we have so the
+	 * sender can pick up from there next time.
+	 */
+
+	if (p->started == TRUE && rx_state == OTA_RX_BUSY) {
+		f_sync (&p->f);
+		otaResumeSave (p);
+	}
+
 	f_close (&p->f);
+	ble_l2cap_tx_release = ota_tx_release_prev;
 	geventRegisterCallback (&p->gl, NULL, NULL);
 	geventDetachSource (&p->gl, NULL);
 
 	free (p);
 
+	if (rx_state == OTA_RX_FAILED) {
+		f_unlink ("OTA.RES");
+		f_unlink ("OTA.BIN");
+	}
+
 	/* Launch the firmware updater */
 
-	if (status == 0) {
-		if (crc != sent_crc) {
-			screen_alert_draw (FALSE,
-			    "Bad checksum - aborting");
-			f_unlink ("OTA.BIN");
-			chThdSleepMilliseconds (2000);
-		} else {
-			f_unlink ("BADGE.BIN");
-			f_rename ("OTA.BIN", "BADGE.BIN");
-			orchardAppRun (orchardAppByName ("Update FW"));
-		}
+	if (status == 0 && rx_state == OTA_RX_DONE) {
+		f_unlink ("OTA.RES");
+		f_unlink ("BADGE.BIN");
+		f_rename ("OTA.BIN", "BADGE.BIN");
+		orchardAppRun (orchardAppByName ("Update FW"));
 	} else
 		bleGapDisconnect ();
 
@@ -44,57 +44,291 @@
 #include "ble_peer.h"
 #include "nrf52i2s_lld.h"
 #include "nullprot_lld.h"
+#include "async_io_lld.h"
 #include "ides_gfx.h"
 #include "crc32.h"
+#include "ota.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
 
-#define OTA_SIZE	BLE_IDES_L2CAP_MTU
+#define OTA_PUMP_US	20000	/* Window service interval */
+#define OTA_SHOW_BYTES	16384	/* Screen update interval */
+
+/*
+ * Each window slot holds one DATA packet, header and payload
+ * together, so it can be handed to the SoftDevice as is.
+ */
+
+#define OTA_SLOT_FREE		0
+#define OTA_SLOT_READING	1	/* Async read in progress */
+#define OTA_SLOT_READY		2	/* Waiting to be sent */
+#define OTA_SLOT_SENT		3	/* Waiting to be acknowledged */
+#define OTA_SLOT_ACKED		4	/* Acknowledged, SoftDevice still has it */
+
+typedef struct _OtaSlot {
+	uint8_t		ots_pkt[OTA_PKT];
+	uint8_t		ots_state;
+	uint8_t		ots_queued;	/* Copies the SoftDevice holds */
+	ASYNC_IO_REQ	ots_req;
+} OtaSlot;
 
 extern uint32_t __ram7_init_text__;
 static uint8_t clone;
 
+OTA_STATS ota_tx_stats;
+
 typedef struct _OtaHandles {
 	FIL		f;
-	uint8_t		txbuf[OTA_SIZE];
-	uint8_t		retry;
-	uint32_t	size;
-	uint32_t	last;
-	uint32_t	crc;
-	uint32_t	send_crc;
+	OtaSlot		slot[OTA_WINDOW];
+	ota_hdr_t	start;
+	uint32_t	imgcrc;
 	uint32_t	fwsize;
-	uint32_t	fwcnt;
 	uint8_t	*	fwpos;
+	uint32_t	base;		/* Lowest unacknowledged offset */
+	uint32_t	next;		/* Next offset to read */
+	uint32_t	shown;
+	systime_t	progress;	/* When base last moved */
+	uint8_t		started;
 	char *		listitems[BLE_PEER_LIST_SIZE + 2];
 	ble_gap_addr_t	listaddrs[BLE_PEER_LIST_SIZE + 2];
 	OrchardUiContext uiCtx;
 	GListener	gl;
 } OtaHandles;
 
+/*
+ * Work out the CRC of the whole image up front, since it goes
+ * out in the START packet. The first slot's buffer is free at
+ * this point, so we read through it.
+ */
+
+static int
+otaImageCrc (OtaHandles * p)
+{
+	CRC32_CTX ctx;
+	UINT br;
+
+	crc32_init (&ctx, CRC_INIT);
+
+	if (clone == TRUE)
+		crc32_update (&ctx, p->fwpos, p->fwsize);
+	else {
+		p->fwsize = f_size (&p->f);
+		while (1) {
+			if (f_read (&p->f, p->slot[0].ots_pkt,
+			    OTA_PKT, &br) != FR_OK)
+				return (-1);
+			if (br == 0)
+				break;
+			crc32_update (&ctx, p->slot[0].ots_pkt, br);
+		}
+		if (ctx.len != p->fwsize)
+			return (-1);
+	}
+
+	p->imgcrc = crc32_final (&ctx);
+
+	return (0);
+}
+
 static void
-dataGet (OtaHandles * p, UINT * br)
+otaShow (OtaHandles * p)
 {
-	if (clone == TRUE) {
-		/* Out of data */
-		if (p->fwsize == p->fwcnt) {
-			*br = 0;
-		/* Last chunk */
-		} else if ((p->fwsize - p->fwcnt) < OTA_SIZE) {
-			*br = p->fwsize - p->fwcnt;
-			memcpy (p->txbuf, p->fwpos, *br);
-			p->fwcnt += *br;
-		/* Get a chunk */
+	char msg[64];
+
+	sprintf (msg, "Sent %ld bytes, %ldKB/s, %ld retries",
+	    ota_tx_stats.st_off, otaRate (&ota_tx_stats) / 1024,
+	    ota_tx_stats.st_retx);
+	screen_alert_draw (FALSE, msg);
+	p->shown = ota_tx_stats.st_off;
+
+	return;
+}
+
+static void
+otaSlotRelease (OtaSlot * s)
+{
+	if (s->ots_queued)
+		s->ots_state = OTA_SLOT_ACKED;
+	else
+		s->ots_state = OTA_SLOT_FREE;
+
+	return;
+}
+
+/*
+ * The receiver has everything below off. Retire the chunks
+ * that covers.
+ */
+
+static void
+otaAck (OtaHandles * p, uint32_t off)
+{
+	OtaSlot * s;
+	ota_hdr_t * h;
+	int i;
+
+	if (off <= p->base || off > p->next)
+		return;
+
+	for (i = 0; i < OTA_WINDOW; i++) {
+		s = &p->slot[i];
+		h = (ota_hdr_t *)s->ots_pkt;
+		if ((s->ots_state == OTA_SLOT_SENT ||
+		    s->ots_state == OTA_SLOT_READY) &&
+		    h->ota_off + h->ota_len <= off)
+			otaSlotRelease (s);
+	}
+
+	p->base = off;
+	p->progress = chVTGetSystemTime ();
+	ota_tx_stats.st_off = off;
+
+	if (off - p->shown >= OTA_SHOW_BYTES || off == p->fwsize)
+		otaShow (p);
+
+	return;
+}
+
+/*
+ * Go back N: everything from off onwards that has already gone
+ * out is queued to be sent again.
+ */
+
+static void
+otaRewind (OtaHandles * p, uint32_t off)
+{
+	OtaSlot * s;
+	ota_hdr_t * h;
+	int i;
+
+	for (i = 0; i < OTA_WINDOW; i++) {
+		s = &p->slot[i];
+		h = (ota_hdr_t *)s->ots_pkt;
+		if (s->ots_state == OTA_SLOT_SENT && h->ota_off >= off) {
+			s->ots_state = OTA_SLOT_READY;
+			ota_tx_stats.st_retx++;
+		}
+	}
+
+	p->progress = chVTGetSystemTime ();
+
+	return;
+}
+
+/*
+ * Keep the window full: start reads into free slots, finish
+ * the ones that are done, and send whatever is ready, always
+ * in offset order.
+ */
+
+static int
+otaPump (OtaHandles * p)
+{
+	OtaSlot * s;
+	OtaSlot * first;
+	ota_hdr_t * h;
+	uint32_t len;
+	int i;
+
+	for (i = 0; i < OTA_WINDOW && p->next < p->fwsize; i++) {
+		s = &p->slot[i];
+		if (s->ots_state != OTA_SLOT_FREE)
+			continue;
+
+		len = p->fwsize - p->next;
+		if (len > OTA_CHUNK)
+			len = OTA_CHUNK;
+
+		h = (ota_hdr_t *)s->ots_pkt;
+		h->ota_op = OTA_OP_DATA;
+		h->ota_flags = 0;
+		h->ota_len = len;
+		h->ota_off = p->next;
+		h->ota_size = p->fwsize;
+		p->next += len;
+
+		if (clone == TRUE) {
+			memcpy (s->ots_pkt + sizeof(ota_hdr_t),
+			    p->fwpos + h->ota_off, len);
+			h->ota_crc = crc32_le (s->ots_pkt +
+			    sizeof(ota_hdr_t), len, CRC_INIT);
+			s->ots_state = OTA_SLOT_READY;
 		} else {
-			*br = OTA_SIZE;
-			memcpy (p->txbuf, p->fwpos, OTA_SIZE);
-			p->fwpos += OTA_SIZE;
-			p->fwcnt += OTA_SIZE;
+			asyncIoReqInit (&s->ots_req, &p->f,
+			    s->ots_pkt + sizeof(ota_hdr_t), len);
+			s->ots_req.aio_off = h->ota_off;
+			s->ots_state = OTA_SLOT_READING;
+			asyncIoSubmit (&s->ots_req);
 		}
-	} else
-	    f_read (&p->f, p->txbuf, OTA_SIZE, br);
+	}
+
+	for (i = 0; i < OTA_WINDOW; i++) {
+		s = &p->slot[i];
+		if (s->ots_state != OTA_SLOT_READING ||
+		    s->ots_req.aio_state != ASYNC_REQ_DONE)
+			continue;
+		h = (ota_hdr_t *)s->ots_pkt;
+		if (s->ots_req.aio_res != FR_OK ||
+		    s->ots_req.aio_br != h->ota_len) {
+			s->ots_state = OTA_SLOT_FREE;
+			return (-1);
+		}
+		h->ota_crc = crc32_le (s->ots_pkt + sizeof(ota_hdr_t),
+		    h->ota_len, CRC_INIT);
+		s->ots_state = OTA_SLOT_READY;
+	}
+
+	while (1) {
+		first = NULL;
+		for (i = 0; i < OTA_WINDOW; i++) {
+			s = &p->slot[i];
+			if (s->ots_state != OTA_SLOT_READING &&
+			    s->ots_state != OTA_SLOT_READY)
+				continue;
+			if (first == NULL ||
+			    ((ota_hdr_t *)s->ots_pkt)->ota_off <
+			    ((ota_hdr_t *)first->ots_pkt)->ota_off)
+				first = s;
+		}
+
+		/* Don't get ahead of a read that hasn't finished */
+
+		if (first == NULL || first->ots_state != OTA_SLOT_READY)
+			break;
+
+		h = (ota_hdr_t *)first->ots_pkt;
+		if (bleL2CapSend (first->ots_pkt,
+		    sizeof(ota_hdr_t) + h->ota_len) != NRF_SUCCESS)
+			break;
+
+		first->ots_queued++;
+		first->ots_state = OTA_SLOT_SENT;
+		ota_tx_stats.st_chunks++;
+	}
+
+	return (0);
+}
+
+/* The SoftDevice is done with one of our buffers */
+
+static void
+otaTxDone (OtaHandles * p, uint8_t * buf)
+{
+	OtaSlot * s;
+	int i;
+
+	for (i = 0; i < OTA_WINDOW; i++) {
+		s = &p->slot[i];
+		if (s->ots_pkt != buf || s->ots_queued == 0)
+			continue;
+		s->ots_queued--;
+		if (s->ots_state == OTA_SLOT_ACKED && s->ots_queued == 0)
+			s->ots_state = OTA_SLOT_FREE;
+		break;
+	}
 
 	return;
 }
@@ -141,18 +375,25 @@ otasend_start (OrchardAppContext *context)
 	p = malloc (sizeof (OtaHandles));
 
 	memset (p, 0, sizeof(OtaHandles));
-	p->crc = CRC_INIT;
 
 	context->priv = p;
 
 	if (clone == TRUE) {
 		p->fwsize = (uint32_t)&__ram7_init_text__ - 2;
 		p->fwpos = NULL;
-		p->fwcnt = 0;
 		nullProtStop ();
 	} else
 		f_open (&p->f, "0:BADGE.BIN", FA_READ);
 
+	screen_alert_draw (FALSE, "Checking image...");
+	if (otaImageCrc (p) != 0) {
+		screen_alert_draw (FALSE, "Reading firmware failed!");
+		chThdSleepMilliseconds (2000);
+		orchardAppExit ();
+		return;
+	}
+	gdispClear (Black);
+
 	p->listitems[0] = "Choose a peer";
 	p->listitems[1] = "Exit";
 
@@ -193,8 +434,8 @@ otasend_event (OrchardAppContext *context,
 {
 	OrchardAppRadioEvent *	radio;
 	ble_evt_t *		evt;
-	UINT			br;
 	OtaHandles * 		p;
+	ota_hdr_t *		h;
 	char			msg[32];
 	ble_gatts_evt_rw_authorize_request_t * rw;
 	ble_gatts_evt_write_t * req;
@@ -244,6 +485,32 @@ otasend_event (OrchardAppContext *context,
 		bleGapConnect (&p->listaddrs[uiContext->selected + 1]);
 	}
 
+	/*
+	 * Service the window, and go back to the oldest unacknowledged
+	 * chunk if the receiver has gone quiet. A lost START is simply
+	 * sent again.
+	 */
+
+	if (event->type == timerEvent) {
+		if ((chVTGetSystemTime () - p->progress) >
+		    TIME_MS2I(OTA_TIMEOUT)) {
+			if (p->started == FALSE) {
+				p->progress = chVTGetSystemTime ();
+				bleL2CapSend ((uint8_t *)&p->start,
+				    sizeof(ota_hdr_t));
+			} else if (p->base < p->fwsize) {
+				ota_tx_stats.st_timeouts++;
+				otaRewind (p, p->base);
+			}
+		}
+		if (p->started == TRUE && otaPump (p) != 0) {
+			screen_alert_draw (FALSE, "Reading firmware failed!");
+			chThdSleepMilliseconds (2000);
+			orchardAppExit ();
+		}
+		return;
+	}
+
         if (event->type == radioEvent) {
                 radio = (OrchardAppRadioEvent *)&event->radio;
                 evt = &radio->evt;
@@ -285,66 +552,91 @@ otasend_event (OrchardAppContext *context,
 				}
 				break;
 
-			/* L2CAP connected -- start sending the file */
+			/*
+			 * L2CAP connected -- tell the other side what's
+			 * coming and wait for it to say where to start.
+			 */
 			case l2capConnectEvent:
-				screen_alert_draw (FALSE, "Sending...");
-				/* FALLTHROUGH */
-			/* L2CAP TX successful -- send the next chunk */
+				screen_alert_draw (FALSE, "Starting...");
+				p->start.ota_op = OTA_OP_START;
+				p->start.ota_crc = p->imgcrc;
+				p->start.ota_size = p->fwsize;
+				p->progress = chVTGetSystemTime ();
+				bleL2CapSend ((uint8_t *)&p->start,
+				    sizeof(ota_hdr_t));
+				orchardAppTimer (context, OTA_PUMP_US, TRUE);
+				break;
+
+			/* L2CAP TX done -- the buffer can be reused */
 			case l2capTxEvent:
+				otaTxDone (p,
+				    evt->evt.l2cap_evt.params.tx.sdu_buf.p_data);
+				if (p->started == TRUE && otaPump (p) != 0) {
+					screen_alert_draw (FALSE,
+					    "Reading firmware failed!");
+					chThdSleepMilliseconds (2000);
+					orchardAppExit ();
+				}
+				break;
 
-				if (p->retry == 0) {
-					br = 0;
-
-					dataGet (p, &br);
-
-					/*
-					 * The only time the number of bytes
-					 * read will be less than OTA_SIZE
-					 * will be when we read the last few
-					 * bytes left in the file. The other
-					 * side expects that a transmission of
-					 * 4 bytes will always contain the
-				 	 * checksum. If there happens to be
-					 * exactly 4 bytes left in the file
-					 * after the last OTA_SIZE chunk, then
-					 * the other side will mistake it for
-					 * the checksum. To avoid this, if
-					 * we have exactly 4 bytes left,
-					 * lie and claim it's 5 just so the
-					 * other side doesn't get confused.
-					 */
-
-					if (br == 4)
-						br++;
-					if (br == 0 && p->send_crc == 0) {
-						memcpy (p->txbuf, &p->crc, 4);
-						br = 4;
-						p->send_crc = 1;
-					} else {
-						p->crc = crc32_le (p->txbuf,
-						    br, p->crc);
-					}
-					p->last = br;
-					p->size += br;
-				} else
-					br = p->last;
-
-				if (br) {
-					/* Send data chunk */
-					if (bleL2CapSend (p->txbuf, br) ==
-					    NRF_SUCCESS) {
-						p->retry = 0;
-						sprintf (msg, "Sent %ld bytes",
-						    p->size);
-						screen_alert_draw (FALSE, msg);
-					} else
-						p->retry = 1;
-				} else {
-					if (radio->type == l2capTxEvent) {
-						screen_alert_draw (FALSE,
-						    "Done!");
-						orchardAppExit ();
-					}
+			/* Acknowledgement from the receiver */
+			case l2capRxEvent:
+				if (radio->pktlen < sizeof(ota_hdr_t))
+					break;
+				h = (ota_hdr_t *)radio->pkt;
+
+				if (h->ota_op == OTA_OP_FAIL) {
+					screen_alert_draw (FALSE,
+					    "Bad checksum - aborting");
+					chThdSleepMilliseconds (2000);
+					orchardAppExit ();
+					break;
+				}
+
+				/*
+				 * The first ACK tells us where to start,
+				 * which may be part way in if the other
+				 * side is resuming.
+				 */
+
+				if (h->ota_op == OTA_OP_ACK &&
+				    p->started == FALSE) {
+					if (h->ota_off > p->fwsize)
+						break;
+					p->started = TRUE;
+					p->base = p->next = h->ota_off;
+					p->progress = chVTGetSystemTime ();
+					memset (&ota_tx_stats, 0,
+					    sizeof(ota_tx_stats));
+					ota_tx_stats.st_size = p->fwsize;
+					ota_tx_stats.st_resume = h->ota_off;
+					ota_tx_stats.st_off = h->ota_off;
+					ota_tx_stats.st_start = p->progress;
+					otaShow (p);
+				} else if (h->ota_op == OTA_OP_ACK)
+					otaAck (p, h->ota_off);
+				else if (h->ota_op == OTA_OP_NAK &&
+				    p->started == TRUE) {
+					ota_tx_stats.st_naks++;
+					otaAck (p, h->ota_off);
+					otaRewind (p, h->ota_off);
+				}
+
+				if (h->ota_flags & OTA_ACK_DONE) {
+					ota_tx_stats.st_end =
+					    chVTGetSystemTime ();
+					otaShow (p);
+					chThdSleepMilliseconds (1000);
+					screen_alert_draw (FALSE, "Done!");
+					orchardAppExit ();
+					break;
+				}
+
+				if (otaPump (p) != 0) {
+					screen_alert_draw (FALSE,
+					    "Reading firmware failed!");
+					chThdSleepMilliseconds (2000);
+					orchardAppExit ();
 				}
 				break;
 
@@ -353,6 +645,9 @@ otasend_event (OrchardAppContext *context,
 			case l2capDisconnectEvent:
 			case disconnectEvent:
 			case connectTimeoutEvent:
+				if (ota_tx_stats.st_end == 0)
+					ota_tx_stats.st_end =
+					    chVTGetSystemTime ();
 				orchardAppExit ();
 				break;
 			default:
@@ -382,6 +677,13 @@ otasend_exit (OrchardAppContext *context)
 
 	p = context->priv;
 
+	/* Reads still in progress land in our slots; wait them out. */
+
+	for (i = 0; i < OTA_WINDOW; i++) {
+		if (p->slot[i].ots_state == OTA_SLOT_READING)
+			asyncIoCancel (&p->slot[i].ots_req);
+	}
+
 	if (clone == TRUE)
 		nullProtStart ();
 	else
@@ -176,6 +176,7 @@ puzwat_unlock_puzzle(void)
 	if (!conf->puz_enabled) {
 		conf->puz_enabled = 1;
 		configSave(conf);
+		configFlush();
 	}
 
 	chThdSleepMilliseconds(3000);
@@ -42,14 +42,24 @@
 #include "nrf52i2s_lld.h"
 
 #include "userconfig.h"
+#include "spectrum.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#define SPECTRUM_CHANNELS	140	/* 2360MHz to 2499MHz */
+#define SPECTRUM_TOP		112
+#define SPECTRUM_DECAY_ROWS	4
+
 typedef struct spectrum_state {
 	uint8_t		airplane;
 	GListener	gl;
+	SPECTRUM_BARS	bars;
+	uint8_t		rssi[SPECTRUM_CHANNELS];
+	uint8_t		level[SPECTRUM_CHANNELS];
+	uint8_t		peak[SPECTRUM_CHANNELS];
+	uint8_t		hold[SPECTRUM_CHANNELS];
 } SpectrumState;
 
 static void
@@ -117,8 +127,28 @@ spectrum_start (OrchardAppContext *context)
 	gdispClear (Teal);
 
 	state = malloc (sizeof(SpectrumState));
+	memset (state, 0, sizeof(SpectrumState));
 	context->priv = state;
 
+	/*
+	 * Each channel gets a column two pixels wide. The column is
+	 * the signal level, and the yellow marker above it is the
+	 * highest level seen lately.
+	 */
+
+	state->bars.sb_x = 20;
+	state->bars.sb_y = SPECTRUM_TOP;
+	state->bars.sb_step = 2;
+	state->bars.sb_width = 2;
+	state->bars.sb_height = gdispGetHeight () - SPECTRUM_TOP;
+	state->bars.sb_count = SPECTRUM_CHANNELS;
+	state->bars.sb_bg = Teal;
+	state->bars.sb_peakcolor = Yellow;
+	state->bars.sb_color[0] = Navy;
+	state->bars.sb_color[1] = Navy;
+	state->bars.sb_color[2] = Navy;
+	spectrumBarsReset (&state->bars);
+
 	paramShow (140, 2430);
 
 	gs = ginputGetMouse (0);
@@ -143,8 +173,11 @@ static void
 spectrum_event (OrchardAppContext *context,
 	const OrchardAppEvent *event)
 {
+	SpectrumState * state;
 	int8_t rssi;
-	int i, j, x;
+	int j;
+
+	state = context->priv;
 
 	if (event->type == appEvent && event->app.event == appStart)
 		orchardAppTimer (context, 1, TRUE);
@@ -156,28 +189,23 @@ spectrum_event (OrchardAppContext *context,
 	}
 
 	if (event->type == timerEvent) {
-		GDISP->p.y = 112;
-		GDISP->p.cx = 2;
-		GDISP->p.cy = gdispGetHeight () - 112;
-		for (j = 0; j < 140; j++) {
+		/*
+		 * The RSSI reading is how many dB below 0dBm the signal
+		 * is, so the column height is what's left of 127.
+		 */
+		for (j = 0; j < SPECTRUM_CHANNELS; j++) {
 			nrf52radioChanSet (2360 + j);
 			nrf52radioRxEnable ();
 			nrf52radioRssiGet (&rssi);
 			nrf52radioRxDisable ();
-			GDISP->p.x = 20 + (j * 2);
-			gdisp_lld_write_start (GDISP);
-			for (i = 0; i < 128; i++) {
-				if (rssi == i)
-					GDISP->p.color = Yellow;
-				else if (rssi > i)
-					GDISP->p.color = Teal;
-				else
-					GDISP->p.color = Navy;
-				for (x = 0; x < 2; x++)
-					gdisp_lld_write_color (GDISP);
-			}
-			gdisp_lld_write_stop (GDISP);
+			if (rssi < 0)
+				rssi = 0;
+			state->rssi[j] = 127 - rssi;
 		}
+
+		spectrumSmooth (state->level, state->peak, state->hold,
+		    state->rssi, SPECTRUM_CHANNELS, SPECTRUM_DECAY_ROWS);
+		spectrumBarsDraw (&state->bars, state->level, state->peak);
 	}
 
 	return;
@@ -37,12 +37,14 @@
 
 #include "ff.h"
 #include "ffconf.h"
+#include "mmc.h"
 
 #include "ble_lld.h"
 
 #include "nullprot_lld.h"
 
 #include "led.h"
+#include "userconfig.h"
 
 #include "buildtime.h"
 
@@ -94,6 +96,10 @@ update (VHandles * p)
 
 	ledStop ();
 
+	/* Make sure any unsaved config changes make it to flash */
+
+	configFlush ();
+
 	/* Stop the radio */
 
 	bleDisable ();
@@ -149,6 +155,8 @@ update (VHandles * p)
 	 * the same time.
 	 */
 
+	spiAcquireBus (&SPID1);
+	mmc_disk_stream_stop ();
 	spiStop (&SPID1);
 	spiStop (&SPID4);
 
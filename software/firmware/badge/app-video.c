@@ -90,7 +90,8 @@ video_start (OrchardAppContext *context)
 	while (1) {
 		if (f_readdir (&d, &info) != FR_OK || info.fname[0] == 0)
 			break;
-		if (strstr (info.fname, ".VID") != NULL)
+		if (strstr (info.fname, ".VID") != NULL ||
+		    strstr (info.fname, ".VDZ") != NULL)
 			i++;
 	}
 
@@ -119,7 +120,8 @@ video_start (OrchardAppContext *context)
 	while (1) {
 		if (f_readdir (&d, &info) != FR_OK || info.fname[0] == 0)
 			break;
-		if (strstr (info.fname, ".VID") != NULL) {
+		if (strstr (info.fname, ".VID") != NULL ||
+		    strstr (info.fname, ".VDZ") != NULL) {
 			p->listitems[i] =
 			    malloc (strlen (info.fname) + 1);
 			memset (p->listitems[i], 0, strlen (info.fname) + 1);
@@ -40,23 +40,45 @@
 #include "diskio.h"
 
 #include "async_io_lld.h"
+#include "crc32.h"
 
 static thread_t * pThread;
 
-static void * async_buf;
-static FIL * async_f;
-static UINT async_btr;
-static volatile UINT async_br = ASYNC_THD_READY;
+static ASYNC_IO_REQ * async_head;
+static ASYNC_IO_REQ * async_tail;
+static volatile int async_exit;
+static volatile int async_pending;
 
+static thread_reference_t fsReference;
+
+/* Request whose completion callback is running */
+
+static ASYNC_IO_REQ * async_cbreq;
+
+/*
+ * Request used to implement the original single-slot
+ * asyncIoRead()/asyncIoWait() API.
+ */
+
+static ASYNC_IO_REQ async_legacy;
 static UINT * saved_br;
 
-static thread_reference_t fsReference;
-static thread_reference_t wakeReference;
+static void
+asyncIoDone (ASYNC_IO_REQ * r, uint8_t state)
+{
+	r->aio_state = state;
+	async_pending--;
+	osalThreadResumeS (&r->aio_waiter, MSG_OK);
+
+	return;
+}
 
 static THD_WORKING_AREA(waAsyncIoThread, 256);
 static THD_FUNCTION(asyncIoThread, arg)
 {
-	UINT br = ASYNC_THD_READY;
+	ASYNC_IO_REQ * r;
+	FRESULT res;
+	UINT br;
 
 	(void) arg;
 
@@ -64,13 +86,60 @@ static THD_FUNCTION(asyncIoThread, arg)
 
 	while (1) {
 		osalSysLock ();
-		async_br = br;
-		osalThreadResumeS (&wakeReference, MSG_OK);
-		osalThreadSuspendS (&fsReference);
-		osalSysUnlock ();
-		if (async_br == ASYNC_THD_EXIT)
+		while (async_head == NULL && async_exit == 0)
+			osalThreadSuspendS (&fsReference);
+		if (async_exit) {
+			/* Nobody will service these, so let their waiters go */
+			while ((r = async_head) != NULL) {
+				async_head = r->aio_next;
+				r->aio_next = NULL;
+				r->aio_br = 0;
+				asyncIoDone (r, ASYNC_REQ_CANCELLED);
+			}
+			async_tail = NULL;
+			osalSysUnlock ();
 			break;
-		f_read (async_f, async_buf, async_btr, &br);
+		}
+		r = async_head;
+		async_head = r->aio_next;
+		if (async_head == NULL)
+			async_tail = NULL;
+		r->aio_next = NULL;
+		r->aio_state = ASYNC_REQ_BUSY;
+		osalSysUnlock ();
+
+		br = 0;
+		res = FR_OK;
+		if (r->aio_off != ASYNC_OFF_CUR)
+			res = f_lseek (r->aio_f, r->aio_off);
+		if (res == FR_OK)
+			res = f_read (r->aio_f, r->aio_buf, r->aio_btr, &br);
+		if (res == FR_OK && r->aio_crc != NULL)
+			crc32_update (r->aio_crc, r->aio_buf, br);
+
+		r->aio_br = br;
+		r->aio_res = res;
+
+		/*
+		 * The callback runs before the request is marked done,
+		 * since after that it belongs to its owner again and
+		 * may be reused or freed. If the callback resubmits
+		 * it, it stays ours and any waiter keeps waiting for
+		 * the new read.
+		 */
+
+		if (r->aio_cb != NULL) {
+			async_cbreq = r;
+			r->aio_cb (r);
+			async_cbreq = NULL;
+		}
+
+		osalSysLock ();
+		if (r->aio_state == ASYNC_REQ_BUSY)
+			asyncIoDone (r, ASYNC_REQ_DONE);
+		else
+			async_pending--;
+		osalSysUnlock ();
 	}
 
 	chThdExitS (MSG_OK);
@@ -79,36 +148,145 @@ static THD_FUNCTION(asyncIoThread, arg)
 }
 
 void
-asyncIoRead (FIL * f, void * buf, UINT btr, UINT * br)
+asyncIoReqInit (ASYNC_IO_REQ * r, FIL * f, void * buf, UINT btr)
 {
-	if (async_br != ASYNC_THD_READY)
+	r->aio_next = NULL;
+	r->aio_f = f;
+	r->aio_buf = buf;
+	r->aio_btr = btr;
+	r->aio_br = 0;
+	r->aio_off = ASYNC_OFF_CUR;
+	r->aio_res = FR_OK;
+	r->aio_state = ASYNC_REQ_FREE;
+	r->aio_cb = NULL;
+	r->aio_arg = NULL;
+	r->aio_crc = NULL;
+	r->aio_waiter = NULL;
+
+	return;
+}
+
+void
+asyncIoSubmit (ASYNC_IO_REQ * r)
+{
+	osalSysLock ();
+
+	/*
+	 * Can't submit the same request twice, except from its own
+	 * completion callback.
+	 */
+
+	if (r->aio_state == ASYNC_REQ_QUEUED ||
+	    (r->aio_state == ASYNC_REQ_BUSY && r != async_cbreq)) {
+		osalSysUnlock ();
 		return;
+	}
 
-	async_f = f;
-	async_buf = buf;
-	async_btr = btr;
+	r->aio_br = 0;
+	r->aio_next = NULL;
+	r->aio_state = ASYNC_REQ_QUEUED;
 
-	saved_br = br;
+	if (async_tail == NULL)
+		async_head = r;
+	else
+		async_tail->aio_next = r;
+	async_tail = r;
+	async_pending++;
 
-	osalSysLock ();
-	async_br = ASYNC_THD_READ;
 	osalThreadResumeS (&fsReference, MSG_OK);
 	osalSysUnlock ();
 
 	return;
 }
 
-void
-asyncIoWait (void)
+/*
+ * Wait for a request to finish and return the number of
+ * bytes read. A request that was never submitted or that was
+ * cancelled returns right away.
+ */
+
+UINT
+asyncIoReqWait (ASYNC_IO_REQ * r)
+{
+	osalSysLock ();
+	while (r->aio_state == ASYNC_REQ_QUEUED ||
+	    r->aio_state == ASYNC_REQ_BUSY)
+		osalThreadSuspendS (&r->aio_waiter);
+	osalSysUnlock ();
+
+	return (r->aio_br);
+}
+
+/*
+ * Cancel a request. If it's still in the queue, it's removed and
+ * we return 0. A read that has already started can't be stopped,
+ * so in that case we wait for it to finish and return -1, which
+ * tells the caller that the file position has moved.
+ */
+
+int
+asyncIoCancel (ASYNC_IO_REQ * r)
 {
+	ASYNC_IO_REQ * prev;
+	ASYNC_IO_REQ * cur;
+
 	osalSysLock ();
-	while (async_br == ASYNC_THD_READ ||
-	       async_br == ASYNC_THD_READY)
-		osalThreadSuspendS (&wakeReference);
+
+	if (r->aio_state == ASYNC_REQ_QUEUED) {
+		prev = NULL;
+		for (cur = async_head; cur != NULL; cur = cur->aio_next) {
+			if (cur == r)
+				break;
+			prev = cur;
+		}
+		if (prev == NULL)
+			async_head = r->aio_next;
+		else
+			prev->aio_next = r->aio_next;
+		if (async_tail == r)
+			async_tail = prev;
+		r->aio_next = NULL;
+		r->aio_br = 0;
+		asyncIoDone (r, ASYNC_REQ_CANCELLED);
+		osalSysUnlock ();
+		return (0);
+	}
+
 	osalSysUnlock ();
 
-	*saved_br = async_br;
-	async_br = ASYNC_THD_READY;
+	if (r->aio_state == ASYNC_REQ_BUSY) {
+		(void) asyncIoReqWait (r);
+		return (-1);
+	}
+
+	return (0);
+}
+
+int
+asyncIoPending (void)
+{
+	return (async_pending);
+}
+
+void
+asyncIoRead (FIL * f, void * buf, UINT btr, UINT * br)
+{
+	if (async_legacy.aio_state == ASYNC_REQ_QUEUED ||
+	    async_legacy.aio_state == ASYNC_REQ_BUSY)
+		return;
+
+	asyncIoReqInit (&async_legacy, f, buf, btr);
+	saved_br = br;
+	asyncIoSubmit (&async_legacy);
+
+	return;
+}
+
+void
+asyncIoWait (void)
+{
+	*saved_br = asyncIoReqWait (&async_legacy);
+	async_legacy.aio_state = ASYNC_REQ_FREE;
 
 	return;
 }
@@ -116,11 +294,15 @@ asyncIoWait (void)
 void
 asyncIoStart (void)
 {
+	async_head = NULL;
+	async_tail = NULL;
+	async_exit = 0;
+	async_pending = 0;
+	async_cbreq = NULL;
+
 	pThread = chThdCreateStatic (waAsyncIoThread, sizeof(waAsyncIoThread),
 	    NORMALPRIO + 5, asyncIoThread, NULL);
 
-	async_br = ASYNC_THD_READY;
-
 	return;
 }
 
@@ -128,7 +310,7 @@ void
 asyncIoStop (void)
 {
 	osalSysLock ();
-	async_br = ASYNC_THD_EXIT;
+	async_exit = 1;
 	osalThreadResumeS (&fsReference, MSG_OK);
 	osalSysUnlock ();
 
@@ -33,11 +33,63 @@
 #ifndef _ASYNC_IO_LLD_H
 #define _ASYNC_IO_LLD_H
 
-#define ASYNC_THD_READ		0xFFFFFFFF
-#define ASYNC_THD_EXIT		0xFFFFFFFE
-#define ASYNC_THD_READY		0xFFFFFFFD
+/*
+ * Asynchronous read requests
+ *
+ * Any number of requests can be queued at once. They are serviced
+ * in the order submitted by the async I/O thread, which means that
+ * several sequential reads from the same file can be kept in flight
+ * without specifying an offset. A request may also carry an explicit
+ * file offset, in which case we seek there first.
+ *
+ * When a request completes, its callback (if any) is invoked from
+ * the async I/O thread, and then anyone blocked in asyncIoReqWait()
+ * is woken up. The callback runs on a small stack and should do no
+ * more than signal another thread or resubmit a request. If it
+ * resubmits the same request, waiters keep waiting for the new read.
+ *
+ * asyncIoStop() cancels any requests still in the queue.
+ *
+ * If aio_crc is set, the data is folded into that running CRC32 as
+ * soon as it's read, so whoever is waiting for it doesn't have to
+ * make another pass over it.
+ *
+ * The request structure belongs to the async I/O code from the time
+ * it's submitted until it's completed or cancelled, so it must not
+ * be on the stack of a function that might return before then.
+ */
+
+#define ASYNC_REQ_FREE		0	/* Not submitted */
+#define ASYNC_REQ_QUEUED	1	/* Waiting to be serviced */
+#define ASYNC_REQ_BUSY		2	/* Read in progress */
+#define ASYNC_REQ_DONE		3	/* Read finished */
+#define ASYNC_REQ_CANCELLED	4	/* Cancelled before it started */
+
+#define ASYNC_OFF_CUR		0xFFFFFFFF
+
+typedef struct async_io_req {
+	struct async_io_req *	aio_next;
+	FIL *			aio_f;
+	void *			aio_buf;
+	UINT			aio_btr;
+	UINT			aio_br;
+	FSIZE_t			aio_off;
+	FRESULT			aio_res;
+	volatile uint8_t	aio_state;
+	void			(*aio_cb)(struct async_io_req *);
+	void *			aio_arg;
+	struct crc32_ctx *	aio_crc;
+	thread_reference_t	aio_waiter;
+} ASYNC_IO_REQ;
 
 void asyncIoStart (void);
+void asyncIoStop (void);
+
+void asyncIoReqInit (ASYNC_IO_REQ *, FIL *, void *, UINT);
+void asyncIoSubmit (ASYNC_IO_REQ *);
+UINT asyncIoReqWait (ASYNC_IO_REQ *);
+int asyncIoCancel (ASYNC_IO_REQ *);
+int asyncIoPending (void);
 
 void asyncIoRead (FIL *, void *, UINT, UINT * br);
 void asyncIoWait (void);
@@ -13,8 +13,13 @@
 #include "entity.h"
 
 #define FRAME_DELAY           0.033f     // timer will be set to this * 1,000,000 (33mS)
+#define FRAME_DELAY_FX        FIX16_FROM_FLOAT(FRAME_DELAY) // physics time step
 #define FPS                   30         // ... which represents about 30 FPS.
 #define NETWORK_TIMEOUT       (FPS * 10) // number of ticks to timeout (10 seconds)
+#define FRAME_BUDGET_US       (1000000 / FPS) // sprite drawing time allowed per frame
+#define SEND_RETRIES          5          // waits for a TX buffer before an event is dropped
+#define SEND_RETRY_MS         5          // ... of this long each
+#define SPRITE_COMPOSITOR     TRUE       // FALSE to draw combat sprites directly, for comparison
 #define PEER_ADDR_LEN         12 + 5
 #define MAX_PEERMEM           (PEER_ADDR_LEN + BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED + 1)
 #define COLOR_PLAYER          HTML2COLOR(0xeeeseee) // light grey
@@ -28,6 +33,7 @@
 #define BATTLE_OP_ENTITY_DESTROY    0x02 /* Discard existing entity */
 #define BATTLE_OP_ENTITY_UPDATE     0x03 /* Entity state update */
 #define BATTLE_OP_MINE_CREATE       0x04 /* have a nice mine */
+#define BATTLE_OP_FRAME             0x05 /* a tick's worth of records */
 /* VS opcodes */
 #define BATTLE_OP_SHIP_SELECT       0x10 /* Current ship selection */
 #define BATTLE_OP_SHIP_CONFIRM      0x11 /* Final ship choice */
@@ -112,35 +118,46 @@ typedef struct _bp_header
 } bp_header_t;
 
 /*
- * Entity packets. Can be used to specify that a new entity
- * (combatant, bullet, etc...) is in the simulation, has left the
- * simulation, or is being updated. (24 bytes)
+ * Frame packets. Everything one side has to say during a combat
+ * tick is batched into a single packet, as a run of records that
+ * each start with a one byte opcode:
+ *
+ * BATTLE_OP_ENTITY_UPDATE  mask, then one int16_t for each of the
+ *                          low six mask bits that is set: x, y,
+ *                          velocity x/y, goal velocity x/y, in
+ *                          1/16th pixels. BP_ENT_FACING says bit 7
+ *                          holds faces_right.
+ * BATTLE_OP_ENTITY_CREATE  int8_t dir_x, int8_t dir_y, uint8_t is_free
+ * BATTLE_OP_MINE_CREATE    nothing
+ * anything else            uint16_t operand
+ *
+ * Entity updates only carry the fields that changed since the last
+ * one we sent; the receiver keeps the rest from the last one it got.
+ * L2CAP channels are reliable and in order, so once a frame is
+ * handed to the stack the other side will see it.
+ *
+ * bp_id is the frame sequence number. Frames fit in one slab.
  */
 
-typedef struct _bp_entity_pkt
-{
-  bp_header_t bp_header;
-  uint16_t    bp_x;
-  uint16_t    bp_y;
-  uint16_t    bp_velocity_x;
-  uint16_t    bp_velocity_y;
-  uint16_t    bp_velogoal_x;
-  uint16_t    bp_velogoal_y;
-  uint16_t    bp_visibility;
-  uint16_t    bp_faces_right;
-} bp_entity_pkt_t;
-
-typedef struct _bp_bullet_pkt
+#define BP_FRAME_DATA         (int)(64 - sizeof(bp_header_t) - 1)
+
+#define BP_ENT_X              0x01
+#define BP_ENT_Y              0x02
+#define BP_ENT_VX             0x04
+#define BP_ENT_VY             0x08
+#define BP_ENT_GX             0x10
+#define BP_ENT_GY             0x20
+#define BP_ENT_FACING         0x40
+#define BP_ENT_FACES_RIGHT    0x80
+
+#define BP_QUANT_SHIFT        (FIX16_SHIFT - 4) /* fix16_t to 1/16th px */
+
+typedef struct _bp_frame_pkt
 {
   bp_header_t bp_header;
-  uint16_t   bp_origin_x;
-  uint16_t   bp_origin_y;
-  int16_t    bp_dir_x;
-  int16_t    bp_dir_y;
-  uint8_t    bp_is_free;
-  uint8_t    bp_pad1;
-  uint16_t   bp_pad2;
-} bp_bullet_pkt_t; /* 20 bytes */
+  uint8_t     bp_len;                   /* bytes of records used */
+  uint8_t     bp_data[BP_FRAME_DATA];
+} bp_frame_pkt_t;
 
 /*
  * VS. packets. These are used in the VS. select screen,
@@ -155,17 +172,4 @@ typedef struct _bp_vs_pkt
   uint16_t    bp_unlocks;
 } bp_vs_pkt_t;
 
-/*
- * State packets. These are used to keep the state machine
- * from possibly getting stuck and to update game timers.
- * (12 bytes)
- */
-
-typedef struct _bp_state_pkt
-{
-  bp_header_t bp_header;
-  uint16_t    bp_operand;
-  uint16_t    bp_pad;
-} bp_state_pkt_t;
-
 #endif /* _BATTLE_H_ */
@@ -53,6 +53,14 @@
 static uint8_t ble_rx_buf[BLE_IDES_L2CAP_MTU];
 uint16_t ble_local_cid;
 
+/*
+ * Called from the SoftDevice event handler with every transmit buffer
+ * the SoftDevice hands back, whether it was sent or dropped when the
+ * channel went away. Unlike l2capTxEvent this can't be lost in a full
+ * radio queue or delivered to an app that has since exited.
+ */
+void (*ble_l2cap_tx_release)(void *);
+
 static void bleL2CapSetupReply (ble_l2cap_evt_ch_setup_request_t *);
 
 void
@@ -123,6 +131,9 @@ bleL2CapDispatch (ble_evt_t * evt)
 #ifdef BLE_L2CAP_VERBOSE
 			printf ("L2CAP channel SDU buffer released\n");
 #endif
+			if (ble_l2cap_tx_release != NULL)
+				ble_l2cap_tx_release (evt->evt.l2cap_evt.params.
+				    ch_sdu_buf_released.sdu_buf.p_data);
 			break;
 
 		case BLE_L2CAP_EVT_CH_CREDIT:
@@ -151,6 +162,9 @@ bleL2CapDispatch (ble_evt_t * evt)
 #ifdef BLE_L2CAP_VERBOSE
 			printf ("L2CAP SDU transmitted\n");
 #endif
+			if (ble_l2cap_tx_release != NULL)
+				ble_l2cap_tx_release (evt->evt.l2cap_evt.params.
+				    tx.sdu_buf.p_data);
 			orchardAppRadioCallback (l2capTxEvent, evt,
 			    NULL, 0);
 			break;
@@ -49,6 +49,7 @@
 #define BLE_IDES_L2CAP_MPS	128
 
 extern uint16_t ble_local_cid;
+extern void (*ble_l2cap_tx_release)(void *);
 
 extern void bleL2CapDispatch (ble_evt_t *);
 
@@ -31,6 +31,7 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 
 #include "ch.h"
 #include "hal.h"
@@ -54,6 +55,45 @@ audio_stop (int argc, char *argv[])
 	return;
 }
 
+static void
+audio_tone (int argc, char *argv[])
+{
+	if (argc != 3) {
+		printf ("Usage: audio tone <hz> <ms>\r\n");
+		return;
+	}
+
+	if (i2sVoiceTone (atoi (argv[1]), atoi (argv[2]),
+	    I2S_PRIO_NORMAL, I2S_GAIN_UNITY) == -1)
+		printf ("No voice available\r\n");
+
+	return;
+}
+
+static void
+audio_stats (int argc, char *argv[])
+{
+	I2S_MIX_STATS s;
+	uint32_t avg = 0;
+
+	i2sMixStats (&s);
+
+	if (s.ms_blocks)
+		avg = s.ms_total / s.ms_blocks;
+
+	printf ("Blocks mixed:         %lu\r\n", s.ms_blocks);
+	printf ("Underruns:            %lu\r\n", s.ms_underruns);
+	printf ("Voices stolen:        %lu\r\n", s.ms_steals);
+	printf ("Sounds rejected:      %lu\r\n", s.ms_rejects);
+	printf ("Block time last/avg/max: %lu/%lu/%lu us (budget %lu us)\r\n",
+	    RTC2US(NRF5_HFCLK_FREQUENCY, s.ms_last),
+	    RTC2US(NRF5_HFCLK_FREQUENCY, avg),
+	    RTC2US(NRF5_HFCLK_FREQUENCY, s.ms_max),
+	    ((I2S_SAMPLES / 2) * 1000000UL) / I2S_RATE);
+
+	return;
+}
+
 static void
 cmd_audio(BaseSequentialStream *chp, int argc, char *argv[])
 {
@@ -61,6 +101,8 @@ cmd_audio(BaseSequentialStream *chp, int argc, char *argv[])
 		printf ("Audio commands:\r\n");
 		printf ("play <filename>      Play tune\r\n");
 		printf ("stop                 Stop playing\r\n");
+		printf ("tone <hz> <ms>       Play a sine wave\r\n");
+		printf ("stats                Show mixer stats\r\n");
                 return;
         }
 
@@ -68,6 +110,10 @@ cmd_audio(BaseSequentialStream *chp, int argc, char *argv[])
 		audio_play (argc, argv);
 	else if (strcmp (argv[0], "stop") == 0)
 		audio_stop (argc, argv);
+	else if (strcmp (argv[0], "tone") == 0)
+		audio_tone (argc, argv);
+	else if (strcmp (argv[0], "stats") == 0)
+		audio_stats (argc, argv);
 	else
 		printf ("Unrecognized audio command\r\n");
 
@@ -28,6 +28,8 @@ static void cmd_config_save(BaseSequentialStream *chp, int argc, char *argv[]);
 static void cmd_config(BaseSequentialStream *chp, int argc, char *argv[]);
 static void cmd_config_led_stop(BaseSequentialStream *chp);
 static void cmd_config_led_run(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmd_config_led_play(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmd_config_led_stats(BaseSequentialStream *chp, int argc, char *argv[]);
 static void cmd_config_led_dim(BaseSequentialStream *chp, int argc, char *argv[]);
 static void cmd_config_led_list(BaseSequentialStream *chp);
 static void cmd_config_led_eye(BaseSequentialStream *chp, int argc, char *argv[]);
@@ -170,6 +172,7 @@ static void cmd_config_save(BaseSequentialStream *chp, int argc, char *argv[]) {
 
   userconfig *config = getConfig();
   configSave(config);
+  configFlush();
 
   printf ("Config saved.\n");
 }
@@ -186,6 +189,8 @@ static void cmd_config(BaseSequentialStream *chp, int argc, char *argv[])
     printf ("   led dim n      LED Global Current Control (0-255) 255=brightest\n");
     printf ("   led run n      run pattern #n\n");
     printf ("   led stop       stop and blank LEDs\n");
+    printf ("   led play file  play an animation from the SD card\n");
+    printf ("   led stats [-z] show (or zero) LED frame engine stats\n");
     printf ("   led eye r g b  set eye color (rgb 0-127)\n");
     printf ("   save           save config to flash\n\n");
 
@@ -238,6 +243,16 @@ static void cmd_config(BaseSequentialStream *chp, int argc, char *argv[])
       cmd_config_led_stop(chp);
       return;
     }
+
+    if (!strcasecmp(argv[1], "play")) {
+      cmd_config_led_play(chp, argc, argv);
+      return;
+    }
+
+    if (!strcasecmp(argv[1], "stats")) {
+      cmd_config_led_stats(chp, argc, argv);
+      return;
+    }
   }
 
   printf ("Unrecognized config command.\n");
@@ -316,6 +331,66 @@ static void cmd_config_led_run(BaseSequentialStream *chp, int argc, char *argv[]
   }
 }
 
+static void cmd_config_led_play(BaseSequentialStream *chp, int argc, char *argv[]) {
+
+  if (argc != 3) {
+    printf ("No file specified\n");
+    return;
+  }
+
+  if (ledPlayFile(argv[2]) == false) {
+    printf ("Can't play %s.\n", argv[2]);
+    return;
+  }
+
+  printf ("Playing %s.\n", argv[2]);
+
+  if (ledsOff) {
+    led_init ();
+    ledStart();
+  }
+}
+
+static void cmd_config_led_stats(BaseSequentialStream *chp, int argc, char *argv[]) {
+  led_stats_t s;
+  uint32_t ms;
+  uint32_t cpu;
+
+  if (argc == 3 && !strcmp(argv[2], "-z")) {
+    memset (&led_stats, 0, sizeof(led_stats));
+    led_stats.start = chVTGetSystemTime();
+    printf ("LED stats zeroed.\n");
+    return;
+  }
+
+  s = led_stats;
+  ms = TIME_I2MS(chVTGetSystemTime() - s.start);
+  if (ms == 0)
+    ms = 1;
+
+  printf ("Frames drawn:      %ld (%ld/sec)\n", s.frames,
+          (uint32_t)((uint64_t)s.frames * 1000 / ms));
+  printf ("Shows:             %ld, %ld with nothing to send\n",
+          s.shows, s.idle);
+  printf ("I2C writes:        %ld (%ld/sec)\n", s.xfers,
+          (uint32_t)((uint64_t)s.xfers * 1000 / ms));
+  printf ("I2C bytes:         %ld/sec, whole frames would be %ld/sec\n",
+          (uint32_t)((uint64_t)s.bytes * 1000 / ms),
+          (uint32_t)((uint64_t)s.full_bytes * 1000 / ms));
+
+  if (s.frames) {
+    /* hundredths of a percent */
+    cpu = (uint64_t)s.render_us * 10 / ms;
+    printf ("Render time:       %ld us/frame, %ld.%02ld%% CPU\n",
+            s.render_us / s.frames, cpu / 100, cpu % 100);
+  }
+
+  if (s.shows) {
+    printf ("Show time:         %ld us/show, mostly waiting on I2C\n",
+            s.show_us / s.shows);
+  }
+}
+
 static void cmd_config_led_dim(BaseSequentialStream *chp, int argc, char *argv[]) {
 
   int16_t level;
@@ -39,6 +39,7 @@
 #include "shell.h"
 
 #include "badge.h"
+#include "slaballoc.h"
 
 extern char   __heap_base__; /* Set by linker */
 extern char   __heap_end__; /* Set by linker */
@@ -59,3 +60,33 @@ cmd_mem (BaseSequentialStream *chp, int argc, char *argv[])
 }
 
 orchard_command("mem", cmd_mem);
+
+static void
+cmd_slabs (BaseSequentialStream *chp, int argc, char *argv[])
+{
+	SLAB_POOL * pools[SL_MAX_POOLS];
+	SLAB_POOL * p;
+	int i, n;
+
+	(void)argv;
+	if (argc > 0) {
+		printf ("Usage: slabs\n");
+		return;
+	}
+
+	n = sl_pool_list (pools, SL_MAX_POOLS);
+
+	printf ("%-10s %5s %5s %5s %5s %10s %8s\n", "POOL", "SIZE",
+	    "COUNT", "USED", "HIWAT", "ALLOCS", "FAILS");
+
+	for (i = 0; i < n; i++) {
+		p = pools[i];
+		printf ("%-10s %5u %5u %5u %5u %10lu %8lu\n", p->name,
+		    p->size, p->count, p->used, p->hiwat,
+		    p->allocs, p->fails);
+	}
+
+	return;
+}
+
+orchard_command("slabs", cmd_slabs);
@@ -0,0 +1,99 @@
+/*-
+ * Copyright (c) 2019
+ *      Bill Paul <wpaul@windriver.com>.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed by Bill Paul.
+ * 4. Neither the name of the author nor the names of any co-contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Bill Paul AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL Bill Paul OR THE VOICES IN HIS HEAD
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "shell.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ble.h"
+#include "ble_lld.h"
+#include "ble_l2cap_lld.h"
+#include "ota.h"
+
+#include "badge.h"
+
+/*
+ * Average throughput in bytes per second since the transfer started,
+ * counting only what was moved this time round.
+ */
+
+uint32_t
+otaRate (OTA_STATS * s)
+{
+	systime_t end;
+	uint32_t ms;
+
+	if (s->st_start == 0)
+		return (0);
+
+	end = s->st_end;
+	if (end == 0)
+		end = chVTGetSystemTime ();
+
+	ms = TIME_I2MS(end - s->st_start);
+	if (ms == 0)
+		return (0);
+
+	return ((uint64_t)(s->st_off - s->st_resume) * 1000 / ms);
+}
+
+static void
+otaStatsShow (char * name, OTA_STATS * s)
+{
+	printf ("%s: %ld of %ld bytes", name, s->st_off, s->st_size);
+	if (s->st_resume)
+		printf (" (resumed at %ld)", s->st_resume);
+	printf (", %ld bytes/sec\n", otaRate (s));
+	printf ("  chunks: %ld retransmits: %ld naks: %ld timeouts: %ld "
+	    "bad crc: %ld\n", s->st_chunks, s->st_retx, s->st_naks,
+	    s->st_timeouts, s->st_badcrc);
+
+	return;
+}
+
+static void
+cmd_ota(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	(void)chp;
+	(void)argc;
+	(void)argv;
+
+	otaStatsShow ("Send", &ota_tx_stats);
+	otaStatsShow ("Receive", &ota_rx_stats);
+
+	return;
+}
+
+orchard_command("ota", cmd_ota);
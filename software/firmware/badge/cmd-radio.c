@@ -51,6 +51,7 @@
 #include "ble_peer.h"
 
 #include "badge.h"
+#include "orchard-app.h"
 
 #pragma pack(1)
 struct formatted_uuid {
@@ -257,6 +258,24 @@ radio_send (BaseSequentialStream *chp, int argc, char *argv[])
 	return;
 }
 
+static void
+radio_stats (BaseSequentialStream *chp, int argc, char *argv[])
+{
+	OrchardAppRadioStats stats;
+
+	orchardAppRadioStatsGet (&stats);
+
+	printf ("Events queued:        %lu\n", stats.queued);
+	printf ("Pending:              %lu\n", stats.pending);
+	printf ("High water:           %lu\n", stats.hiwat);
+	printf ("Dropped (ring full):  %lu\n", stats.drop_full);
+	printf ("Dropped (no memory):  %lu\n", stats.drop_nomem);
+	printf ("Batches:              %lu\n", stats.batches);
+	printf ("Largest batch:        %lu\n", stats.max_batch);
+
+	return;
+}
+
 void
 cmd_radio (BaseSequentialStream *chp, int argc, char *argv[])
 {
@@ -274,6 +293,7 @@ cmd_radio (BaseSequentialStream *chp, int argc, char *argv[])
 		printf ("discover             Discover GATTC services\n");
 		printf ("read                 Perform GATTC read\n");
 		printf ("write                Perform GATTC write\n");
+		printf ("stats                Show radio event queue stats\n");
 		return;
 	}
 
@@ -301,6 +321,8 @@ cmd_radio (BaseSequentialStream *chp, int argc, char *argv[])
 		radio_read (chp, argc, argv);
 	else if (strcmp (argv[0], "write") == 0)
 		radio_write (chp, argc, argv);
+	else if (strcmp (argv[0], "stats") == 0)
+		radio_stats (chp, argc, argv);
 	else
 		printf ("Unrecognized radio command\n");
 
@@ -35,6 +35,7 @@
 #include "shell.h"
 
 #include "badge.h"
+#include "userconfig.h"
 
 static void
 cmd_reset(BaseSequentialStream *chp, int argc, char *argv[])
@@ -45,6 +46,7 @@ cmd_reset(BaseSequentialStream *chp, int argc, char *argv[])
 		return;
 	}
 
+	configFlush ();
 	NVIC_SystemReset ();
 	/* NOTREACHED */
 }
@@ -0,0 +1,120 @@
+/*-
+ * Copyright (c) 2019
+ *      Bill Paul <wpaul@windriver.com>.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed by Bill Paul.
+ * 4. Neither the name of the author nor the names of any co-contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Bill Paul AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL Bill Paul OR THE VOICES IN HIS HEAD
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "shell.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+#include "mmc.h"
+
+#include "sdbench.h"
+#include "badge.h"
+
+#define SDBENCH_FILE	"videos/misc/rickroll.vid"
+
+#define SDBENCH_CYCLES_PER_US	(NRF5_HFCLK_FREQUENCY / 1000000)
+
+static uint32_t sdbench_last;
+static uint32_t sdbench_frac;
+static uint32_t sdbench_us;
+
+/*
+ * Microseconds from the DWT cycle counter. The counter wraps every
+ * minute or so at 64MHz, so we keep our own running total rather
+ * than just scaling it.
+ */
+
+uint32_t
+sdbenchMicros (void)
+{
+	uint32_t now;
+
+	now = DWT->CYCCNT;
+	sdbench_frac += now - sdbench_last;
+	sdbench_last = now;
+
+	sdbench_us += sdbench_frac / SDBENCH_CYCLES_PER_US;
+	sdbench_frac %= SDBENCH_CYCLES_PER_US;
+
+	return (sdbench_us);
+}
+
+static void
+cmd_sdbench (BaseSequentialStream *chp, int argc, char *argv[])
+{
+	uint32_t flags = 0;
+	int nostream = 0;
+	char * name = SDBENCH_FILE;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		if (strcmp (argv[i], "-v") == 0)
+			flags |= SDBENCH_VERBOSE;
+		else if (strcmp (argv[i], "-n") == 0)
+			nostream = 1;
+		else if (argv[i][0] != '-')
+			name = argv[i];
+		else {
+			printf ("Usage: sdbench [-v] [-n] [file]\n");
+			printf ("  -v  print latency histograms\n");
+			printf ("  -n  turn off streaming reads\n");
+			return;
+		}
+	}
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	sdbench_last = DWT->CYCCNT;
+
+	if (nostream)
+		mmc_disk_stream_enable (0);
+
+	memset (&mmc_stats, 0, sizeof(mmc_stats));
+
+	sdbenchRun (name, flags);
+
+	printf ("mmc: cmds %ld joins %ld sectors %ld cache hits %ld\n",
+	    mmc_stats.cmds, mmc_stats.joins, mmc_stats.sectors,
+	    mmc_stats.hits);
+
+	if (nostream)
+		mmc_disk_stream_enable (1);
+
+	return;
+}
+
+orchard_command("sdbench", cmd_sdbench);
@@ -1,8 +1,25 @@
 #ifndef _CRC32H_
 #define _CRC32H_
 
+#include <stdint.h>
+#include <stddef.h>
+
 #define CRC_INIT	0xFFFFFFFF
 
+/* 8 = slice-by-8 (8KB of tables), 4 = slice-by-4 (4KB), 0 = 64 bytes */
+#ifndef CRC32_SLICE
+#define CRC32_SLICE	8
+#endif
+
+typedef struct crc32_ctx {
+	uint32_t	crc;
+	uint32_t	len;	/* bytes so far */
+} CRC32_CTX;
+
 uint32_t crc32_le(const uint8_t *buf, size_t len, uint32_t init);
 
+void crc32_init(CRC32_CTX *ctx, uint32_t init);
+void crc32_update(CRC32_CTX *ctx, const void *buf, size_t len);
+uint32_t crc32_final(CRC32_CTX *ctx);
+
 #endif /* _CRC32H_ */
@@ -0,0 +1,177 @@
+/* dds.c
+ *
+ * table driven sine tone synthesis, for touch tones and beeps
+ */
+
+#include "dds.h"
+
+/* First quarter of a sine wave, plus the peak */
+
+static const int16_t dds_sine[65] = {
+	0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+	6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+	18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+	27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+	32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767,
+};
+
+#define DDS_QUARTER	0x400000	/* quarter cycle, in 6.16 table units */
+#define DDS_ENV_ONE	32768
+
+/******************************************************************************
+*
+* ddsSine - look up the sine of a phase angle
+*
+* The full 32-bit range of <phase> is one cycle. The top two bits pick the
+* quadrant, the next 6 index the table and the 16 after that are used to
+* interpolate between neighbouring entries.
+*
+* RETURNS: sin(phase) scaled to +/-32767
+*/
+
+int16_t
+ddsSine (uint32_t phase)
+{
+	uint32_t pos;
+	uint32_t idx;
+	int32_t y;
+
+	pos = (phase >> 8) & (DDS_QUARTER - 1);
+
+	/* The second and fourth quarters run backwards. */
+
+	if (phase & 0x40000000)
+		pos = DDS_QUARTER - pos;
+
+	idx = pos >> 16;
+	y = dds_sine[idx];
+	if (idx < 64)
+		y += ((dds_sine[idx + 1] - y) * (int32_t)(pos & 0xFFFF)) >> 16;
+
+	if (phase & 0x80000000)
+		y = -y;
+
+	return ((int16_t)y);
+}
+
+/******************************************************************************
+*
+* ddsInit - set up a tone
+*
+* This function prepares <t> to generate the tones <freqa> and <freqb> (in
+* Hertz) mixed together at a sample rate of <rate>, with a peak amplitude of
+* <amp>. For a single tone, pass the same frequency twice. The tone plays
+* until ddsRelease() is called, with no envelope, unless ddsEnvelope() says
+* otherwise.
+*
+* RETURNS: N/A
+*/
+
+void
+ddsInit (DDS_TONE * t, uint32_t rate, uint32_t freqa, uint32_t freqb,
+    uint16_t amp)
+{
+	t->dt_phase[0] = 0;
+	t->dt_phase[1] = 0;
+	t->dt_step[0] = ((uint64_t)freqa << 32) / rate;
+	t->dt_step[1] = ((uint64_t)freqb << 32) / rate;
+	t->dt_pos = 0;
+	t->dt_len = 0;
+	t->dt_attack = 0;
+	t->dt_release = 0;
+	t->dt_amp = amp > DDS_AMP_MAX ? DDS_AMP_MAX : amp;
+
+	return;
+}
+
+/******************************************************************************
+*
+* ddsEnvelope - set a tone's length and envelope
+*
+* The tone will last <len> samples (0 means until ddsRelease() is called),
+* ramping up over the first <attack> samples and down over the last
+* <release> samples.
+*
+* RETURNS: N/A
+*/
+
+void
+ddsEnvelope (DDS_TONE * t, uint32_t len, uint32_t attack, uint32_t release)
+{
+	t->dt_len = len;
+	t->dt_attack = attack;
+	t->dt_release = release;
+
+	return;
+}
+
+/******************************************************************************
+*
+* ddsRelease - end a tone
+*
+* This function starts the release part of the envelope now, so that the
+* tone fades out and ends after the release time.
+*
+* RETURNS: N/A
+*/
+
+void
+ddsRelease (DDS_TONE * t)
+{
+	if (t->dt_len == 0 || t->dt_len > t->dt_pos + t->dt_release)
+		t->dt_len = t->dt_pos + t->dt_release;
+
+	return;
+}
+
+/******************************************************************************
+*
+* ddsFill - generate samples
+*
+* This function writes up to <cnt> samples of tone <t> into <buf>, <stride>
+* samples apart (1 for mono, 2 to fill one channel of interleaved stereo).
+*
+* RETURNS: The number of samples generated. This is less than <cnt> only if
+* the tone has ended.
+*/
+
+int
+ddsFill (DDS_TONE * t, int16_t * buf, int cnt, int stride)
+{
+	uint32_t env;
+	uint32_t rel;
+	int32_t s;
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		if (t->dt_len != 0 && t->dt_pos >= t->dt_len)
+			break;
+
+		s = ddsSine (t->dt_phase[0]) + ddsSine (t->dt_phase[1]);
+		s = (s * t->dt_amp) >> 16;
+
+		env = DDS_ENV_ONE;
+		if (t->dt_pos < t->dt_attack)
+			env = (t->dt_pos * DDS_ENV_ONE) / t->dt_attack;
+		if (t->dt_len != 0 && t->dt_len - t->dt_pos < t->dt_release) {
+			rel = ((t->dt_len - t->dt_pos) * DDS_ENV_ONE) /
+			    t->dt_release;
+			if (rel < env)
+				env = rel;
+		}
+		if (env != DDS_ENV_ONE)
+			s = (s * (int32_t)env) >> 15;
+
+		buf[i * stride] = (int16_t)s;
+
+		t->dt_phase[0] += t->dt_step[0];
+		t->dt_phase[1] += t->dt_step[1];
+		t->dt_pos++;
+	}
+
+	return (i);
+}
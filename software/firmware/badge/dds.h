@@ -0,0 +1,34 @@
+#ifndef _DDS_H_
+#define _DDS_H_
+
+#include <stdint.h>
+
+/*
+ * Direct digital synthesis of one or two mixed sine tones. Each
+ * oscillator is a 32-bit phase accumulator stepped once per sample;
+ * the top bits of the phase index a quarter-wave sine table. Tones
+ * can have a linear attack and release so they start and stop
+ * without clicks.
+ */
+
+#define DDS_AMP_MAX		32767
+
+typedef struct dds_tone {
+	uint32_t	dt_phase[2];
+	uint32_t	dt_step[2];
+	uint32_t	dt_pos;		/* samples generated so far */
+	uint32_t	dt_len;		/* total samples, 0 = until released */
+	uint32_t	dt_attack;	/* samples to ramp up */
+	uint32_t	dt_release;	/* samples to ramp down */
+	uint16_t	dt_amp;		/* peak amplitude */
+} DDS_TONE;
+
+extern int16_t ddsSine (uint32_t phase);
+extern void ddsInit (DDS_TONE *, uint32_t rate, uint32_t freqa,
+    uint32_t freqb, uint16_t amp);
+extern void ddsEnvelope (DDS_TONE *, uint32_t len, uint32_t attack,
+    uint32_t release);
+extern void ddsRelease (DDS_TONE *);
+extern int ddsFill (DDS_TONE *, int16_t * buf, int cnt, int stride);
+
+#endif /* _DDS_H_ */
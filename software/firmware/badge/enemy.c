@@ -75,27 +75,6 @@ void enemy_clearall_blink(gll_t *enemies)
   }
 }
 
-int enemy_find_ll_pos(gll_t *enemies, ble_gap_addr_t *ble_peer_addr)
-{
-  gll_node_t *currNode = enemies->first;
-  int         i        = 0;
-
-  while (currNode != NULL)
-  {
-    ENEMY *e = (ENEMY *)currNode->data;
-
-    if (memcmp(&(e->ble_peer_addr), ble_peer_addr, 6) == 0)
-    {
-      return(i);
-    }
-
-    i++;
-    currNode = currNode->next;
-  }
-
-  return(-1);
-}
-
 ENEMY *getNearestEnemy(gll_t *enemies, ENEMY *player)
 {
   // given my current position? are there any enemies near me?
@@ -108,10 +87,10 @@ ENEMY *getNearestEnemy(gll_t *enemies, ENEMY *player)
     // does not account for screen edges -- but might be ok?
     // also does not attempt to sort the enemy list. if two people in same place
     // we'll have an issue.
-    if ((e->e.vecPosition.x >= (player->e.vecPosition.x - (ENGAGE_BB / 2))) &&
-        (e->e.vecPosition.x <= (player->e.vecPosition.x + (ENGAGE_BB / 2))) &&
-        (e->e.vecPosition.y >= (player->e.vecPosition.y - (ENGAGE_BB / 2))) &&
-        (e->e.vecPosition.y <= (player->e.vecPosition.y + (ENGAGE_BB / 2))))
+    if ((e->e.vecPosition.x >= (player->e.vecPosition.x - FIX16_FROM_INT(ENGAGE_BB / 2))) &&
+        (e->e.vecPosition.x <= (player->e.vecPosition.x + FIX16_FROM_INT(ENGAGE_BB / 2))) &&
+        (e->e.vecPosition.y >= (player->e.vecPosition.y - FIX16_FROM_INT(ENGAGE_BB / 2))) &&
+        (e->e.vecPosition.y <= (player->e.vecPosition.y + FIX16_FROM_INT(ENGAGE_BB / 2))))
     {
       return(e);
     }
@@ -191,8 +170,8 @@ ENEMY *getEnemyFromBLE(ble_gap_addr_t *peer, ENEMY *current_enemy)
         current_enemy->energy    = shiptable[current_enemy->ship_type].max_energy;
         current_enemy->level     = p->ble_game_state.ble_ides_level;
 
-        current_enemy->e.vecPosition.x = p->ble_game_state.ble_ides_x;
-        current_enemy->e.vecPosition.y = p->ble_game_state.ble_ides_y;
+        current_enemy->e.vecPosition.x = FIX16_FROM_INT(p->ble_game_state.ble_ides_x);
+        current_enemy->e.vecPosition.y = FIX16_FROM_INT(p->ble_game_state.ble_ides_y);
 
         current_enemy->level          = p->ble_game_state.ble_ides_level;
         current_enemy->ship_locked_in = FALSE;
@@ -258,13 +237,13 @@ void enemy_list_refresh(gll_t *enemies,
         e->e.prevPos.x = e->e.vecPosition.x;
         e->e.prevPos.y = e->e.vecPosition.y;
 
-        e->e.vecPosition.x = p->ble_game_state.ble_ides_x;
-        e->e.vecPosition.y = p->ble_game_state.ble_ides_y;
+        e->e.vecPosition.x = FIX16_FROM_INT(p->ble_game_state.ble_ides_x);
+        e->e.vecPosition.y = FIX16_FROM_INT(p->ble_game_state.ble_ides_y);
 
         isp_set_sprite_xy(sprites,
                           e->e.sprite_id,
-                          e->e.vecPosition.x,
-                          e->e.vecPosition.y);
+                          FIX16_TO_INT(e->e.vecPosition.x),
+                          FIX16_TO_INT(e->e.vecPosition.y));
 
         e->xp        = p->ble_game_state.ble_ides_xp;
         e->level     = p->ble_game_state.ble_ides_level;
@@ -325,16 +304,16 @@ void enemy_list_refresh(gll_t *enemies,
         }
 
         e->e.visible       = TRUE;
-        e->e.vecPosition.x = p->ble_game_state.ble_ides_x;
-        e->e.vecPosition.y = p->ble_game_state.ble_ides_y;
+        e->e.vecPosition.x = FIX16_FROM_INT(p->ble_game_state.ble_ides_x);
+        e->e.vecPosition.y = FIX16_FROM_INT(p->ble_game_state.ble_ides_y);
 
         isp_set_sprite_xy(sprites,
                           e->e.sprite_id,
-                          e->e.vecPosition.x,
-                          e->e.vecPosition.y);
+                          FIX16_TO_INT(e->e.vecPosition.x),
+                          FIX16_TO_INT(e->e.vecPosition.y));
 
-        e->e.prevPos.x = p->ble_game_state.ble_ides_x;
-        e->e.prevPos.y = p->ble_game_state.ble_ides_y;
+        e->e.prevPos.x = FIX16_FROM_INT(p->ble_game_state.ble_ides_x);
+        e->e.prevPos.y = FIX16_FROM_INT(p->ble_game_state.ble_ides_y);
 
         memcpy(&e->ble_peer_addr.addr, p->ble_peer_addr, 6);
 
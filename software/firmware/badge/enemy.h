@@ -36,7 +36,6 @@ typedef struct _enemy
 
 extern ENEMY *enemy_find_by_peer(gll_t *enemies, uint8_t *);
 extern void enemy_clearall_blink(gll_t *enemies);
-extern int enemy_find_ll_pos(gll_t *enemies, ble_gap_addr_t *);
 ENEMY *getNearestEnemy(gll_t *enemies, ENEMY *player);
 extern ENEMY *enemy_engage(OrchardAppContext *context,
                            gll_t *enemies,
@@ -43,8 +43,8 @@ entity_init(ENTITY *p, ISPRITESYS *sprites, int16_t size_x, int16_t size_y, enti
   p->vecPosition.y = 0;
 
   // this is "ocean drag"
-  p->vecGravity.x = VDRAG;
-  p->vecGravity.y = VDRAG;
+  p->vecGravity.x = FIX16_FROM_FLOAT(VDRAG);
+  p->vecGravity.y = FIX16_FROM_FLOAT(VDRAG);
 
   p->vapproach = VAPPROACH;
   p->vmult = VAPPROACH;
@@ -87,3 +87,193 @@ entity_init(ENTITY *p, ISPRITESYS *sprites, int16_t size_x, int16_t size_y, enti
   isp_set_sprite_block(sprites, p->sprite_id, size_x, size_y, buf);
   free(buf);
 }
+
+/* approach lets us interpolate smoothly between positions */
+static fix16_t
+entity_approach(fix16_t goal, fix16_t current, fix16_t dt)
+{
+  fix16_t difference = goal - current;
+
+  if (difference > dt)
+    return(current + dt);
+
+  if (difference < -dt)
+    return(current - dt);
+
+  return(goal);
+}
+
+/*
+ * Move an entity on by one time step. This is only the physics; the
+ * caller deals with ttl, sprites and collisions.
+ */
+void
+entity_physics(ENTITY *p, fix16_t dt)
+{
+  p->vecVelocity.x = entity_approach(p->vecVelocityGoal.x,
+                                     p->vecVelocity.x,
+                                     dt * p->vapproach);
+
+  p->vecVelocity.y = entity_approach(p->vecVelocityGoal.y,
+                                     p->vecVelocity.y,
+                                     dt * p->vapproach);
+
+  p->vecPosition.x += fix16_mul(p->vecVelocity.x, dt) * p->vmult;
+  p->vecPosition.y += fix16_mul(p->vecVelocity.y, dt) * p->vmult;
+
+  p->vecVelocity.x += fix16_mul(p->vecGravity.x, dt);
+  p->vecVelocity.y += fix16_mul(p->vecGravity.y, dt);
+}
+
+static uint8_t
+entity_pool_cell(int16_t x, int16_t y)
+{
+  x = (x < 0) ? 0 : x / EGRID_CELL;
+  y = (y < 0) ? 0 : y / EGRID_CELL;
+  x = (x >= EGRID_W) ? EGRID_W - 1 : x;
+  y = (y >= EGRID_H) ? EGRID_H - 1 : y;
+
+  return((y * EGRID_W) + x);
+}
+
+static void
+entity_pool_unlink(ENTITY_POOL *pool, uint8_t slot)
+{
+  uint8_t *link;
+
+  link = &pool->grid[pool->cell[slot]];
+  while (*link != ENTITY_NONE)
+  {
+    if (*link == slot)
+    {
+      *link = pool->next[slot];
+      break;
+    }
+    link = &pool->next[*link];
+  }
+}
+
+static void
+entity_pool_link(ENTITY_POOL *pool, uint8_t slot)
+{
+  pool->cell[slot] = entity_pool_cell(pool->px[slot], pool->py[slot]);
+  pool->next[slot] = pool->grid[pool->cell[slot]];
+  pool->grid[pool->cell[slot]] = slot;
+}
+
+void
+entity_pool_init(ENTITY_POOL *pool)
+{
+  int i;
+
+  memset(pool->live, 0, sizeof(pool->live));
+  memset(pool->grid, ENTITY_NONE, sizeof(pool->grid));
+
+  for (i = 0; i < ENTITY_POOL_SIZE; i++)
+  {
+    pool->next[i] = (i + 1 < ENTITY_POOL_SIZE) ? i + 1 : ENTITY_NONE;
+  }
+
+  pool->freelist = 0;
+  pool->used     = 0;
+}
+
+/* returns a zeroed entity, or NULL if the pool is full */
+ENTITY *
+entity_alloc(ENTITY_POOL *pool)
+{
+  uint8_t slot;
+
+  slot = pool->freelist;
+  if (slot == ENTITY_NONE)
+  {
+    return(NULL);
+  }
+  pool->freelist = pool->next[slot];
+  pool->used++;
+
+  memset(&pool->ent[slot], 0, sizeof(ENTITY));
+  pool->live[slot] = &pool->ent[slot];
+  pool->px[slot]   = 0;
+  pool->py[slot]   = 0;
+  entity_pool_link(pool, slot);
+
+  return(&pool->ent[slot]);
+}
+
+void
+entity_free(ENTITY_POOL *pool, ENTITY *p)
+{
+  uint8_t slot;
+
+  slot = p - pool->ent;
+  if (pool->live[slot] == NULL)
+  {
+    return;
+  }
+
+  entity_pool_unlink(pool, slot);
+  pool->live[slot] = NULL;
+  pool->next[slot] = pool->freelist;
+  pool->freelist   = slot;
+  pool->used--;
+}
+
+/* call after an entity moves, to keep the grid up to date */
+void
+entity_pool_move(ENTITY_POOL *pool, ENTITY *p)
+{
+  uint8_t slot;
+
+  slot = p - pool->ent;
+  pool->px[slot] = FIX16_TO_INT(p->vecPosition.x);
+  pool->py[slot] = FIX16_TO_INT(p->vecPosition.y);
+
+  if (entity_pool_cell(pool->px[slot], pool->py[slot]) != pool->cell[slot])
+  {
+    entity_pool_unlink(pool, slot);
+    entity_pool_link(pool, slot);
+  }
+}
+
+/*
+ * Find the entities that might touch the box r. Boxes that only share
+ * an edge count, the same as isp_check_sprites_collision() with
+ * overlap FALSE. Results are candidates: the grid is only as fine
+ * as a cell, so callers still do their own exact test. Returns the
+ * number found, up to max.
+ */
+int
+entity_pool_query(ENTITY_POOL *pool, RECT r, ENTITY **out, int max)
+{
+  uint8_t x0, y0, x1, y1, x, y, slot;
+  int n = 0;
+
+  /* an entity can hang over from the cell up and to the left */
+  x0 = entity_pool_cell(r.x - EGRID_CELL, 0);
+  y0 = entity_pool_cell(0, r.y - EGRID_CELL) / EGRID_W;
+  x1 = entity_pool_cell(r.xr, 0);
+  y1 = entity_pool_cell(0, r.yb) / EGRID_W;
+
+  for (y = y0; y <= y1; y++)
+  {
+    for (x = x0; x <= x1; x++)
+    {
+      for (slot = pool->grid[(y * EGRID_W) + x];
+           slot != ENTITY_NONE;
+           slot = pool->next[slot])
+      {
+        if ((pool->px[slot] <= r.xr) &&
+            (pool->py[slot] <= r.yb) &&
+            (pool->px[slot] + pool->ent[slot].size_x >= r.x) &&
+            (pool->py[slot] + pool->ent[slot].size_y >= r.y) &&
+            (n < max))
+        {
+          out[n++] = pool->live[slot];
+        }
+      }
+    }
+  }
+
+  return(n);
+}
@@ -2,6 +2,7 @@
 #define _ENTITY_H_
 
 #include "vector.h"
+#include "ships.h"
 
 /*
  * We define entity types as macros rather than using an enum,
@@ -43,7 +44,7 @@ typedef struct _entity
   VECTOR      vecGravity;
   VECTOR      vecPositionLast; /* if this doesn't match, we'll erase and repaint */
 
-  float       vdrag;
+  fix16_t     vdrag;
   int8_t      vapproach;
   int8_t      vmult;
   int8_t      vgoal;
@@ -52,7 +53,47 @@ typedef struct _entity
   uint8_t     size_y;
 } ENTITY;
 
+/*
+ * Fixed size store for short lived entities (bullets and mines), so
+ * firing doesn't go through malloc()/free(). Free slots are chained
+ * through next[]. Used slots are also hashed into a uniform grid over
+ * the screen by the cell their top left corner is in, so collision
+ * checks only have to look at the cells near a ship. Positions are kept
+ * in whole pixels in separate arrays for the grid; the ENTITY itself is
+ * still the real state.
+ *
+ * Anything stored here must be no bigger than a grid cell.
+ */
+
+#define ENTITY_POOL_SIZE  MAX_BULLETS
+#define ENTITY_NONE       0xFF
+
+#define EGRID_CELL        32
+#define EGRID_W           ((SCREEN_W + EGRID_CELL - 1) / EGRID_CELL)
+#define EGRID_H           ((SCREEN_H + EGRID_CELL - 1) / EGRID_CELL)
+
+typedef struct _entity_pool
+{
+  ENTITY   ent[ENTITY_POOL_SIZE];
+  ENTITY * live[ENTITY_POOL_SIZE];  /* &ent[i] while in use, else NULL */
+  int16_t  px[ENTITY_POOL_SIZE];    /* position, in pixels */
+  int16_t  py[ENTITY_POOL_SIZE];
+  uint8_t  cell[ENTITY_POOL_SIZE];  /* grid cell we're filed under */
+  uint8_t  next[ENTITY_POOL_SIZE];  /* next in cell, or next free slot */
+  uint8_t  grid[EGRID_W * EGRID_H]; /* first slot in each cell */
+  uint8_t  freelist;                /* first free slot */
+  uint8_t  used;
+} ENTITY_POOL;
+
 extern void
 entity_init(ENTITY *p, ISPRITESYS *sprites, int16_t size_x, int16_t size_y, entity_type t);
+extern void entity_physics(ENTITY *p, fix16_t dt);
+
+extern void entity_pool_init(ENTITY_POOL *pool);
+extern ENTITY *entity_alloc(ENTITY_POOL *pool);
+extern void entity_free(ENTITY_POOL *pool, ENTITY *p);
+extern void entity_pool_move(ENTITY_POOL *pool, ENTITY *p);
+extern int entity_pool_query(ENTITY_POOL *pool, RECT r,
+                             ENTITY **out, int max);
 
 #endif /* _ENTITY_H_ */
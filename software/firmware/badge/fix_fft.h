@@ -1,6 +1,9 @@
 #ifndef _FIX_FFT_H_
 #define _FIX_FFT_H_
 
+/* One full cycle in N_WAVE (1024) points, of which the first 3/4 are kept */
+extern short Sinewave[];
+
 extern int fix_fft(short fr[], short fi[], short m, short inverse);
 extern int fix_fftr(short fr[], short m, short inverse);
 
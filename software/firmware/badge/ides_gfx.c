@@ -19,6 +19,7 @@
 
 #include "ffconf.h"
 #include "ff.h"
+#include "mmc.h"
 
 #include "async_io_lld.h"
 #include "badge.h"
@@ -196,6 +197,7 @@ static int
 putRgbImage (char *name, int16_t x, int16_t y)
 {
 	FIL f;
+	DWORD clmt[16];
 	uint16_t h;
 	uint16_t w;
 	GDISP_IMAGE hdr;
@@ -207,6 +209,8 @@ putRgbImage (char *name, int16_t x, int16_t y)
 	if (f_open (&f, name, FA_READ) != FR_OK)
 		return (1);
 
+	mmc_disk_map (&f, clmt, sizeof(clmt) / sizeof(DWORD));
+
 	f_read (&f, &hdr, sizeof(GDISP_IMAGE), &br1);
 	h = hdr.gdi_height_hi << 8 | hdr.gdi_height_lo;
 	w = hdr.gdi_width_hi << 8 | hdr.gdi_width_lo;
@@ -47,6 +47,25 @@ typedef struct _4rect {
   RECT bx[4];
 } FOUR_RECTS;
 
+/* compositor bookkeeping for one BG restore */
+typedef struct _isp_restore {
+  RECT r;         /* old BG position, unclipped. buf is laid out to match */
+  pixel_t *buf;   /* old BG pixels, NULL for fixed color */
+  color_t color;
+} ISP_RESTORE;
+
+/* compositor bookkeeping for one sprite that gets (re)drawn */
+typedef struct _isp_paint {
+  ISPID id;
+  RECT r;         /* new sprite position, unclipped */
+  pixel_t *cap;   /* new BG buffer to capture into, or NULL */
+  bool_t cover;   /* sprite hides whatever is under it */
+} ISP_PAINT;
+
+/* max number of uncovered pieces of a band we track before giving up
+ * and reading the whole band back */
+#define ISP_MAX_PIECES 16
+
 const RECT rect_default = {.x=0, .y=0, .xr=0, .yb=0};
 
 static int allo_num=0;
@@ -270,7 +289,9 @@ WMAP *wm_copy_wmap(WMAP *w)
 
 static void wm_set_first_last_per_row(WMAP *w)
 {
-  coord_t y, x,last;
+  coord_t y, last;
+  int i;
+  uint32_t *row;
   if(NULL != w)
   {
     last = (w->w - 1);
@@ -281,21 +302,22 @@ static void wm_set_first_last_per_row(WMAP *w)
       {
         w->map[y].first_px = 0;
         w->map[y].last_px  = last;
+        row = w->map[y].row;
 
-        for(x=0; x < w->w; x++)
+        /* find the lowest and highest set bits a word at a time */
+        for(i=0; i < WMAP_W; i++)
         {
-          if(wm_value(w, x,y, 3))
+          if(row[i])
           {
-
-            w->map[y].first_px = x;
+            w->map[y].first_px = (i * 32) + __builtin_ctz(row[i]);
             break;
           }
         }
-        for(x = last ; x >= w->map[y].first_px; x--)
+        for(i=WMAP_W-1; i >= 0; i--)
         {
-          if(wm_value(w, x,y, 3))
+          if(row[i])
           {
-            w->map[y].last_px = x;
+            w->map[y].last_px = (i * 32) + 31 - __builtin_clz(row[i]);
             break;
           }
         }
@@ -330,7 +352,22 @@ printf("x%u y%u offs%u bit %u w%d - %u wh%x bit%x\n", x, y, offs, bit,w->h, v, &
     else if(1 == v)
     {
       w->map[y].row[offs] |= 1<< bit;
-      w->map[y].notblank = TRUE;
+      /* keep first_px/last_px covering every set pixel, so the
+       * collision checks can trust them without a rescan */
+      if(TRUE != w->map[y].notblank)
+      {
+        w->map[y].first_px = x;
+        w->map[y].last_px  = x;
+        w->map[y].notblank = TRUE;
+      }
+      else if(x < w->map[y].first_px)
+      {
+        w->map[y].first_px = x;
+      }
+      else if(x > w->map[y].last_px)
+      {
+        w->map[y].last_px = x;
+      }
     }
     else
     {
@@ -489,6 +526,47 @@ void print_rect(char *s, RECT r)
   printf("%s: x:%d y:%d xr:%d yb:%d\n", s, r.x, r.y, r.xr, r.yb);
 }
 
+/* mask of the bits in word i that fall between pixels x and xr, inclusive */
+static uint32_t wm_span_mask(int i, coord_t x, coord_t xr)
+{
+  uint32_t mask = 0xffffffff;
+
+  if(WM_STEP(x) == (uint32_t)i)
+  {
+    mask &= 0xffffffff << WM_BIT(x);
+  }
+  if(WM_STEP(xr) == (uint32_t)i)
+  {
+    mask &= 0xffffffff >> (31 - WM_BIT(xr));
+  }
+  return(mask);
+}
+
+/* 32 pixels of a row starting at pixel x, which may hang off either end */
+static uint32_t wm_row_bits(WROW *r, int x)
+{
+  int i, sh;
+  uint32_t ret;
+
+  if( (x <= -32) || (x >= (WMAP_W * 32)) )
+  {
+    return(0);
+  }
+  if(x < 0)
+  {
+    return(r->row[0] << -x);
+  }
+
+  i  = x / 32;
+  sh = x % 32;
+  ret = r->row[i] >> sh;
+  if( (sh > 0) && ((i + 1) < WMAP_W) )
+  {
+    ret |= r->row[i + 1] << (32 - sh);
+  }
+  return(ret);
+}
+
 /* pass valid rect to limit collision test to those coords */
 /* currenly uses that as course guide, it starts at the (int) containing that coord.
  * so in this case, we say 45, but this will start at 32, which is the start of that
@@ -497,16 +575,19 @@ void print_rect(char *s, RECT r)
  *  01234567890123456789801234567891  23456789012345678901234567890123
  * [................................][.............|||||||||||........]
  *
+ * rows that are blank in either map, or whose first_px/last_px spans don't
+ * overlap, are skipped without touching the bits.
  */
 bool_t wm_collision_check_maps(WMAP *mapa, WMAP *mapb, RECT r)
 {
-  coord_t x=0, y=0, xmax=0, ymax=0, xstart=0;
-  bool_t ret=FALSE;
+  coord_t y=0, ymax=0, lo, hi;
+  int x, xstart=0, xmax=0, xs, xe;
+  WROW *ra, *rb;
 
   if(is_valid_rect(r))
   {
-    xstart = WM_STEP(r.x);
-    y = r.y;
+    xstart = (r.x > 0) ? WM_STEP(r.x) : 0;
+    y = (r.y > 0) ? r.y : 0;
     xmax = WM_STEP(r.xr);
     ymax = r.yb;
   }
@@ -515,23 +596,107 @@ bool_t wm_collision_check_maps(WMAP *mapa, WMAP *mapb, RECT r)
     xmax = WM_STEP(mapa->w);
     ymax = mapa->h;
   }
+  if(xmax >= WMAP_W)
+  {
+    xmax = WMAP_W - 1;
+  }
+  ymax = (ymax > mapa->h) ? mapa->h : ymax;
+  ymax = (ymax > mapb->h) ? mapb->h : ymax;
 
   for( ; y < ymax; y++)
   {
-    for(x=xstart ; x <= xmax; x++)
+    ra = &mapa->map[y];
+    rb = &mapb->map[y];
+    if( (TRUE != ra->notblank) || (TRUE != rb->notblank) )
+    {
+      continue;
+    }
+
+    lo = (ra->first_px > rb->first_px) ? ra->first_px : rb->first_px;
+    hi = (ra->last_px < rb->last_px) ? ra->last_px : rb->last_px;
+    if(lo > hi)
+    {
+      continue;
+    }
+
+    xs = ((int)WM_STEP(lo) > xstart) ? (int)WM_STEP(lo) : xstart;
+    xe = ((int)WM_STEP(hi) < xmax) ? (int)WM_STEP(hi) : xmax;
+    for(x=xs; x <= xe; x++)
     {
-      if(mapa->map[y].row[x] & mapb->map[y].row[x])
+      if(ra->row[x] & rb->row[x])
       {
-        ret = TRUE;
-        break;
+        return(TRUE);
       }
     }
-    if(TRUE == ret)
+  }
+  return(FALSE);
+}
+
+/* pixel accurate test of two maps sitting at (ax,ay) and (bx,by) on the
+ * same screen.  the map RECTs are the broad phase, then each overlapping
+ * row is ANDed a word at a time, with b's bits shifted into line with a's
+ * words.
+ */
+bool_t wm_collision_check_offset(WMAP *a, coord_t ax, coord_t ay,
+                                 WMAP *b, coord_t bx, coord_t by)
+{
+  RECT ra, rb;
+  coord_t y, x0, x1, t;
+  int i;
+  WROW *wa, *wb;
+
+  if( (NULL == a) || (NULL == b) )
+  {
+    return(FALSE);
+  }
+
+  ra.x = ax; ra.y = ay; ra.xr = ax + a->w; ra.yb = ay + a->h;
+  rb.x = bx; rb.y = by; rb.xr = bx + b->w; rb.yb = by + b->h;
+
+  /* overlap of the two boxes, in screen coords */
+  ra.x  = (ra.x > rb.x) ? ra.x : rb.x;
+  ra.y  = (ra.y > rb.y) ? ra.y : rb.y;
+  ra.xr = (ra.xr < rb.xr) ? ra.xr : rb.xr;
+  ra.yb = (ra.yb < rb.yb) ? ra.yb : rb.yb;
+  if( (ra.x >= ra.xr) || (ra.y >= ra.yb) )
+  {
+    return(FALSE);
+  }
+
+  for(y = ra.y; y < ra.yb; y++)
+  {
+    wa = &a->map[y - ay];
+    wb = &b->map[y - by];
+    if( (TRUE != wa->notblank) || (TRUE != wb->notblank) )
+    {
+      continue;
+    }
+
+    /* narrow the span down, in a's coords */
+    x0 = ra.x - ax;
+    x1 = ra.xr - 1 - ax;
+    x0 = (wa->first_px > x0) ? wa->first_px : x0;
+    x1 = (wa->last_px < x1) ? wa->last_px : x1;
+    t  = wb->first_px + bx - ax;
+    x0 = (t > x0) ? t : x0;
+    t  = wb->last_px + bx - ax;
+    x1 = (t < x1) ? t : x1;
+    if(x0 > x1)
     {
-      break;
+      continue;
+    }
+
+    for(i = WM_STEP(x0); i <= (int)WM_STEP(x1); i++)
+    {
+      if(wa->row[i] &
+         wm_row_bits(wb, (i * 32) + ax - bx) &
+         wm_span_mask(i, x0, x1))
+      {
+        return(TRUE);
+      }
     }
   }
-  return(ret);
+  return(FALSE);
 }
 
 
@@ -595,24 +760,43 @@ bool_t wm_make_collision_box(WMAP *w, RECT r)
 }
 
 
+/* any land under the box? the box edges are masked straight into the
+ * row words, rather than drawing the box into a scratch map */
 bool_t wm_check_box_for_land_collision(WMAP *w, RECT r)
 {
-  bool_t ret = FALSE;
-  WMAP *test;
+  coord_t y, x0, x1, ymax;
+  int i;
+  WROW *row;
+
   if( (NULL != w) && (is_valid_rect(r)) )
   {
-    test = wm_make_screensize_wmap();
-    wm_make_collision_box(test, r);
-/*
-  print_wmap_hits(test);
-*/
-  /* make a single row that has 1 in every X coord where the RECT covers.
-   * no need to do this for every row, it's box, every row is the osalMutexLock */
+    ymax = (r.yb > w->h) ? w->h : r.yb;
+    for(y = (r.y > 0) ? r.y : 0; y < ymax; y++)
+    {
+      row = &w->map[y];
+      if(TRUE != row->notblank)
+      {
+        continue;
+      }
 
-    ret = wm_collision_check_maps(w, test, r);
-    wm_destroy_wmap(test);
+      x0 = (r.x > row->first_px) ? r.x : row->first_px;
+      x1 = ((r.xr - 1) < row->last_px) ? (r.xr - 1) : row->last_px;
+      x1 = (x1 < (w->w - 1)) ? x1 : (w->w - 1);
+      if(x0 > x1)
+      {
+        continue;
+      }
+
+      for(i = WM_STEP(x0); i <= (int)WM_STEP(x1); i++)
+      {
+        if(row->row[i] & wm_span_mask(i, x0, x1))
+        {
+          return(TRUE);
+        }
+      }
+    }
   }
-  return(ret);
+  return(FALSE);
 }
 
 
@@ -1264,6 +1448,9 @@ ISPRITESYS *isp_init(void)
   if(NULL != iss)
   {
     iss->wm = NULL;
+    iss->composite = FALSE;
+    iss->tile = NULL;
+    memset(&iss->stats, 0, sizeof(ISPSTATS));
     for(i=0; i < ISP_MAX_SPRITES; i++)
     {
       iss->list[i] = isprite_default;
@@ -1351,6 +1538,33 @@ bool_t isp_check_sprites_collision(ISPRITESYS *iss, ISPID id1, ISPID id2, bool_t
 
 
 
+/* like isp_check_sprites_collision(), but only solid pixels count.  the
+ * sprite boxes are the broad phase, and the alpha maps the narrow phase.
+ * overlap means the same as it does there, for the box test.  a sprite
+ * with no alpha map is treated as a solid box, so if either one has no
+ * map this is the same as isp_check_sprites_collision().
+ */
+bool_t isp_check_sprites_pixel_collision(ISPRITESYS *iss, ISPID id1, ISPID id2,
+                                         bool_t overlap)
+{
+  bool_t ret;
+
+  ret = isp_check_sprites_collision(iss, id1, id2, overlap, FALSE);
+  if( ret &&
+      (NULL != iss->list[id1].alphamap) &&
+      (NULL != iss->list[id2].alphamap) )
+  {
+    ret = wm_collision_check_offset(iss->list[id1].alphamap,
+                                    iss->list[id1].sp_buf.x,
+                                    iss->list[id1].sp_buf.y,
+                                    iss->list[id2].alphamap,
+                                    iss->list[id2].sp_buf.x,
+                                    iss->list[id2].sp_buf.y);
+  }
+  return(ret);
+}
+
+
 /* if one dirty sprite has any coordinate overlap with another sprite, they both must become dirty
  * if visible_only is true, it will only compare against visible sprites.
  * if it's false, it will compare against visible and invisible sprites.
@@ -1610,9 +1824,466 @@ bool_t test_sprite_for_land_collision(ISPRITESYS *iss, ISPID id)
   return(ret);
 }
 
+/* switch auto_bg sprites that crossed between land and water to the
+ * other BG mode.  must be called after the old BGs have been restored */
+static void isp_switch_bg_modes(ISPRITESYS *iss, ISPID *slist, ISPID max)
+{
+  ISPID i, id;
+
+  if(NULL != iss->wm)
+  {
+    for(i=0; i< max; i++)
+    {
+      id = slist[i];
+      if(iss->list[id].auto_bg && iss->list[id].mode_switch)
+      {
+        iss->list[id].mode_switch = FALSE;
+        if(ISP_BG_FIXEDCOLOR == iss->list[id].bgtype)
+        {
+          iss->list[id].bgtype = ISP_BG_DYNAMIC;
+          //iss->list[id].status = ISP_STAT_DIRTY_BOTH;
+        }
+        else
+        {
+          iss->list[id].bgtype = ISP_BG_FIXEDCOLOR;
+        }
+      }
+    }
+  }
+}
+
+/* paint straight to the screen, one sprite at a time */
+static void isp_draw_direct(ISPRITESYS *iss, ISPID *slist, ISPID max)
+{
+  ISPID i, id;
+
+  /* first restore all dirty BG blocks*/
+  for(i=0; i< max; i++)
+  {
+    id = slist[i];
+    if(ISP_STAT_DIRTY_BOTH == iss->list[id].status)
+    {
+      isp_restore_bg(iss, id);
+    }
+  }
+
+  isp_switch_bg_modes(iss, slist, max);
+
+  /* now collect BG block from new sprite postitions */
+  for(i=0; i< max; i++)
+  {
+    id = slist[i];
+
+  /* only save BG if sprite is visibe AND either status is Dirty, or we have no BG */
+    if( (iss->list[id].visible) &&
+        ((ISP_STAT_DIRTY_BOTH == iss->list[id].status ) || (NULL == iss->list[id].bg_buf.buf))  )
+    {
+      isp_capture_bg(iss, id);
+      iss->list[id].status = ISP_STAT_DIRTY_SP;
+    }
+
+  }
+  /* now paint all dirty sprites */
+  for(i=0; i< max; i++)
+  {
+    id = slist[i];
+    /* this handles visibility checks and changes flag status.  just let it  figure it out. */
+    isp_draw_sprite(iss, id);
+  }
+}
+
+/*
+ * Dirty rectangle compositor.
+ *
+ * The direct path restores and redraws every sprite straight to the
+ * screen, so overlapping sprites get painted over several times and each
+ * piece costs its own SPI window.  Here we collect every area that will
+ * change this frame (old BGs being restored and sprites being redrawn),
+ * merge those into non-overlapping rectangles, and build each rectangle
+ * in a RAM tile in the same order the direct path would paint it: screen
+ * contents, restored BGs, BG capture, sprites.  The tile then goes out
+ * with a single putPixelBlock().  Rectangles bigger than the tile are
+ * done in horizontal bands.
+ *
+ * Reading back from the screen is slow, so only the parts of a band that
+ * aren't fully painted over by a restore or an opaque sprite are read.
+ */
+
+static ISP_RESTORE isp_rs[ISP_MAX_SPRITES];
+static ISP_PAINT isp_pt[ISP_MAX_SPRITES];
+static RECT isp_dirty[ISP_MAX_DIRTY];
+
+/* overlap of a and b.  returns FALSE if there isn't any */
+static bool_t isp_rect_and(RECT a, RECT b, RECT *out)
+{
+  out->x  = (a.x > b.x) ? a.x : b.x;
+  out->y  = (a.y > b.y) ? a.y : b.y;
+  out->xr = (a.xr < b.xr) ? a.xr : b.xr;
+  out->yb = (a.yb < b.yb) ? a.yb : b.yb;
+  return( (out->x < out->xr) && (out->y < out->yb) );
+}
+
+/* clip to the screen.  returns FALSE if nothing is left */
+static bool_t isp_rect_clip_screen(RECT *r)
+{
+  RECT scr = {.x=0, .y=0, .xr=SCREEN_W, .yb=SCREEN_H};
+  return(isp_rect_and(*r, scr, r));
+}
+
+/* a minus c, as up to 4 rectangles.  returns the count */
+static int isp_rect_cut(RECT a, RECT c, RECT *out)
+{
+  RECT o;
+  int n=0;
+
+  if(!isp_rect_and(a, c, &o))
+  {
+    out[0] = a;
+    return(1);
+  }
+  if(a.y < o.y)
+  {
+    out[n].x = a.x; out[n].xr = a.xr; out[n].y = a.y; out[n].yb = o.y;
+    n++;
+  }
+  if(o.yb < a.yb)
+  {
+    out[n].x = a.x; out[n].xr = a.xr; out[n].y = o.yb; out[n].yb = a.yb;
+    n++;
+  }
+  if(a.x < o.x)
+  {
+    out[n].x = a.x; out[n].xr = o.x; out[n].y = o.y; out[n].yb = o.yb;
+    n++;
+  }
+  if(o.xr < a.xr)
+  {
+    out[n].x = o.xr; out[n].xr = a.xr; out[n].y = o.y; out[n].yb = o.yb;
+    n++;
+  }
+  return(n);
+}
+
+/* remove c from a list of pieces.  returns the new count, or -1 if the
+ * list overflowed */
+static int isp_pieces_cut(RECT *piece, int n, RECT c)
+{
+  RECT out[ISP_MAX_PIECES], cut[4];
+  int i, j, k, m=0;
+
+  for(i=0; i < n; i++)
+  {
+    k = isp_rect_cut(piece[i], c, cut);
+    for(j=0; j < k; j++)
+    {
+      if(m == ISP_MAX_PIECES)
+      {
+        return(-1);
+      }
+      out[m++] = cut[j];
+    }
+  }
+  memcpy(piece, out, m * sizeof(RECT));
+  return(m);
+}
+
+/* copy the area c from one pixel block to another. each block is laid
+ * out to cover its RECT */
+static void isp_blit(pixel_t *dst, RECT dr, pixel_t *src, RECT sr, RECT c)
+{
+  coord_t y, dw, sw, len;
+
+  dw = dr.xr - dr.x;
+  sw = sr.xr - sr.x;
+  len = (c.xr - c.x) * sizeof(pixel_t);
+  for(y = c.y; y < c.yb; y++)
+  {
+    memcpy(&dst[((y - dr.y) * dw) + (c.x - dr.x)],
+           &src[((y - sr.y) * sw) + (c.x - sr.x)], len);
+  }
+}
+
+static void isp_fill(pixel_t *dst, RECT dr, RECT c, color_t col)
+{
+  coord_t x, y, dw;
+  pixel_t *p;
+
+  dw = dr.xr - dr.x;
+  for(y = c.y; y < c.yb; y++)
+  {
+    p = &dst[((y - dr.y) * dw) + (c.x - dr.x)];
+    for(x = c.x; x < c.xr; x++)
+    {
+      *p++ = col;
+    }
+  }
+}
+
+/* load whatever part of the band isn't going to be painted over from
+ * the screen */
+static void isp_read_band(ISPRITESYS *iss, RECT band, int nrs, int npt)
+{
+  RECT piece[ISP_MAX_PIECES];
+  coord_t w, y;
+  int i, n;
+
+  piece[0] = band;
+  n = 1;
+  for(i=0; (i < nrs) && (n > 0); i++)
+  {
+    n = isp_pieces_cut(piece, n, isp_rs[i].r);
+  }
+  for(i=0; (i < npt) && (n > 0); i++)
+  {
+    if(isp_pt[i].cover)
+    {
+      n = isp_pieces_cut(piece, n, isp_pt[i].r);
+    }
+  }
+
+  if(n < 0)
+  {
+    piece[0] = band;
+    n = 1;
+  }
+
+  w = band.xr - band.x;
+  for(i=0; i < n; i++)
+  {
+    if( (piece[i].x == band.x) && (piece[i].xr == band.xr) )
+    {
+      getPixelBlock(piece[i].x, piece[i].y,
+                    w, piece[i].yb - piece[i].y,
+                    &iss->tile[(piece[i].y - band.y) * w]);
+    }
+    else
+    {
+      for(y = piece[i].y; y < piece[i].yb; y++)
+      {
+        getPixelBlock(piece[i].x, y, piece[i].xr - piece[i].x, 1,
+                      &iss->tile[((y - band.y) * w) + (piece[i].x - band.x)]);
+      }
+    }
+    iss->stats.reads++;
+  }
+}
+
+static void isp_composite(ISPRITESYS *iss, ISPID *slist, ISPID max)
+{
+  ISPID i, id;
+  ISPRITE *sp;
+  RECT r, c, band;
+  coord_t w, rows;
+  int j, k, nrs=0, npt=0, nd=0;
+  bool_t merged;
+
+  /* old BGs that need restoring.  note what they were before any of
+   * them change mode */
+  for(i=0; i < max; i++)
+  {
+    id = slist[i];
+    sp = &iss->list[id];
+    if( (ISP_STAT_DIRTY_BOTH == sp->status) &&
+        (sp->bg_buf.xs > 0) &&
+        (sp->bg_buf.ys > 0) &&
+        ((ISP_BG_FIXEDCOLOR == sp->bgtype) || (NULL != sp->bg_buf.buf)) )
+    {
+      isp_rs[nrs].r = make_rect(sp->bg_buf);
+      isp_rs[nrs].buf = (ISP_BG_DYNAMIC == sp->bgtype) ? sp->bg_buf.buf : NULL;
+      isp_rs[nrs].color = sp->bgcolor;
+      r = isp_rs[nrs].r;
+      if(isp_rect_clip_screen(&r))
+      {
+        isp_dirty[nd++] = r;
+      }
+      nrs++;
+      sp->full_restore = FALSE;
+    }
+  }
+
+  isp_switch_bg_modes(iss, slist, max);
+
+  /* sprites that get painted, and where their new BGs go */
+  for(i=0; i < max; i++)
+  {
+    id = slist[i];
+    sp = &iss->list[id];
+    if(!sp->visible)
+    {
+      continue;
+    }
+    isp_pt[npt].id = id;
+    isp_pt[npt].r = make_rect(sp->sp_buf);
+    isp_pt[npt].cap = NULL;
+    isp_pt[npt].cover = (NULL != sp->sp_buf.buf);
+
+    if( (ISP_STAT_DIRTY_BOTH == sp->status) || (NULL == sp->bg_buf.buf) )
+    {
+      if( (ISP_BG_DYNAMIC == sp->bgtype) &&
+          (sp->sp_buf.xs > 0) &&
+          (sp->sp_buf.ys > 0) )
+      {
+        /* the old BG gets restored before the new one is captured in
+         * every band, so the buffer can be reused only if it hasn't moved */
+        if( (NULL != sp->bg_buf.buf) &&
+            (sp->bg_buf.x == sp->sp_buf.x) &&
+            (sp->bg_buf.y == sp->sp_buf.y) &&
+            (sp->bg_buf.xs == sp->sp_buf.xs) &&
+            (sp->bg_buf.ys == sp->sp_buf.ys) )
+        {
+          isp_pt[npt].cap = sp->bg_buf.buf;
+        }
+        else
+        {
+          isp_pt[npt].cap = (pixel_t *)dmalloc(sp->sp_buf.xs * sp->sp_buf.ys * sizeof(pixel_t),
+                                               "isp_composite() dynamic BG buffer");
+        }
+      }
+      sp->status = ISP_STAT_DIRTY_SP;
+    }
+
+    if(ISP_STAT_CLEAN != sp->status)
+    {
+      r = isp_pt[npt].r;
+      if( (NULL != sp->sp_buf.buf) && isp_rect_clip_screen(&r) )
+      {
+        isp_dirty[nd++] = r;
+      }
+      npt++;
+    }
+  }
+
+  /* a sprite only hides what's under it if nothing captures from there */
+  for(j=0; j < npt; j++)
+  {
+    for(k=0; (k < npt) && isp_pt[j].cover; k++)
+    {
+      if( (NULL != isp_pt[k].cap) &&
+          isp_rect_and(isp_pt[j].r, isp_pt[k].r, &c) )
+      {
+        isp_pt[j].cover = FALSE;
+      }
+    }
+  }
+
+  /* merge anything that overlaps or touches until nothing does */
+  do
+  {
+    merged = FALSE;
+    for(j=0; j < nd; j++)
+    {
+      for(k=j+1; k < nd; k++)
+      {
+        if( (isp_dirty[j].x <= isp_dirty[k].xr) && (isp_dirty[k].x <= isp_dirty[j].xr) &&
+            (isp_dirty[j].y <= isp_dirty[k].yb) && (isp_dirty[k].y <= isp_dirty[j].yb) )
+        {
+          isp_dirty[j].x  = (isp_dirty[k].x  < isp_dirty[j].x)  ? isp_dirty[k].x  : isp_dirty[j].x;
+          isp_dirty[j].y  = (isp_dirty[k].y  < isp_dirty[j].y)  ? isp_dirty[k].y  : isp_dirty[j].y;
+          isp_dirty[j].xr = (isp_dirty[k].xr > isp_dirty[j].xr) ? isp_dirty[k].xr : isp_dirty[j].xr;
+          isp_dirty[j].yb = (isp_dirty[k].yb > isp_dirty[j].yb) ? isp_dirty[k].yb : isp_dirty[j].yb;
+          isp_dirty[k] = isp_dirty[--nd];
+          merged = TRUE;
+          k--;
+        }
+      }
+    }
+  } while(merged);
+
+  /* compose and push each rectangle */
+  for(j=0; j < nd; j++)
+  {
+    w = isp_dirty[j].xr - isp_dirty[j].x;
+    rows = ISP_TILE_PIXELS / w;
+    band = isp_dirty[j];
+    for(band.y = isp_dirty[j].y; band.y < isp_dirty[j].yb; band.y += rows)
+    {
+      band.yb = band.y + rows;
+      if(band.yb > isp_dirty[j].yb)
+      {
+        band.yb = isp_dirty[j].yb;
+      }
+
+      isp_read_band(iss, band, nrs, npt);
+
+      for(k=0; k < nrs; k++)
+      {
+        if(isp_rect_and(band, isp_rs[k].r, &c))
+        {
+          if(NULL != isp_rs[k].buf)
+          {
+            isp_blit(iss->tile, band, isp_rs[k].buf, isp_rs[k].r, c);
+          }
+          else
+          {
+            isp_fill(iss->tile, band, c, isp_rs[k].color);
+          }
+        }
+      }
+
+      for(k=0; k < npt; k++)
+      {
+        if( (NULL != isp_pt[k].cap) &&
+            isp_rect_and(band, isp_pt[k].r, &c) )
+        {
+          isp_blit(isp_pt[k].cap, isp_pt[k].r, iss->tile, band, c);
+        }
+      }
+
+      for(k=0; k < npt; k++)
+      {
+        sp = &iss->list[isp_pt[k].id];
+        if( (NULL != sp->sp_buf.buf) &&
+            isp_rect_and(band, isp_pt[k].r, &c) )
+        {
+          isp_blit(iss->tile, band, sp->sp_buf.buf, isp_pt[k].r, c);
+        }
+      }
+
+      putPixelBlock(band.x, band.y, w, band.yb - band.y, iss->tile);
+      iss->stats.rects++;
+    }
+  }
+
+  /* hand over the new BGs */
+  for(i=0; i < max; i++)
+  {
+    id = slist[i];
+    if( (ISP_STAT_DIRTY_BOTH == iss->list[id].status) &&
+        (FALSE == iss->list[id].visible) )
+    {
+      isp_destroy_ispbuf(&iss->list[id].bg_buf);
+    }
+  }
+  for(k=0; k < npt; k++)
+  {
+    sp = &iss->list[isp_pt[k].id];
+    if( (NULL != isp_pt[k].cap) && (isp_pt[k].cap != sp->bg_buf.buf) )
+    {
+      if(NULL != sp->bg_buf.buf)
+      {
+        dfree(sp->bg_buf.buf, "isp_composite free old buffer");
+      }
+      sp->bg_buf.buf = isp_pt[k].cap;
+    }
+    if(ISP_STAT_DIRTY_SP == sp->status)
+    {
+      sp->bg_buf.x  = sp->sp_buf.x;
+      sp->bg_buf.y  = sp->sp_buf.y;
+      sp->bg_buf.xs = sp->sp_buf.xs;
+      sp->bg_buf.ys = sp->sp_buf.ys;
+    }
+    sp->status = ISP_STAT_CLEAN;
+  }
+}
+
 void  isp_draw_all_sprites(ISPRITESYS *iss)
 {
   ISPID i, id, max, slist[ISP_MAX_SPRITES];
+  rtcnt_t start;
+  uint32_t us;
+
+  start = chSysGetRealtimeCounterX();
+
   /* make list of active only.  This way we don't have to perform that check constantly */
   max=0;
   for(i=0; i< ISP_MAX_SPRITES; i++)
@@ -1673,60 +2344,21 @@ void  isp_draw_all_sprites(ISPRITESYS *iss)
     }
   }
 
-  /* first restore all dirty BG blocks*/
-  for(i=0; i< max; i++)
+  if( (iss->composite) && (NULL != iss->tile) )
   {
-    id = slist[i];
-    if(ISP_STAT_DIRTY_BOTH == iss->list[id].status)
-    {
-      isp_restore_bg(iss, id);
-    }
+    isp_composite(iss, slist, max);
   }
-
-  /* Now that BG is restored, check if we have a WMAP, and then test all
-       * auto_bg sprites against it and set their BG modes accordingly.
-  */
-  if(NULL != iss->wm)
+  else
   {
-    for(i=0; i< max; i++)
-    {
-      id = slist[i];
-      if(iss->list[id].auto_bg && iss->list[id].mode_switch)
-      {
-        iss->list[id].mode_switch = FALSE;
-        if(ISP_BG_FIXEDCOLOR == iss->list[id].bgtype)
-        {
-          iss->list[id].bgtype = ISP_BG_DYNAMIC;
-          //iss->list[id].status = ISP_STAT_DIRTY_BOTH;
-        }
-        else
-        {
-          iss->list[id].bgtype = ISP_BG_FIXEDCOLOR;
-        }
-      }
-    }
+    isp_draw_direct(iss, slist, max);
   }
 
-  /* now collect BG block from new sprite postitions */
-  for(i=0; i< max; i++)
+  us = RTC2US(NRF5_HFCLK_FREQUENCY, chSysGetRealtimeCounterX() - start);
+  iss->stats.frames++;
+  iss->stats.us_total += us;
+  if(us > iss->stats.us_max)
   {
-    id = slist[i];
-
-  /* only save BG if sprite is visibe AND either status is Dirty, or we have no BG */
-    if( (iss->list[id].visible) &&
-        ((ISP_STAT_DIRTY_BOTH == iss->list[id].status ) || (NULL == iss->list[id].bg_buf.buf))  )
-    {
-      isp_capture_bg(iss, id);
-      iss->list[id].status = ISP_STAT_DIRTY_SP;
-    }
-
-  }
-  /* now paint all dirty sprites */
-  for(i=0; i< max; i++)
-  {
-    id = slist[i];
-    /* this handles visibility checks and changes flag status.  just let it  figure it out. */
-    isp_draw_sprite(iss, id);
+    iss->stats.us_max = us;
   }
 }
 
@@ -1747,10 +2379,52 @@ void isp_shutdown(ISPRITESYS *iss)
     {
       isp_destroy_sprite(iss, i);
     }
+    isp_set_compositor(iss, FALSE);
   }
   dfree(iss, "isp_shutdown iss");
 }
 
+/* turn the dirty rectangle compositor on or off.  returns false if the
+ * tile buffer couldn't be allocated, in which case sprites keep being
+ * drawn directly */
+bool_t isp_set_compositor(ISPRITESYS *iss, bool_t on)
+{
+  if(on && (NULL == iss->tile))
+  {
+    iss->tile = (pixel_t *)dmalloc(ISP_TILE_PIXELS * sizeof(pixel_t), "isp_set_compositor() tile");
+  }
+  else if(!on && (NULL != iss->tile))
+  {
+    dfree(iss->tile, "isp_set_compositor() tile");
+    iss->tile = NULL;
+  }
+  iss->composite = (NULL != iss->tile);
+  return(iss->composite == on);
+}
+
+/* print frame time stats for isp_draw_all_sprites() against a per frame
+ * time budget, then reset them */
+void isp_print_stats(ISPRITESYS *iss, char *name, uint32_t budget_us)
+{
+  uint32_t avg;
+
+  if(0 == iss->stats.frames)
+  {
+    return;
+  }
+  avg = iss->stats.us_total / iss->stats.frames;
+  printf("%s: %s sprites, %lu frames, avg %luus max %luus of %luus budget (%lu%%)\n",
+         name, iss->composite ? "composited" : "direct",
+         iss->stats.frames, avg, iss->stats.us_max, budget_us,
+         (avg * 100) / budget_us);
+  if(iss->composite)
+  {
+    printf("%s: %lu blocks written, %lu blocks read back\n",
+           name, iss->stats.rects, iss->stats.reads);
+  }
+  memset(&iss->stats, 0, sizeof(ISPSTATS));
+}
+
 
 pixel_t *boxmaker(coord_t x, coord_t y, color_t col)
 {
@@ -4,6 +4,11 @@
 
 #define ISP_MAX_SPRITES 32
 
+/* compositor tile buffer size, in pixels. Dirty rectangles that are
+ * bigger than this are composed in horizontal bands. */
+#define ISP_TILE_PIXELS 4096
+#define ISP_MAX_DIRTY   (ISP_MAX_SPRITES * 2)
+
 
 /* 0 water, 1 land */
 #define WMAP_W SCREEN_W / 32
@@ -110,9 +115,21 @@ typedef struct _rectangle {
 } RECT;
 
 
+/* frame time accounting for isp_draw_all_sprites() */
+typedef struct _ides_sprite_stats {
+  uint32_t frames;
+  uint32_t us_total;
+  uint32_t us_max;
+  uint32_t rects;   /* rectangles pushed to the screen */
+  uint32_t reads;   /* rectangles that had to be read back from the screen */
+} ISPSTATS;
+
 typedef struct _ides_sprite_list{
   ISPRITE list[ISP_MAX_SPRITES];
   WMAP *wm;
+  bool_t composite; /* draw through the dirty rectangle compositor */
+  pixel_t *tile;    /* compositor tile buffer */
+  ISPSTATS stats;
 } ISPRITESYS;
 
 
@@ -128,8 +145,11 @@ extern void isp_set_sprite_bgcolor(ISPRITESYS *iss, ISPID id, color_t col);
 extern void isp_set_sprite_wmap_bgcolor(ISPRITESYS *iss, ISPID id, color_t col);
 extern void isp_release_sprite_bgcolor(ISPRITESYS *iss, ISPID id);
 extern bool_t isp_check_sprites_collision(ISPRITESYS *iss, ISPID id1, ISPID id2, bool_t overlap, bool_t drawtest);
+extern bool_t isp_check_sprites_pixel_collision(ISPRITESYS *iss, ISPID id1, ISPID id2, bool_t overlap);
 extern bool_t test_sprite_for_land_collision(ISPRITESYS *iss, ISPID id);
 extern void isp_draw_all_sprites(ISPRITESYS *iss);
+extern bool_t isp_set_compositor(ISPRITESYS *iss, bool_t on);
+extern void isp_print_stats(ISPRITESYS *iss, char *name, uint32_t budget_us);
 extern void isp_shutdown(ISPRITESYS *iss);
 extern void sprite_tester(void);
 extern bool_t is_valid_rect(RECT r);
@@ -140,6 +160,8 @@ extern void sprite_tester_mapaware(void);
 extern bool_t wm_value(WMAP *w, coord_t x, coord_t y, uint8_t v);
 extern WMAP *wm_build_land_map_from_screen(void);
 extern bool_t wm_check_box_for_land_collision(WMAP *map, RECT r);
+extern bool_t wm_collision_check_maps(WMAP *mapa, WMAP *mapb, RECT r);
+extern bool_t wm_collision_check_offset(WMAP *a, coord_t ax, coord_t ay, WMAP *b, coord_t bx, coord_t by);
 extern pixel_t *boxmaker(coord_t x, coord_t y, color_t col);
 extern int isp_load_image_from_file(ISPRITESYS *iss, ISPID id, char *name);
 extern bool_t isp_set_sprite_from_spholder(ISPRITESYS *iss, ISPID id, ISPHOLDER *sph);
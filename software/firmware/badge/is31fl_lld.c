@@ -50,6 +50,13 @@ static bool m_initialized = false;
 static uint32_t m_last_init_attempt = 0;
 #endif
 
+/*
+ * The register page we last selected. Switching pages costs two
+ * writes, so skip them when the chip is already where we want it.
+ * 0xFF means we don't know.
+ */
+static uint8_t m_page = 0xFF;
+
 uint8_t hal_i2c_read_reg_byte(uint8_t i2c_address, uint8_t reg) {
   uint8_t txbuf;
   uint8_t rxbuf;
@@ -120,8 +127,10 @@ bool drv_is31fl_init(void) {
 
   /* Issue a reset */
 
+  m_page = 0xFF;
   drv_is31fl_set_page(ISSI_PAGE_FUNCTION);
   hal_i2c_read_reg_byte(LED_I2C_ADDR, ISSI_REG_RESET);
+  m_page = 0xFF;
   chThdSleepMilliseconds(100);
 
   // disable soft shut down and enable the OSD checks
@@ -237,9 +246,13 @@ void drv_is31fl_send_value(uint8_t address, uint8_t value) {
  */
 void drv_is31fl_set_page(uint8_t page) {
 #ifndef CONFIG_BADGE_TYPE_STANDALONE
-  hal_i2c_write_reg_byte(LED_I2C_ADDR, ISSI_REG_WRITE_LOCK,
-                         ISSI_REG_WRITE_UNLOCK);
-  hal_i2c_write_reg_byte(LED_I2C_ADDR, ISSI_REG_COMMAND,
-                         page);
+  if (page == m_page)
+    return;
+
+  m_page = 0xFF;
+  if (hal_i2c_write_reg_byte(LED_I2C_ADDR, ISSI_REG_WRITE_LOCK,
+                             ISSI_REG_WRITE_UNLOCK) &&
+      hal_i2c_write_reg_byte(LED_I2C_ADDR, ISSI_REG_COMMAND, page))
+    m_page = page;
 #endif
 }
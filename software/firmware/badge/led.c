@@ -6,6 +6,8 @@
 #include "math.h"
 #include "userconfig.h"
 #include "rand.h"
+#include "dds.h"
+#include "ff.h"
 
 #include <string.h>
 
@@ -13,6 +15,12 @@
 #define util_random(x,y) randRange(x,y)
 #define M_PI 3.14159265358979323846264338327950288
 
+/* ddsSine() phase steps: the full 32 bits are one turn */
+#define LED_RADIAN 683565276U       /* 2^32 / (2 * pi) */
+#define LED_DEGREE 11930465U        /* 2^32 / 360 */
+
+#define LED_CYCLES_PER_US (NRF5_HFCLK_FREQUENCY / 1000000)
+
 /* if use_gamma is on, we'll do lookups againt the gamma table
  * which may make animations look smoother. This comes at a cost,
  * which is that over all the entire system looks darker. It's off
@@ -33,6 +41,44 @@
  */
 unsigned char led_memory[ISSI_ADDR_MAX + 2];
 
+/*
+ * led_memory[] is the frame being drawn. led_shown[] has the same
+ * layout and holds what the chip was last sent, so led_show() only
+ * needs to write the registers that differ between the two. Most
+ * patterns move a handful of LEDs per frame, which makes that a few
+ * dozen bytes instead of the whole page.
+ */
+static unsigned char led_shown[ISSI_ADDR_MAX + 2];
+static unsigned char led_txbuf[ISSI_ADDR_MAX + 2];
+
+/*
+ * Changed registers this close together go out in the same write.
+ * Starting a new write costs the slave address, the register offset
+ * and a start/stop, so resending a couple of unchanged registers in
+ * between is cheaper. Past LED_SHOW_MAXRUNS separate writes we just
+ * send everything from the first change to the last.
+ */
+#define LED_SHOW_GAP 3
+#define LED_SHOW_MAXRUNS 8
+
+led_stats_t led_stats;
+
+/* pre-baked animation being played from the SD card */
+static MUTEX_DECL(led_anim_mtx);
+static FIL led_anim_fil;
+static bool led_anim_open = false;
+static uint8_t led_anim_leds;
+static uint16_t led_anim_period;
+static int32_t led_anim_wait;
+
+/*
+ * The eye breathes like a sleeping macbook: exp(sin(t)) - 1/e over
+ * an 8 second cycle. The curve is worked out once when the thread
+ * starts, scaled to 0-255, and looked up by time after that.
+ */
+#define LED_BREATH_MS 8000
+static uint8_t led_breath[256];
+
 /* prototypes */
 void led_set_all(uint8_t r, uint8_t g, uint8_t b);
 void led_brightness_set(uint8_t brightness);
@@ -50,9 +96,10 @@ void led_pattern_balls(led_pattern_balls_t*);
 void led_pattern_flame(void);
 void led_pattern_kitt(int8_t*, int8_t*);
 void led_pattern_triangle(int8_t*, int8_t*);
-void led_pattern_double_sweep(uint8_t* p_index, float* p_hue, float* p_value);
+void led_pattern_double_sweep(uint8_t* p_index, uint16_t* p_hue,
+                              uint8_t* p_value);
 void led_pattern_triple_sweep(led_triple_sweep_state_t* p_triple_sweep);
-void led_pattern_rainbow(float* p_hue, uint8_t repeat);
+void led_pattern_rainbow(uint16_t* p_hue, uint8_t repeat);
 void led_pattern_roller_coaster(uint8_t positions[], color_rgb_t color);
 void led_pattern_running_lights(uint8_t red,
                                 uint8_t green,
@@ -71,6 +118,7 @@ void led_pattern_meteor(uint8_t red, uint8_t green, uint8_t blue,
 void led_pattern_unlock(uint8_t* p_index, int8_t* p_direction);
 void led_pattern_unlock_success(uint8_t* p_index);
 void led_pattern_unlock_failed(uint8_t *p_position);
+void led_pattern_file(void);
 
 /* control vars */
 static thread_t * pThread;
@@ -196,55 +244,45 @@ static int antipodal_index(int i) {
   return iN;
 }
 
-/* color utils */
-color_rgb_t util_hsv_to_rgb(float H, float S, float V) {
-  H = fmodf(H, 1.0);
-
-  float h = H * 6;
-  uint8_t i = floor(h);
-  float a = V * (1 - S);
-  float b = V * (1 - S * (h - i));
-  float c = V * (1 - (S * (1 - (h - i))));
-  float rf, gf, bf;
+/*
+ * color utils. Hue is how far round the colour wheel to go, 0 to
+ * 65535; saturation and value are 0 to 255. LED_HUE() converts a
+ * fraction of the wheel at compile time.
+ */
+#define LED_HUE(f) ((uint16_t)((f) * 65535))
+
+color_rgb_t util_hsv_to_rgb(uint16_t h, uint8_t s, uint8_t v) {
+  uint32_t h6 = (uint32_t)h * 6;
+  uint8_t i = h6 >> 16;
+  uint32_t f = (h6 >> 8) & 0xFF;   /* how far into this sixth, /256 */
+  uint32_t vs = (uint32_t)v * s;
+  uint8_t a = v - vs / 255;
+  uint8_t b = v - (vs * f) / (255 * 256);
+  uint8_t c = v - (vs * (256 - f)) / (255 * 256);
+  uint8_t R, G, B;
 
   switch (i) {
     case 0:
-      rf = V * 255;
-      gf = c * 255;
-      bf = a * 255;
+      R = v; G = c; B = a;
       break;
     case 1:
-      rf = b * 255;
-      gf = V * 255;
-      bf = a * 255;
+      R = b; G = v; B = a;
       break;
     case 2:
-      rf = a * 255;
-      gf = V * 255;
-      bf = c * 255;
+      R = a; G = v; B = c;
       break;
     case 3:
-      rf = a * 255;
-      gf = b * 255;
-      bf = V * 255;
+      R = a; G = b; B = v;
       break;
     case 4:
-      rf = c * 255;
-      gf = a * 255;
-      bf = V * 255;
+      R = c; G = a; B = v;
       break;
     case 5:
     default:
-      rf = V * 255;
-      gf = a * 255;
-      bf = b * 255;
+      R = v; G = a; B = b;
       break;
   }
 
-  uint8_t R = rf;
-  uint8_t G = gf;
-  uint8_t B = bf;
-
   color_rgb_t RGB = (R << 16) + (G << 8) + B;
   return RGB;
 }
@@ -253,8 +291,11 @@ bool led_init() {
   // on exit, the chip is now in the PWM page
   for (uint8_t i = 0; i < ISSI_ADDR_MAX + 2; i++) {
     led_memory[i] = 0;
+    led_shown[i] = 0;
   }
 
+  led_stats.start = chVTGetSystemTime();
+
   led_reset ();
 
   leds_init_ok = drv_is31fl_init();
@@ -268,6 +309,15 @@ void led_clear() {
 }
 
 void ledSetPattern(uint8_t patt) {
+  if (patt != LED_PATTERN_FILE) {
+    chMtxLock(&led_anim_mtx);
+    if (led_anim_open) {
+      f_close(&led_anim_fil);
+      led_anim_open = false;
+    }
+    chMtxUnlock(&led_anim_mtx);
+  }
+
   led_current_func = patt;
 
   if (leds_init_ok == false)
@@ -284,6 +334,51 @@ void ledSetPattern(uint8_t patt) {
   }
 }
 
+/*
+ * Play a pre-baked animation from the SD card instead of drawing
+ * one. The file keeps playing until another pattern is chosen.
+ * Returns false if it can't be opened or isn't an animation.
+ */
+bool ledPlayFile(const char *name) {
+  led_anim_hdr_t hdr;
+  UINT br;
+  bool ok = false;
+
+  chMtxLock(&led_anim_mtx);
+
+  if (led_anim_open) {
+    f_close(&led_anim_fil);
+    led_anim_open = false;
+  }
+
+  if (f_open(&led_anim_fil, name, FA_READ) != FR_OK) {
+    chMtxUnlock(&led_anim_mtx);
+    return (false);
+  }
+
+  if (f_read(&led_anim_fil, &hdr, sizeof(hdr), &br) == FR_OK &&
+      br == sizeof(hdr) &&
+      memcmp(hdr.magic, LED_ANIM_MAGIC, sizeof(hdr.magic)) == 0 &&
+      hdr.leds > 0 && hdr.leds <= LED_COUNT) {
+    led_anim_leds = hdr.leds;
+    led_anim_period = hdr.period;
+    if (led_anim_period < EFFECTS_REDRAW_MS)
+      led_anim_period = EFFECTS_REDRAW_MS;
+    led_anim_wait = 0;
+    led_anim_open = true;
+    ok = true;
+  } else {
+    f_close(&led_anim_fil);
+  }
+
+  chMtxUnlock(&led_anim_mtx);
+
+  if (ok)
+    ledSetPattern(LED_PATTERN_FILE);
+
+  return (ok);
+}
+
 void
 ledDraw (short amp)
 {
@@ -438,27 +533,97 @@ led_reinit (void)
 
   drv_is31fl_gcc_set (led_brightness_level);
 
+  /* The init cleared all the PWM registers */
+
+  memset (led_shown, 0, sizeof(led_shown));
+
   return;
 }
 
+/*
+ * Write registers led_memory[from] through led_memory[to] to the
+ * chip in one transfer. The values go through led_txbuf so that
+ * led_shown[] gets exactly what was sent, even if someone is
+ * drawing at the same time.
+ */
+static msg_t led_send(unsigned int from, unsigned int to) {
+  unsigned int len = to - from + 1;
+
+  led_txbuf[0] = from - 1;
+  memcpy(&led_txbuf[1], &led_memory[from], len);
+  memcpy(&led_shown[from], &led_txbuf[1], len);
+
+  led_stats.xfers++;
+  led_stats.bytes += len + 2;
+
+  return (i2cMasterTransmitTimeout (&I2CD2, LED_I2C_ADDR,
+    led_txbuf, len + 1, NULL, 0, ISSI_TIMEOUT));
+}
+
 void led_show() {
-  msg_t r;
+  unsigned int i, j, end;
+  unsigned int first = 0, last = 0;
+  int runs = 0;
+  rtcnt_t start;
+  msg_t r = MSG_OK;
 
   if (leds_init_ok == false)
     return;
 
+  start = chSysGetRealtimeCounterX();
+
   i2cAcquireBus(&I2CD2);
 
-  drv_is31fl_set_page(ISSI_PAGE_PWM);
+  led_stats.shows++;
+  led_stats.full_bytes += sizeof(led_memory) + 1;
+
+  /* Byte 0 is the register offset, the registers start at 1 */
+  for (i = 1; i < sizeof(led_memory); i++) {
+    if (led_memory[i] == led_shown[i])
+      continue;
+    if (runs == 0)
+      first = i;
+    else if (i - last <= LED_SHOW_GAP) {
+      last = i;
+      continue;
+    }
+    runs++;
+    last = i;
+  }
+
+  if (runs == 0) {
+    led_stats.idle++;
+  } else {
+    drv_is31fl_set_page(ISSI_PAGE_PWM);
+
+    if (runs > LED_SHOW_MAXRUNS) {
+      r = led_send(first, last);
+    } else {
+      i = first;
+      while (i <= last) {
+        end = i;
+        for (j = i + 1; j <= last && j - end <= LED_SHOW_GAP; j++) {
+          if (led_memory[j] != led_shown[j])
+            end = j;
+        }
 
-  r = i2cMasterTransmitTimeout (&I2CD2, LED_I2C_ADDR,
-    led_memory, sizeof(led_memory),
-    NULL, 0, ISSI_TIMEOUT);
+        r = led_send(i, end);
+        if (r != MSG_OK)
+          break;
+
+        for (i = end + 1; i <= last && led_memory[i] == led_shown[i]; i++)
+          ;
+      }
+    }
+  }
 
   if (r != MSG_OK)
     led_reinit();
 
   i2cReleaseBus(&I2CD2);
+
+  led_stats.show_us +=
+    (chSysGetRealtimeCounterX() - start) / LED_CYCLES_PER_US;
 }
 
 void led_test() {
@@ -484,21 +649,40 @@ void led_test() {
     led_clear();
 }
 
+static void led_breath_init(void) {
+  for (int i = 0; i < 256; i++) {
+    led_breath[i] = (expf(sinf(i * 2 * M_PI / 256)) - 0.36787944) /
+                    (2.71828183 - 0.36787944) * 255 + 0.5;
+  }
+}
+
+/*
+ * Scale one eye channel by breath level q. At the top of the curve
+ * the old float version came out at 1.175 times the colour, which is
+ * 301/256; clip anything that runs past full.
+ */
+static uint8_t led_breath_scale(uint8_t q, uint8_t c) {
+  uint32_t v = ((uint32_t)q * c * 301) >> 16;
+
+  return (v > 255 ? 255 : v);
+}
+
 static void update_eye(void) {
   userconfig *config = getConfig();
 
   uint8_t r = (config->eye_rgb_color & 0xff0000) >> 16;
   uint8_t g = (config->eye_rgb_color & 0x00ff00) >> 8;
   uint8_t b = (config->eye_rgb_color & 0x0000ff);
+  uint8_t q;
 
   // this approximates the 'breathing' pattern as seen on macbooks
-  led_set(31,(exp(sin(MILLIS()/4000.0 * M_PI)) - 0.36787944) * r/2,
-	  (exp(sin(MILLIS()/4000.0 * M_PI)) - 0.36787944) * g/2,
-	  (exp(sin(MILLIS()/4000.0 * M_PI)) - 0.36787944) * b/2);
+  q = led_breath[(MILLIS() % LED_BREATH_MS) * 256 / LED_BREATH_MS];
+  led_set(31, led_breath_scale(q, r), led_breath_scale(q, g),
+          led_breath_scale(q, b));
 }
 
 /* Threads ------------------------------------------------------ */
-static THD_WORKING_AREA(waBlingThread, 768);
+static THD_WORKING_AREA(waBlingThread, 1024);
 static THD_FUNCTION(bling_thread, arg) {
   userconfig *config = getConfig();
   /* animation state vars */
@@ -507,9 +691,10 @@ static THD_FUNCTION(bling_thread, arg) {
   uint8_t anim_uindex = 0;
   int16_t anim_pos16 = 0;
   int8_t anim_position = 0;
-  float anim_hue = 100;
-  float anim_value = 0;
+  uint16_t anim_hue = 0;
+  uint8_t anim_value = 0;
   uint8_t last_brightness;
+  rtcnt_t start;
 
   // Positions storage for roller coaster
   uint8_t positions[LED_PATTERN_ROLLER_COASTER_COUNT];
@@ -539,6 +724,7 @@ static THD_FUNCTION(bling_thread, arg) {
   led_brightness_level = config->led_brightness;
   last_brightness = led_brightness_level;
   drv_is31fl_gcc_set(led_brightness_level);
+  led_breath_init();
   led_pattern_balls_init(&anim_balls);
   led_current_func = config->led_pattern;
 
@@ -568,6 +754,8 @@ static THD_FUNCTION(bling_thread, arg) {
         my_current_func = led_current_random;
       }
 
+      start = chSysGetRealtimeCounterX();
+
       switch (my_current_func) {
       case 2:
         led_pattern_flame();
@@ -594,16 +782,16 @@ static THD_FUNCTION(bling_thread, arg) {
         led_pattern_rainbow(&anim_hue, 2);
         break;
       case 10:
-        led_pattern_roller_coaster(positions, util_hsv_to_rgb(0, 1, 1));
+        led_pattern_roller_coaster(positions, util_hsv_to_rgb(LED_HUE(0), 255, 255));
         break;
       case 11:
-        led_pattern_roller_coaster(positions, util_hsv_to_rgb(0.3, 1, 1));
+        led_pattern_roller_coaster(positions, util_hsv_to_rgb(LED_HUE(0.3), 255, 255));
         break;
       case 12:
-        led_pattern_roller_coaster(positions, util_hsv_to_rgb(0.7, 1, 1));
+        led_pattern_roller_coaster(positions, util_hsv_to_rgb(LED_HUE(0.7), 255, 255));
         break;
       case 13:
-        led_pattern_roller_coaster(positions, util_hsv_to_rgb(0.16, 1, 1));
+        led_pattern_roller_coaster(positions, util_hsv_to_rgb(LED_HUE(0.16), 255, 255));
         break;
       case 14:
         led_pattern_running_lights(255, 0, 0, &anim_uindex);
@@ -662,12 +850,20 @@ static THD_FUNCTION(bling_thread, arg) {
       case LED_PATTERN_LEVELUP:
         led_pattern_unlock_success(&anim_uindex);
         break;
+      case LED_PATTERN_FILE:
+        led_pattern_file();
+        break;
       case LED_TEST:
         led_test();
         break;
       }
 
       update_eye();
+
+      led_stats.frames++;
+      led_stats.render_us +=
+        (chSysGetRealtimeCounterX() - start) / LED_CYCLES_PER_US;
+
       led_show();
     }
 
@@ -710,26 +906,28 @@ uint8_t ledStop(void) {
 
 /* Animations ------------------------------------------------------------- */
 
+/*
+ * Ball physics, in 16.16 fixed point. Heights are in units of the
+ * drop height (1m) and velocities in m/s.
+ */
+#define LED_BALL_G_HALF 321454   /* g / 2, 9.81 / 2 */
+#define LED_BALL_V0     290288   /* sqrt(2 * g * 1m), to reach the top */
+#define LED_BALL_VMIN   655      /* 0.01: stop bouncing and start over */
+
 /**
  * @brief Initilize balls
  * @param p_balls : Pointer to balls
  */
 void led_pattern_balls_init(led_pattern_balls_t* p_balls) {
-  p_balls->start_height = 1;
-  p_balls->gravity = -9.81;
-  p_balls->impact_velocity_start =
-      sqrt(-2 * p_balls->gravity * p_balls->start_height);
-
   // Initialize the led balls state
   for (int i = 0; i < LED_PATTERN_BALLS_COUNT; i++) {
     p_balls->clock_since_last_bounce[i] = MILLIS();
-    p_balls->height[i] = p_balls->start_height;
+    p_balls->height[i] = 1 << 16;
     p_balls->position[i] = 0;
-    p_balls->impact_velocity[i] = p_balls->impact_velocity_start;
-    p_balls->time_since_last_bounce[i] = 0;
-    p_balls->dampening[i] = 0.90 - (float)i / pow(LED_PATTERN_BALLS_COUNT, 2);
-    p_balls->colors[i] =
-        util_hsv_to_rgb((float)randRange(0, 100) / 100.0, 1, 1);
+    p_balls->impact_velocity[i] = LED_BALL_V0;
+    /* 0.90 - i / 25 */
+    p_balls->dampening[i] = 58982 - i * 2621;
+    p_balls->colors[i] = util_hsv_to_rgb(randUInt16(), 255, 255);
   }
 }
 
@@ -738,36 +936,39 @@ void led_pattern_balls_init(led_pattern_balls_t* p_balls) {
  * @param p_balls : Pointer to balls state
  */
 void led_pattern_balls(led_pattern_balls_t* p_balls) {
+  int32_t t;
+
   for (int i = 0; i < LED_PATTERN_BALLS_COUNT; i++) {
-    p_balls->time_since_last_bounce[i] =
-        MILLIS() - p_balls->clock_since_last_bounce[i];
+    /* milliseconds since the bounce; much over a second means it's down */
+    t = MILLIS() - p_balls->clock_since_last_bounce[i];
+    if (t > 10000)
+      t = 10000;
+
     p_balls->height[i] =
-        0.5 * p_balls->gravity *
-            pow(p_balls->time_since_last_bounce[i] / 1000, 2.0) +
-        p_balls->impact_velocity[i] * p_balls->time_since_last_bounce[i] / 1000;
+        ((int64_t)p_balls->impact_velocity[i] * t -
+         (int64_t)LED_BALL_G_HALF * t * t / 1000) / 1000;
 
     if (p_balls->height[i] < 0) {
       p_balls->height[i] = 0;
       p_balls->impact_velocity[i] =
-          p_balls->dampening[i] * p_balls->impact_velocity[i];
+          ((int64_t)p_balls->dampening[i] *
+           p_balls->impact_velocity[i]) >> 16;
       p_balls->clock_since_last_bounce[i] = MILLIS();
 
       // Bouncing has stopped, start over
-      if (p_balls->impact_velocity[i] < 0.01) {
-        p_balls->impact_velocity[i] = p_balls->impact_velocity_start;
-        p_balls->colors[i] =
-            util_hsv_to_rgb((float)randRange(0, 100) / 100.0, 1, 1);
+      if (p_balls->impact_velocity[i] < LED_BALL_VMIN) {
+        p_balls->impact_velocity[i] = LED_BALL_V0;
+        p_balls->colors[i] = util_hsv_to_rgb(randUInt16(), 255, 255);
       }
     }
     p_balls->position[i] =
-        round(p_balls->height[i] * (LED_COUNT - 1) / p_balls->start_height);
+        (p_balls->height[i] * (LED_COUNT - 1) + 0x8000) >> 16;
   }
 
+  led_set_all(0, 0, 0);
   for (int i = 0; i < LED_PATTERN_BALLS_COUNT; i++) {
     led_set_rgb(p_balls->position[i], p_balls->colors[i]);
   }
-  led_show();
-  led_set_all(0, 0, 0);
 }
 
 void led_pattern_police(uint8_t* p_index, int8_t* p_direction) {
@@ -779,8 +980,6 @@ void led_pattern_police(uint8_t* p_index, int8_t* p_direction) {
   int fx_positionB = antipodal_index(fx_positionR);
   led_set(fx_positionR, 255, 0, 0);
   led_set(fx_positionB, 0, 0, 255);
-
-  led_show();
 }
 
 void led_pattern_triple_sweep(led_triple_sweep_state_t* p_triple_sweep) {
@@ -827,7 +1026,6 @@ void led_pattern_triple_sweep(led_triple_sweep_state_t* p_triple_sweep) {
               p_triple_sweep->rgb[(uint8_t)p_triple_sweep->index_blue]);
   led_set_rgb((uint8_t)p_triple_sweep->index_yellow,
               p_triple_sweep->rgb[(uint8_t)p_triple_sweep->index_yellow]);
-  led_show();
 
   // Move indices, assume next run around range will be checked
   p_triple_sweep->index_red += p_triple_sweep->direction_red;
@@ -867,7 +1065,6 @@ void led_pattern_flame() {
       led_set(x, red, green, 0);
     }
   }
-  led_show();
 }
 
 /**
@@ -891,8 +1088,6 @@ void led_pattern_kitt(int8_t* p_index, int8_t* p_direction) {
     }
   }
 
-  led_show();
-
   if (*p_direction > 0) {
     (*p_index) += 2;
     if (*p_index >= LED_COUNT) {
@@ -908,29 +1103,25 @@ void led_pattern_kitt(int8_t* p_index, int8_t* p_direction) {
   }
 }
 
-
-void led_pattern_double_sweep(uint8_t* p_index, float* p_hue, float* p_value) {
-  color_rgb_t rgb = util_hsv_to_rgb(*p_hue, 1.0, *p_value);
+void led_pattern_double_sweep(uint8_t* p_index, uint16_t* p_hue,
+                              uint8_t* p_value) {
+  color_rgb_t rgb = util_hsv_to_rgb(*p_hue, 255, *p_value);
   led_set_rgb(LED_COUNT / 2, rgb);
   led_set_rgb(LED_COUNT / 2 + *p_index, rgb);
   led_set_rgb(LED_COUNT / 2 - *p_index, rgb);
-  led_show();
 
   (*p_index)++;
   if (*p_index > (LED_COUNT / 2)) {
     *p_index = 0;
 
-    // Ensure hue wraps around
-    *p_hue += 0.1;
-    if (*p_hue >= 1.0) {
-      *p_hue -= 1.0;
-    }
+    // a tenth of the way round; the hue wraps by itself
+    *p_hue += LED_HUE(0.1);
 
     // Alternate light / dark
     if (*p_value > 0) {
       *p_value = 0;
     } else {
-      *p_value = 1.0;
+      *p_value = 255;
     }
   }
 }
@@ -940,7 +1131,7 @@ void led_pattern_triangle(int8_t *fx_index, int8_t *fx_position) {
   int16_t N3 = LED_COUNT/4;
   (*fx_index)++;
   if ( *fx_index % 3 != 0 ) { return; } // 1/3rd speed
-  led_clear();
+  led_set_all(0, 0, 0);
 
   for(int i = 0; i < LED_COUNT; i++ ) {
     if ((i == (0 + *fx_position)) || (i == (N3 + 1 + *fx_position)) ||
@@ -951,29 +1142,21 @@ void led_pattern_triangle(int8_t *fx_index, int8_t *fx_position) {
 
   (*fx_position)++;
   if (*fx_position > N3) { *fx_position = 0; }
-
-  led_show();
 }
 
-
-
 /**
  * @brief Rainbow pattern because we can
  * @param p_hue : Pointer to hue for first LED
  * @param repeat : How many times to repeat the rainbow
  */
-void led_pattern_rainbow(float* p_hue, uint8_t repeat) {
-  float hue_step = 1.0 / ((float)LED_COUNT / (float)repeat);
+void led_pattern_rainbow(uint16_t* p_hue, uint8_t repeat) {
+  uint16_t hue_step = 65536 * repeat / LED_COUNT;
   for (uint8_t i = 0; i < LED_COUNT; i++) {
-    color_rgb_t rgb = util_hsv_to_rgb(*p_hue + (hue_step * i), 1, 1);
+    color_rgb_t rgb = util_hsv_to_rgb(*p_hue + (hue_step * i), 255, 255);
     led_set_rgb(i, rgb);
   }
-  led_show();
 
-  *p_hue += 0.05;
-  if (*p_hue > 1) {
-    *p_hue -= 1;
-  }
+  *p_hue += LED_HUE(0.05);
 }
 
 /**
@@ -983,20 +1166,20 @@ void led_pattern_rainbow(float* p_hue, uint8_t repeat) {
 void led_pattern_roller_coaster(uint8_t positions[], color_rgb_t color) {
   led_set_all(0, 0, 0);
   for (uint8_t i = 0; i < LED_PATTERN_ROLLER_COASTER_COUNT; i++) {
-    float pos = (float)positions[i];
-    float rad = (pos / (float)(LED_COUNT - 1)) * 2 * M_PI;
-    float velocity =
-        (-1.75) * cosf(rad) - 2.25;  // Ensure velocity is between -0.5 and -4.0
+    // positions and speeds in 1/256ths of an LED
+    int32_t pos = positions[i] << 8;
+    uint32_t phase = positions[i] * (0xFFFFFFFFU / (LED_COUNT - 1));
+    int32_t velocity =
+        // -1.75 * cos() - 2.25, so velocity is between -0.5 and -4.0
+        ((-448 * ddsSine(phase + 0x40000000)) >> 15) - 576;
     pos += velocity;
     if (pos < 0) {
-      pos += LED_COUNT;
+      pos += LED_COUNT << 8;
     }
-    positions[i] = (uint8_t)pos;
+    positions[i] = pos >> 8;
 
     led_set_rgb(positions[i], color);
   }
-
-  led_show();
 }
 
 /**
@@ -1011,13 +1194,12 @@ void led_pattern_running_lights(uint8_t red,
                                 uint8_t blue,
                                 uint8_t* p_position) {
   for (int i = 0; i < LED_COUNT; i++) {
-    led_set(i, ((sin(i + *p_position) * 127 + 128) / 255) * red,
-            ((sin(i + *p_position) * 127 + 128) / 255) * green,
-            ((sin(i + *p_position) * 127 + 128) / 255) * blue);
+    // sin() of (i + position) radians, moved to 1 - 255
+    uint32_t level = 128 +
+      ((ddsSine((i + *p_position) * LED_RADIAN) * 127) >> 15);
+    led_set(i, level * red / 255, level * green / 255, level * blue / 255);
   }
 
-  led_show();
-
   (*p_position)++;
   if (*p_position >= LED_COUNT * 2) {
     *p_position = 0;
@@ -1030,10 +1212,9 @@ void led_pattern_kraftwerk(uint8_t *fx_index, int8_t *fx_position) {
 
   if (*fx_position > 8) { *fx_position = 0; };
 
-  led_clear();
+  led_set_all(0, 0, 0);
   led_set(LED_COUNT-(*fx_position)-1, 255,0,0);
   led_set(*fx_position, 255,0,0);
-  led_show();
 }
 
 void led_add_glitter(int n, int16_t *pos) {
@@ -1105,7 +1286,6 @@ void led_pattern_dualspin(uint8_t r1, uint8_t g1, uint8_t b1,
     led_add_glitter(glitter, p_index);
   }
 
-  led_show();
   (*p_index)++;
 }
 
@@ -1113,9 +1293,11 @@ void led_pattern_bgsparkle(uint8_t r1, uint8_t g1, uint8_t b1,
                            int16_t *p_position, bool bgpulse) {
 
   if (bgpulse) {
-    led_set_all(  (sin(*p_position * M_PI/180) * r1/2 + r1/2 ),
-                  (sin(*p_position * M_PI/180) * g1/2 + g1/2 ),
-                  (sin(*p_position * M_PI/180) * b1/2 + b1/2 )  );
+    // position is in degrees
+    int32_t sn = ddsSine(*p_position * LED_DEGREE);
+    led_set_all(  ((sn * (r1/2)) >> 15) + r1/2,
+                  ((sn * (g1/2)) >> 15) + g1/2,
+                  ((sn * (b1/2)) >> 15) + b1/2  );
 
   } else {
     led_set_all(r1, g1, b1);
@@ -1124,9 +1306,6 @@ void led_pattern_bgsparkle(uint8_t r1, uint8_t g1, uint8_t b1,
   led_add_glitter(6, p_position);
 
   (*p_position)++;
-
-  led_show();
-
 };
 
 void fadeToBlack(int ledNo, uint8_t fadeValue) {
@@ -1165,7 +1344,6 @@ void led_pattern_meteor(uint8_t red, uint8_t green, uint8_t blue,
       }
     }
 
-    led_show();
     (*pos)++;
 }
 
@@ -1177,7 +1355,7 @@ void led_pattern_unlock(uint8_t *p_position, int8_t *direction) {
   for (int i = 0; i < 16; i++) {
     // pulse the ones that we have enabled.
     if (config->unlocks & ( 1 << i )) {
-      led_set(i,0,(sin(.25 * *p_position) * 64) + 128,0);
+      led_set(i,0,((ddsSine(*p_position * (LED_RADIAN / 4)) * 64) >> 15) + 128,0);
     } else {
       // blue
       led_set(i, 0, 0, 30);
@@ -1189,8 +1367,6 @@ void led_pattern_unlock(uint8_t *p_position, int8_t *direction) {
   if (*p_position > 254) {
     *p_position = 0;
   }
-
-  led_show();
 }
 
 void led_pattern_unlock_failed(uint8_t *p_position) {
@@ -1206,9 +1382,6 @@ void led_pattern_unlock_failed(uint8_t *p_position) {
   if (*p_position > 1000 / EFFECTS_REDRAW_MS) {
     *p_position = 0;
   }
-
-  led_show();
-
 }
 
 void led_pattern_unlock_success(uint8_t *p_position) {
@@ -1224,7 +1397,49 @@ void led_pattern_unlock_success(uint8_t *p_position) {
   if (*p_position > 1000 / EFFECTS_REDRAW_MS) {
     *p_position = 0;
   }
+}
 
-  led_show();
+/**
+ * @brief Show the next frame of the animation ledPlayFile() opened,
+ * going back to the first one at the end of the file
+ */
+void led_pattern_file(void) {
+  uint8_t frame[LED_COUNT * 3];
+  UINT len, br = 0;
+
+  chMtxLock(&led_anim_mtx);
+
+  if (led_anim_open == false) {
+    chMtxUnlock(&led_anim_mtx);
+    return;
+  }
+
+  // hold each frame for its period; the LEDs keep it until then
+  led_anim_wait -= EFFECTS_REDRAW_MS;
+  if (led_anim_wait > 0) {
+    chMtxUnlock(&led_anim_mtx);
+    return;
+  }
+  led_anim_wait += led_anim_period;
+
+  len = led_anim_leds * 3;
+  if (f_read(&led_anim_fil, frame, len, &br) == FR_OK && br < len) {
+    if (f_lseek(&led_anim_fil, sizeof(led_anim_hdr_t)) == FR_OK)
+      f_read(&led_anim_fil, frame, len, &br);
+  }
+
+  // a read error, or a file without a single whole frame
+  if (br < len) {
+    f_close(&led_anim_fil);
+    led_anim_open = false;
+    chMtxUnlock(&led_anim_mtx);
+    led_set_all(0, 0, 0);
+    return;
+  }
+
+  for (UINT i = 0; i < led_anim_leds; i++) {
+    led_set(i, frame[i * 3], frame[i * 3 + 1], frame[i * 3 + 2]);
+  }
 
+  chMtxUnlock(&led_anim_mtx);
 }
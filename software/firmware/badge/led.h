@@ -23,6 +23,7 @@
 #define LED_PATTERN_UNLOCK_FAILED  131
 #define LED_PATTERN_UNLOCK_SUCCESS 132
 #define LED_PATTERN_LEVELUP        132
+#define LED_PATTERN_FILE           133
 #define LED_TEST                   255
 
 typedef uint32_t color_rgb_t;
@@ -45,21 +46,50 @@ extern void ledBar(float remain_f,
 extern uint8_t led_brightness_get(void);
 extern void led_brightness_set(uint8_t brightness);
 extern void led_clear(void);
+extern bool ledPlayFile(const char *name);
+
+/*
+ * Pre-baked animations (see ledPlayFile()) start with this header,
+ * followed by frames of leds * 3 bytes of R, G, B. Frames are shown
+ * period milliseconds apart and the file loops when it runs out.
+ * tools/scripts/convert_to_led.sh bakes one from an image with a row
+ * per frame and a pixel per LED.
+ */
+#define LED_ANIM_MAGIC "LEDA"
+
+typedef struct {
+  char magic[4];
+  uint8_t leds;          /* LEDs per frame, at most LED_COUNT */
+  uint8_t reserved;
+  uint16_t period;       /* milliseconds per frame, little endian */
+} led_anim_hdr_t;
+
+/* Frame engine counters, for the "led" command */
+typedef struct {
+  uint32_t frames;       /* frames drawn by the bling thread */
+  uint32_t shows;        /* calls to led_show() */
+  uint32_t idle;         /* ...that found nothing had changed */
+  uint32_t xfers;        /* I2C writes of PWM registers */
+  uint32_t bytes;        /* bytes in those writes, addresses included */
+  uint32_t full_bytes;   /* bytes if every show sent the whole frame */
+  uint32_t render_us;    /* time spent drawing frames */
+  uint32_t show_us;      /* time spent in led_show() */
+  systime_t start;
+} led_stats_t;
+
+extern led_stats_t led_stats;
 
 /* Animation structs */
 #define LED_PATTERN_ROLLER_COASTER_COUNT 5
 #define LED_PATTERN_BALLS_COUNT 5
+/* heights, velocities and dampening are 16.16 fixed point */
 typedef struct {
-  float gravity;
   color_rgb_t colors[LED_PATTERN_BALLS_COUNT];
-  int32_t start_height;
-  float height[LED_PATTERN_BALLS_COUNT];
-  float impact_velocity_start;
-  float impact_velocity[LED_PATTERN_BALLS_COUNT];
-  float time_since_last_bounce[LED_PATTERN_BALLS_COUNT];
+  int32_t height[LED_PATTERN_BALLS_COUNT];
+  int32_t impact_velocity[LED_PATTERN_BALLS_COUNT];
   int32_t position[LED_PATTERN_BALLS_COUNT];
   uint32_t clock_since_last_bounce[LED_PATTERN_BALLS_COUNT];
-  float dampening[LED_PATTERN_BALLS_COUNT];
+  int32_t dampening[LED_PATTERN_BALLS_COUNT];
 } led_pattern_balls_t;
 
 typedef struct {
@@ -32,7 +32,8 @@
 #include "diskio.h"
 #include "mmc.h"
 
-#define MMC_FORCE_MULTIBLOCK_READ
+#include <string.h>
+
 
 /* Peripheral controls (Platform dependent) */
 #define CS_LOW() 		/* Set MMC_CS = low */		\
@@ -85,6 +86,40 @@ BYTE Timer1, Timer2;	/* 100Hz decrement timer */
 static __attribute__((section(".fsbss")))
 BYTE CardType;			/* Card type flags (b0:MMC, b1:SDv1, b2:SDv2, b3:Block addressing) */
 
+/*
+ * Streaming reads
+ *
+ * A READ_MULTIPLE_BLOCK command is left open when a read finishes,
+ * with the card still selected, so that if the next request starts
+ * at the sector after the last one we can just keep clocking data
+ * out instead of paying for STOP_TRANSMISSION, a new command and the
+ * card's access latency again. Anything else that wants the card or
+ * the bus has to close the stream first with stream_stop(); the
+ * touch controller on the same SPI bus does this through
+ * mmc_disk_stream_stop().
+ *
+ * When a single sector read continues an open stream, somebody is
+ * reading sequentially in small pieces, so we read a few sectors
+ * further while we're at it and keep them in a small cache.
+ */
+
+#define MMC_RA_SECTORS	4	/* Read-ahead cache size */
+
+static __attribute__((section(".fsbss")))
+BYTE StreamOn;			/* READ_MULTIPLE_BLOCK in progress */
+
+static __attribute__((section(".fsbss")))
+DWORD StreamNext;		/* Next sector the stream will deliver */
+
+static volatile __attribute__((section(".fsdata")))
+BYTE StreamEnable = 1;		/* Leave streams open between requests */
+
+static BYTE RaBuf[MMC_RA_SECTORS * 512];	/* Read-ahead cache */
+static DWORD RaSector;		/* First sector in the cache */
+static UINT RaCount;		/* Sectors in the cache */
+
+MMC_STATS mmc_stats;
+
 
 
 /*-----------------------------------------------------------------------*/
@@ -199,6 +234,25 @@ int select (void)	/* 1:Successful, 0:Timeout */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Close an open read stream                                             */
+/*-----------------------------------------------------------------------*/
+
+static BYTE send_cmd (BYTE cmd, DWORD arg);
+
+static
+void stream_stop (void)
+{
+	if (!StreamOn) return;
+
+	send_cmd(CMD12, 0);		/* STOP_TRANSMISSION */
+	deselect();
+	StreamOn = 0;
+	mmc_stats.stops++;
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Receive a data packet from MMC                                        */
 /*-----------------------------------------------------------------------*/
@@ -330,6 +384,8 @@ DSTATUS mmc_disk_initialize (void)
 
 	spiAcquireBus (&SPID1);
 	gptStartContinuous (&GPTD3, NRF5_GPT_FREQ_62500HZ / 100);
+	stream_stop();						/* The card is about to be reset */
+	RaCount = 0;
 	power_on();							/* Turn on the socket power */
 	FCLK_SLOW();
 	for (n = 10; n; n--) xchg_spi(0xFF);	/* 80 dummy clocks */
@@ -397,37 +453,72 @@ DRESULT mmc_disk_read (
 	UINT count			/* Sector count (1..128) */
 )
 {
-	BYTE cmd;
+	DWORD addr;
+	BYTE join;
+	UINT n;
 
 
 	if (!count) return RES_PARERR;
 	if (Stat & STA_NOINIT) return RES_NOTRDY;
 
-	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert to byte address if needed */
-
-#ifdef MMC_FORCE_MULTIBLOCK_READ
-	/*
-	 * Always use command 18 (multiple block read). There seem to
-	 * be some SD cards that don't perform quite as well when using
-	 * the single block read command.
-	 */
-	cmd = CMD18;
-#else
-	cmd = count > 1 ? CMD18 : CMD17;			/*  READ_MULTIPLE_BLOCK : READ_SINGLE_BLOCK */
-#endif
 	spiAcquireBus (&SPID1);
 	gptStartContinuous (&GPTD3, NRF5_GPT_FREQ_62500HZ / 100);
-	if (send_cmd(cmd, sector) == 0) {
+
+	/* Take what we can from the read-ahead cache */
+	while (count && sector >= RaSector && sector < RaSector + RaCount) {
+		memcpy(buff, &RaBuf[(sector - RaSector) * 512], 512);
+		buff += 512;
+		sector++;
+		count--;
+		mmc_stats.hits++;
+	}
+
+	join = (StreamOn && StreamNext == sector) ? 1 : 0;
+
+	if (count && !join) {
+		stream_stop();
+		addr = sector;
+		if (!(CardType & CT_BLOCK)) addr *= 512;	/* Convert to byte address if needed */
+		/*
+		 * Always use command 18 (multiple block read). There seem to
+		 * be some SD cards that don't perform quite as well when using
+		 * the single block read command, and we need it for streaming
+		 * anyway.
+		 */
+		if (send_cmd(CMD18, addr) == 0) {	/* READ_MULTIPLE_BLOCK */
+			StreamOn = 1;
+			StreamNext = sector;
+			mmc_stats.cmds++;
+		} else {
+			deselect();
+		}
+	} else if (count) {
+		mmc_stats.joins++;
+	}
+
+	if (count && StreamOn) {
+		n = count;
 		do {
 			if (!rcvr_datablock(buff, 512)) break;
 			buff += 512;
+			StreamNext++;
 		} while (--count);
-#ifndef MMC_FORCE_MULTIBLOCK_READ
-		if (cmd == CMD18)
-#endif
-			send_cmd(CMD12, 0);	/* STOP_TRANSMISSION */
+		mmc_stats.sectors += n - count;
+
+		/* Sequential small reads: fill the read-ahead cache */
+		if (!count && n == 1 && join && StreamEnable) {
+			for (RaCount = 0; RaCount < MMC_RA_SECTORS; RaCount++) {
+				if (!rcvr_datablock(&RaBuf[RaCount * 512], 512)) break;
+			}
+			RaSector = StreamNext;
+			StreamNext += RaCount;
+			mmc_stats.sectors += RaCount;
+			if (RaCount < MMC_RA_SECTORS) stream_stop();
+		}
 	}
-	deselect();
+
+	if (count || !StreamEnable) stream_stop();
+
 	gptStopTimer (&GPTD3);
 	spiReleaseBus (&SPID1);
 
@@ -455,6 +546,8 @@ DRESULT mmc_disk_write (
 
 	spiAcquireBus (&SPID1);
 	gptStartContinuous (&GPTD3, NRF5_GPT_FREQ_62500HZ / 100);
+	stream_stop();
+	RaCount = 0;		/* Cached sectors may be stale now */
 	if (count == 1) {	/* Single block write */
 		if ((send_cmd(CMD24, sector) == 0)	/* WRITE_BLOCK */
 			&& xmit_datablock(buff, 0xFE))
@@ -503,6 +596,7 @@ DRESULT mmc_disk_ioctl (
 
 	spiAcquireBus (&SPID1);
 	gptStartContinuous (&GPTD3, NRF5_GPT_FREQ_62500HZ / 100);
+	stream_stop();
 	res = RES_ERROR;
 	switch (cmd) {
 	case CTRL_SYNC :		/* Make sure that no pending write process. Do not remove this or written sector might not left updated. */
@@ -648,6 +742,53 @@ DRESULT mmc_disk_ioctl (
 #endif
 
 
+/*-----------------------------------------------------------------------*/
+/* Stream control                                                        */
+/*-----------------------------------------------------------------------*/
+
+/* Close any open read stream. The caller must hold the SPI bus. */
+
+void mmc_disk_stream_stop (void)
+{
+	stream_stop();
+}
+
+
+/* Turn streaming on or off; with it off, every read stands alone. */
+
+void mmc_disk_stream_enable (int on)
+{
+	spiAcquireBus (&SPID1);
+	StreamEnable = on ? 1 : 0;
+	if (!on) stream_stop();
+	RaCount = 0;
+	spiReleaseBus (&SPID1);
+}
+
+
+/*
+ * Give an open file a cluster link map (FF_USE_FASTSEEK), so FatFs
+ * can find its clusters without reading the FAT. That keeps a long
+ * sequential read on one stream even across cluster boundaries.
+ * tbl[] must stay around until the file is closed. Returns the number
+ * of fragments in the file (1 means it's contiguous), or 0 if tbl[]
+ * was too small, in which case the file is read the normal way.
+ */
+
+UINT mmc_disk_map (FIL *fp, DWORD *tbl, UINT len)
+{
+	tbl[0] = len;
+	fp->cltbl = tbl;
+	if (f_lseek(fp, CREATE_LINKMAP) != FR_OK) {
+		fp->cltbl = 0;
+		return 0;
+	}
+
+	return (tbl[0] - 1) / 2;
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Device Timer Interrupt Procedure                                      */
 /*-----------------------------------------------------------------------*/
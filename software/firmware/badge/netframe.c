@@ -0,0 +1,284 @@
+/* netframe.c
+ *
+ * batches battle traffic into one L2CAP packet per frame, and
+ * only sends the parts of our ship's state that changed
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "orchard-app.h"
+
+#include "ble_lld.h"
+#include "ble_l2cap_lld.h"
+
+#include "battle.h"
+#include "netframe.h"
+#include "slaballoc.h"
+
+SLAB_POOL_DECL(nf_txpool, "l2cap tx", sizeof(bp_frame_pkt_t), 16);
+
+void
+nf_init(NETFRAME *nf)
+{
+  memset(nf, 0, sizeof(NETFRAME));
+}
+
+/*
+ * ble_l2cap_tx_release hook: put a transmit buffer back in the pool
+ * once the SoftDevice is done with it. Other apps' buffers aren't ours.
+ */
+void
+nf_tx_release(void *buf)
+{
+  if ((uint8_t *)buf >= nf_txpool.mem &&
+      (uint8_t *)buf < nf_txpool.mem + (nf_txpool.size * nf_txpool.count))
+    sl_pool_free(&nf_txpool, buf);
+}
+
+/*
+ * Make room for len bytes at *pp, sending the frame first if it's
+ * full. If that send fails, nothing is queued and nf_flush()'s error
+ * is returned.
+ */
+static int
+nf_reserve(NETFRAME *nf, int len, uint8_t **pp)
+{
+  int r;
+
+  if (nf->len + len > BP_FRAME_DATA && (r = nf_flush(nf)) != NF_OK)
+    return(r);
+
+  *pp = &nf->data[nf->len];
+  nf->len += len;
+
+  return(NF_OK);
+}
+
+int
+nf_flush(NETFRAME *nf)
+{
+  bp_frame_pkt_t *pkt;
+  uint8_t *buf;
+
+  if (nf->len == 0)
+    return(NF_OK);
+
+  buf = sl_pool_alloc(&nf_txpool);
+  if (buf == NULL)
+    return(NF_NOMEM);
+
+  pkt = (bp_frame_pkt_t *)buf;
+  pkt->bp_header.bp_opcode = BATTLE_OP_FRAME;
+  pkt->bp_header.bp_type   = T_ENEMY; // always enemy.
+  pkt->bp_header.bp_id     = nf->seq++;
+  pkt->bp_len              = nf->len;
+  memcpy(pkt->bp_data, nf->data, nf->len);
+  nf->len = 0;
+
+  if (bleL2CapSend(buf, sizeof(bp_header_t) + 1 + pkt->bp_len) !=
+      NRF_SUCCESS)
+  {
+    sl_pool_free(&nf_txpool, buf);
+    return(NF_XMIT);
+  }
+
+  return(NF_OK);
+}
+
+int
+nf_add_state(NETFRAME *nf, uint8_t op, uint16_t operand)
+{
+  uint8_t *p;
+  int      r;
+
+  if ((r = nf_reserve(nf, 3, &p)) != NF_OK)
+    return(r);
+
+  p[0] = op;
+  memcpy(&p[1], &operand, sizeof(operand));
+
+  return(NF_OK);
+}
+
+int
+nf_add_bullet(NETFRAME *nf, int8_t dir_x, int8_t dir_y, uint8_t is_free)
+{
+  uint8_t *p;
+  int      r;
+
+  if ((r = nf_reserve(nf, 4, &p)) != NF_OK)
+    return(r);
+
+  p[0] = BATTLE_OP_ENTITY_CREATE;
+  p[1] = (uint8_t)dir_x;
+  p[2] = (uint8_t)dir_y;
+  p[3] = is_free;
+
+  return(NF_OK);
+}
+
+int
+nf_add_mine(NETFRAME *nf)
+{
+  uint8_t *p;
+  int      r;
+
+  if ((r = nf_reserve(nf, 1, &p)) != NF_OK)
+    return(r);
+
+  p[0] = BATTLE_OP_MINE_CREATE;
+
+  return(NF_OK);
+}
+
+static int16_t
+nf_quantize(fix16_t v)
+{
+  v = (v + (1 << (BP_QUANT_SHIFT - 1))) >> BP_QUANT_SHIFT;
+
+  if (v > INT16_MAX)
+    return(INT16_MAX);
+  if (v < INT16_MIN)
+    return(INT16_MIN);
+
+  return((int16_t)v);
+}
+
+static fix16_t
+nf_unquantize(int16_t v)
+{
+  return((fix16_t)v * (1 << BP_QUANT_SHIFT));
+}
+
+/*
+ * Queue whatever has changed in e since the last update we sent.
+ * Nothing is queued if it all rounds to the same values. If it
+ * can't be queued, the next call sends the same changes again.
+ */
+int
+nf_add_entity(NETFRAME *nf, ENTITY *e)
+{
+  int16_t  now[6];
+  uint8_t  mask = 0;
+  uint8_t *p;
+  int      i, r, len = 2;
+
+  now[0] = nf_quantize(e->vecPosition.x);
+  now[1] = nf_quantize(e->vecPosition.y);
+  now[2] = nf_quantize(e->vecVelocity.x);
+  now[3] = nf_quantize(e->vecVelocity.y);
+  now[4] = nf_quantize(e->vecVelocityGoal.x);
+  now[5] = nf_quantize(e->vecVelocityGoal.y);
+
+  for (i = 0; i < 6; i++)
+  {
+    if (!nf->tx.valid || now[i] != nf->tx.val[i])
+    {
+      mask |= 1 << i;
+      len += sizeof(int16_t);
+    }
+  }
+
+  if (!nf->tx.valid || e->faces_right != nf->tx.faces_right)
+    mask |= BP_ENT_FACING | (e->faces_right ? BP_ENT_FACES_RIGHT : 0);
+
+  if (mask == 0)
+    return(NF_OK);
+
+  if ((r = nf_reserve(nf, len, &p)) != NF_OK)
+    return(r);
+
+  *p++ = BATTLE_OP_ENTITY_UPDATE;
+  *p++ = mask;
+
+  for (i = 0; i < 6; i++)
+  {
+    if (mask & (1 << i))
+    {
+      memcpy(p, &now[i], sizeof(int16_t));
+      p += sizeof(int16_t);
+      nf->tx.val[i] = now[i];
+    }
+  }
+
+  nf->tx.faces_right = e->faces_right;
+  nf->tx.valid       = TRUE;
+
+  return(NF_OK);
+}
+
+/*
+ * Decode the record at p, which has len bytes left in the frame.
+ * Entity updates are folded into nf->rx. Returns the number of bytes
+ * used, or 0 if the record is cut short.
+ */
+int
+nf_decode(NETFRAME *nf, const uint8_t *p, int len, NF_RECORD *r)
+{
+  uint8_t mask;
+  int     i, used;
+
+  memset(r, 0, sizeof(NF_RECORD));
+  r->op = p[0];
+
+  switch (r->op)
+  {
+  case BATTLE_OP_ENTITY_UPDATE:
+    if (len < 2)
+      return(0);
+    mask = p[1];
+    used = 2;
+    for (i = 0; i < 6; i++)
+    {
+      if (mask & (1 << i))
+        used += sizeof(int16_t);
+    }
+    if (len < used)
+      return(0);
+
+    p += 2;
+    for (i = 0; i < 6; i++)
+    {
+      if (mask & (1 << i))
+      {
+        memcpy(&nf->rx.val[i], p, sizeof(int16_t));
+        p += sizeof(int16_t);
+      }
+    }
+    if (mask & BP_ENT_FACING)
+      nf->rx.faces_right = (mask & BP_ENT_FACES_RIGHT) ? TRUE : FALSE;
+    nf->rx.valid = TRUE;
+    return(used);
+
+  case BATTLE_OP_ENTITY_CREATE:
+    if (len < 4)
+      return(0);
+    r->dir_x   = (int8_t)p[1];
+    r->dir_y   = (int8_t)p[2];
+    r->is_free = p[3];
+    return(4);
+
+  case BATTLE_OP_MINE_CREATE:
+    return(1);
+
+  default:
+    if (len < 3)
+      return(0);
+    memcpy(&r->operand, &p[1], sizeof(uint16_t));
+    return(3);
+  }
+}
+
+/* copy the last state the other side sent into e */
+void
+nf_apply_entity(NETFRAME *nf, ENTITY *e)
+{
+  e->vecPosition.x     = nf_unquantize(nf->rx.val[0]);
+  e->vecPosition.y     = nf_unquantize(nf->rx.val[1]);
+  e->vecVelocity.x     = nf_unquantize(nf->rx.val[2]);
+  e->vecVelocity.y     = nf_unquantize(nf->rx.val[3]);
+  e->vecVelocityGoal.x = nf_unquantize(nf->rx.val[4]);
+  e->vecVelocityGoal.y = nf_unquantize(nf->rx.val[5]);
+}
@@ -0,0 +1,61 @@
+#ifndef _NETFRAME_H_
+#define _NETFRAME_H_
+
+#include "battle.h"
+#include "slaballoc.h"
+
+/*
+ * Per-tick battle replication. Records are queued into a frame as
+ * the game runs and go out as one bp_frame_pkt_t when nf_flush() is
+ * called (or when the frame fills up). See battle.h for the format.
+ */
+
+#define NF_OK           0
+#define NF_NOMEM        1      /* no slab; frame is kept for next time */
+#define NF_XMIT         2      /* the L2CAP send failed */
+
+/* entity state as it went over the air, in 1/16th pixels */
+typedef struct _nf_snapshot
+{
+  int16_t  val[6];             /* x, y, vx, vy, gx, gy */
+  uint8_t  faces_right;
+  bool     valid;
+} NF_SNAPSHOT;
+
+/* one decoded record */
+typedef struct _nf_record
+{
+  uint8_t  op;
+  uint16_t operand;
+  int8_t   dir_x;
+  int8_t   dir_y;
+  uint8_t  is_free;
+} NF_RECORD;
+
+typedef struct _netframe
+{
+  uint32_t    seq;
+  uint8_t     len;
+  uint8_t     data[BP_FRAME_DATA];
+  NF_SNAPSHOT tx;              /* last state we sent about ourselves */
+  NF_SNAPSHOT rx;              /* last state the other side sent */
+} NETFRAME;
+
+/* L2CAP transmit buffers for battle packets */
+extern SLAB_POOL nf_txpool;
+
+extern void nf_init(NETFRAME *nf);
+extern void nf_tx_release(void *buf);
+extern int nf_flush(NETFRAME *nf);
+
+/* these return NF_OK, or what nf_flush() said when the frame was full */
+extern int nf_add_state(NETFRAME *nf, uint8_t op, uint16_t operand);
+extern int nf_add_bullet(NETFRAME *nf, int8_t dir_x, int8_t dir_y,
+                         uint8_t is_free);
+extern int nf_add_mine(NETFRAME *nf);
+extern int nf_add_entity(NETFRAME *nf, ENTITY *e);
+
+extern int nf_decode(NETFRAME *nf, const uint8_t *p, int len, NF_RECORD *r);
+extern void nf_apply_entity(NETFRAME *nf, ENTITY *e);
+
+#endif /* _NETFRAME_H_ */
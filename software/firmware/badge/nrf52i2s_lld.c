@@ -34,129 +34,409 @@
 #include "hal_i2s.h"
 #include "nrf52i2s_lld.h"
 #include "ff.h"
+#include "dds.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 uint16_t * i2sBuf;
 uint8_t i2sEnabled = TRUE;
 
-static char * fname;
+typedef struct i2s_voice {
+	uint8_t		iv_type;
+	uint8_t		iv_prio;
+	uint8_t		iv_loop;
+	uint8_t		iv_busy;	/* mixer is reading it, unlocked */
+	uint8_t		iv_stop;	/* stopped while busy */
+	uint16_t	iv_gain;
+	uint32_t	iv_age;
+	/* I2S_VOICE_FILE */
+	FIL		iv_f;
+	/* I2S_VOICE_MEM */
+	const int16_t *	iv_buf;
+	int		iv_cnt;
+	int		iv_pos;
+	/* I2S_VOICE_TONE */
+	DDS_TONE	iv_tone;
+} I2S_VOICE;
+
 static thread_t * pThread = NULL;
-static volatile uint8_t play;
-static uint8_t i2sloop;
 
 static THD_WORKING_AREA(waI2sThread, 1024);
 static thread_reference_t i2sThreadReference;
 static int i2sState;
 static int i2sRunning;
 
-static
-THD_FUNCTION(i2sThread, arg)
+/*
+ * The voice table is shared between the mixer thread and whoever
+ * starts and stops sounds, and is protected by i2sMixLock. The mixer
+ * sleeps on i2sMixSem when there's nothing to play. The lock isn't
+ * held while the mixer reads a file voice from the SD card or waits
+ * for a block to play, so starting a sound never waits on either.
+ */
+
+static mutex_t i2sMixLock;
+static binary_semaphore_t i2sMixSem;
+static I2S_VOICE i2sVoices[I2S_VOICES];
+static uint32_t i2sVoiceAge;
+static int16_t * i2sMixBuf;
+static int16_t i2sScratch[I2S_SAMPLES];
+static I2S_MIX_STATS i2sStats;
+
+#define I2S_TONE_RAMP		(I2S_RATE / 500)	/* 2ms */
+
+static inline int16_t
+i2sSat16 (int32_t v)
 {
-        FIL f;
-        UINT br;
-        uint16_t * p;
-        thread_t * th;
-        char * file = NULL;
+	if (v > INT16_MAX)
+		return (INT16_MAX);
+	if (v < INT16_MIN)
+		return (INT16_MIN);
+	return ((int16_t)v);
+}
 
-	chRegSetThreadName ("I2S");
+/*
+ * Must be called with i2sMixLock held. A voice the mixer is reading
+ * from is only marked, and the mixer releases it once the read is
+ * done.
+ */
 
-	while (1) {
-		if (play == 0) {
-			th = chMsgWait ();
-			file = fname;
-			play = 1;
-			chMsgRelease (th, MSG_OK);
-		}
+static void
+i2sVoiceRelease (I2S_VOICE * v)
+{
+	if (v->iv_busy == TRUE) {
+		v->iv_stop = TRUE;
+		return;
+	}
+
+	if (v->iv_type == I2S_VOICE_FILE)
+		f_close (&v->iv_f);
+	v->iv_type = I2S_VOICE_FREE;
+	v->iv_stop = FALSE;
+
+	return;
+}
+
+/*
+ * Find a voice for a new sound of priority <prio>. Must be called
+ * with i2sMixLock held. Returns -1 if every voice is playing
+ * something more important.
+ */
+
+static int
+i2sVoiceAlloc (uint8_t prio)
+{
+	I2S_VOICE * v;
+	int i;
+	int best = -1;
+
+	if (i2sEnabled == FALSE)
+		return (-1);
 
-		if (i2sEnabled == FALSE) {
-			play = 0;
-			file = NULL;
+	/*
+	 * If someone else (e.g. the video player) has the I2S
+	 * channel, we can't play from two sources at once.
+	 */
+
+	if (i2sBuf != NULL && i2sBuf != (uint16_t *)i2sMixBuf)
+		return (-1);
+
+	for (i = 0; i < I2S_VOICES; i++) {
+		v = &i2sVoices[i];
+		if (v->iv_type == I2S_VOICE_FREE)
+			return (i);
+		if (v->iv_prio > prio || v->iv_busy == TRUE)
 			continue;
-		}
+		if (best == -1 || v->iv_prio < i2sVoices[best].iv_prio ||
+		    (v->iv_prio == i2sVoices[best].iv_prio &&
+		    (int32_t)(v->iv_age - i2sVoices[best].iv_age) < 0))
+			best = i;
+	}
 
-		/*
-		 * If the video app is running, then it's already using
-		 * the I2S channel, and we shouldn't try to use it again
-		 * here because we can't play from two sources at once.
-		 */
-        
-		if (i2sBuf != NULL) {
-			play = 0;
+	if (best == -1) {
+		i2sStats.ms_rejects++;
+		return (-1);
+	}
+
+	i2sStats.ms_steals++;
+	i2sVoiceRelease (&i2sVoices[best]);
+
+	return (best);
+}
+
+static void
+i2sVoiceSetup (int i, uint8_t type, uint8_t prio, uint16_t gain)
+{
+	I2S_VOICE * v;
+
+	v = &i2sVoices[i];
+	v->iv_type = type;
+	v->iv_prio = prio;
+	v->iv_gain = gain;
+	v->iv_loop = I2S_PLAY_ONCE;
+	v->iv_age = i2sVoiceAge++;
+
+	return;
+}
+
+/*
+ * Produce up to <max> samples from voice <v>. Returns the number of
+ * samples available and sets <src> to point at them. Anything less
+ * than <max> means the voice has finished.
+ */
+
+static int
+i2sVoiceFetch (I2S_VOICE * v, const int16_t ** src, int max)
+{
+	UINT br;
+	UINT total;
+	int i, n;
+
+	switch (v->iv_type) {
+		case I2S_VOICE_FILE:
+			total = 0;
+			while (total < max * sizeof(int16_t)) {
+				if (f_read (&v->iv_f, (uint8_t *)i2sScratch +
+				    total, (max * sizeof(int16_t)) - total,
+				    &br) != FR_OK)
+					break;
+				total += br;
+				if (br != 0)
+					continue;
+				/* End of file: rewind if looping */
+				if (v->iv_loop == I2S_PLAY_ONCE ||
+				    f_lseek (&v->iv_f, 0) != FR_OK ||
+				    f_size (&v->iv_f) == 0)
+					break;
+			}
+			*src = i2sScratch;
+			return ((total >> 1) & ~1);
+
+		case I2S_VOICE_MEM:
+			n = v->iv_cnt - v->iv_pos;
+			if (n > max)
+				n = max;
+			*src = v->iv_buf + v->iv_pos;
+			v->iv_pos += n;
+			return (n);
+
+		case I2S_VOICE_TONE:
+			n = ddsFill (&v->iv_tone, i2sScratch, max >> 1, 2);
+			for (i = 0; i < n; i++)
+				i2sScratch[(i * 2) + 1] = i2sScratch[i * 2];
+			*src = i2sScratch;
+			return (n * 2);
+
+		default:
+			break;
+	}
+
+	return (0);
+}
+
+static void
+i2sMixIn (int16_t * out, const int16_t * src, int n, uint16_t gain)
+{
+	int i;
+
+	if (gain == I2S_GAIN_UNITY) {
+		for (i = 0; i < n; i++)
+			out[i] = i2sSat16 ((int32_t)out[i] + src[i]);
+	} else {
+		for (i = 0; i < n; i++)
+			out[i] = i2sSat16 ((int32_t)out[i] +
+			    (((int32_t)src[i] * gain) >> 8));
+	}
+
+	return;
+}
+
+/*
+ * Mix one block from all active voices into <out>. Must be called
+ * with i2sMixLock held. Tones and samples in memory are mixed right
+ * away; file voices are marked busy and read with the lock dropped,
+ * then the lock is taken again to retire the ones that ended. Returns
+ * the number of samples in the block, which is only less than
+ * I2S_SAMPLES if every voice ended.
+ */
+
+static int
+i2sMixBlock (int16_t * out)
+{
+	I2S_VOICE * v;
+	const int16_t * src;
+	uint16_t gain[I2S_VOICES];
+	int got[I2S_VOICES];
+	int len = 0;
+	int reads = 0;
+	int i, n;
+
+	memset (out, 0, I2S_BYTES);
+
+	for (i = 0; i < I2S_VOICES; i++) {
+		v = &i2sVoices[i];
+		if (v->iv_type == I2S_VOICE_FREE)
 			continue;
-		}
 
-		if (f_open (&f, file, FA_READ) != FR_OK) {
-			play = 0;
+		if (v->iv_type == I2S_VOICE_FILE) {
+			v->iv_busy = TRUE;
+			gain[i] = v->iv_gain;
+			reads++;
 			continue;
 		}
 
-		i2sBuf = malloc (I2S_BYTES * 2);
+		n = i2sVoiceFetch (v, &src, I2S_SAMPLES);
+		i2sMixIn (out, src, n, v->iv_gain);
+
+		if (n > len)
+			len = n;
+		if (n < I2S_SAMPLES)
+			i2sVoiceRelease (v);
+	}
+
+	if (reads == 0)
+		return (len);
+
+	/* Only this thread touches a busy voice */
 
-		/* Load the first block of samples. */
+	chMtxUnlock (&i2sMixLock);
 
-		p = i2sBuf;
-		if (f_read (&f, p, I2S_BYTES, &br) != FR_OK) {
-			f_close (&f);
-			free (i2sBuf);
-			i2sBuf = NULL;
-			play = 0;
+	for (i = 0; i < I2S_VOICES; i++) {
+		v = &i2sVoices[i];
+		if (v->iv_busy == FALSE)
 			continue;
-		}
+		got[i] = i2sVoiceFetch (v, &src, I2S_SAMPLES);
+		i2sMixIn (out, src, got[i], gain[i]);
+	}
 
-		/* Power up the audio amp */
+	chMtxLock (&i2sMixLock);
 
-		palClearPad (IOPORT1, IOPORT1_I2S_AMPSD);
+	for (i = 0; i < I2S_VOICES; i++) {
+		v = &i2sVoices[i];
+		if (v->iv_busy == FALSE)
+			continue;
+		v->iv_busy = FALSE;
 
-		while (1) {
+		if (got[i] > len)
+			len = got[i];
+		if (got[i] < I2S_SAMPLES || v->iv_stop == TRUE)
+			i2sVoiceRelease (v);
+	}
+
+	return (len);
+}
 
-			/* Start the samples playing */
+static int
+i2sVoicesActive (void)
+{
+	int i;
+	int cnt = 0;
 
-			i2sSamplesPlay (p, br >> 1);
+	for (i = 0; i < I2S_VOICES; i++) {
+		if (i2sVoices[i].iv_type != I2S_VOICE_FREE)
+			cnt++;
+	}
 
-			/* Swap buffers and load the next block of samples */
+	return (cnt);
+}
 
-			if (p == i2sBuf)
-        			p += I2S_SAMPLES;
-			else
-        			p = i2sBuf;
+static
+THD_FUNCTION(i2sThread, arg)
+{
+	int16_t * p = NULL;
+	int16_t * buf;
+	uint8_t playing = FALSE;
+	rtcnt_t start;
+	rtcnt_t t;
+	int cnt;
 
-			if (f_read (&f, p, I2S_BYTES, &br) != FR_OK)
-        			break;
-			/*
-			 * Wait until the current block of samples
-			 * finishes playing before playing the next
-			 * block.
-			 */
+	chRegSetThreadName ("I2S");
 
-			i2sSamplesWait ();
+	while (1) {
+		chMtxLock (&i2sMixLock);
 
-			/* If we read 0 bytes, we reached end of file. */
+		/*
+		 * Nothing left to play: let the last block drain,
+		 * shut down and wait for something new. The lock is
+		 * dropped while it drains, so look again afterwards
+		 * in case a sound was started meanwhile.
+		 */
 
-			if (br == 0)
-				break;
+		if (i2sVoicesActive () == 0) {
+			if (playing == TRUE) {
+				chMtxUnlock (&i2sMixLock);
+				i2sSamplesWait ();
+				i2sSamplesStop ();
+				playing = FALSE;
+				continue;
+			}
+
+			if (i2sMixBuf != NULL) {
+				/* Power down the audio amp */
+
+				palSetPad (IOPORT1, IOPORT1_I2S_AMPSD);
+
+				if (i2sBuf == (uint16_t *)i2sMixBuf)
+					i2sBuf = NULL;
+				free (i2sMixBuf);
+				i2sMixBuf = NULL;
+			}
+			chMtxUnlock (&i2sMixLock);
+			chBSemWait (&i2sMixSem);
+			continue;
+		}
 
-			/* If told to stop, exit the loop. */
+		if (i2sMixBuf == NULL) {
+			buf = NULL;
+			if (i2sBuf == NULL)
+				buf = malloc (I2S_BYTES * 2);
+			if (buf == NULL) {
+				for (cnt = 0; cnt < I2S_VOICES; cnt++)
+					i2sVoiceRelease (&i2sVoices[cnt]);
+				chMtxUnlock (&i2sMixLock);
+				continue;
+			}
+			i2sMixBuf = buf;
+			i2sBuf = (uint16_t *)buf;
+			p = buf;
+
+			/* Power up the audio amp */
 
-			if (play == 0)
-        			break;
+			palClearPad (IOPORT1, IOPORT1_I2S_AMPSD);
 		}
 
-		/* We're done, close the file. */
+		/* Mix the next block while the current one plays. */
 
-		i2sSamplesStop ();
-		if (br == 0 && i2sloop == I2S_PLAY_ONCE) {
-			file = NULL;
-			play = 0;
+		start = chSysGetRealtimeCounterX ();
+		cnt = i2sMixBlock (p);
+		t = chSysGetRealtimeCounterX () - start;
+
+		i2sStats.ms_blocks++;
+		i2sStats.ms_last = t;
+		i2sStats.ms_total += t;
+		if (t > i2sStats.ms_max)
+			i2sStats.ms_max = t;
+
+		chMtxUnlock (&i2sMixLock);
+
+		if (cnt == 0)
+			continue;
+
+		if (playing == TRUE) {
+			if (i2sState == I2S_STATE_IDLE)
+				i2sStats.ms_underruns++;
+			i2sSamplesWait ();
 		}
 
-		/* Power down the audio amp */
+		i2sSamplesPlay (p, cnt);
+		playing = TRUE;
 
-		palSetPad (IOPORT1, IOPORT1_I2S_AMPSD);
+		/* Swap buffers */
 
-		free (i2sBuf);
-               	i2sBuf = NULL;
-		f_close (&f);
+		if (p == i2sMixBuf)
+			p += I2S_SAMPLES;
+		else
+			p = i2sMixBuf;
 	}
 
 	/* NOTREACHED */
@@ -268,6 +548,9 @@ i2sStart (void)
 
 	/* Launch the player thread. */
 
+	chMtxObjectInit (&i2sMixLock);
+	chBSemObjectInit (&i2sMixSem, TRUE);
+
 	pThread = chThdCreateStatic (waI2sThread, sizeof(waI2sThread),
 	    I2S_THREAD_PRIO, i2sThread, NULL);
 
@@ -423,9 +706,9 @@ i2sSamplesStop (void)
 
 /******************************************************************************
 *
-* i2sWait - wait for current audio file to finish playing
+* i2sWait - wait for all sounds to finish playing
 *
-* This function can be used to test when the current audio sample file has
+* This function can be used to test when all the voices in the mixer have
 * finished playing. It can be used to pause the current thread until a
 * sound effect finishes playing.
 *
@@ -437,7 +720,7 @@ i2sWait (void)
 {
 	int waits = 0;
 
-	while (play != 0) {
+	while (i2sMixBuf != NULL) {
 		chThdSleep (1);
 		waits++;
 	}
@@ -467,14 +750,16 @@ i2sPlay (char * file)
 *
 * i2sLoopPlay - play an audio file
 *
-* This function cues up an audio file to be played by the background I2S
-* thread. The file name is specified by <file>. If <loop> is I2S_PLAY_ONCE,
-* the sample file is played once and then the player thread will go idle
-* again. If <loop> is I2S_PLAY_LOOP, the same file will be played over and
-* over again.
+* This function plays an audio file on a free mixer voice at normal priority
+* and full volume, so it mixes with whatever else is already playing. The
+* file name is specified by <file>. If <loop> is I2S_PLAY_ONCE, the sample
+* file is played once. If <loop> is I2S_PLAY_LOOP, the same file will be
+* played over and over again.
 *
-* Playback of any sample file (including one that is looping) can be halted
-* at any time by calling i2sLoopPlay() with <file> set to NULL.
+* All playback (including any sample file that is looping) can be halted
+* at any time by calling i2sLoopPlay() with <file> set to NULL. This waits
+* for the mixer to release the I2S channel, so the caller can then use
+* i2sSamplesPlay() directly.
 *
 * RETURNS: N/A
 */
@@ -482,10 +767,178 @@ i2sPlay (char * file)
 void
 i2sLoopPlay (char * file, uint8_t loop)
 {
-	play = 0;
-	i2sloop = loop;
-	fname = file;
-	chMsgSend (pThread, MSG_OK);
+	if (file == NULL) {
+		i2sVoiceStop (I2S_VOICE_ALL);
+		chBSemSignal (&i2sMixSem);
+		i2sWait ();
+	} else
+		i2sVoiceFile (file, loop, I2S_PRIO_NORMAL, I2S_GAIN_UNITY);
+
+	return;
+}
+
+/******************************************************************************
+*
+* i2sVoiceFile - play an audio file on a mixer voice
+*
+* This function opens the sample file <file> and starts streaming it on a
+* mixer voice with priority <prio> and gain <gain> (I2S_GAIN_UNITY is full
+* volume). If <loop> is I2S_PLAY_LOOP, the file is played until the voice
+* is stopped or taken over by a more important sound.
+*
+* RETURNS: The voice number, or -1 if the file couldn't be opened or no
+* voice was available.
+*/
+
+int
+i2sVoiceFile (char * file, uint8_t loop, uint8_t prio, uint16_t gain)
+{
+	int i;
+
+	chMtxLock (&i2sMixLock);
+
+	if ((i = i2sVoiceAlloc (prio)) != -1) {
+		if (f_open (&i2sVoices[i].iv_f, file, FA_READ) != FR_OK)
+			i = -1;
+		else {
+			i2sVoiceSetup (i, I2S_VOICE_FILE, prio, gain);
+			i2sVoices[i].iv_loop = loop;
+		}
+	}
+
+	chMtxUnlock (&i2sMixLock);
+
+	if (i != -1)
+		chBSemSignal (&i2sMixSem);
+
+	return (i);
+}
+
+/******************************************************************************
+*
+* i2sVoiceSamples - play samples from memory on a mixer voice
+*
+* This function plays <cnt> 16-bit stereo samples from <buf> once, with
+* priority <prio> and gain <gain>. The buffer is read in place, so it must
+* stay valid until the voice finishes or is stopped.
+*
+* RETURNS: The voice number, or -1 if no voice was available.
+*/
+
+int
+i2sVoiceSamples (const int16_t * buf, int cnt, uint8_t prio, uint16_t gain)
+{
+	int i;
+
+	chMtxLock (&i2sMixLock);
+
+	if ((i = i2sVoiceAlloc (prio)) != -1) {
+		i2sVoiceSetup (i, I2S_VOICE_MEM, prio, gain);
+		i2sVoices[i].iv_buf = buf;
+		i2sVoices[i].iv_cnt = cnt & ~1;
+		i2sVoices[i].iv_pos = 0;
+	}
+
+	chMtxUnlock (&i2sMixLock);
+
+	if (i != -1)
+		chBSemSignal (&i2sMixSem);
+
+	return (i);
+}
+
+/******************************************************************************
+*
+* i2sVoiceTone - play a sine wave tone on a mixer voice
+*
+* This function synthesizes a tone of <hz> Hertz lasting <ms> milliseconds,
+* with priority <prio> and gain <gain>. See dds.c.
+*
+* RETURNS: The voice number, or -1 if no voice was available.
+*/
+
+int
+i2sVoiceTone (uint32_t hz, uint32_t ms, uint8_t prio, uint16_t gain)
+{
+	int i;
+
+	chMtxLock (&i2sMixLock);
+
+	if ((i = i2sVoiceAlloc (prio)) != -1) {
+		i2sVoiceSetup (i, I2S_VOICE_TONE, prio, gain);
+		ddsInit (&i2sVoices[i].iv_tone, I2S_RATE, hz, hz, DDS_AMP_MAX);
+		ddsEnvelope (&i2sVoices[i].iv_tone, (ms * I2S_RATE) / 1000,
+		    I2S_TONE_RAMP, I2S_TONE_RAMP);
+	}
+
+	chMtxUnlock (&i2sMixLock);
+
+	if (i != -1)
+		chBSemSignal (&i2sMixSem);
+
+	return (i);
+}
+
+/******************************************************************************
+*
+* i2sVoiceGain - change the gain of a playing voice
+*
+* RETURNS: N/A
+*/
+
+void
+i2sVoiceGain (int voice, uint16_t gain)
+{
+	if (voice < 0 || voice >= I2S_VOICES)
+		return;
+
+	chMtxLock (&i2sMixLock);
+	i2sVoices[voice].iv_gain = gain;
+	chMtxUnlock (&i2sMixLock);
+
+	return;
+}
+
+/******************************************************************************
+*
+* i2sVoiceStop - stop a mixer voice
+*
+* This function stops the voice <voice>, or all voices if <voice> is
+* I2S_VOICE_ALL.
+*
+* RETURNS: N/A
+*/
+
+void
+i2sVoiceStop (int voice)
+{
+	int i;
+
+	chMtxLock (&i2sMixLock);
+
+	for (i = 0; i < I2S_VOICES; i++) {
+		if (voice == I2S_VOICE_ALL || voice == i)
+			i2sVoiceRelease (&i2sVoices[i]);
+	}
+
+	chMtxUnlock (&i2sMixLock);
+
+	return;
+}
+
+/******************************************************************************
+*
+* i2sMixStats - get mixer statistics
+*
+* RETURNS: N/A
+*/
+
+void
+i2sMixStats (I2S_MIX_STATS * stats)
+{
+	chMtxLock (&i2sMixLock);
+	memcpy (stats, &i2sStats, sizeof(I2S_MIX_STATS));
+	chMtxUnlock (&i2sMixLock);
 
 	return;
 }
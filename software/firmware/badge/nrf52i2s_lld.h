@@ -49,6 +49,44 @@
 #define I2S_AMP_OFF		0
 #define I2S_AMP_ON		1
 
+/* Sample rate: 32MHz / 8 / 256 */
+
+#define I2S_RATE		15625
+
+/*
+ * Mixer voices. All voices are mixed together into one block of
+ * I2S_SAMPLES at a time, so the mixing work per block is bounded by
+ * I2S_VOICES no matter how many sounds are requested. When all voices
+ * are busy, a new sound takes over the lowest priority voice (the
+ * oldest one if there's a tie), as long as that voice's priority
+ * isn't higher than its own.
+ */
+
+#define I2S_VOICES		4
+#define I2S_VOICE_ALL		-1
+#define I2S_NAMELEN		32
+
+#define I2S_VOICE_FREE		0
+#define I2S_VOICE_FILE		1	/* streamed from a .snd file */
+#define I2S_VOICE_MEM		2	/* samples in RAM */
+#define I2S_VOICE_TONE		3	/* synthesized sine wave */
+
+#define I2S_PRIO_LOW		0
+#define I2S_PRIO_NORMAL		1
+#define I2S_PRIO_HIGH		2
+
+#define I2S_GAIN_UNITY		256	/* gain is 8.8 fixed point */
+
+typedef struct i2s_mix_stats {
+	uint32_t	ms_blocks;	/* blocks mixed */
+	uint32_t	ms_underruns;	/* DMA went idle before next block */
+	uint32_t	ms_steals;	/* voices taken over by new sounds */
+	uint32_t	ms_rejects;	/* sounds with no voice to play on */
+	rtcnt_t		ms_last;	/* time to fill the last block */
+	rtcnt_t		ms_max;		/* longest time to fill a block */
+	uint64_t	ms_total;
+} I2S_MIX_STATS;
+
 extern void i2sStart (void);
 
 extern void i2sAudioAmpCtl (uint8_t);
@@ -61,6 +99,13 @@ extern int i2sWait (void);
 extern void i2sPlay (char *);
 extern void i2sLoopPlay (char *, uint8_t);
 
+extern int i2sVoiceFile (char *, uint8_t, uint8_t, uint16_t);
+extern int i2sVoiceSamples (const int16_t *, int, uint8_t, uint16_t);
+extern int i2sVoiceTone (uint32_t, uint32_t, uint8_t, uint16_t);
+extern void i2sVoiceGain (int, uint16_t);
+extern void i2sVoiceStop (int);
+extern void i2sMixStats (I2S_MIX_STATS *);
+
 extern uint16_t * i2sBuf;
 extern uint8_t i2sEnabled;
 
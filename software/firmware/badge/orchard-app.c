@@ -7,6 +7,7 @@
 #include "orchard-app.h"
 #include "orchard-events.h"
 #include "orchard-ui.h"
+#include "slaballoc.h"
 
 #include "nrf52i2s_lld.h"
 #include "joypad_lld.h"
@@ -40,14 +41,28 @@ event_source_t orchard_app_key;
 
 static uint8_t ui_override = 0;
 
-#define RADIO_QUEUE_LEN	64
-
-static uint8_t prod_idx;
-static uint8_t cons_idx;
-static uint8_t queue_cnt;
-
-static OrchardAppRadioEvent * radio_evt[RADIO_QUEUE_LEN];
-static uint8_t * radio_pkt[RADIO_QUEUE_LEN];
+/*
+ * Radio events are queued by the SoftDevice event thread and drained
+ * by the app thread. There is exactly one of each, so the ring needs
+ * no locking: only the producer moves radio_head and only the
+ * consumer moves radio_tail. Both count up forever and are masked
+ * to find the slot. Packets that fit are copied into the slot; bigger
+ * ones (L2CAP SDUs) go in a slab.
+ */
+
+#define RADIO_QUEUE_LEN		64	/* must be a power of 2 */
+#define RADIO_PKT_INLINE	64
+#define RADIO_BATCH_LEN		32	/* events taken per drain */
+
+typedef struct _radio_slot {
+  OrchardAppRadioEvent	ev;
+  uint8_t		pkt[RADIO_PKT_INLINE];
+} radio_slot;
+
+static radio_slot radio_ring[RADIO_QUEUE_LEN];
+static volatile uint32_t radio_head;
+static volatile uint32_t radio_tail;
+static OrchardAppRadioStats radio_stats;
 
 void orchardAppUgfxCallback (void * arg, GEvent * pe)
 {
@@ -93,87 +108,153 @@ static void ugfx_event(eventid_t id) {
   return;
 }
 
+static void radio_slot_release (radio_slot * slot) {
+  if (slot->ev.pkt != NULL && slot->ev.pkt != slot->pkt)
+    sl_release (slot->ev.pkt);
+  slot->ev.pkt = NULL;
+
+  return;
+}
+
 static void flush_radio_queue (void) {
-  int i;
-
-  for (i = 0; i < RADIO_QUEUE_LEN; i++) {
-    if (radio_evt[i] != NULL)
-        free (radio_evt[i]);
-    radio_evt[i] = NULL;
-    if (radio_pkt[i] != NULL)
-        free (radio_pkt[i]);
-    radio_pkt[i] = NULL;
-  }
+  uint32_t head;
 
-  prod_idx = 0;
-  cons_idx = 0;
-  queue_cnt = 0;
+  head = __atomic_load_n (&radio_head, __ATOMIC_ACQUIRE);
+  while (radio_tail != head) {
+    radio_slot_release (&radio_ring[radio_tail & (RADIO_QUEUE_LEN - 1)]);
+    __atomic_store_n (&radio_tail, radio_tail + 1, __ATOMIC_RELEASE);
+  }
 
   return;
 }
+
 void orchardAppRadioCallback (OrchardAppRadioEventType type,
   ble_evt_t * evt, void * pkt, uint16_t len) {
 
-  OrchardAppRadioEvent * r_evt;
+  radio_slot * slot;
+  uint32_t head;
+  uint32_t used;
 
   if (instance.context == NULL)
     return;
 
   /*
-   * We buffer the current frame. If another frame arrives before
-   * the app has processed it, then we drop the new frame. We could
-   * expand this to permit buffering of more frames, but for now
-   * this seems sufficient.
+   * If the app has fallen so far behind that the ring is full,
+   * the new event is dropped and counted.
    */
 
-  if (queue_cnt < RADIO_QUEUE_LEN) {
-    r_evt = malloc (sizeof(OrchardAppRadioEvent));
-    memset (r_evt, 0, sizeof(OrchardAppRadioEvent));
-    radio_evt[prod_idx] = r_evt;
+  head = radio_head;
+  used = head - __atomic_load_n (&radio_tail, __ATOMIC_ACQUIRE);
+  if (used == RADIO_QUEUE_LEN) {
+    radio_stats.drop_full++;
+    return;
+  }
 
-    r_evt->type = type;
+  slot = &radio_ring[head & (RADIO_QUEUE_LEN - 1)];
+  slot->ev.type = type;
+  slot->ev.pkt = NULL;
+  slot->ev.pktlen = 0;
+
+  if (pkt != NULL && len != 0) {
+    if (len <= RADIO_PKT_INLINE)
+      slot->ev.pkt = slot->pkt;
+    else if ((slot->ev.pkt = sl_alloc (len)) == NULL) {
+      radio_stats.drop_nomem++;
+      return;
+    }
+    memcpy (slot->ev.pkt, pkt, len);
+    slot->ev.pktlen = len;
+  }
 
-    if (pkt != NULL && len != 0)
-      {
-      radio_pkt[prod_idx] = malloc (len);
-      r_evt->pkt = radio_pkt[prod_idx];
-      memcpy (r_evt->pkt, pkt, len);
-      r_evt->pktlen = len;
-      }
+  if (evt != NULL)
+    memcpy (&slot->ev.evt, evt, sizeof(ble_evt_t));
+  else
+    memset (&slot->ev.evt, 0, sizeof(ble_evt_t));
 
-    if (evt != NULL)
-      memcpy (&r_evt->evt, evt, sizeof(ble_evt_t));
-    queue_cnt++;
-    prod_idx++;
-    if (prod_idx == RADIO_QUEUE_LEN)
-        prod_idx = 0;
-  } else
-    return;
+  __atomic_store_n (&radio_head, head + 1, __ATOMIC_RELEASE);
+
+  radio_stats.queued++;
+  if (used + 1 > radio_stats.hiwat)
+    radio_stats.hiwat = used + 1;
 
   chEvtBroadcast (&orchard_app_radio);
 
   return;
 }
 
+/*
+ * Fill evts with pointers to up to max pending radio events, oldest
+ * first, and return how many there are. The events stay in the ring
+ * until orchardAppRadioRelease() is called, so nothing is copied.
+ */
+int orchardAppRadioDrain (OrchardAppRadioEvent ** evts, int max) {
+  uint32_t head;
+  uint32_t tail;
+  int n = 0;
+
+  head = __atomic_load_n (&radio_head, __ATOMIC_ACQUIRE);
+  tail = radio_tail;
+
+  while (tail != head && n < max) {
+    evts[n++] = &radio_ring[tail & (RADIO_QUEUE_LEN - 1)].ev;
+    tail++;
+  }
+
+  return (n);
+}
+
+/* Hand the oldest cnt drained events back to the ring. */
+void orchardAppRadioRelease (int cnt) {
+  uint32_t head;
+
+  head = __atomic_load_n (&radio_head, __ATOMIC_ACQUIRE);
+  while (cnt-- && radio_tail != head) {
+    radio_slot_release (&radio_ring[radio_tail & (RADIO_QUEUE_LEN - 1)]);
+    __atomic_store_n (&radio_tail, radio_tail + 1, __ATOMIC_RELEASE);
+  }
+
+  return;
+}
+
+void orchardAppRadioStatsGet (OrchardAppRadioStats * stats) {
+  memcpy (stats, &radio_stats, sizeof(OrchardAppRadioStats));
+  stats->pending = __atomic_load_n (&radio_head, __ATOMIC_ACQUIRE) -
+      radio_tail;
+
+  return;
+}
+
 static void radio_event(eventid_t id) {
   OrchardAppEvent evt;
+  OrchardAppRadioEvent * batch[RADIO_BATCH_LEN];
   OrchardAppRadioEvent * r_evt;
+  int i, n;
   bool r;
 
   (void) id;
 
   if (instance.context != NULL) {
     evt.type = radioEvent;
-    while (queue_cnt) {
 
-        r_evt = radio_evt[cons_idx];
+    /*
+     * Take everything that's pending in one go, and go around again
+     * if more arrived while we were busy.
+     */
+
+    while ((n = orchardAppRadioDrain (batch, RADIO_BATCH_LEN)) != 0) {
+      radio_stats.batches++;
+      if ((uint32_t)n > radio_stats.max_batch)
+        radio_stats.max_batch = n;
+
+      for (i = 0; i < n; i++) {
+        r_evt = batch[i];
 
         /*
          * When someone writes to one of our characteristics, it could
          * be a notification of some kind (e.g. chat request). If no
-      	 * other app is running besides the launcher, run the notify
-      	 * app to announce what happened.
-      	 */
+         * other app is running besides the launcher, run the notify
+         * app to announce what happened.
+         */
 
         r = FALSE;
 
@@ -187,18 +268,9 @@ static void radio_event(eventid_t id) {
           memcpy (&evt.radio, r_evt, sizeof(OrchardAppRadioEvent));
           instance.app->event (instance.context, &evt);
         }
+      }
 
-        free (radio_evt[cons_idx]);
-        if (radio_pkt[cons_idx] != NULL)
-            free (radio_pkt[cons_idx]);
-        radio_evt[cons_idx] = NULL;
-        radio_pkt[cons_idx] = NULL;
-
-        queue_cnt--;
-
-        cons_idx++;
-        if (cons_idx == RADIO_QUEUE_LEN)
-            cons_idx = 0;
+      orchardAppRadioRelease (n);
     }
   }
 
@@ -471,6 +543,8 @@ void orchardAppInit(void) {
   chEvtObjectInit(&orchard_app_key);
   chVTReset(&instance.timer);
 
+  sl_init();
+
   current = orchard_app_list;
   while (current->name) {
     if (current->flags & APP_FLAG_AUTOINIT)
@@ -40,6 +40,17 @@ extern event_source_t orchard_app_terminated;
 // Emitted to the system after a UI dialog is completed
 extern event_source_t ui_completed;
 
+/* Radio event queue counters, for the "radio stats" command */
+typedef struct _OrchardAppRadioStats {
+  uint32_t queued;	/* events accepted */
+  uint32_t drop_full;	/* dropped because the ring was full */
+  uint32_t drop_nomem;	/* dropped because a large packet got no slab */
+  uint32_t batches;	/* wakeups that drained events */
+  uint32_t max_batch;	/* most events drained in one go */
+  uint32_t hiwat;	/* most events ever pending */
+  uint32_t pending;	/* events pending right now */
+} OrchardAppRadioStats;
+
 extern void orchardAppInit(void);
 extern void orchardAppRestart(void);
 extern void orchardAppWatchdog(void);
@@ -52,6 +63,9 @@ extern void orchardAppTimer(const OrchardAppContext *context,
 extern void orchardAppUgfxCallback (void * arg, GEvent * pe);
 extern void orchardAppRadioCallback (OrchardAppRadioEventType type,
     ble_evt_t * evt, void * pkt, uint16_t pktlen);
+extern int orchardAppRadioDrain (OrchardAppRadioEvent ** evts, int max);
+extern void orchardAppRadioRelease (int cnt);
+extern void orchardAppRadioStatsGet (OrchardAppRadioStats * stats);
 
 extern bool (*app_radio_notify)(void *);
 
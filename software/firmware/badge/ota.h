@@ -0,0 +1,102 @@
+/*-
+ * Copyright (c) 2019
+ *      Bill Paul <wpaul@windriver.com>.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed by Bill Paul.
+ * 4. Neither the name of the author nor the names of any co-contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Bill Paul AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL Bill Paul OR THE VOICES IN HIS HEAD
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _OTA_H_
+#define _OTA_H_
+
+/*
+ * Firmware transfer protocol used over the OTA L2CAP channel
+ *
+ * Every packet starts with an ota_hdr_t. The sender opens with
+ * OTA_OP_START, giving the size and CRC of the whole image. The
+ * receiver answers with an OTA_OP_ACK whose offset says where to
+ * begin: zero for a new transfer, or how far it got last time if it
+ * already holds part of the same image.
+ *
+ * The sender then keeps up to OTA_WINDOW OTA_OP_DATA packets in
+ * flight. Each one carries its offset in the image and the CRC of
+ * its own payload. The receiver acknowledges cumulatively once data
+ * has been handed to the SD card. If a chunk arrives damaged or out
+ * of order, the receiver drops it and sends one OTA_OP_NAK giving
+ * the offset it wants next, and the sender goes back and resends
+ * from there. The sender does the same if nothing is acknowledged
+ * for OTA_TIMEOUT milliseconds.
+ *
+ * When the whole image is in and its CRC matches, the last ACK has
+ * OTA_ACK_DONE set. If the CRC doesn't match, the receiver sends
+ * OTA_OP_FAIL and throws its copy away.
+ */
+
+#define OTA_OP_START	0x01
+#define OTA_OP_DATA	0x02
+#define OTA_OP_ACK	0x03
+#define OTA_OP_NAK	0x04
+#define OTA_OP_FAIL	0x05
+
+#define OTA_ACK_DONE	0x01
+
+typedef struct ota_hdr {
+	uint8_t		ota_op;
+	uint8_t		ota_flags;
+	uint16_t	ota_len;	/* Payload length (DATA) */
+	uint32_t	ota_off;	/* Offset in the image */
+	uint32_t	ota_crc;	/* Payload CRC (DATA), image CRC (START) */
+	uint32_t	ota_size;	/* Image size */
+} ota_hdr_t;
+
+#define OTA_PKT		BLE_IDES_L2CAP_MTU
+#define OTA_CHUNK	(OTA_PKT - sizeof(ota_hdr_t))
+
+#define OTA_WINDOW	4	/* Chunks in flight */
+#define OTA_TIMEOUT	2000	/* Milliseconds before going back */
+
+/* Transfer counters, for the "ota" command */
+
+typedef struct ota_stats {
+	uint32_t	st_size;	/* Image size */
+	uint32_t	st_resume;	/* Offset we started from */
+	uint32_t	st_off;		/* Offset acknowledged so far */
+	uint32_t	st_chunks;	/* Chunks sent or accepted */
+	uint32_t	st_retx;	/* Chunks sent more than once */
+	uint32_t	st_naks;	/* NAKs sent or received */
+	uint32_t	st_timeouts;	/* Go-backs due to no progress */
+	uint32_t	st_badcrc;	/* Chunks that failed their CRC */
+	systime_t	st_start;
+	systime_t	st_end;
+} OTA_STATS;
+
+extern OTA_STATS ota_tx_stats;
+extern OTA_STATS ota_rx_stats;
+
+extern uint32_t otaRate (OTA_STATS *);
+
+#endif /* _OTA_H_ */
@@ -0,0 +1,434 @@
+/*-
+ * Copyright (c) 2019
+ *      Bill Paul <wpaul@windriver.com>.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed by Bill Paul.
+ * 4. Neither the name of the author nor the names of any co-contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Bill Paul AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL Bill Paul OR THE VOICES IN HIS HEAD
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "sdbench.h"
+
+static const UINT sdbench_chunks[] = { 512, 1024, 2048, 4096, 8192 };
+
+#define SDBENCH_NCHUNKS	(sizeof(sdbench_chunks) / sizeof(UINT))
+
+/* Room in the cluster link map for this many fragments */
+
+#define SDBENCH_FRAGS	32
+#define SDBENCH_MAP_LEN	(2 + (SDBENCH_FRAGS * 2))
+
+typedef struct sdbench_ctx {
+	FIL		sc_f;
+	uint8_t *	sc_buf;
+	uint32_t *	sc_samples;
+	DWORD		sc_map[SDBENCH_MAP_LEN];	/* FatFs CLMT */
+	uint32_t	sc_size;
+	uint32_t	sc_seed;
+	uint32_t	sc_flags;
+} SDBENCH_CTX;
+
+typedef int (*SDBENCH_TEST)(SDBENCH_CTX *, UINT, SDBENCH_RESULT *);
+
+/*
+ * Our own generator, so the random tests hit the same offsets
+ * on every platform and every run.
+ */
+
+static uint32_t
+sdbenchRand (SDBENCH_CTX * c)
+{
+	c->sc_seed = c->sc_seed * 1103515245 + 12345;
+	return (c->sc_seed >> 8);
+}
+
+static int
+sdbenchCmp (const void * a, const void * b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+static void
+sdbenchSample (SDBENCH_CTX * c, SDBENCH_RESULT * r, uint32_t us, UINT bytes)
+{
+	int b;
+
+	if (r->sb_reqs < SDBENCH_SAMPLES)
+		c->sc_samples[r->sb_reqs] = us;
+	r->sb_reqs++;
+	r->sb_bytes += bytes;
+	if (us > r->sb_max)
+		r->sb_max = us;
+
+	/* Bucket b holds latencies below 2^(b+1) microseconds */
+
+	for (b = 0; b < SDBENCH_BUCKETS - 1 && (us >> (b + 1)) != 0; b++)
+		;
+	r->sb_hist[b]++;
+
+	return;
+}
+
+static void
+sdbenchFinish (SDBENCH_CTX * c, SDBENCH_RESULT * r)
+{
+	uint32_t n;
+
+	n = r->sb_reqs;
+	if (n > SDBENCH_SAMPLES)
+		n = SDBENCH_SAMPLES;
+	if (n == 0)
+		return;
+
+	qsort (c->sc_samples, n, sizeof(uint32_t), sdbenchCmp);
+	r->sb_p50 = c->sc_samples[((n - 1) * 50) / 100];
+	r->sb_p99 = c->sc_samples[((n - 1) * 99) / 100];
+
+	return;
+}
+
+static uint32_t
+sdbenchSeqLimit (SDBENCH_CTX * c, UINT chunk)
+{
+	uint32_t limit;
+
+	limit = c->sc_size;
+	if (limit > SDBENCH_SEQ_BYTES)
+		limit = SDBENCH_SEQ_BYTES;
+
+	return (limit - (limit % chunk));
+}
+
+static int
+sdbenchFatSeq (SDBENCH_CTX * c, UINT chunk, SDBENCH_RESULT * r)
+{
+	uint32_t limit, t;
+	UINT br;
+
+	limit = sdbenchSeqLimit (c, chunk);
+	if (f_lseek (&c->sc_f, 0) != FR_OK)
+		return (-1);
+
+	while (r->sb_bytes < limit) {
+		t = sdbenchMicros ();
+		if (f_read (&c->sc_f, c->sc_buf, chunk, &br) != FR_OK ||
+		    br != chunk)
+			return (-1);
+		sdbenchSample (c, r, sdbenchMicros () - t, br);
+	}
+
+	return (0);
+}
+
+/*
+ * Find the sector that holds byte off of the file using the cluster
+ * link map, and how many sectors follow it in the same fragment.
+ * The map is laid out as FatFs leaves it: the table size, then a
+ * cluster count and first cluster for each fragment, then a zero.
+ */
+
+static DWORD
+sdbenchMap (SDBENCH_CTX * c, uint32_t off, UINT * run)
+{
+	FATFS * fs;
+	DWORD * t;
+	DWORD cl, sect;
+
+	fs = c->sc_f.obj.fs;
+	cl = off / (fs->csize * 512);
+	sect = (off / 512) % fs->csize;
+
+	for (t = c->sc_map + 1; t[0] != 0; t += 2) {
+		if (cl < t[0])
+			break;
+		cl -= t[0];
+	}
+
+	/* off is always inside the file, so we never hit the end */
+
+	*run = ((t[0] - cl) * fs->csize) - sect;
+
+	return (fs->database + ((t[1] + cl - 2) * fs->csize) + sect);
+}
+
+/* Read chunk bytes at off, with one disk_read() per fragment it spans */
+
+static int
+sdbenchRawRead (SDBENCH_CTX * c, uint32_t off, UINT chunk)
+{
+	uint8_t * p;
+	UINT n, run;
+	DWORD sect;
+
+	p = c->sc_buf;
+	for (n = chunk / 512; n > 0; n -= run) {
+		sect = sdbenchMap (c, off, &run);
+		if (run > n)
+			run = n;
+		if (disk_read (c->sc_f.obj.fs->pdrv, p, sect, run) != RES_OK)
+			return (-1);
+		p += run * 512;
+		off += run * 512;
+	}
+
+	return (0);
+}
+
+static int
+sdbenchRawSeq (SDBENCH_CTX * c, UINT chunk, SDBENCH_RESULT * r)
+{
+	uint32_t limit, t;
+
+	limit = sdbenchSeqLimit (c, chunk);
+
+	while (r->sb_bytes < limit) {
+		t = sdbenchMicros ();
+		if (sdbenchRawRead (c, r->sb_bytes, chunk) != 0)
+			return (-1);
+		sdbenchSample (c, r, sdbenchMicros () - t, chunk);
+	}
+
+	return (0);
+}
+
+/* Random chunk-aligned reads; the time includes the seek. */
+
+static int
+sdbenchFatRand (SDBENCH_CTX * c, UINT chunk, SDBENCH_RESULT * r)
+{
+	uint32_t i, off, t;
+	UINT br;
+
+	for (i = 0; i < SDBENCH_RAND_REQS; i++) {
+		off = (sdbenchRand (c) % (c->sc_size / chunk)) * chunk;
+		t = sdbenchMicros ();
+		if (f_lseek (&c->sc_f, off) != FR_OK ||
+		    f_read (&c->sc_f, c->sc_buf, chunk, &br) != FR_OK ||
+		    br != chunk)
+			return (-1);
+		sdbenchSample (c, r, sdbenchMicros () - t, br);
+	}
+
+	return (0);
+}
+
+static int
+sdbenchRawRand (SDBENCH_CTX * c, UINT chunk, SDBENCH_RESULT * r)
+{
+	uint32_t i, off, t;
+
+	for (i = 0; i < SDBENCH_RAND_REQS; i++) {
+		off = (sdbenchRand (c) % (c->sc_size / chunk)) * chunk;
+		t = sdbenchMicros ();
+		if (sdbenchRawRead (c, off, chunk) != 0)
+			return (-1);
+		sdbenchSample (c, r, sdbenchMicros () - t, chunk);
+	}
+
+	return (0);
+}
+
+static uint32_t
+sdbenchRate (SDBENCH_RESULT * r)
+{
+	if (r->sb_us == 0)
+		return (0);
+
+	return ((uint32_t)(((uint64_t)r->sb_bytes * 1000000 / r->sb_us) /
+	    1024));
+}
+
+static int
+sdbenchTest (SDBENCH_CTX * c, char * name, SDBENCH_TEST test, UINT chunk,
+	SDBENCH_RESULT * r)
+{
+	uint32_t t;
+	int b;
+
+	memset (r, 0, sizeof(SDBENCH_RESULT));
+
+	if (c->sc_size < chunk)
+		return (0);
+
+	t = sdbenchMicros ();
+	if (test (c, chunk, r) != 0) {
+		printf ("%-10s %5u  read failed\n", name, chunk);
+		return (-1);
+	}
+	r->sb_us = sdbenchMicros () - t;
+
+	sdbenchFinish (c, r);
+
+	printf ("%-10s %5u %8lu %5lu %7lu %7lu %7lu\n", name, chunk,
+	    (unsigned long)sdbenchRate (r), (unsigned long)r->sb_reqs,
+	    (unsigned long)r->sb_p50, (unsigned long)r->sb_p99,
+	    (unsigned long)r->sb_max);
+
+	if (c->sc_flags & SDBENCH_VERBOSE) {
+		printf ("   ");
+		for (b = 0; b < SDBENCH_BUCKETS; b++) {
+			if (r->sb_hist[b])
+				printf (" <%lu:%lu", 2UL << b,
+				    (unsigned long)r->sb_hist[b]);
+		}
+		printf ("\n");
+	}
+
+	return (0);
+}
+
+int
+sdbenchRun (const char * name, uint32_t flags)
+{
+	SDBENCH_CTX * c;
+	SDBENCH_RESULT * r;
+	SDBENCH_RESULT * raw;
+	SDBENCH_RESULT * fat;
+	FATFS * fs;
+	uint32_t rr, fr;
+	unsigned int i;
+	FRESULT res;
+	int err;
+
+	c = malloc (sizeof(SDBENCH_CTX));
+	r = malloc (sizeof(SDBENCH_RESULT) * (SDBENCH_NCHUNKS * 2 + 1));
+	if (c != NULL) {
+		c->sc_buf = malloc (SDBENCH_MAX_CHUNK);
+		c->sc_samples = malloc (sizeof(uint32_t) * SDBENCH_SAMPLES);
+	}
+
+	if (c == NULL || r == NULL || c->sc_buf == NULL ||
+	    c->sc_samples == NULL) {
+		printf ("Out of memory\n");
+		err = -1;
+		goto out;
+	}
+
+	c->sc_seed = 1;
+	c->sc_flags = flags;
+
+	if (f_open (&c->sc_f, name, FA_READ) != FR_OK) {
+		printf ("Opening %s failed\n", name);
+		err = -1;
+		goto out;
+	}
+
+	fs = c->sc_f.obj.fs;
+	c->sc_size = f_size (&c->sc_f);
+	if (c->sc_size < 512 || c->sc_f.obj.sclust < 2) {
+		printf ("%s is too small\n", name);
+		f_close (&c->sc_f);
+		err = -1;
+		goto out;
+	}
+
+	/*
+	 * The raw tests follow the file's clusters through a link map,
+	 * so they read the same sectors FatFs does even if the file is
+	 * fragmented. The map is only ours: FatFs reads the file the
+	 * normal way.
+	 */
+
+	c->sc_map[0] = SDBENCH_MAP_LEN;
+	c->sc_f.cltbl = c->sc_map;
+	res = f_lseek (&c->sc_f, CREATE_LINKMAP);
+	c->sc_f.cltbl = NULL;
+	if (res != FR_OK) {
+		if (res == FR_NOT_ENOUGH_CORE)
+			printf ("%s has more than %d fragments\n", name,
+			    SDBENCH_FRAGS);
+		else
+			printf ("Mapping %s failed\n", name);
+		f_close (&c->sc_f);
+		err = -1;
+		goto out;
+	}
+
+	printf ("%s: %lu bytes in %lu fragments, cluster %u sectors\n", name,
+	    (unsigned long)c->sc_size, (unsigned long)(c->sc_map[0] - 2) / 2,
+	    fs->csize);
+	printf ("test       chunk     KB/s  reqs     p50     p99     max"
+	    " (us)\n");
+
+	raw = r;
+	fat = r + SDBENCH_NCHUNKS;
+	err = 0;
+
+	for (i = 0; i < SDBENCH_NCHUNKS && err == 0; i++) {
+		err = sdbenchTest (c, "raw seq", sdbenchRawSeq,
+		    sdbench_chunks[i], &raw[i]);
+		if (err == 0)
+			err = sdbenchTest (c, "fatfs seq", sdbenchFatSeq,
+			    sdbench_chunks[i], &fat[i]);
+	}
+
+	for (i = 0; i < SDBENCH_NCHUNKS && err == 0; i += 3) {
+		err = sdbenchTest (c, "raw rand", sdbenchRawRand,
+		    sdbench_chunks[i], &r[SDBENCH_NCHUNKS * 2]);
+		if (err == 0)
+			err = sdbenchTest (c, "fatfs rand", sdbenchFatRand,
+			    sdbench_chunks[i], &r[SDBENCH_NCHUNKS * 2]);
+	}
+
+	/* How much of the raw sequential rate FatFs gives away */
+
+	if (err == 0) {
+		printf ("fatfs overhead:");
+		for (i = 0; i < SDBENCH_NCHUNKS; i++) {
+			rr = sdbenchRate (&raw[i]);
+			fr = sdbenchRate (&fat[i]);
+			if (rr == 0)
+				continue;
+			printf (" %u:%ld%%", sdbench_chunks[i],
+			    (long)(((int32_t)rr - (int32_t)fr) * 100 /
+			    (int32_t)rr));
+		}
+		printf ("\n");
+	}
+
+	f_close (&c->sc_f);
+
+out:
+	if (c != NULL) {
+		free (c->sc_samples);
+		free (c->sc_buf);
+	}
+	free (c);
+	free (r);
+
+	return (err);
+}
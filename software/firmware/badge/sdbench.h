@@ -0,0 +1,70 @@
+/*-
+ * Copyright (c) 2019
+ *      Bill Paul <wpaul@windriver.com>.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed by Bill Paul.
+ * 4. Neither the name of the author nor the names of any co-contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Bill Paul AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL Bill Paul OR THE VOICES IN HIS HEAD
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SDBENCH_H_
+#define _SDBENCH_H_
+
+/*
+ * SD card benchmark
+ *
+ * This only talks to FatFs and the diskio layer, so the same code
+ * runs on the badge (the "sdbench" command) and on a PC against a
+ * card image (tools/src/sdbench.c), and the numbers from the two can
+ * be compared directly. The platform supplies sdbenchMicros().
+ *
+ * Each test reads from one file, either through f_read() or with
+ * raw disk_read() calls on the sectors the file starts at, and
+ * records how long every request took.
+ */
+
+#define SDBENCH_SEQ_BYTES	262144	/* Per sequential test */
+#define SDBENCH_RAND_REQS	128	/* Per random test */
+#define SDBENCH_MAX_CHUNK	8192
+#define SDBENCH_SAMPLES		512	/* Latencies kept for percentiles */
+#define SDBENCH_BUCKETS		24	/* log2 microsecond histogram */
+
+#define SDBENCH_VERBOSE		0x01	/* Print latency histograms */
+
+typedef struct sdbench_result {
+	uint32_t	sb_bytes;
+	uint32_t	sb_us;
+	uint32_t	sb_reqs;
+	uint32_t	sb_p50;
+	uint32_t	sb_p99;
+	uint32_t	sb_max;
+	uint32_t	sb_hist[SDBENCH_BUCKETS];
+} SDBENCH_RESULT;
+
+extern uint32_t sdbenchMicros (void);
+extern int sdbenchRun (const char * name, uint32_t flags);
+
+#endif /* _SDBENCH_H_ */
@@ -79,8 +79,8 @@ typedef struct {
 } ship_type_t;
 
 typedef struct ship_init_pos {
-  VECTOR attacker;
-  VECTOR defender;
+  IVECTOR attacker;
+  IVECTOR defender;
 } ship_init_pos_t;
 
 #define SHIP_INIT_POS_COUNT 16
@@ -3,39 +3,171 @@
 #include "slaballoc.h"
 #include "ch.h"
 
-/* tiny allocator for transmit buffer memory */
-TXBUF  slabs[MAX_SLABS];
+/* tiny allocator for fixed size buffers */
 
-void sl_init(void) {
+/* general purpose size classes, smallest first */
+SLAB_POOL_DECL(sl_class_32, "32", 32, 16);
+SLAB_POOL_DECL(sl_class_64, "64", 64, 16);
+SLAB_POOL_DECL(sl_class_256, "256", 256, 8);
+SLAB_POOL_DECL(sl_class_1024, "1024", 1024, 6);
+
+static SLAB_POOL * sl_classes[] = {
+  &sl_class_32,
+  &sl_class_64,
+  &sl_class_256,
+  &sl_class_1024
+};
+
+#define SL_CLASSES (sizeof(sl_classes) / sizeof(sl_classes[0]))
+
+/* every pool that has been initialized, for the stats command */
+static SLAB_POOL * sl_pools[SL_MAX_POOLS];
+static int sl_npools;
+
+static uint32_t
+sl_head(uint32_t old, uint16_t idx)
+{
+  return(((old + 0x10000) & 0xFFFF0000) | idx);
+}
+
+/*
+ * (Re)build the free list. Nothing may be allocated from the pool
+ * while this runs, and anything that was is forgotten.
+ */
+void
+sl_pool_init(SLAB_POOL *p)
+{
   int i;
-  for (i=0; i < MAX_SLABS;i++) {
-    slabs[i].active = FALSE;
-    memset(&(slabs[i].txb_data), 0, sizeof(slabs[i].txb_data));
+
+  for (i = 0; i < p->count - 1; i++)
+    p->next[i] = i + 1;
+  p->next[p->count - 1] = SL_NONE;
+
+  p->used = 0;
+  p->head = sl_head(p->head, 0);
+
+  chSysLock();
+  for (i = 0; i < sl_npools; i++)
+  {
+    if (sl_pools[i] == p)
+      break;
   }
+  if (i == sl_npools && sl_npools < SL_MAX_POOLS)
+    sl_pools[sl_npools++] = p;
+  chSysUnlock();
 }
 
-uint8_t *sl_alloc(void) {
-  int i;
+void *
+sl_pool_alloc(SLAB_POOL *p)
+{
+  uint32_t old, new;
+  uint16_t idx, used, hiwat;
 
-  for (i=0; i < MAX_SLABS;i++) {
-    if (slabs[i].active == FALSE) {
-      memset(&(slabs[i].txb_data), 0, sizeof(slabs[i].txb_data));
-      slabs[i].active = TRUE;
-      //printf("slalloc = %p\n", (void *) &(slabs[i].txb_data[0]));
-      return(&(slabs[i].txb_data[0]));
+  old = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+  do {
+    idx = old & 0xFFFF;
+    if (idx == SL_NONE)
+    {
+      __atomic_fetch_add(&p->fails, 1, __ATOMIC_RELAXED);
+      return(NULL);
     }
+    /*
+     * next[idx] may be stale if someone else took idx first, but
+     * then the tag has moved on and the swap fails.
+     */
+    new = sl_head(old, p->next[idx]);
+  } while (!__atomic_compare_exchange_n(&p->head, &old, new, TRUE,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+  __atomic_fetch_add(&p->allocs, 1, __ATOMIC_RELAXED);
+  used  = __atomic_add_fetch(&p->used, 1, __ATOMIC_RELAXED);
+  hiwat = __atomic_load_n(&p->hiwat, __ATOMIC_RELAXED);
+  while (used > hiwat &&
+         !__atomic_compare_exchange_n(&p->hiwat, &hiwat, used, TRUE,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+
+  return(&p->mem[idx * p->size]);
+}
+
+void
+sl_pool_free(SLAB_POOL *p, void *blk)
+{
+  uint32_t old, new;
+  uint16_t idx;
+
+  idx = ((uint8_t *)blk - p->mem) / p->size;
+
+  /* count it gone before it can be handed out again */
+  __atomic_sub_fetch(&p->used, 1, __ATOMIC_RELAXED);
+
+  old = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+  do {
+    p->next[idx] = old & 0xFFFF;
+    new = sl_head(old, idx);
+  } while (!__atomic_compare_exchange_n(&p->head, &old, new, TRUE,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+/* set up the size classes; called once at boot */
+void
+sl_init(void)
+{
+  unsigned int i;
+
+  for (i = 0; i < SL_CLASSES; i++)
+    sl_pool_init(sl_classes[i]);
+}
+
+/*
+ * Allocate from the smallest class that len fits in, moving up a
+ * class if that one is empty.
+ */
+void *
+sl_alloc(size_t len)
+{
+  unsigned int i;
+  void *p;
+
+  for (i = 0; i < SL_CLASSES; i++)
+  {
+    if (len > sl_classes[i]->size)
+      continue;
+    if ((p = sl_pool_alloc(sl_classes[i])) != NULL)
+      return(p);
   }
 
   /* we failed to find memory */
-  return NULL;
+  return(NULL);
 }
 
-void sl_release(uint8_t *p) {
-  /* we expect to receive a pointer here from the tx complete event */
-  /* if we go back one byte we'll be pointing to the start of the struct */
-  TXBUF *t;
+void
+sl_release(void *blk)
+{
+  unsigned int i;
+  SLAB_POOL *p;
+
+  for (i = 0; i < SL_CLASSES; i++)
+  {
+    p = sl_classes[i];
+    if ((uint8_t *)blk >= p->mem &&
+        (uint8_t *)blk < p->mem + (p->size * p->count))
+    {
+      sl_pool_free(p, blk);
+      return;
+    }
+  }
+
+  printf("sl_release: %p is not a slab\n", blk);
+}
+
+int
+sl_pool_list(SLAB_POOL **list, int max)
+{
+  int i;
+
+  for (i = 0; i < sl_npools && i < max; i++)
+    list[i] = sl_pools[i];
 
-  t = (TXBUF *)(p-1);
-  //printf("slrelease = %p\n", (void *) t);
-  t->active = FALSE;
+  return(i);
 }
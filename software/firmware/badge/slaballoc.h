@@ -1,15 +1,60 @@
 #ifndef _SLABALLOC_H_
 #define _SLABALLOC_H_
-#define MAX_SLABS 16
 
-typedef struct _txbuf {
-   uint8_t     active;
-   uint8_t     txb_data[64];
-} TXBUF;
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Fixed size block pools. Each pool is a static array of equal sized
+ * blocks with a free list threaded through a parallel array of
+ * indexes. The free list head carries a tag that changes on every
+ * update, so alloc and free can be done with a compare-and-swap and
+ * are safe to call from SoftDevice callbacks and interrupts as well
+ * as threads.
+ *
+ * Pools are declared with SLAB_POOL_DECL() and must be set up with
+ * sl_pool_init() before use. sl_alloc()/sl_release() pick from a set
+ * of general purpose size classes.
+ */
+
+#define SL_NONE         0xFFFF
+#define SL_MAX_POOLS    12
+
+typedef struct _slab_pool {
+  const char *        name;
+  uint16_t            size;     /* bytes per block */
+  uint16_t            count;    /* number of blocks */
+  uint8_t *           mem;
+  uint16_t *          next;     /* free list links */
+  volatile uint32_t   head;     /* tag << 16 | first free block */
+  volatile uint16_t   used;
+  volatile uint16_t   hiwat;    /* most blocks ever in use at once */
+  volatile uint32_t   allocs;
+  volatile uint32_t   fails;
+} SLAB_POOL;
+
+#define SL_ROUNDUP(x)   (((x) + 3) & ~3)
+
+#define SLAB_POOL_DECL(var, _name, _size, _count)                     \
+  static uint8_t var##_mem[SL_ROUNDUP(_size) * (_count)]              \
+      __attribute__((aligned(4)));                                    \
+  static uint16_t var##_next[_count];                                 \
+  SLAB_POOL var = {                                                   \
+    .name  = _name,                                                   \
+    .size  = SL_ROUNDUP(_size),                                       \
+    .count = _count,                                                  \
+    .mem   = var##_mem,                                               \
+    .next  = var##_next,                                              \
+  }
+
+extern void sl_pool_init(SLAB_POOL *p);
+extern void *sl_pool_alloc(SLAB_POOL *p);
+extern void sl_pool_free(SLAB_POOL *p, void *blk);
 
-extern void sl_release(uint8_t *p);
 extern void sl_init(void);
-extern uint8_t *sl_alloc(void);
-extern TXBUF  slabs[MAX_SLABS];
+extern void *sl_alloc(size_t len);
+extern void sl_release(void *blk);
+
+extern int sl_pool_list(SLAB_POOL **list, int max);
 
 #endif /* _SLABALLOC_H_ */
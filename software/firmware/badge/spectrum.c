@@ -0,0 +1,500 @@
+/*-
+ * Copyright (c) 2019
+ *      Bill Paul <wpaul@windriver.com>.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed by Bill Paul.
+ * 4. Neither the name of the author nor the names of any co-contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Bill Paul AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL Bill Paul OR THE VOICES IN HIS HEAD
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This module turns blocks of audio samples into smoothed levels for
+ * a handful of log-spaced frequency bands, and draws them as columns.
+ * The music player uses it for both the screen and the LEDs; the RF
+ * spectrum app uses the smoothing and the column drawing on its own.
+ *
+ * Everything that runs per block is integer arithmetic. The window
+ * and band edges need a little floating point, but only once, in
+ * spectrumInit().
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "gfx.h"
+
+#include "orchard-app.h"
+#include "ides_gfx.h"
+
+#include "fix_fft.h"
+#include "dds.h"
+#include "spectrum.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Hann window, first half; the second half is the mirror image */
+
+static uint16_t spectrum_hann[SPECTRUM_POINTS / 2 + 1];
+static int spectrum_hann_ok;
+
+/* Sinewave[] holds one 1024 point cycle; this is our step through it */
+
+#define SPECTRUM_SINE_SHIFT	(10 - SPECTRUM_LOG2_POINTS)
+
+/******************************************************************************
+*
+* spectrumInit - set up a spectrum analysis
+*
+* This function prepares <sp> to produce <bands> levels from the FFT bins
+* <lobin> up to (but not including) <hibin>. Band edges are spaced
+* logarithmically, except that every band gets at least one bin, so at
+* the low end they may come out linear. All levels start at zero.
+*
+* RETURNS: N/A
+*/
+
+void
+spectrumInit (SPECTRUM * sp, int bands, int lobin, int hibin)
+{
+	float ratio;
+	int edge;
+	int i;
+
+	if (spectrum_hann_ok == 0) {
+		/* sin^2(pi * n / N) is the same as 0.5 - 0.5cos(2pi * n / N) */
+		for (i = 0; i <= SPECTRUM_POINTS / 2; i++) {
+			edge = ddsSine (i * (0x80000000U / SPECTRUM_POINTS));
+			spectrum_hann[i] = (edge * edge) >> 15;
+		}
+		spectrum_hann_ok = 1;
+	}
+
+	if (lobin < 1)
+		lobin = 1;
+	if (hibin > SPECTRUM_BINS)
+		hibin = SPECTRUM_BINS;
+	if (bands > SPECTRUM_BANDS_MAX)
+		bands = SPECTRUM_BANDS_MAX;
+	if (bands > hibin - lobin)
+		bands = hibin - lobin;
+
+	memset (sp->sp_level, 0, sizeof(sp->sp_level));
+	memset (sp->sp_peak, 0, sizeof(sp->sp_peak));
+	memset (sp->sp_hold, 0, sizeof(sp->sp_hold));
+
+	sp->sp_bands = bands;
+	sp->sp_floor = SPECTRUM_FLOOR;
+	sp->sp_range = SPECTRUM_RANGE;
+	sp->sp_decay = SPECTRUM_DECAY;
+	sp->sp_loud = 0;
+
+	ratio = (float)hibin / (float)lobin;
+	sp->sp_edge[0] = lobin;
+
+	for (i = 1; i < bands; i++) {
+		edge = lobin * powf (ratio, (float)i / (float)bands) + 0.5;
+		if (edge <= sp->sp_edge[i - 1])
+			edge = sp->sp_edge[i - 1] + 1;
+		/* leave at least one bin for each band still to come */
+		if (edge > hibin - (bands - i))
+			edge = hibin - (bands - i);
+		sp->sp_edge[i] = edge;
+	}
+
+	sp->sp_edge[bands] = hibin;
+
+	return;
+}
+
+/*
+ * Approximate log2(v) in 1/16ths: the position of the top bit, plus
+ * the next four bits below it as a linear fraction.
+ */
+
+static unsigned int
+spectrumLog2 (uint32_t v)
+{
+	unsigned int msb;
+
+	if (v == 0)
+		return (0);
+
+	msb = 31 - __builtin_clz (v);
+
+	if (msb >= 4)
+		v >>= msb - 4;
+	else
+		v <<= 4 - msb;
+
+	return ((msb << 4) | (v & 0xF));
+}
+
+/******************************************************************************
+*
+* spectrumSmooth - apply attack, decay and peak hold to a set of levels
+*
+* For each of the <cnt> entries, a new level in <in> that is higher than
+* the current one in <level> replaces it at once; a lower one pulls it down
+* by at most <decay>. When <peak> and <hold> are given, <peak> follows the
+* highest level, stays put for SPECTRUM_HOLD calls and then falls at the
+* same rate.
+*
+* RETURNS: N/A
+*/
+
+void
+spectrumSmooth (uint8_t * level, uint8_t * peak, uint8_t * hold,
+    const uint8_t * in, int cnt, uint8_t decay)
+{
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		if (in[i] >= level[i])
+			level[i] = in[i];
+		else if (level[i] - in[i] > decay)
+			level[i] -= decay;
+		else
+			level[i] = in[i];
+
+		if (peak == NULL)
+			continue;
+
+		if (level[i] >= peak[i]) {
+			peak[i] = level[i];
+			hold[i] = SPECTRUM_HOLD;
+		} else if (hold[i])
+			hold[i]--;
+		else if (peak[i] - level[i] > decay)
+			peak[i] -= decay;
+		else
+			peak[i] = level[i];
+	}
+
+	return;
+}
+
+/******************************************************************************
+*
+* spectrumRun - analyse a block of samples
+*
+* This function takes SPECTRUM_POINTS samples from <samples>, <stride>
+* entries apart (2 picks one channel out of interleaved stereo), and
+* updates the band levels and peaks in <sp>.
+*
+* The samples are windowed and packed two to a complex point, evens in
+* the real part and odds in the imaginary part, and transformed with a
+* SPECTRUM_POINTS / 2 point fix_fft(). The two interleaved spectra are
+* then pulled apart and recombined into the first half of the spectrum
+* of the real signal. That's about half the work of running fix_fft()
+* at full size with the imaginary input all zeros.
+*
+* RETURNS: N/A
+*/
+
+void
+spectrumRun (SPECTRUM * sp, const int16_t * samples, int stride)
+{
+	uint8_t raw[SPECTRUM_BANDS_MAX];
+	const int16_t * s;
+	uint32_t max;
+	uint32_t loud;
+	unsigned int l;
+	int ar, ai, br, bi;
+	int er, ei, or, oi;
+	int xr, xi;
+	int c, sn;
+	int i, k;
+	int w;
+
+	/* Window and pack */
+
+	s = samples;
+	for (i = 0; i < SPECTRUM_BINS; i++) {
+		k = i * 2;
+		w = spectrum_hann[k <= SPECTRUM_POINTS / 2 ?
+		    k : SPECTRUM_POINTS - k];
+		sp->sp_re[i] = (s[0] * w) >> 15;
+		k++;
+		w = spectrum_hann[k <= SPECTRUM_POINTS / 2 ?
+		    k : SPECTRUM_POINTS - k];
+		sp->sp_im[i] = (s[stride] * w) >> 15;
+		s += stride * 2;
+	}
+
+	fix_fft (sp->sp_re, sp->sp_im, SPECTRUM_LOG2_POINTS - 1, 0);
+
+	/*
+	 * Split. With Z the half-size transform and b = Z[N/2 - k]:
+	 * the even samples' spectrum is E = (Z[k] + conj(b)) / 2, the
+	 * odd samples' is O = (Z[k] - conj(b)) / 2j, and the real
+	 * signal's is X[k] = E + O * e^(-2 pi j k / N). The half-size
+	 * fix_fft() only scaled by 2/N, so X is halved to come out at
+	 * 1/N like a full-size one.
+	 */
+
+	for (k = 0; k < SPECTRUM_BINS; k++) {
+		i = (SPECTRUM_BINS - k) & (SPECTRUM_BINS - 1);
+		ar = sp->sp_re[k];
+		ai = sp->sp_im[k];
+		br = sp->sp_re[i];
+		bi = sp->sp_im[i];
+
+		er = (ar + br) >> 1;
+		ei = (ai - bi) >> 1;
+		or = (ai + bi) >> 1;
+		oi = (br - ar) >> 1;
+
+		sn = Sinewave[k << SPECTRUM_SINE_SHIFT];
+		c = Sinewave[(k << SPECTRUM_SINE_SHIFT) + 256];
+
+		xr = (er + ((c * or + sn * oi) >> 15)) >> 1;
+		xi = (ei + ((c * oi - sn * or) >> 15)) >> 1;
+
+		/* |x| is close enough to max + 3/8 min */
+
+		if (xr < 0)
+			xr = -xr;
+		if (xi < 0)
+			xi = -xi;
+		if (xr < xi) {
+			w = xr;
+			xr = xi;
+			xi = w;
+		}
+		xr += (xi >> 2) + (xi >> 3);
+		sp->sp_mag[k] = xr > 0xFFFF ? 0xFFFF : xr;
+	}
+
+	/* Gather the bins into bands and put them on a log scale */
+
+	loud = 0;
+	for (i = 0; i < sp->sp_bands; i++) {
+		max = 0;
+		for (k = sp->sp_edge[i]; k < sp->sp_edge[i + 1]; k++) {
+			if (sp->sp_mag[k] > max)
+				max = sp->sp_mag[k];
+		}
+
+		l = spectrumLog2 (max);
+		if (l <= sp->sp_floor)
+			l = 0;
+		else {
+			l = ((l - sp->sp_floor) * SPECTRUM_LEVEL_MAX) /
+			    sp->sp_range;
+			if (l > SPECTRUM_LEVEL_MAX)
+				l = SPECTRUM_LEVEL_MAX;
+		}
+
+		raw[i] = l;
+		loud += l;
+	}
+
+	spectrumSmooth (sp->sp_level, sp->sp_peak, sp->sp_hold, raw,
+	    sp->sp_bands, sp->sp_decay);
+
+	if (sp->sp_bands) {
+		raw[0] = loud / sp->sp_bands;
+		spectrumSmooth (&sp->sp_loud, NULL, NULL, raw, 1,
+		    sp->sp_decay);
+	}
+
+	return;
+}
+
+/******************************************************************************
+*
+* spectrumBarsReset - forget what's on the screen
+*
+* Call this after painting the background under <b>. The next
+* spectrumBarsDraw() will then treat every column as empty.
+*
+* RETURNS: N/A
+*/
+
+void
+spectrumBarsReset (SPECTRUM_BARS * b)
+{
+	memset (b->sb_drawn, 0, sizeof(b->sb_drawn));
+	memset (b->sb_drawnpk, SPECTRUM_NOPEAK, sizeof(b->sb_drawnpk));
+	return;
+}
+
+static color_t
+spectrumBarColor (SPECTRUM_BARS * b, int row, int h, int pk)
+{
+	if (row == pk)
+		return (b->sb_peakcolor);
+	if (row >= h)
+		return (b->sb_bg);
+	if (row < b->sb_zone[0])
+		return (b->sb_color[0]);
+	if (row < b->sb_zone[1])
+		return (b->sb_color[1]);
+	return (b->sb_color[2]);
+}
+
+/*
+ * Columns that change are sent in strips: a run of neighbouring
+ * columns goes out as one window covering all of their changed rows,
+ * built in sb_strip and handed to putPixelBlock(). Folding a column
+ * into the strip means also resending rows that didn't change, plus
+ * the gaps between columns, so a column only joins if that costs no
+ * more than SPECTRUM_STRIP_SLACK extra pixels. Otherwise the strip
+ * goes out and a new one starts.
+ */
+
+static void
+spectrumBarsFlush (SPECTRUM_BARS * b, int first, int last, int lo, int hi)
+{
+	pixel_t * p;
+	color_t c;
+	coord_t cx;
+	int band, top;
+	int i, r, x;
+
+	cx = ((last - first) * b->sb_step) + b->sb_width;
+	band = SPECTRUM_STRIP_PIXELS / cx;
+
+	/* Rows count up from the bottom; the window runs down. */
+
+	while (hi > lo) {
+		top = hi - band;
+		if (top < lo)
+			top = lo;
+		p = b->sb_strip;
+		for (r = hi - 1; r >= top; r--) {
+			for (i = first; i <= last; i++) {
+				c = spectrumBarColor (b, r, b->sb_drawn[i],
+				    b->sb_drawnpk[i]);
+				for (x = 0; x < b->sb_width; x++)
+					*p++ = c;
+				if (i == last)
+					break;
+				for (; x < b->sb_step; x++)
+					*p++ = b->sb_bg;
+			}
+		}
+		putPixelBlock (b->sb_x + (first * b->sb_step),
+		    b->sb_y + b->sb_height - hi, cx, hi - top, b->sb_strip);
+		hi = top;
+	}
+
+	return;
+}
+
+/******************************************************************************
+*
+* spectrumBarsDraw - update the columns on the screen
+*
+* This function brings the columns of <b> up to date with <rows>, the
+* height of each one in pixels, and <peaks>, the row of a peak marker
+* above each one (SPECTRUM_NOPEAK for none). <peaks> may be NULL. Only
+* columns that have changed are drawn, and only the rows between their
+* old and new heights, batched into as few SPI windows as is worth it.
+* The space between columns must be painted in sb_bg.
+*
+* RETURNS: N/A
+*/
+
+void
+spectrumBarsDraw (SPECTRUM_BARS * b, const uint8_t * rows,
+    const uint8_t * peaks)
+{
+	int h, pk, oh, opk;
+	int lo, hi, slo, shi;
+	int first, last;
+	int i, w, grow;
+
+	first = -1;
+	last = slo = shi = 0;
+
+	for (i = 0; i < b->sb_count; i++) {
+		h = rows[i];
+		if (h > b->sb_height)
+			h = b->sb_height;
+		pk = SPECTRUM_NOPEAK;
+		if (peaks != NULL && peaks[i] != SPECTRUM_NOPEAK) {
+			pk = peaks[i];
+			if (pk >= b->sb_height)
+				pk = b->sb_height - 1;
+		}
+
+		oh = b->sb_drawn[i];
+		opk = b->sb_drawnpk[i];
+
+		if (h == oh && pk == opk)
+			continue;
+
+		lo = h < oh ? h : oh;
+		hi = h < oh ? oh : h;
+		if (pk != SPECTRUM_NOPEAK) {
+			if (pk < lo)
+				lo = pk;
+			if (pk + 1 > hi)
+				hi = pk + 1;
+		}
+		if (opk != SPECTRUM_NOPEAK) {
+			if (opk < lo)
+				lo = opk;
+			if (opk + 1 > hi)
+				hi = opk + 1;
+		}
+
+		b->sb_drawn[i] = h;
+		b->sb_drawnpk[i] = pk;
+
+		if (first != -1) {
+			/*
+			 * Pixels we'd send by joining, less what the
+			 * strip and this column need on their own.
+			 */
+			w = ((i - first) * b->sb_step) + b->sb_width;
+			grow = w * ((hi > shi ? hi : shi) -
+			    (lo < slo ? lo : slo));
+			grow -= (((last - first) * b->sb_step) +
+			    b->sb_width) * (shi - slo);
+			grow -= b->sb_width * (hi - lo);
+			if (grow <= SPECTRUM_STRIP_SLACK) {
+				last = i;
+				if (lo < slo)
+					slo = lo;
+				if (hi > shi)
+					shi = hi;
+				continue;
+			}
+			spectrumBarsFlush (b, first, last, slo, shi);
+		}
+
+		first = last = i;
+		slo = lo;
+		shi = hi;
+	}
+
+	if (first != -1)
+		spectrumBarsFlush (b, first, last, slo, shi);
+
+	return;
+}
@@ -0,0 +1,121 @@
+/*-
+ * Copyright (c) 2019
+ *      Bill Paul <wpaul@windriver.com>.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. All advertising materials mentioning features or use of this software
+ *    must display the following acknowledgement:
+ *      This product includes software developed by Bill Paul.
+ * 4. Neither the name of the author nor the names of any co-contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Bill Paul AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL Bill Paul OR THE VOICES IN HIS HEAD
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SPECTRUM_H_
+#define _SPECTRUM_H_
+
+#include "gfx.h"
+
+/*
+ * Audio spectrum engine
+ *
+ * spectrumRun() takes SPECTRUM_POINTS real samples, applies a Hann
+ * window and does a real-input FFT (a half-size complex fix_fft()
+ * plus a split pass). Bin magnitudes are then gathered into log-spaced
+ * bands. Each band comes out as a level from 0 to SPECTRUM_LEVEL_MAX
+ * on a log (dB) scale, with an instant attack, a steady decay and a
+ * held peak. sp_loud is the same idea for the whole spectrum.
+ *
+ * spectrumSmooth() is that smoothing on its own, for levels that
+ * come from somewhere else.
+ *
+ * What the levels drive is up to the caller. spectrumBarsDraw() does
+ * the usual column display; it only touches the pixels of columns
+ * whose height or peak has changed since the last call, and sends
+ * neighbouring changes to the screen together as one block.
+ */
+
+#define SPECTRUM_LOG2_POINTS	10
+#define SPECTRUM_POINTS		(1 << SPECTRUM_LOG2_POINTS)
+#define SPECTRUM_BINS		(SPECTRUM_POINTS / 2)
+#define SPECTRUM_BANDS_MAX	160
+#define SPECTRUM_LEVEL_MAX	255
+
+/* Defaults; the caller may change them after spectrumInit() */
+
+#define SPECTRUM_FLOOR		64	/* log2(magnitude) * 16 shown as 0 */
+#define SPECTRUM_RANGE		128	/* ...and how far above it is full */
+#define SPECTRUM_DECAY		16	/* level lost per spectrumRun() */
+#define SPECTRUM_HOLD		8	/* runs a peak stays put */
+
+#define SPECTRUM_STRIP_PIXELS	1024	/* biggest block sent at once */
+#define SPECTRUM_STRIP_SLACK	64	/* unchanged pixels worth resending */
+
+typedef struct spectrum {
+	short		sp_re[SPECTRUM_BINS];
+	short		sp_im[SPECTRUM_BINS];
+	uint16_t	sp_mag[SPECTRUM_BINS];
+	uint16_t	sp_edge[SPECTRUM_BANDS_MAX + 1];
+	uint8_t		sp_level[SPECTRUM_BANDS_MAX];
+	uint8_t		sp_peak[SPECTRUM_BANDS_MAX];
+	uint8_t		sp_hold[SPECTRUM_BANDS_MAX];
+	int		sp_bands;
+	uint16_t	sp_floor;
+	uint16_t	sp_range;
+	uint8_t		sp_decay;
+	uint8_t		sp_loud;	/* smoothed level of all bands */
+} SPECTRUM;
+
+/*
+ * A row of columns on the screen. Fill in the geometry and colours,
+ * paint the background, then call spectrumBarsReset(). Column heights
+ * are in pixels; a column's colour depends on how high up it is, in
+ * three zones split at sb_zone[0] and sb_zone[1] pixels.
+ */
+
+typedef struct spectrum_bars {
+	coord_t		sb_x;		/* left edge of the first column */
+	coord_t		sb_y;		/* top of the columns */
+	coord_t		sb_step;	/* distance between columns */
+	coord_t		sb_width;	/* width of each column */
+	coord_t		sb_height;	/* tallest column, at most 254 */
+	int		sb_count;
+	color_t		sb_bg;
+	color_t		sb_peakcolor;
+	color_t		sb_color[3];
+	coord_t		sb_zone[2];
+	uint8_t		sb_drawn[SPECTRUM_BANDS_MAX];
+	uint8_t		sb_drawnpk[SPECTRUM_BANDS_MAX];
+	pixel_t		sb_strip[SPECTRUM_STRIP_PIXELS];
+} SPECTRUM_BARS;
+
+#define SPECTRUM_NOPEAK		0xFF
+
+extern void spectrumInit (SPECTRUM *, int bands, int lobin, int hibin);
+extern void spectrumRun (SPECTRUM *, const int16_t * samples, int stride);
+extern void spectrumSmooth (uint8_t * level, uint8_t * peak, uint8_t * hold,
+    const uint8_t * in, int cnt, uint8_t decay);
+extern void spectrumBarsReset (SPECTRUM_BARS *);
+extern void spectrumBarsDraw (SPECTRUM_BARS *, const uint8_t * rows,
+    const uint8_t * peaks);
+
+#endif /* _SPECTRUM_H_ */
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stddef.h>
 
 #include "ch.h"
 #include "hal.h"
@@ -15,6 +16,7 @@
 
 #include "rand.h"
 #include "vector.h"
+#include "crc32.h"
 
 #include "gfx.h"
 extern void tonePlay (GWidgetObject * w, uint8_t b, uint32_t duration);
@@ -36,7 +38,7 @@ const char *rankname[] = {
 // so that we don't have to search for starting places, here's a list
 // of 28 safe starting places in the world map.
 #define MAX_SAFE_START 28
-VECTOR safe_start[MAX_SAFE_START] = {
+IVECTOR safe_start[MAX_SAFE_START] = {
   { 38,57 },
   { 51,47 },
   { 97,52 },
@@ -84,6 +86,385 @@ static userconfig config_cache;
 
 mutex_t config_mutex;
 
+/*
+ * The config is kept as an append-only log spread over the last
+ * CONFIG_LOG_SECTORS sectors of flash, so that most saves are a small
+ * program operation instead of a sector erase. Each sector holds a
+ * full copy of the config followed by delta records with just the
+ * bytes that changed since the record before. When a sector fills
+ * up, the oldest sector is erased and a fresh full copy starts it.
+ * The sector header is written last, magic after generation, so a
+ * sector only counts once its first record is safely in flash.
+ *
+ * Every record carries a sequence number and a CRC. Replay stops at
+ * the first record that doesn't check out, which is what a write cut
+ * short by a reset looks like, and the next save moves on to a fresh
+ * sector rather than writing after the damage.
+ *
+ * configSave() only updates the RAM copy. The sync thread writes it
+ * out CONFIG_FLUSH_MS later, so a burst of saves (like the end of a
+ * battle) turns into one flash write.
+ */
+
+typedef struct cfg_sector_hdr {
+  uint32_t magic;
+  uint32_t gen;        // bumped every time a sector is started
+} cfg_sector_hdr;
+
+typedef struct cfg_rec_hdr {
+  uint16_t magic;
+  uint8_t  type;
+  uint8_t  version;    // CONFIG_VERSION when it was written
+  uint16_t len;        // payload bytes, not counting padding
+  uint16_t resv;
+  uint32_t seq;
+  uint32_t crc;        // over the header up to here, then the payload
+} cfg_rec_hdr;
+
+#define CFG_REC_FULL   1   // payload is a whole userconfig
+#define CFG_REC_DELTA  2   // payload is { u16 off, u16 len, data } runs
+
+#define CFG_ROUNDUP(x)   (((x) + 3) & ~3)
+#define CFG_REC_MAX      (sizeof(cfg_rec_hdr) + CFG_ROUNDUP(sizeof(userconfig)))
+#define CFG_DELTA_GAP    4   // merge runs closer together than this
+
+static struct {
+  int      sector;     // index of the sector being appended to, or -1
+  uint32_t off;        // where the next record goes
+  uint32_t gen;
+  uint32_t seq;
+  bool     torn;       // junk after the last good record
+} cfg_log = { -1, 0, 0, 0, false };
+
+static userconfig cfg_flash;        // what the log currently says
+static userconfig cfg_snap;         // what configFlush() is writing
+static uint32_t cfg_recbuf[CFG_REC_MAX / sizeof(uint32_t)];
+static volatile bool config_dirty;
+
+static binary_semaphore_t config_sem;
+static THD_WORKING_AREA(waConfigThread, 768);
+
+#define CFG_LOAD_OK       0
+#define CFG_LOAD_EMPTY    1
+#define CFG_LOAD_VERSION  2
+
+static const uint8_t *cfg_sector_base(int idx) {
+  return (const uint8_t *)((CONFIG_LOG_FIRST_SECTOR + idx) * FLASH_PAGE_SIZE);
+}
+
+static uint32_t cfg_rec_crc(const cfg_rec_hdr *r, const uint8_t *payload) {
+  uint32_t crc;
+
+  crc = crc32_le((const uint8_t *)r, offsetof(cfg_rec_hdr, crc), CRC_INIT);
+  return crc32_le(payload, r->len, crc);
+}
+
+static bool cfg_delta_apply(userconfig *c, const uint8_t *p, int len) {
+  uint16_t off, n;
+
+  while (len >= 4) {
+    memcpy(&off, p, sizeof(off));
+    memcpy(&n, p + 2, sizeof(n));
+    p += 4;
+    len -= 4;
+    if (n > len || off + n > sizeof(userconfig))
+      return false;
+    memcpy((uint8_t *)c + off, p, n);
+    p += n;
+    len -= n;
+  }
+
+  return (len == 0);
+}
+
+/*
+ * Replay the records in one sector into cfg_flash. Returns the number
+ * of good records, and leaves cfg_log pointing just past the last one.
+ */
+static int cfg_replay_sector(int idx, bool *badversion) {
+  const uint8_t *base = cfg_sector_base(idx);
+  const cfg_rec_hdr *r;
+  uint32_t off = sizeof(cfg_sector_hdr);
+  uint32_t size;
+  int good = 0;
+
+  while (off + sizeof(cfg_rec_hdr) <= FLASH_PAGE_SIZE) {
+    r = (const cfg_rec_hdr *)(base + off);
+    size = sizeof(cfg_rec_hdr) + CFG_ROUNDUP(r->len);
+
+    if (r->magic != CONFIG_REC_MAGIC || off + size > FLASH_PAGE_SIZE)
+      break;
+    if (r->crc != cfg_rec_crc(r, (const uint8_t *)(r + 1)))
+      break;
+    if (good > 0 && (int32_t)(r->seq - cfg_log.seq) <= 0)
+      break;
+
+    if (r->version != CONFIG_VERSION) {
+      *badversion = true;
+      break;
+    }
+
+    if (good == 0) {
+      /* a sector has to start with a full copy */
+      if (r->type != CFG_REC_FULL || r->len != sizeof(userconfig))
+        break;
+      memcpy(&cfg_flash, r + 1, sizeof(userconfig));
+    } else if (r->type == CFG_REC_DELTA) {
+      if (!cfg_delta_apply(&cfg_flash, (const uint8_t *)(r + 1), r->len))
+        break;
+    } else if (r->type == CFG_REC_FULL && r->len == sizeof(userconfig)) {
+      memcpy(&cfg_flash, r + 1, sizeof(userconfig));
+    } else {
+      break;
+    }
+
+    cfg_log.seq = r->seq;
+    off += size;
+    good++;
+  }
+
+  cfg_log.off = off;
+  cfg_log.torn = (off + sizeof(uint32_t) <= FLASH_PAGE_SIZE &&
+                  *(const uint32_t *)(base + off) != 0xFFFFFFFF);
+
+  return good;
+}
+
+/*
+ * Find the newest sector with a good full copy in it and replay it.
+ * Only the newest sector matters; the rest hold older history.
+ */
+static int cfg_replay(void) {
+  const cfg_sector_hdr *h;
+  bool tried[CONFIG_LOG_SECTORS];
+  bool badversion = false;
+  int i, best;
+
+  memset(tried, 0, sizeof(tried));
+  cfg_log.sector = -1;
+  cfg_log.gen = 0;
+
+  /* new sectors always have to come out newest */
+  for (i = 0; i < CONFIG_LOG_SECTORS; i++) {
+    h = (const cfg_sector_hdr *)cfg_sector_base(i);
+    if (h->magic == CONFIG_LOG_MAGIC &&
+        (int32_t)(h->gen - cfg_log.gen) > 0)
+      cfg_log.gen = h->gen;
+  }
+
+  while (1) {
+    best = -1;
+    for (i = 0; i < CONFIG_LOG_SECTORS; i++) {
+      h = (const cfg_sector_hdr *)cfg_sector_base(i);
+      if (tried[i] || h->magic != CONFIG_LOG_MAGIC)
+        continue;
+      if (best == -1 || (int32_t)(h->gen -
+          ((const cfg_sector_hdr *)cfg_sector_base(best))->gen) > 0)
+        best = i;
+    }
+
+    if (best == -1)
+      break;
+
+    tried[best] = true;
+    if (cfg_replay_sector(best, &badversion) > 0) {
+      cfg_log.sector = best;
+      return CFG_LOAD_OK;
+    }
+    if (badversion)
+      break;
+  }
+
+  /* if we give up on the log, the next write starts a new sector */
+  cfg_log.sector = -1;
+
+  return badversion ? CFG_LOAD_VERSION : CFG_LOAD_EMPTY;
+}
+
+/*
+ * Build the runs of bytes that differ between cfg_flash and c.
+ * Returns the payload length, or -1 if a full copy would be smaller.
+ */
+static int cfg_delta_build(uint8_t *p, const userconfig *c) {
+  const uint8_t *a = (const uint8_t *)&cfg_flash;
+  const uint8_t *b = (const uint8_t *)c;
+  uint16_t off, n;
+  int i = 0, j, end, len = 0;
+
+  while (i < (int)sizeof(userconfig)) {
+    if (a[i] == b[i]) {
+      i++;
+      continue;
+    }
+
+    end = i + 1;
+    for (j = end; j < (int)sizeof(userconfig); j++) {
+      if (a[j] != b[j])
+        end = j + 1;
+      else if (j - end >= CFG_DELTA_GAP)
+        break;
+    }
+
+    if (len + 4 + (end - i) >= (int)sizeof(userconfig))
+      return -1;
+
+    off = i;
+    n = end - i;
+    memcpy(p + len, &off, sizeof(off));
+    memcpy(p + len + 2, &n, sizeof(n));
+    memcpy(p + len + 4, b + i, n);
+    len += 4 + n;
+    i = end;
+  }
+
+  return len;
+}
+
+static uint32_t cfg_rec_build(uint8_t type, int len) {
+  cfg_rec_hdr *r = (cfg_rec_hdr *)cfg_recbuf;
+  uint32_t size = sizeof(cfg_rec_hdr) + CFG_ROUNDUP(len);
+
+  /* pad with ones so the padding is left unprogrammed */
+  memset((uint8_t *)(r + 1) + len, 0xFF, CFG_ROUNDUP(len) - len);
+
+  r->magic = CONFIG_REC_MAGIC;
+  r->type = type;
+  r->version = CONFIG_VERSION;
+  r->len = len;
+  r->resv = 0xFFFF;
+  r->seq = ++cfg_log.seq;
+  r->crc = cfg_rec_crc(r, (const uint8_t *)(r + 1));
+
+  return size;
+}
+
+/* erase the oldest sector and start it with a full copy of c */
+static int cfg_rotate(const userconfig *c) {
+  cfg_sector_hdr h;
+  flash_offset_t base;
+  uint32_t size;
+  int next;
+
+  next = (cfg_log.sector + 1) % CONFIG_LOG_SECTORS;
+  base = (CONFIG_LOG_FIRST_SECTOR + next) * FLASH_PAGE_SIZE;
+
+  if (flashStartEraseSector(&FLASHD2, CONFIG_LOG_FIRST_SECTOR + next)
+      != FLASH_NO_ERROR) {
+    printf("configSave: Flash Erase Failed!\r\n");
+    return -1;
+  }
+  flashWaitErase((void *)&FLASHD2);
+
+  memcpy((cfg_rec_hdr *)cfg_recbuf + 1, c, sizeof(userconfig));
+  size = cfg_rec_build(CFG_REC_FULL, sizeof(userconfig));
+
+  if (flashProgram(&FLASHD2, base + sizeof(h), size,
+      (uint8_t *)cfg_recbuf) != FLASH_NO_ERROR)
+    return -1;
+
+  /*
+   * The generation goes in before the magic: a header cut short
+   * between the two words would otherwise have a good magic and a
+   * half-programmed generation that can outrank newer sectors.
+   */
+  h.magic = CONFIG_LOG_MAGIC;
+  h.gen = cfg_log.gen + 1;
+  if (flashProgram(&FLASHD2, base + offsetof(cfg_sector_hdr, gen),
+      sizeof(h.gen), (uint8_t *)&h.gen) != FLASH_NO_ERROR)
+    return -1;
+  if (flashProgram(&FLASHD2, base + offsetof(cfg_sector_hdr, magic),
+      sizeof(h.magic), (uint8_t *)&h.magic) != FLASH_NO_ERROR)
+    return -1;
+
+  cfg_log.sector = next;
+  cfg_log.gen = h.gen;
+  cfg_log.off = sizeof(h) + size;
+  cfg_log.torn = false;
+
+  return 0;
+}
+
+/* append whatever c changes since the last write; config_mutex is held */
+static int cfg_write(const userconfig *c) {
+  uint32_t size;
+  int len;
+
+  if (cfg_log.sector == -1 || cfg_log.torn)
+    return cfg_rotate(c);
+
+  len = cfg_delta_build((uint8_t *)((cfg_rec_hdr *)cfg_recbuf + 1), c);
+  if (len == 0)
+    return 0;
+
+  if (len < 0) {
+    memcpy((cfg_rec_hdr *)cfg_recbuf + 1, c, sizeof(userconfig));
+    size = cfg_rec_build(CFG_REC_FULL, sizeof(userconfig));
+  } else {
+    size = cfg_rec_build(CFG_REC_DELTA, len);
+  }
+
+  if (cfg_log.off + size > FLASH_PAGE_SIZE)
+    return cfg_rotate(c);
+
+  if (flashProgram(&FLASHD2,
+      (CONFIG_LOG_FIRST_SECTOR + cfg_log.sector) * FLASH_PAGE_SIZE +
+      cfg_log.off, size, (uint8_t *)cfg_recbuf) != FLASH_NO_ERROR) {
+    /* we don't know how much made it; don't write after it */
+    cfg_log.torn = true;
+    return -1;
+  }
+
+  cfg_log.off += size;
+
+  return 0;
+}
+
+/*
+ * Write any pending changes to flash now. Call this before anything
+ * that resets the badge.
+ */
+void configFlush(void) {
+  osalMutexLock(&config_mutex);
+
+  if (config_dirty) {
+    /*
+     * Callers change getConfig() fields in place without the
+     * mutex, so write a snapshot: anything changed while the flash
+     * is busy stays dirty for the next flush instead of being
+     * counted as written.
+     */
+    memcpy(&cfg_snap, &config_cache, sizeof(userconfig));
+    config_dirty = false;
+
+    /*
+     * Note: we're compiled to use the SoftDevice for flash access,
+     * which means we can only actually perform erase and program
+     * operations on the internal flash after the SoftDevice has
+     * been enabled.
+     */
+    if (cfg_write(&cfg_snap) == 0) {
+      memcpy(&cfg_flash, &cfg_snap, sizeof(userconfig));
+    } else {
+      config_dirty = true;
+      printf("ERROR: Unable to save config to flash.\n");
+    }
+  }
+
+  osalMutexUnlock(&config_mutex);
+}
+
+static THD_FUNCTION(configThread, arg) {
+  (void)arg;
+
+  chRegSetThreadName("ConfigSync");
+
+  while (1) {
+    chBSemWait(&config_sem);
+    chThdSleepMilliseconds(CONFIG_FLUSH_MS);
+    configFlush();
+  }
+}
+
 int16_t maxhp(uint16_t unlocks, uint8_t level) {
   // return maxHP given some unlock data and level
   uint16_t hp;
@@ -159,30 +540,13 @@ uint16_t xp_for_level(uint8_t level)
 }
 
 void configSave(userconfig *newConfig) {
-  int8_t ret;
   osalMutexLock(&config_mutex);
-  /*
-   * Note: we're compiled to use the SoftDevice for flash access,
-   * which means we can only actually perform erase and program
-   * operations on the internal flash after the SoftDevice has
-   * been enabled.
-   */
-
-  if (flashStartEraseSector (&FLASHD2, 255) != FLASH_NO_ERROR) {
-    printf ("configSave: Flash Erase Failed!\r\n");
-    osalMutexUnlock(&config_mutex);
-    return;
-  }
-
-  flashWaitErase((void *)&FLASHD2);
-  /*                  base      offset   size                pointer */
-  ret = flashProgram (&FLASHD2, 0xFF000, sizeof(userconfig), (uint8_t *)newConfig);
-
-  if (ret != FLASH_NO_ERROR) {
-    printf("ERROR (%d): Unable to save config to flash.\n", ret);
-  }
-
+  if (newConfig != &config_cache)
+    memcpy(&config_cache, newConfig, sizeof(userconfig));
+  config_dirty = true;
   osalMutexUnlock(&config_mutex);
+
+  chBSemSignal(&config_sem);
 }
 
 static void init_config(userconfig *config) {
@@ -237,11 +601,14 @@ static void init_config(userconfig *config) {
 #define ENABLE_JOYPAD
 
 void configStart(void) {
-  userconfig *config = (userconfig *)CONFIG_FLASH_ADDR;
+  userconfig *legacy = (userconfig *)CONFIG_FLASH_ADDR;
+  userconfig *config = &config_cache;
   uint8_t wipeconfig = false;
   uint8_t toggleleds = false;
+  int status;
 
   osalMutexObjectInit(&config_mutex);
+  chBSemObjectInit(&config_sem, true);
 
   /* if the user is holding down BOTH SELECTS, then we will wipe the configuration */
 #ifdef ENABLE_JOYPAD
@@ -290,20 +657,34 @@ void configStart(void) {
   }
 #endif
 
-  if ( (config->signature != CONFIG_SIGNATURE) ||
+  status = cfg_replay();
+
+  /* pick up a config saved before the log existed */
+  if (status == CFG_LOAD_EMPTY &&
+      legacy->signature == CONFIG_SIGNATURE &&
+      legacy->end_signature == CONFIG_END_SIGNATURE &&
+      legacy->version == CONFIG_VERSION) {
+    printf("Converting config to log format.\n");
+    memcpy(&cfg_flash, legacy, sizeof(userconfig));
+    config_dirty = true;
+    status = CFG_LOAD_OK;
+  }
+
+  if (status == CFG_LOAD_OK)
+    memcpy(&config_cache, &cfg_flash, sizeof(userconfig));
+
+  if ( (status == CFG_LOAD_EMPTY) ||
+   (config->signature != CONFIG_SIGNATURE) ||
    (config->end_signature != CONFIG_END_SIGNATURE) || (wipeconfig)) {
     printf("Config not found, Initializing!\n");
     init_config(&config_cache);
-    memcpy(config, &config_cache, sizeof(userconfig));
     configSave(&config_cache);
-  } else if ( config->version != CONFIG_VERSION ) {
+  } else if ( status == CFG_LOAD_VERSION ) {
     printf("Config found, but wrong version.\n");
     init_config(&config_cache);
-    memcpy(config, &config_cache, sizeof(userconfig));
     configSave(&config_cache);
   } else {
     printf("Config OK!\n");
-    memcpy(&config_cache, config, sizeof(userconfig));
 
     if (config_cache.puz_enabled)
       printf("Puzzle mode has been enabled!\n");
@@ -324,27 +705,30 @@ void configStart(void) {
     configSave (&config_cache);
   }
 
+  /* write out anything we changed above, then let saves batch up */
+  configFlush();
+  chThdCreateStatic(waConfigThread, sizeof(waConfigThread),
+                    NORMALPRIO, configThread, NULL);
+
   return;
 }
 
 struct userconfig *getConfig(void) {
-  userconfig *config = (userconfig *)CONFIG_FLASH_ADDR;
-
   /*
    * returns volatile config, unless we're called very early
-   * during startup, in which case we try to return a pointer
-   * to the actual flash memory. This is to avoid a "chicken-and-the-egg"
+   * during startup, in which case we replay the log in flash to
+   * fill it in. This is to avoid a "chicken-and-the-egg"
    * problem where the BLE startup code needs to read the board config.
    * (We need the SoftDevice to do flash accesses so we have to initialize
    * BLE first and userconfig second, but that means config_cache will
-   * never be valid until after we initialize the radio.)
+   * never be valid until after we initialize the radio.) Reading the
+   * log doesn't need the SoftDevice.
    */
 
   if (config_cache.signature != CONFIG_SIGNATURE &&
       config_cache.end_signature != CONFIG_END_SIGNATURE &&
-      config->signature == CONFIG_SIGNATURE &&
-      config->end_signature == CONFIG_END_SIGNATURE)
-    return (config);
+      cfg_replay() == CFG_LOAD_OK)
+    memcpy(&config_cache, &cfg_flash, sizeof(userconfig));
 
   return &config_cache;
 }
@@ -9,8 +9,18 @@
  * goes in here
  */
 
-#define CONFIG_FLASH_ADDR 0xFF000
+#define CONFIG_FLASH_ADDR 0xFF000   // where the config lived before the log
 #define CONFIG_FLASH_SECTOR 255
+
+/*
+ * the config log uses the last CONFIG_LOG_SECTORS sectors of flash;
+ * NRF52840_softdevice.ld leaves them out of flash0, so change both
+ */
+#define CONFIG_LOG_SECTORS 4
+#define CONFIG_LOG_FIRST_SECTOR (CONFIG_FLASH_SECTOR - CONFIG_LOG_SECTORS + 1)
+#define CONFIG_LOG_MAGIC  0xc0f1609e
+#define CONFIG_REC_MAGIC  0xc0f6
+#define CONFIG_FLUSH_MS   2000      // how long saves are held in RAM
 #define CONFIG_SIGNATURE  0xdeadbeef  // duh
 #define CONFIG_END_SIGNATURE  0xdeadfa11
 #define CONFIG_VERSION    6
@@ -76,6 +86,7 @@ typedef struct userconfig {
 /* prototypes */
 extern void configStart(void);
 extern void configSave(userconfig *);
+extern void configFlush(void);
 extern userconfig *getConfig(void);
 extern int16_t maxhp(uint16_t, uint8_t);
 extern uint16_t xp_for_level(uint8_t level);
@@ -85,5 +96,5 @@ extern const char *rankname[];
 extern unsigned long rtc;
 extern unsigned long rtc_set_at;
 
-extern VECTOR safe_start[];
+extern IVECTOR safe_start[];
 #endif
@@ -1,9 +1,42 @@
 #ifndef _VECTOR_H_
 #define _VECTOR_H_
 
+#include <stdint.h>
+
+/*
+ * Entity physics runs in Q16.16 fixed point: 16 bits of whole pixels
+ * and 16 bits of fraction. Integer math gives the same answer on every
+ * badge, so both sides of a battle see the same positions and can send
+ * them over the air without losing anything.
+ */
+
+typedef int32_t fix16_t;
+
+#define FIX16_SHIFT           16
+#define FIX16_ONE             ((fix16_t)1 << FIX16_SHIFT)
+
+#define FIX16_FROM_INT(i)     ((fix16_t)(i) * FIX16_ONE)
+#define FIX16_FROM_FLOAT(f)   ((fix16_t)((f) * (float)FIX16_ONE + \
+                                ((f) < 0 ? -0.5f : 0.5f)))
+/* whole pixels, rounding towards zero like a cast from float did */
+#define FIX16_TO_INT(x)       ((int)((x) / FIX16_ONE))
+#define FIX16_TO_FLOAT(x)     ((float)(x) / (float)FIX16_ONE)
+
+static inline fix16_t
+fix16_mul(fix16_t a, fix16_t b)
+{
+  return((fix16_t)(((int64_t)a * b) >> FIX16_SHIFT));
+}
+
 typedef struct _vector {
-  float x;
-  float y;
+  fix16_t x;
+  fix16_t y;
 } VECTOR;
 
+/* whole pixel positions, for tables of map coordinates */
+typedef struct _ivector {
+  int16_t x;
+  int16_t y;
+} IVECTOR;
+
 #endif /* _VECTOR_H_ */
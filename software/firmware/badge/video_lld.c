@@ -39,6 +39,7 @@
 #include "ff.h"
 #include "ffconf.h"
 #include "diskio.h"
+#include "mmc.h"
 
 #include "video_lld.h"
 #include "async_io_lld.h"
@@ -46,7 +47,20 @@
 
 #include "badge.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+static ASYNC_IO_REQ vid_req[VID_IO_SLOTS];
+
+typedef struct _video_stats {
+	uint64_t	vs_total;
+	uint64_t	vs_pixel;
+	uint64_t	vs_decode;
+	rtcnt_t		vs_last;
+} VIDEO_STATS;
+
+static VIDEO_STATS vid_stats;
 
 typedef struct _audio_state {
 	uint16_t *	audio_curbuf;
@@ -92,60 +106,520 @@ audioAccumulate (AUDIO_STATE * h, uint16_t * samples)
 }
 
 static void
-videoAccumulate (pixel_t * pixels, pixel_t * linebuf)
+videoSpiWait (void)
 {
-	pixel_t pix;
-	pixel_t * p;
-	int i, j;
-
 	osalSysLock ();
 	if (SPID4.state != SPI_READY)
 		(void) osalThreadSuspendS (&SPID4.thread);
 	osalSysUnlock ();
 
+	return;
+}
+
+/*
+ * Keep track of how much CPU time goes into pushing pixels out
+ * (and decoding them, for .VDZ clips) relative to the total time
+ * spent playing, so we know how much is left over for everything
+ * else. The realtime counter runs at the CPU clock rate.
+ */
+
+static void
+videoStatsStart (void)
+{
+	memset (&vid_stats, 0, sizeof(vid_stats));
+	vid_stats.vs_last = chSysGetRealtimeCounterX ();
+
+	return;
+}
+
+static void
+videoStatsTick (void)
+{
+	rtcnt_t now;
+
+	now = chSysGetRealtimeCounterX ();
+	vid_stats.vs_total += (rtcnt_t)(now - vid_stats.vs_last);
+	vid_stats.vs_last = now;
+
+	return;
+}
+
+static void
+videoStatsPrint (void)
+{
+	videoStatsTick ();
+
+	if (vid_stats.vs_total == 0)
+		return;
+
+	printf ("Video: pixel output %lu%% CPU, decode %lu%% CPU\n",
+	    (uint32_t)((vid_stats.vs_pixel * 100) / vid_stats.vs_total),
+	    (uint32_t)((vid_stats.vs_decode * 100) / vid_stats.vs_total));
+
+	return;
+}
+
+/*
+ * Send a block of cx by cy pixels to the display. If linebuf is
+ * not NULL, the block is pixel doubled on the way out, so the
+ * region on the screen is actually cx * 2 by cy * 2 pixels.
+ *
+ * For doubling, the CPU only widens each line, two source pixels
+ * (one 32-bit word) at a time. The SPI controller then sends each
+ * widened line twice, which saves us writing the second copy. Since
+ * the source rows are contiguous and so are the widened ones, the
+ * whole block can be widened in one pass. The pixel and line
+ * buffers must be 32-bit aligned.
+ */
+
+static void
+videoAccumulate (pixel_t * pixels, pixel_t * linebuf, int cx, int cy)
+{
+	uint32_t * src;
+	uint32_t * dst;
+	uint32_t w;
+	rtcnt_t start;
+	int i;
+
+	videoSpiWait ();
+
 	if (linebuf == NULL) {
-		spiStartSend (&SPID4, VID_CHUNK_LINES *
-		    VID_PIXELS_PER_LINE * 2, pixels);
+		spiStartSend (&SPID4, cx * cy * 2, pixels);
 		return;
 	}
 
-	for (i = 0; i < VID_CHUNK_LINES; i++) {
-		p = linebuf + (320 * i * 2);
+	start = chSysGetRealtimeCounterX ();
+
+	src = (uint32_t *)pixels;
+	dst = (uint32_t *)linebuf;
+
+	for (i = (cx * cy) >> 1; i; i--) {
+		w = *src++;
+		*dst++ = (w & 0xFFFF) | (w << 16);
+		*dst++ = (w & 0xFFFF0000) | (w >> 16);
+	}
+
+	if ((cx * cy) & 1) {
+		w = *(pixel_t *)src;
+		*dst = w | (w << 16);
+	}
+
+	vid_stats.vs_pixel += (rtcnt_t)(chSysGetRealtimeCounterX () - start);
+
+	osalSysLock ();
+	SPID4.state = SPI_ACTIVE;
+	spi_lld_send_repeat (&SPID4, cx * 2 * sizeof(pixel_t), cy, 2, linebuf);
+	osalSysUnlock ();
+
+	return;
+}
+
+/*
+ * Expand a run-length encoded block of npix pixels from srclen
+ * words of input. Runs are filled two pixels at a time where
+ * alignment allows, since long runs of a single color are the
+ * common case for the backgrounds in most of our clips.
+ *
+ * Returns -1 if the stream is damaged: an op with a count of zero,
+ * or one that needs more input than there is.
+ */
+
+static int
+vdzDecode (const uint16_t * src, int srclen, pixel_t * dst, int npix)
+{
+	const uint16_t * end;
+	uint32_t * d32;
+	uint32_t pix2;
+	uint16_t pix;
+	uint16_t op;
+	int n, i;
+
+	end = src + srclen;
+
+	while (npix > 0) {
+		if (src == end)
+			return (-1);
+		op = *src++;
+		n = op & VDZ_OP_CNT;
+		if (n == 0)
+			return (-1);
+		if (n > npix)
+			n = npix;
+		npix -= n;
+
+		if (op & VDZ_OP_RUN) {
+			if (src == end)
+				return (-1);
+			pix = *src++;
+			if (n && ((uintptr_t)dst & 2)) {
+				*dst++ = pix;
+				n--;
+			}
+			pix2 = pix | (pix << 16);
+			d32 = (uint32_t *)dst;
+			for (i = n >> 1; i; i--)
+				*d32++ = pix2;
+			dst = (pixel_t *)d32;
+			if (n & 1)
+				*dst++ = pix;
+		} else {
+			if (end - src < n)
+				return (-1);
+			memcpy (dst, src, n * sizeof(pixel_t));
+			dst += n;
+			src += n;
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Move the display write window. The current window can only be
+ * changed once the previous DMA transfer into it has finished.
+ */
+
+static void
+vdzWindow (int x, int y, int cx, int cy)
+{
+	videoSpiWait ();
+	gdisp_lld_write_stop (GDISP);
+	GDISP->p.x = x;
+	GDISP->p.y = y;
+	GDISP->p.cx = cx;
+	GDISP->p.cy = cy;
+	gdisp_lld_write_start (GDISP);
+
+	return;
+}
+
+static int
+vdzWinPlay (char * fname, int x, int y)
+{
+	FIL f;
+	DWORD clmt[VID_CLMT_LEN];
+	VDZ_HDR hdr;
+	VDZ_REC * rec;
+	VDZ_CHUNK * c;
+	uint8_t * buf;
+	uint8_t * p1;
+	uint8_t * p2;
+	uint8_t * p;
+	uint8_t * recend;
+	pixel_t * decbuf;
+	pixel_t * dcur;
+	pixel_t * linebuf;
+	pixel_t * pix;
+	int i;
+	int scale;
+	int cpf;
+	int wx, wy;
+	int vx, vy, vcx, vtop, vcy;
+	UINT br;
+	UINT nextlen;
+	rtcnt_t start;
+	GListener gl;
+	GSourceHandle gs;
+	GEventMouse * me = NULL;
+	AUDIO_STATE * a;
+
+	i2sPlay (NULL);
+
+	if (f_open (&f, fname, FA_READ) != FR_OK)
+		return (-1);
+
+	mmc_disk_map (&f, clmt, VID_CLMT_LEN);
+
+	if (f_read (&f, &hdr, sizeof(hdr), &br) != FR_OK ||
+	    br != sizeof(hdr) || hdr.vdz_magic != VDZ_MAGIC ||
+	    hdr.vdz_width == 0 || hdr.vdz_chunk_lines == 0 ||
+	    hdr.vdz_height % hdr.vdz_chunk_lines) {
+		f_close (&f);
+		return (-1);
+	}
+
+	/*
+	 * Full screen playback of a clip that's half the width of
+	 * the display gets pixel doubled, anything else is drawn
+	 * 1:1, either full screen or in a window.
+	 */
+
+	if (x == -1 && hdr.vdz_width * 2 <= gdispGetWidth ())
+		scale = 2;
+	else
+		scale = 1;
+
+	if (hdr.vdz_width * scale > gdispGetWidth () ||
+	    hdr.vdz_height * scale > gdispGetHeight ()) {
+		f_close (&f);
+		return (-1);
+	}
+
+	if (x == -1) {
+		x = (gdispGetWidth () - (hdr.vdz_width * scale)) / 2;
+		y = (gdispGetHeight () - (hdr.vdz_height * scale)) / 2;
+	}
+
+	cpf = hdr.vdz_height / hdr.vdz_chunk_lines;
+
+	/* Skip the keyframe index, we always play from the start */
+
+	f_lseek (&f, sizeof(hdr) + (hdr.vdz_keycnt * sizeof(VDZ_KEY)));
+
+	buf = malloc (hdr.vdz_maxrec * 2);
+	decbuf = malloc (hdr.vdz_width * hdr.vdz_chunk_lines *
+	    sizeof(pixel_t) * 2);
+	if (scale == 2)
+		linebuf = malloc (hdr.vdz_width * hdr.vdz_chunk_lines *
+		    sizeof(pixel_t) * 2);
+	else
+		linebuf = NULL;
+	i2sBuf = malloc (VID_AUDIO_BYTES_PER_CHUNK * VID_AUDIO_BUFCNT * 2);
+	a = malloc (sizeof (AUDIO_STATE));
+
+	if (buf == NULL || decbuf == NULL || i2sBuf == NULL ||
+	    a == NULL || (scale == 2 && linebuf == NULL)) {
+		free (buf);
+		free (decbuf);
+		free (linebuf);
+		free (i2sBuf);
+		free (a);
+		i2sBuf = NULL;
+		f_close (&f);
+		return (-1);
+	}
+
+	a->audio_curbuf = i2sBuf;
+	a->audio_curframe = i2sBuf;
+	a->audio_scnt = 0;
+
+	/* Start with the window covering the whole clip */
+
+	vx = x;
+	vy = y;
+	vtop = y;
+	vcx = hdr.vdz_width * scale;
+	vcy = hdr.vdz_height * scale;
+
+	GDISP->p.x = vx;
+	GDISP->p.y = vy;
+	GDISP->p.cx = vcx;
+	GDISP->p.cy = vcy;
+
+	gdisp_lld_write_start (GDISP);
+
+	gs = ginputGetMouse (0);
+	geventListenerInit (&gl);
+	geventAttachSource (&gl, gs, GLISTEN_MOUSEMETA);
+
+	p1 = buf;
+	p2 = buf + hdr.vdz_maxrec;
+	dcur = decbuf;
+
+	nextlen = hdr.vdz_firstrec;
+	if (nextlen > hdr.vdz_maxrec)
+		nextlen = 0;
+	f_read (&f, p1, nextlen, &br);
+	if (br != nextlen)
+		br = 0;
+
+	i2sAudioAmpCtl (I2S_AMP_ON);
+
+	badge_sleep_disable ();
+
+	videoStatsStart ();
+
+	while (1) {
+
+		if (br == 0)
+			break;
+
+		rec = (VDZ_REC *)p1;
 
 		/*
-		 * Expand one 160 pixel line to
-		 * two 320 pixel lines
+		 * Bail out on a damaged record. br belongs to the
+		 * async read from here on, so note where this record
+		 * ends first.
 		 */
 
-		for (j = 0; j < 160; j++) {
-			pix = pixels[j + (160 * i)];;
-			p[0] = p[1] = p[320] = p[321] = pix;
-			p += 2;
+		if (br < sizeof(VDZ_REC) ||
+		    rec->vdz_chunk0 + rec->vdz_chunks > cpf)
+			break;
+
+		recend = p1 + br;
+
+		nextlen = rec->vdz_nextlen;
+		if (nextlen > hdr.vdz_maxrec)
+			nextlen = 0;
+
+		/* Start next async read */
+
+		if (nextlen)
+			asyncIoRead (&f, p2, nextlen, &br);
+
+		p = p1 + sizeof(VDZ_REC);
+
+		for (i = 0; i < rec->vdz_chunks; i++) {
+			c = (VDZ_CHUNK *)p;
+
+			/*
+			 * Drop the rest of the record if a chunk doesn't
+			 * fit in it, or its block doesn't fit in the
+			 * chunk's lines. Nothing after it can be trusted.
+			 */
+
+			if (recend - p < (int)sizeof(VDZ_CHUNK) ||
+			    recend - p - sizeof(VDZ_CHUNK) < c->vdz_len ||
+			    c->vdz_x + c->vdz_cx > hdr.vdz_width ||
+			    c->vdz_y + c->vdz_cy > hdr.vdz_chunk_lines)
+				break;
+
+			p += sizeof(VDZ_CHUNK);
+
+			audioAccumulate (a, c->vdz_samples);
+
+			if (c->vdz_type == VDZ_CHUNK_SKIP)
+				continue;
+
+			/*
+			 * Raw chunks go straight from the read buffer
+			 * to the screen. RLE chunks are decoded first,
+			 * alternating between two decode buffers so that
+			 * we never scribble on a block that's still being
+			 * DMAed out.
+			 */
+
+			if (c->vdz_type == VDZ_CHUNK_RAW) {
+				if (c->vdz_len <
+				    c->vdz_cx * c->vdz_cy * sizeof(pixel_t))
+					break;
+				pix = (pixel_t *)p;
+			} else {
+				start = chSysGetRealtimeCounterX ();
+				if (vdzDecode ((uint16_t *)p,
+				    c->vdz_len / sizeof(uint16_t), dcur,
+				    c->vdz_cx * c->vdz_cy) != 0)
+					break;
+				vid_stats.vs_decode += (rtcnt_t)
+				    (chSysGetRealtimeCounterX () - start);
+				pix = dcur;
+				dcur += hdr.vdz_width * hdr.vdz_chunk_lines;
+				if (dcur == decbuf +
+				    (hdr.vdz_width * hdr.vdz_chunk_lines * 2))
+					dcur = decbuf;
+			}
+
+			/*
+			 * The display advances its write pointer on
+			 * its own (and wraps back to the top of the
+			 * window at the bottom), so we only need to move
+			 * the window when this block doesn't pick up
+			 * exactly where the last one left off.
+			 */
+
+			wx = x + (c->vdz_x * scale);
+			wy = y + (((rec->vdz_chunk0 + i) *
+			    hdr.vdz_chunk_lines) + c->vdz_y) * scale;
+
+			if (vx != wx || vcx != c->vdz_cx * scale || vy != wy) {
+				vx = wx;
+				vtop = wy;
+				vcx = c->vdz_cx * scale;
+				vcy = (y + (hdr.vdz_height * scale)) - wy;
+				vdzWindow (vx, vtop, vcx, vcy);
+			}
+
+			videoAccumulate (pix, linebuf, c->vdz_cx, c->vdz_cy);
+
+			vy = wy + (c->vdz_cy * scale);
+			if (vy == vtop + vcy)
+				vy = vtop;
+
+			p += c->vdz_len;
 		}
+
+		/*
+		 * The last block may still be going out of the
+		 * record buffer, which is about to be reused for
+		 * the next read.
+		 */
+
+		videoSpiWait ();
+
+		/* Switch to next waiting record */
+
+		p = p1;
+		p1 = p2;
+		p2 = p;
+
+		if (nextlen == 0)
+			break;
+
+		/* Wait for async read to complete */
+
+		asyncIoWait ();
+
+		if (br != nextlen)
+			break;
+
+		videoStatsTick ();
+
+		me = (GEventMouse *)geventEventWait (&gl, 0);
+		if (me != NULL && me->buttons & GMETA_MOUSE_DOWN)
+			break;
 	}
 
-	spiStartSend (&SPID4, 320 * 2 * VID_CHUNK_LINES * 2, linebuf);
+	badge_sleep_enable ();
 
-	return;
+	videoStatsPrint ();
+
+	/* Drain any pending I/O */
+
+	i2sSamplesWait ();
+	i2sSamplesStop ();
+	videoSpiWait ();
+
+	i2sAudioAmpCtl (I2S_AMP_OFF);
+
+	gdisp_lld_write_stop (GDISP);
+
+	geventDetachSource (&gl, NULL);
+
+	f_close (&f);
+
+	free (buf);
+	free (decbuf);
+	free (linebuf);
+	free (i2sBuf);
+	free (a);
+	i2sBuf = NULL;
+
+	if (me != NULL && me->buttons & GMETA_MOUSE_DOWN)
+		return (-1);
+
+	return (0);
 }
 
 int
 videoWinPlay (char * fname, int x, int y)
 {
 	FIL f;
+	DWORD clmt[VID_CLMT_LEN];
 	pixel_t * buf;
-	pixel_t * p1;
-	pixel_t * p2;
 	pixel_t * pcur;
 	pixel_t * p;
 	pixel_t * linebuf;
-	int i;
+	ASYNC_IO_REQ * r;
+	int i, slot;
 	UINT br;
 	GListener gl;
 	GSourceHandle gs;
 	GEventMouse * me = NULL;
 	AUDIO_STATE * a;
 
+	if (strstr (fname, ".VDZ") != NULL || strstr (fname, ".vdz") != NULL)
+		return (vdzWinPlay (fname, x, y));
+
 	/* If someone's playing audio, cut them off */
 
 	i2sPlay (NULL);
@@ -157,7 +631,7 @@ videoWinPlay (char * fname, int x, int y)
 	if (buf == NULL)
  		return (-1);
 
-	linebuf = malloc (320 * 2 * VID_CHUNK_LINES * 2);
+	linebuf = malloc (320 * 2 * VID_CHUNK_LINES);
 
 	if (linebuf == NULL) {
 		free (buf);
@@ -179,6 +653,8 @@ videoWinPlay (char * fname, int x, int y)
 		return (-1);
 	}
 
+	mmc_disk_map (&f, clmt, VID_CLMT_LEN);
+
 	/* Set the display window */
 
 	if (x == -1) {
@@ -206,12 +682,21 @@ videoWinPlay (char * fname, int x, int y)
 	a->audio_curframe = i2sBuf;
 	a->audio_scnt = 0;
 
-	p1 = buf;
-	p2 = buf + (VID_CHUNK_PIXELS * VID_CACHE_FACTOR);
-
-	/* Pre-load initial chunk */
+	/*
+	 * Split the buffer into VID_IO_SLOTS pieces and queue reads
+	 * for all of them, so that several reads are always in flight
+	 * while we play the oldest one. This covers the occasional long
+	 * stall from the SD card better than simple double buffering.
+	 */
+
+	for (i = 0; i < VID_IO_SLOTS; i++) {
+		r = &vid_req[i];
+		asyncIoReqInit (r, &f, buf + (VID_CHUNK_PIXELS *
+		    VID_SLOT_CHUNKS * i), VID_CHUNK_BYTES * VID_SLOT_CHUNKS);
+		asyncIoSubmit (r);
+	}
 
-	f_read(&f, p1, VID_CHUNK_BYTES * VID_CACHE_FACTOR, &br);
+	slot = 0;
 
 	/* Power up the audio amp */
 
@@ -219,20 +704,21 @@ videoWinPlay (char * fname, int x, int y)
 
 	badge_sleep_disable ();
 
-	while (1) {
+	videoStatsStart ();
 
-		if (br == 0)
-			break;
+	while (1) {
+		r = &vid_req[slot];
 
-		/* Start next async read */
+		/* Wait for the oldest read to complete */
 
-		asyncIoRead (&f, p2, VID_CHUNK_BYTES * VID_CACHE_FACTOR, &br);
+		br = asyncIoReqWait (r);
 
-		/* Accumulate audio sample data */
+		if (br < VID_CHUNK_BYTES)
+			break;
 
-		pcur = p1;
+		pcur = r->aio_buf;
 
-		for (i = 0; i < VID_CACHE_FACTOR; i++) {
+		for (i = 0; i < (int)(br / VID_CHUNK_BYTES); i++) {
 
 			/* Accumulate/play audio samples */
 
@@ -243,26 +729,29 @@ videoWinPlay (char * fname, int x, int y)
 			/* Draw the current batch of lines to the screen */
 
 			if (x == -1)
-				videoAccumulate (pcur, linebuf);
+				videoAccumulate (pcur, linebuf,
+				    VID_PIXELS_PER_LINE, VID_CHUNK_LINES);
 			else
-				videoAccumulate (pcur, NULL);
+				videoAccumulate (pcur, NULL,
+				    VID_PIXELS_PER_LINE, VID_CHUNK_LINES);
 
 			pcur += VID_CHUNK_PIXELS;
 		}
 
-		/* Switch to next waiting chunk */
+		/*
+		 * Requeue this slot. In windowed mode the last
+		 * block may still be DMAing out of it, so wait for
+		 * that first.
+		 */
 
-		if (p1 == buf) {
-			p1 += (VID_CHUNK_PIXELS * VID_CACHE_FACTOR);
-			p2 = buf;
-		} else {
-			p1 = buf;
-			p2 += (VID_CHUNK_PIXELS * VID_CACHE_FACTOR);
-		}
+		videoSpiWait ();
+		asyncIoSubmit (r);
 
-		/* Wait for async read to complete */
+		slot++;
+		if (slot == VID_IO_SLOTS)
+			slot = 0;
 
-		asyncIoWait ();
+		videoStatsTick ();
 
 		me = (GEventMouse *)geventEventWait (&gl, 0);
 		if (me != NULL && me->buttons & GMETA_MOUSE_DOWN)
@@ -271,14 +760,16 @@ videoWinPlay (char * fname, int x, int y)
 
 	badge_sleep_enable ();
 
+	videoStatsPrint ();
+
 	/* Drain any pending I/O */
 
+	for (i = 0; i < VID_IO_SLOTS; i++)
+		(void) asyncIoCancel (&vid_req[i]);
+
 	i2sSamplesWait ();
 	i2sSamplesStop ();
-	osalSysLock ();
-	if (SPID4.state != SPI_READY)
-		(void) osalThreadSuspendS (&SPID4.thread);
-	osalSysUnlock ();
+	videoSpiWait ();
 
 	/* Power down the audio amp */
 
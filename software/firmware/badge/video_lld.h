@@ -50,6 +50,18 @@
 
 #define VID_CACHE_FACTOR		4
 
+#define VID_IO_SLOTS			4
+
+/*
+ * Cluster link map size, in DWORDs. Enough for a file in 15
+ * pieces; anything more fragmented is read without a map.
+ */
+
+#define VID_CLMT_LEN			32
+
+#define VID_SLOT_CHUNKS					\
+	((VID_CACHE_FACTOR * 2) / VID_IO_SLOTS)
+
 #define VID_AUDIO_SAMPLES_PER_CHUNK			\
 	(VID_AUDIO_SAMPLES_PER_SCANLINE * VID_CHUNK_LINES)
 
@@ -73,6 +85,80 @@
 	((NRF5_GPT_FREQ_16MHZ * VID_CHUNK_LINES) /	\
 	(VID_LINES_PER_FRAME * VID_FRAMES_PER_SEC))
 
+/*
+ * Compressed video container (.VDZ)
+ *
+ * A .VDZ file starts with a VDZ_HDR, followed by vdz_keycnt
+ * VDZ_KEY index entries (one for every keyframe, which allows
+ * playback to start at something other than the beginning), followed
+ * by a stream of records. Each record holds up to vdz_group chunks
+ * and starts with the length of the record that comes after it, so
+ * that the player can always issue the next read for exactly the
+ * right amount of data while it decodes the current one. Records
+ * never span frames.
+ *
+ * Each chunk covers vdz_chunk_lines lines of the frame and carries
+ * the same VID_AUDIO_SAMPLES_PER_CHUNK audio samples that a .VID
+ * chunk does, so audio timing is identical between the two formats.
+ * The video portion is inter-frame delta coded: the chunk only
+ * describes the bounding rectangle of the pixels that changed since
+ * the previous frame (the rest is left alone in the display's own
+ * frame memory), and the pixels inside that rectangle are either
+ * raw or run-length encoded. A SKIP chunk carries no pixels at all.
+ *
+ * The run-length encoding is a stream of 16-bit opcodes: if
+ * VDZ_OP_RUN is set, the next word is a pixel value to be repeated
+ * (op & VDZ_OP_CNT) times, otherwise (op & VDZ_OP_CNT) literal
+ * pixels follow.
+ *
+ * All fields are little-endian. Pixel data is stored in display
+ * (big-endian RGB565) order, just like in .VID files.
+ */
+
+#define VDZ_MAGIC		0x315A4456	/* "VDZ1" */
+
+#define VDZ_CHUNK_SKIP		0
+#define VDZ_CHUNK_RAW		1
+#define VDZ_CHUNK_RLE		2
+
+#define VDZ_OP_RUN		0x8000
+#define VDZ_OP_CNT		0x7FFF
+
+typedef struct vdz_hdr {
+	uint32_t		vdz_magic;
+	uint16_t		vdz_width;
+	uint16_t		vdz_height;
+	uint16_t		vdz_chunk_lines;
+	uint16_t		vdz_group;
+	uint32_t		vdz_frames;
+	uint32_t		vdz_keycnt;
+	uint32_t		vdz_maxrec;
+	uint32_t		vdz_firstrec;
+} VDZ_HDR;
+
+typedef struct vdz_key {
+	uint32_t		vdz_frame;
+	uint32_t		vdz_off;
+	uint32_t		vdz_len;
+} VDZ_KEY;
+
+typedef struct vdz_rec {
+	uint16_t		vdz_chunks;
+	uint16_t		vdz_chunk0;
+	uint32_t		vdz_nextlen;
+} VDZ_REC;
+
+typedef struct vdz_chunk {
+	uint8_t			vdz_type;
+	uint8_t			vdz_pad;
+	uint16_t		vdz_len;
+	uint16_t		vdz_x;
+	uint16_t		vdz_y;
+	uint16_t		vdz_cx;
+	uint16_t		vdz_cy;
+	uint16_t		vdz_samples[VID_AUDIO_SAMPLES_PER_CHUNK];
+} VDZ_CHUNK;
+
 extern int videoWinPlay (char *, int, int);
 extern int videoPlay (char *);
 
@@ -50,6 +50,7 @@
 #include "hal_spi.h"
 #include "hal_pal.h"
 #include "badge.h"
+#include "mmc.h"
 
 #include "xpt2046_reg.h"
 #include "xpt2046_lld.h"
@@ -86,6 +87,11 @@ uint16_t xptGet (uint8_t cmd)
 	reg = cmd | XPT_CTL_START;
 
 	spiAcquireBus (&SPID1);
+
+	/* The SD card may still be selected with a read stream open */
+
+	mmc_disk_stream_stop ();
+
 	freq = SPID1.port->FREQUENCY;
 	SPID1.port->FREQUENCY = NRF5_SPI_FREQ_4MBPS;
 
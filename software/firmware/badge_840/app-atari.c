@@ -2,6 +2,9 @@
 #include "orchard-ui.h"
 
 #include "ble_lld.h"
+#include "limiter.h"
+
+#include <stdio.h>
 
 extern void atariRun (void);
 
@@ -39,6 +42,8 @@ atari_exit (OrchardAppContext *context)
 {
 	(void)context;
 
+	printf ("Atari: %d frames per second\n", limiter_stats.fps);
+
 	bleEnable ();
 	return;
 }
@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 
 #include "ff.h"
 #include "ffconf.h"
@@ -19,6 +20,9 @@
 #include "vmachine.h"
 #include "collision.h"
 #include "options.h"
+#include "limiter.h"
+
+#include "shell.h"
 
 /* The mainloop from cpu.c */
 extern void mainloop (void);
@@ -37,7 +41,8 @@ static THD_FUNCTION(atariThread, arg)
 
 	theCart = (BYTE *)0x20000100;
 	colvect = (BYTE *)(0x20000100 + 8192);
-	base_opts.rr = 1;
+	base_opts.rr = 0;
+	base_opts.limit = 1;
 	base_opts.magstep = 1;
 	base_opts.bank = 1;
 
@@ -60,6 +65,25 @@ static THD_FUNCTION(atariThread, arg)
 	return;
 }
 
+static void
+cmd_atari (BaseSequentialStream *chp, int argc, char *argv[])
+{
+	(void)chp;
+	(void)argc;
+	(void)argv;
+
+	printf ("Frames emulated:      %lu\r\n", limiter_stats.frames);
+	printf ("Frames skipped:       %lu\r\n", limiter_stats.skipped);
+	printf ("Emulated fps:         %d\r\n", limiter_stats.fps);
+	printf ("Frame CPU time (us):  %ld last, %ld average, %ld max\r\n",
+	    limiter_stats.frame_us, limiter_stats.avg_us,
+	    limiter_stats.max_us);
+
+	return;
+}
+
+orchard_command ("atari", cmd_atari);
+
 void
 atariRun (void)
 {
@@ -55,6 +55,26 @@ int tv_depth = 8;
 
 int tv_bytes_pp = 2;
 
+/*
+ * Pixels are expanded to RGB565 and doubled into one of two band
+ * buffers, which go out to the screen with a single SPI DMA each
+ * while the CPU fills the other one. The pixel stream runs straight
+ * on from one band to the next, so bands don't have to line up with
+ * scanlines.
+ */
+
+#if (NRF5_SPI_USE_SPI3 == TRUE)
+#define TV_SPI		SPID4
+#else
+#define TV_SPI		SPID1
+#endif
+
+#define TV_BAND_WORDS	(2 * 160)	/* Two scanlines at magstep 1 */
+
+static uint32_t tv_band[2][TV_BAND_WORDS];
+static int tv_bcur;
+static int tv_bpos;
+
 /* Create the color map of Atari colors */
 /* VGA colors are only 6 bits wide */
 static void
@@ -124,14 +144,47 @@ tv_on (int argc, char **argv)
 
         gdisp_lld_write_start (GDISP);
 
+	tv_bcur = 0;
+	tv_bpos = 0;
+
 	return (1);
 }
 
+/* Waits for the last band sent to the screen to finish */
+static void
+tv_wait (void)
+{
+	osalSysLock ();
+	if (TV_SPI.state == SPI_ACTIVE)
+		(void) osalThreadSuspendS (&TV_SPI.thread);
+	osalSysUnlock ();
+
+	return;
+}
+
+/* Starts sending the current band and switches to the other one */
+static void
+tv_flush (void)
+{
+	tv_wait ();
+
+	if (tv_bpos == 0)
+		return;
+
+	spiStartSend (&TV_SPI, tv_bpos * sizeof(uint32_t), tv_band[tv_bcur]);
+
+	tv_bcur ^= 1;
+	tv_bpos = 0;
+
+	return;
+}
 
 /* Turn off the tv. Closes the X connection and frees the shared memory */
 void
 tv_off (void)
 {
+	tv_flush ();
+	tv_wait ();
         gdisp_lld_write_stop (GDISP);
 	return;
 }
@@ -162,6 +215,20 @@ tv_event (void)
 	return;
 }
 
+/* Puts one pixel, doubled, into the current band */
+static inline void
+tv_putpixel (pixel_t pixel)
+{
+	uint32_t c;
+
+	c = colors[pixel];
+	tv_band[tv_bcur][tv_bpos++] = c | (c << 16);
+	if (tv_bpos == TV_BAND_WORDS)
+		tv_flush ();
+
+	return;
+}
+
 void
 tv_drawline (int line)
 {
@@ -173,11 +240,8 @@ tv_drawline (int line)
 
 	p = (uint16_t *)vscreen;
 	
-	for (i = 0; i < vwidth; i++) {
-		GDISP->p.color = colors[p[i]];
-		gdisp_lld_write_color (GDISP);
-		gdisp_lld_write_color (GDISP);
-	}
+	for (i = 0; i < vwidth; i++)
+		tv_putpixel (p[i]);
 
 	return;
 }
@@ -185,8 +249,6 @@ tv_drawline (int line)
 void
 tv_drawpixel (pixel_t pixel)
 {
-	GDISP->p.color = colors[pixel];
-	gdisp_lld_write_color (GDISP);
-	gdisp_lld_write_color (GDISP);
+	tv_putpixel (pixel);
 	return;
 }
@@ -105,12 +105,73 @@ u_stoshr (unsigned int val, ADDRESS address, BYTE index)
 }
 #endif /* UNDOC */
 
+/* 
+   Decoded instruction cache. Each entry holds the opcode and the two
+   bytes after it for an instruction in ROM, so mainloop() doesn't
+   have to go through the memory map for them. Entries are tagged by
+   offset into theCart, which covers both the bank and the PC, so a
+   bank switch doesn't need a flush; loading a new cart does.
+ */
+#define DCACHE_SIZE 512		/* Power of two */
+
+struct DecodedIns {
+  ADDRESS tag;			/* Offset into theCart + 1, or 0 */
+  BYTE op;
+  BYTE p1;
+  BYTE p2;
+};
+
+static struct DecodedIns dcache[DCACHE_SIZE];
+
+/* Instruction operands, from the cache if the instruction is there */
+#define OPER1 (ins != NULL ? ins->p1 : LOAD (PC + 1))
+#define OPER2 (ins != NULL ? (ADDRESS) LOHI (ins->p1, ins->p2) : \
+    load_abs_addr ())
+
+/* Look up the instruction at pc */
+/* pc: address of the instruction */
+/* returns: cache entry, or NULL if the instruction can't be cached */
+static inline struct DecodedIns *
+decode (ADDRESS pc)
+{
+  struct MemPage *p = MEM_PAGEOF (pc);
+  struct DecodedIns *d;
+  BYTE *rom;
+  ADDRESS tag;
+
+  /*
+     Only plain ROM is cached: RAM can change, and reads of bank
+     switching pages have side effects. The operands must be in the
+     same page.
+   */
+  if (!(pc & 0x1000) || p->read == NULL ||
+      (pc & MEM_PAGE_MASK) > MEM_PAGE_MASK - 2)
+    return NULL;
+
+  rom = &p->read[pc & MEM_PAGE_MASK];
+  tag = (rom - theCart) + 1;
+  d = &dcache[tag & (DCACHE_SIZE - 1)];
+  if (d->tag != tag)
+    {
+      d->tag = tag;
+      d->op = rom[0];
+      d->p1 = rom[1];
+      d->p2 = rom[2];
+    }
+  return d;
+}
+
 /* Initialise the CPU */
 /* addr: reset vector address */
 /* Called from init_hardware() */
 void
 init_cpu (ADDRESS addr)
 {
+  int i;
+
+  for (i = 0; i < DCACHE_SIZE; i++)
+    dcache[i].tag = 0;
+
   SET_SR (0x20);
   AC=0;
   XR=0;
@@ -128,7 +189,9 @@ init_cpu (ADDRESS addr)
 void
 mainloop (void)
 {
+  struct DecodedIns *ins;
   BYTE b;
+  int c;
   init_hardware ();
   while (1)
     {
@@ -152,13 +215,22 @@ mainloop (void)
 #endif
       while (!reset_flag)
 	{
-	  do_screen (clkcount);
+	  /* Leave the beam to do_screen() only when it changes state */
+	  c = clkcount * 3;
+	  if (c < beam_slack)
+	    {
+	      ebeamx += c;
+	      beam_slack -= c;
+	    }
+	  else
+	    do_screen (clkcount);
 
 #ifdef XDEBUGGER
 	  if (debugf_on)
 	  x_loop ();
 #endif
-	  b = LOADEXEC (PC);
+	  ins = decode (PC);
+	  b = (ins != NULL) ? ins->op : LOADEXEC (PC);
 	  beamadj = 0;
 
 	  switch (b)
@@ -188,7 +260,7 @@ mainloop (void)
 
 	    case 1:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -219,7 +291,7 @@ mainloop (void)
 
 	    case 3:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -249,7 +321,7 @@ mainloop (void)
 
 	    case 5:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -265,7 +337,7 @@ mainloop (void)
 
 	    case 6:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -283,7 +355,7 @@ mainloop (void)
 
 	    case 7:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -316,7 +388,7 @@ mainloop (void)
 
 	    case 9:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -349,7 +421,7 @@ mainloop (void)
 
 	    case 11:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & p1);
 		PC += 2;
 
@@ -374,7 +446,7 @@ mainloop (void)
 
 	    case 13:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -390,7 +462,7 @@ mainloop (void)
 
 	    case 14:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -408,7 +480,7 @@ mainloop (void)
 
 	    case 15:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -430,7 +502,7 @@ mainloop (void)
 	    case 16:
 /*  BPL,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		BYTE hb;
 		PC += 2;
@@ -455,7 +527,7 @@ mainloop (void)
 	    case 17:
 /* ORA,    INDIRECT_Y */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		PC += 2;
@@ -493,7 +565,7 @@ mainloop (void)
 
 	    case 19:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1) + YR);
 		PC += 2;
 
@@ -523,7 +595,7 @@ mainloop (void)
 
 	    case 21:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -539,7 +611,7 @@ mainloop (void)
 
 	    case 22:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -557,7 +629,7 @@ mainloop (void)
 
 	    case 23:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -590,7 +662,7 @@ mainloop (void)
 	    case 25:
 /*  ORA,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 
@@ -621,7 +693,7 @@ mainloop (void)
 
 	    case 27:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 
@@ -652,7 +724,7 @@ mainloop (void)
 	    case 29:
 /*   ORA,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -674,7 +746,7 @@ mainloop (void)
 
 	    case 30:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -692,7 +764,7 @@ mainloop (void)
 
 	    case 31:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -713,7 +785,7 @@ mainloop (void)
 
 	    case 32:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = p2;
 		PC += 3;
 		/* Jump to subroutine. */
@@ -735,7 +807,7 @@ mainloop (void)
 
 	    case 33:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -766,7 +838,7 @@ mainloop (void)
 
 	    case 35:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -790,7 +862,7 @@ mainloop (void)
 
 	    case 36:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -804,7 +876,7 @@ mainloop (void)
 
 	    case 37:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -820,7 +892,7 @@ mainloop (void)
 
 	    case 38:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -840,7 +912,7 @@ mainloop (void)
 
 	    case 39:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -878,7 +950,7 @@ mainloop (void)
 
 	    case 41:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -913,7 +985,7 @@ mainloop (void)
 
 	    case 43:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & p1);
 		PC += 2;
 
@@ -929,7 +1001,7 @@ mainloop (void)
 
 	    case 44:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -943,7 +1015,7 @@ mainloop (void)
 
 	    case 45:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -959,7 +1031,7 @@ mainloop (void)
 
 	    case 46:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -979,7 +1051,7 @@ mainloop (void)
 
 	    case 47:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -1004,7 +1076,7 @@ mainloop (void)
 	    case 48:
 /*   BMI,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		BYTE hb;
 		PC += 2;
@@ -1029,7 +1101,7 @@ mainloop (void)
 	    case 49:
 /*  AND,    INDIRECT_Y */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		PC += 2;
@@ -1066,7 +1138,7 @@ mainloop (void)
 
 	    case 51:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1) + YR);
 		PC += 2;
 
@@ -1099,7 +1171,7 @@ mainloop (void)
 
 	    case 53:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -1115,7 +1187,7 @@ mainloop (void)
 
 	    case 54:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -1135,7 +1207,7 @@ mainloop (void)
 
 	    case 55:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -1171,7 +1243,7 @@ mainloop (void)
 	    case 57:
 /*  AND,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 		if (pagetest (p2, YR))
@@ -1200,7 +1272,7 @@ mainloop (void)
 
 	    case 59:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 
@@ -1234,7 +1306,7 @@ mainloop (void)
 	    case 61:
 /*   AND,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 		if (pagetest (p2, XR))
@@ -1254,7 +1326,7 @@ mainloop (void)
 
 	    case 62:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -1274,7 +1346,7 @@ mainloop (void)
 
 	    case 63:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -1321,7 +1393,7 @@ mainloop (void)
 
 	    case 65:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -1352,7 +1424,7 @@ mainloop (void)
 
 	    case 67:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -1383,7 +1455,7 @@ mainloop (void)
 
 	    case 69:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -1399,7 +1471,7 @@ mainloop (void)
 
 	    case 70:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -1417,7 +1489,7 @@ mainloop (void)
 
 	    case 71:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -1453,7 +1525,7 @@ mainloop (void)
 
 	    case 73:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -1486,7 +1558,7 @@ mainloop (void)
 
 	    case 75:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & p1);
 		PC += 2;
 
@@ -1504,7 +1576,7 @@ mainloop (void)
 
 	    case 76:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = p2;
 		PC += 3;
 
@@ -1517,7 +1589,7 @@ mainloop (void)
 
 	    case 77:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -1533,7 +1605,7 @@ mainloop (void)
 
 	    case 78:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -1551,7 +1623,7 @@ mainloop (void)
 
 	    case 79:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -1574,7 +1646,7 @@ mainloop (void)
 	    case 80:
 /*   BVC,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		BYTE hb;
 		PC += 2;
@@ -1599,7 +1671,7 @@ mainloop (void)
 	    case 81:
 /* EOR,    INDIRECT_Y */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned short p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		PC += 2;
@@ -1636,7 +1708,7 @@ mainloop (void)
 
 	    case 83:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1) + YR);
 		PC += 2;
 
@@ -1667,7 +1739,7 @@ mainloop (void)
 
 	    case 85:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -1683,7 +1755,7 @@ mainloop (void)
 
 	    case 86:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -1701,7 +1773,7 @@ mainloop (void)
 
 	    case 87:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -1735,7 +1807,7 @@ mainloop (void)
 	    case 89:
 /*  EOR,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 		if (pagetest (p2, YR))
@@ -1765,7 +1837,7 @@ mainloop (void)
 
 	    case 91:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 
@@ -1797,7 +1869,7 @@ mainloop (void)
 	    case 93:
 /*  EOR,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 		if (pagetest (p2, XR))
@@ -1818,7 +1890,7 @@ mainloop (void)
 
 	    case 94:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -1836,7 +1908,7 @@ mainloop (void)
 
 	    case 95:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -1878,7 +1950,7 @@ mainloop (void)
 
 	    case 97:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
 		PC += 2;
@@ -1936,7 +2008,7 @@ mainloop (void)
 
 	    case 99:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		unsigned int temp;
 		PC += 2;
@@ -1987,7 +2059,7 @@ mainloop (void)
 
 	    case 101:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
 		PC += 2;
@@ -2030,7 +2102,7 @@ mainloop (void)
 
 	    case 102:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -2050,7 +2122,7 @@ mainloop (void)
 
 	    case 103:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		unsigned int temp;
 		PC += 2;
@@ -2109,7 +2181,7 @@ mainloop (void)
 
 	    case 105:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
 		PC += 2;
@@ -2171,7 +2243,7 @@ mainloop (void)
 
 	    case 107:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & p1);
 		PC += 2;
 
@@ -2191,7 +2263,7 @@ mainloop (void)
 
 	    case 108:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD_ADDR (p2);
 		PC += 3;
 
@@ -2204,7 +2276,7 @@ mainloop (void)
 
 	    case 109:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
 		PC += 3;
@@ -2247,7 +2319,7 @@ mainloop (void)
 
 	    case 110:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -2267,7 +2339,7 @@ mainloop (void)
 
 	    case 111:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		unsigned int temp;
 		PC += 3;
@@ -2310,7 +2382,7 @@ mainloop (void)
 	    case 112:
 /*   BVS,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		BYTE hb;
 		PC += 2;
@@ -2334,7 +2406,7 @@ mainloop (void)
 
 	    case 113:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
@@ -2398,7 +2470,7 @@ mainloop (void)
 
 	    case 115:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1) + YR);
 		unsigned int temp;
 		PC += 2;
@@ -2449,7 +2521,7 @@ mainloop (void)
 
 	    case 117:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
 		PC += 2;
@@ -2492,7 +2564,7 @@ mainloop (void)
 
 	    case 118:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -2512,7 +2584,7 @@ mainloop (void)
 
 	    case 119:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		unsigned int temp;
 		PC += 2;
@@ -2566,7 +2638,7 @@ mainloop (void)
 	    case 121:
 /*   ADC,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
 		PC += 3;
@@ -2623,7 +2695,7 @@ mainloop (void)
 
 	    case 123:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		unsigned int temp;
 		PC += 3;
@@ -2675,7 +2747,7 @@ mainloop (void)
 	    case 125:
 /*  ADC,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		unsigned int temp = src + AC + (IF_CARRY ()? 1 : 0);
 		PC += 3;
@@ -2723,7 +2795,7 @@ mainloop (void)
 
 	    case 126:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -2743,7 +2815,7 @@ mainloop (void)
 
 	    case 127:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		unsigned int temp;
 		PC += 3;
@@ -2794,7 +2866,7 @@ mainloop (void)
 
 	    case 129:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = AC;
 		PC += 2;
 
@@ -2816,7 +2888,7 @@ mainloop (void)
 
 	    case 131:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & XR);
 		PC += 2;
 
@@ -2830,7 +2902,7 @@ mainloop (void)
 	    case 132:
 /*  STY,    ZERO_PAGE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = YR;
 
 		clkcount = 3;
@@ -2845,7 +2917,7 @@ mainloop (void)
 	    case 133:
 /*   STA,    ZERO_PAGE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = AC;
 
 		clkcount = 3;
@@ -2860,7 +2932,7 @@ mainloop (void)
 	    case 134:
 /*  STX,    ZERO_PAGE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = XR;
 
 		clkcount = 3;
@@ -2874,7 +2946,7 @@ mainloop (void)
 
 	    case 135:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & XR);
 		PC += 2;
 
@@ -2925,7 +2997,7 @@ mainloop (void)
 
 	    case 139:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = ((AC | 0xee) & XR & p1);
 		PC += 2;
 
@@ -2941,7 +3013,7 @@ mainloop (void)
 	    case 140:
 /*  STY,    ABSOLUTE */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = YR;
 		PC += 3;
 
@@ -2955,7 +3027,7 @@ mainloop (void)
 	    case 141:
 /*  STA,    ABSOLUTE */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = AC;
 		PC += 3;
 
@@ -2969,7 +3041,7 @@ mainloop (void)
 	    case 142:
 /*  STA,    ABSOLUTE */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = XR;
 		PC += 3;
 
@@ -2983,7 +3055,7 @@ mainloop (void)
 	    case 143:
 /* STX,    ABSOLUTE */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = (AC & XR);
 		PC += 3;
 
@@ -2997,7 +3069,7 @@ mainloop (void)
 	    case 144:
 /*  BCC,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS hb;
 		unsigned int src = p1;
 		PC += 2;
@@ -3021,7 +3093,7 @@ mainloop (void)
 
 	    case 145:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = AC;
 		PC += 2;
 
@@ -3049,7 +3121,7 @@ mainloop (void)
 
 	    case 147:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & XR);
 		PC += 2;
 
@@ -3062,7 +3134,7 @@ mainloop (void)
 
 	    case 148:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = YR;
 		clkcount = 4;
 		PC += 2;
@@ -3076,7 +3148,7 @@ mainloop (void)
 	    case 149:
 /*  STA,    ZERO_PAGE_X */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = AC;
 		clkcount = 4;
 		PC += 2;
@@ -3090,7 +3162,7 @@ mainloop (void)
 	    case 150:
 /* STX,    ZERO_PAGE_Y */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = XR;
 		clkcount = 4;
 		PC += 2;
@@ -3103,7 +3175,7 @@ mainloop (void)
 
 	    case 151:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & XR);
 		PC += 2;
 
@@ -3130,7 +3202,7 @@ mainloop (void)
 
 	    case 153:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = AC;
 		PC += 3;
 
@@ -3167,7 +3239,7 @@ mainloop (void)
 
 	    case 156:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = YR;
 		PC += 3;
 
@@ -3180,7 +3252,7 @@ mainloop (void)
 
 	    case 157:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = AC;
 		PC += 3;
 
@@ -3193,7 +3265,7 @@ mainloop (void)
 
 	    case 158:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = XR;
 		PC += 3;
 
@@ -3206,7 +3278,7 @@ mainloop (void)
 
 	    case 159:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = (AC & XR);
 		PC += 3;
 
@@ -3219,7 +3291,7 @@ mainloop (void)
 
 	    case 160:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -3234,7 +3306,7 @@ mainloop (void)
 
 	    case 161:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -3249,7 +3321,7 @@ mainloop (void)
 
 	    case 162:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -3264,7 +3336,7 @@ mainloop (void)
 
 	    case 163:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -3279,7 +3351,7 @@ mainloop (void)
 
 	    case 164:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -3294,7 +3366,7 @@ mainloop (void)
 
 	    case 165:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -3326,7 +3398,7 @@ mainloop (void)
 
 	    case 167:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -3355,7 +3427,7 @@ mainloop (void)
 
 	    case 169:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -3384,7 +3456,7 @@ mainloop (void)
 
 	    case 171:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = (AC & p1);
 		PC += 2;
 
@@ -3399,7 +3471,7 @@ mainloop (void)
 
 	    case 172:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -3414,7 +3486,7 @@ mainloop (void)
 
 	    case 173:		/* LDA absolute */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src;
 		clkcount = 4;
 		src = LOAD (p2);
@@ -3430,7 +3502,7 @@ mainloop (void)
 
 	    case 174:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -3445,7 +3517,7 @@ mainloop (void)
 
 	    case 175:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -3461,7 +3533,7 @@ mainloop (void)
 	    case 176:
 /*   BCS,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		BYTE hb;
 		PC += 2;
@@ -3486,7 +3558,7 @@ mainloop (void)
 	    case 177:
 /*   LDA,    INDIRECT_Y */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		PC += 2;
@@ -3524,7 +3596,7 @@ mainloop (void)
 	    case 179:
 /*   LAX,    INDIRECT_Y */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		PC += 2;
@@ -3545,7 +3617,7 @@ mainloop (void)
 
 	    case 180:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -3560,7 +3632,7 @@ mainloop (void)
 
 	    case 181:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -3575,7 +3647,7 @@ mainloop (void)
 
 	    case 182:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + YR);
 		PC += 2;
 
@@ -3590,7 +3662,7 @@ mainloop (void)
 
 	    case 183:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + YR);
 		PC += 2;
 
@@ -3616,7 +3688,7 @@ mainloop (void)
 
 	    case 185:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 		if (pagetest (p2, YR))
@@ -3650,7 +3722,7 @@ mainloop (void)
 
 	    case 187:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = (SP & LOAD (p2 + YR));
 		PC += 3;
 		if (pagetest (p2, YR))
@@ -3671,7 +3743,7 @@ mainloop (void)
 	    case 188:
 /*   LDY,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 		if (pagetest (p2, XR))
@@ -3693,7 +3765,7 @@ mainloop (void)
 	    case 189:
 /*  LDA,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -3715,7 +3787,7 @@ mainloop (void)
 	    case 190:
 /*   LDX,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 		if (pagetest (p2, YR))
@@ -3736,7 +3808,7 @@ mainloop (void)
 	    case 191:
 /*   LAX,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 		if (pagetest (p2, YR))
@@ -3756,7 +3828,7 @@ mainloop (void)
 
 	    case 192:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -3771,7 +3843,7 @@ mainloop (void)
 
 	    case 193:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -3795,7 +3867,7 @@ mainloop (void)
 
 	    case 195:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		PC += 2;
 
@@ -3814,7 +3886,7 @@ mainloop (void)
 
 	    case 196:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -3829,7 +3901,7 @@ mainloop (void)
 
 	    case 197:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -3844,7 +3916,7 @@ mainloop (void)
 
 	    case 198:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -3860,7 +3932,7 @@ mainloop (void)
 
 	    case 199:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -3894,7 +3966,7 @@ mainloop (void)
 
 	    case 201:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -3924,7 +3996,7 @@ mainloop (void)
 
 	    case 203:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -3944,7 +4016,7 @@ mainloop (void)
 
 	    case 204:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -3959,7 +4031,7 @@ mainloop (void)
 
 	    case 205:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -3974,7 +4046,7 @@ mainloop (void)
 
 	    case 206:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -3990,7 +4062,7 @@ mainloop (void)
 
 	    case 207:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -4010,7 +4082,7 @@ mainloop (void)
 	    case 208:
 /*  BNE,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		BYTE hb;
 		PC += 2;
@@ -4035,7 +4107,7 @@ mainloop (void)
 	    case 209:
 /*   CMP,    INDIRECT_Y */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		PC += 2;
@@ -4071,7 +4143,7 @@ mainloop (void)
 
 	    case 211:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1) + YR);
 		PC += 2;
 
@@ -4099,7 +4171,7 @@ mainloop (void)
 
 	    case 213:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -4114,7 +4186,7 @@ mainloop (void)
 
 	    case 214:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -4130,7 +4202,7 @@ mainloop (void)
 
 	    case 215:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -4161,7 +4233,7 @@ mainloop (void)
 	    case 217:
 /*   CMP,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 		if (pagetest (p2, YR))
@@ -4190,7 +4262,7 @@ mainloop (void)
 
 	    case 219:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		PC += 3;
 
@@ -4219,7 +4291,7 @@ mainloop (void)
 	    case 221:
 /*   CMP,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 		if (pagetest (p2, XR))
@@ -4239,7 +4311,7 @@ mainloop (void)
 
 	    case 222:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -4255,7 +4327,7 @@ mainloop (void)
 
 	    case 223:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -4274,7 +4346,7 @@ mainloop (void)
 
 	    case 224:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		PC += 2;
 
@@ -4289,7 +4361,7 @@ mainloop (void)
 
 	    case 225:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 2;
@@ -4330,7 +4402,7 @@ mainloop (void)
 
 	    case 227:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1 + XR));
 		unsigned int temp;
 		PC += 2;
@@ -4366,7 +4438,7 @@ mainloop (void)
 
 	    case 228:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -4381,7 +4453,7 @@ mainloop (void)
 
 	    case 229:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 2;
@@ -4413,7 +4485,7 @@ mainloop (void)
 
 	    case 230:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		PC += 2;
 
@@ -4429,7 +4501,7 @@ mainloop (void)
 
 	    case 231:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1);
 		unsigned int temp;
 		PC += 2;
@@ -4481,7 +4553,7 @@ mainloop (void)
 	    case 233:
 /*  SBC,    IMMEDIATE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 2;
@@ -4536,7 +4608,7 @@ mainloop (void)
 
 	    case 235:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 2;
@@ -4568,7 +4640,7 @@ mainloop (void)
 
 	    case 236:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -4583,7 +4655,7 @@ mainloop (void)
 
 	    case 237:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 3;
@@ -4615,7 +4687,7 @@ mainloop (void)
 
 	    case 238:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		PC += 3;
 
@@ -4631,7 +4703,7 @@ mainloop (void)
 
 	    case 239:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2);
 		unsigned int temp;
 		PC += 3;
@@ -4668,7 +4740,7 @@ mainloop (void)
 	    case 240:
 /*   BEQ,    RELATIVE */
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = p1;
 		BYTE hb;
 		PC += 2;
@@ -4692,7 +4764,7 @@ mainloop (void)
 
 	    case 241:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		ADDRESS p2 = LOAD_ZERO_ADDR (p1);
 		unsigned int src = LOAD (p2 + YR);
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
@@ -4746,7 +4818,7 @@ mainloop (void)
 
 	    case 243:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD (LOAD_ZERO_ADDR (p1) + YR);
 		unsigned int temp;
 		PC += 2;
@@ -4791,7 +4863,7 @@ mainloop (void)
 
 	    case 245:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 2;
@@ -4823,7 +4895,7 @@ mainloop (void)
 
 	    case 246:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		PC += 2;
 
@@ -4839,7 +4911,7 @@ mainloop (void)
 
 	    case 247:
 	      {
-		BYTE p1 = LOAD (PC + 1);
+		BYTE p1 = OPER1;
 		unsigned int src = LOAD_ZERO (p1 + XR);
 		unsigned int temp;
 		PC += 2;
@@ -4887,7 +4959,7 @@ mainloop (void)
 	    case 249:
 /*  SBC,    ABSOLUTE_Y */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 3;
@@ -4934,7 +5006,7 @@ mainloop (void)
 
 	    case 251:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + YR);
 		unsigned int temp;
 		PC += 3;
@@ -4980,7 +5052,7 @@ mainloop (void)
 	    case 253:
 /*   SBC,    ABSOLUTE_X */
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		unsigned int temp = AC - src - (IF_CARRY ()? 0 : 1);
 		PC += 3;
@@ -5018,7 +5090,7 @@ mainloop (void)
 
 	    case 254:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		PC += 3;
 
@@ -5034,7 +5106,7 @@ mainloop (void)
 
 	    case 255:
 	      {
-		unsigned short p2 = load_abs_addr ();
+		unsigned short p2 = OPER2;
 		unsigned int src = LOAD (p2 + XR);
 		unsigned int temp;
 		PC += 3;
@@ -16,27 +16,46 @@
 ******************************************************************************/
 
 /*
-   Attempt at a speed limiter.
-   (You'll have a fast computer to need it though!) 
+   Frame pacer.
+
+   At the start of each vertical blank, limiter_sync() works out how
+   long the frame just emulated took and keeps a running balance of
+   real time against emulated time. When the balance is positive the
+   emulator is ahead, and if speed limiting is on it sleeps the
+   difference off. When the balance goes negative the emulator is
+   behind, and with a refresh rate of 0 the next frame is emulated
+   without being drawn. Everything but the drawing still happens on
+   a skipped frame (registers, collisions, sound), so games and
+   audio keep to time and only the picture drops frames.
  */
 
+#include <string.h>
+
+#include "ch.h"
 #include "config.h"
 #include "options.h"
-#include <sys/time.h>
-#include <unistd.h>
 #include "types.h"
 #include "vmachine.h"
+#include "limiter.h"
+
+/* Most frames skipped in a row, so the picture never freezes */
+#define LIMITER_MAXSKIP 4
 
 /* Global variables. A C++ implementation would hide these */
-struct timeval limiter_lastClk;
-struct timeval limiter_newClk;
+struct LimiterStats limiter_stats;
+int limiter_skip = 0;
 long limiter_fTime = 0;
-long limiter_last = 0;
-long limiter_new = 0;
-long limiter_endSleep = 0;
 int limiter_frameRate = 0;
 int limiter_vRate = 0;
 
+/* Microseconds ahead of real time, negative when behind */
+static long limiter_balance;
+static systime_t limiter_start;
+static systime_t limiter_fpsStart;
+static int limiter_fpsFrames;
+static int limiter_skipRun;
+static unsigned long long limiter_totalUs;
+
 
 /* Get the currently set frame rate */
 /* returns: currently set rate */
@@ -61,11 +80,15 @@ limiter_setFrameRate (int f)
 void
 limiter_init (void)
 {
-#ifdef notdef
-  gettimeofday (&limiter_lastClk, NULL);
-  gettimeofday (&limiter_newClk, NULL);
-#endif
-  limiter_endSleep = limiter_lastClk.tv_usec;
+  limiter_balance = 0;
+  limiter_skip = 0;
+  limiter_skipRun = 0;
+  limiter_fpsFrames = 0;
+  limiter_totalUs = 0;
+  memset (&limiter_stats, 0, sizeof(limiter_stats));
+
+  limiter_start = chVTGetSystemTimeX ();
+  limiter_fpsStart = limiter_start;
 }
 
 /* Perform the speed limiting syncronisation */
@@ -73,39 +96,65 @@ limiter_init (void)
 long
 limiter_sync (void)
 {
-  long delta = 0, wait = 0;
-
-  /* Get the current time */
-#ifdef notdef
-  gettimeofday (&limiter_newClk, NULL);
-#endif
-
-  if (limiter_newClk.tv_usec < limiter_endSleep)
-    limiter_endSleep -= 1000000;
-
-  /* how long to wait. Min is 0 usec, max is ftime. */
-  wait = (limiter_fTime - limiter_newClk.tv_usec + limiter_endSleep);
-  if (wait < 0)
-    wait = 0;
-  else if (wait > limiter_fTime)
-    wait = limiter_fTime;
-
-  /* Do the waiting */
-#ifdef HAVE_SELECT 
-  if(base_opts.limit && wait>10)
+  systime_t now;
+  long work, wait = 0;
+
+  /* How long the frame took, not counting any sleep */
+  now = chVTGetSystemTimeX ();
+  work = TIME_I2US (chTimeDiffX (limiter_start, now));
+
+  limiter_stats.frames++;
+  if (limiter_skip)
+    limiter_stats.skipped++;
+  limiter_stats.frame_us = work;
+  if (work > limiter_stats.max_us)
+    limiter_stats.max_us = work;
+  limiter_totalUs += work;
+  limiter_stats.avg_us = limiter_totalUs / limiter_stats.frames;
+
+  limiter_fpsFrames++;
+  if (chTimeDiffX (limiter_fpsStart, now) >= TIME_MS2I (1000))
     {
-      struct timeval tv_wait={0, wait};
-      select(0,0,0,0,&tv_wait);
+      limiter_stats.fps = limiter_fpsFrames;
+      limiter_fpsFrames = 0;
+      limiter_fpsStart = now;
     }
-#endif
 
-  limiter_endSleep = limiter_newClk.tv_usec + wait;
-  delta = limiter_newClk.tv_usec - limiter_lastClk.tv_usec;
+  limiter_balance += limiter_fTime - work;
+
+  /* Ahead: sleep it off */
+  if (base_opts.limit && limiter_balance > 0)
+    {
+      chThdSleep (TIME_US2I (limiter_balance));
+      wait = TIME_I2US (chVTTimeElapsedSinceX (now));
+      limiter_balance -= wait;
+    }
+
+  /*
+   * Don't bank more than a frame of slack, and don't try to catch
+   * up on more than a few frames; past that we've simply lost time.
+   */
+  if (limiter_balance > limiter_fTime)
+    limiter_balance = limiter_fTime;
+  if (limiter_balance < -LIMITER_MAXSKIP * limiter_fTime)
+    limiter_balance = -LIMITER_MAXSKIP * limiter_fTime;
+
+  /* Behind: don't draw the next frame */
+  if (base_opts.rr == 0 && limiter_balance < 0 &&
+      limiter_skipRun < LIMITER_MAXSKIP)
+    {
+      limiter_skip = 1;
+      limiter_skipRun++;
+    }
+  else
+    {
+      limiter_skip = 0;
+      limiter_skipRun = 0;
+    }
 
-#ifdef notdef
-  gettimeofday (&limiter_lastClk, NULL);
-#endif
+  limiter_start = chVTGetSystemTimeX ();
 
-  limiter_vRate = 1000000 / delta;
-  return delta;
+  if (work + wait > 0)
+    limiter_vRate = 1000000 / (work + wait);
+  return work + wait;
 }
@@ -23,6 +23,22 @@
 #ifndef LIMITER_H
 #define LIMITER_H
 
+/* Frame pacer counters, for the "atari" shell command */
+struct LimiterStats
+{
+  unsigned long frames;		/* Frames emulated */
+  unsigned long skipped;	/* Frames emulated but not drawn */
+  int fps;			/* Frames emulated in the last second */
+  long frame_us;		/* CPU time of the last frame */
+  long avg_us;			/* Average CPU time per frame */
+  long max_us;			/* Longest frame so far */
+};
+
+extern struct LimiterStats limiter_stats;
+
+/* Set while the current frame is not being drawn */
+extern int limiter_skip;
+
 void limiter_setFrameRate( int f );
 void limiter_init(void);
 long limiter_sync(void);
@@ -28,19 +28,20 @@
 
 #include "types.h"
 #include "cpu.h"
+#include "memory.h"
 
-#define LOAD(a)      		decRead(a)
-#define LOADEXEC(a)      	undecRead(a)
+#define LOAD(a)      		memRead(a)
+#define LOADEXEC(a)      	memExec(a)
 #define DLOAD(a)                dbgRead(a)
-#define LOAD_ZERO(a) 		decRead((ADDRESS)a)
+#define LOAD_ZERO(a) 		memRead((ADDRESS)a)
 #define LOAD_ADDR(a)		((LOAD(a+1)<<8)+LOAD(a))
 #define LOAD_ZERO_ADDR(a)	LOAD_ADDR(a)
 
-#define STORE(a,b)     	 	decWrite((a),(b))
-#define STORE_ZERO(a,b)         decWrite((a),(b))
+#define STORE(a,b)     	 	memWrite((a),(b))
+#define STORE_ZERO(a,b)         memWrite((a),(b))
 
-#define PUSH(b) 		decWrite(SP+0x100,(b));SP--
-#define PULL()			decRead((++SP)+0x100)
+#define PUSH(b) 		memWrite(SP+0x100,(b));SP--
+#define PULL()			memRead((++SP)+0x100)
 
 #define UPPER(ad)		(((ad)>>8)&0xff)
 #define LOWER(ad)		((ad)&0xff)
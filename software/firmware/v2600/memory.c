@@ -36,27 +36,30 @@
 #include "keyboard.h"
 #include "sound.h"
 #include "dbg_mess.h"
+#include "memory.h"
 
 extern CLOCK clkcount;
 extern CLOCK clk;
 extern int beamadj;
 
+/* The page table, see memory.h */
+struct MemPage mem_page[MEM_PAGES];
+
 /* Undecoded Read, for executable code etc. */
 /* a: address to read */
 /* returns: byte at address a */
 BYTE
 undecRead (ADDRESS a)
 {
-  if (a & 0x1000)
-    return theRom[a & 0xfff];
-  else
-    return theRam[a & 0x7f];
+  return memExec (a);
 }
 
 
 void
 bank_switch_write (ADDRESS a, BYTE b)
 {
+  BYTE *rom = theRom;
+
   a&=0xfff;
   switch (base_opts.bank)
     {
@@ -163,11 +166,14 @@ bank_switch_write (ADDRESS a, BYTE b)
       break;
 #endif
     }
+  if (theRom != rom)
+    mem_map_rom ();
 }
 
 BYTE
 bank_switch_read (ADDRESS a)
 {
+  BYTE *rom = theRom;
   BYTE res;
 
   a&=0xfff;
@@ -283,502 +289,571 @@ bank_switch_read (ADDRESS a)
       res=theRom[a];
       break;
     }
+  if (theRom != rom)
+    mem_map_rom ();
   return res;
 }
 
 
-/* Decoded write to memory */
+/* Write to a TIA page */
 /* a: address written to */
 /* b: byte value written */
-void
-decWrite (ADDRESS a, BYTE b)
+static void
+tia_write (ADDRESS a, BYTE b)
 {
   int i;
 
-  /* A Write to the ROM area */
-  if (a & 0x1000)
-    {
-      bank_switch_write (a,b);
-    }
-  /* A Write to the RAM area in Page 0 and 1 */
-  else if ((a & 0x280) == 0x80)
-    {
-      theRam[a & 0x7f] = b;
-    }
-  /* TIA */
-  else if (!(a & 0x80))
+  switch (a & 0x7f)
     {
-      switch (a & 0x7f)
+    case VSYNC:
+      if (b & 0x02)
 	{
-	case VSYNC:
-	  if (b & 0x02)
-	    {
-	      /* Start vertical sync */
-	      vbeam_state = VSYNCSTATE;
-	    }
-	  break;
-	case VBLANK:
-	  do_vblank (b);
-	  /* Ground paddle pots */
-	  if (b & 0x80)
+	  /* Start vertical sync */
+	  vbeam_state = VSYNCSTATE;
+	  beam_slack = 0;
+	}
+      break;
+    case VBLANK:
+      do_vblank (b);
+      /* Ground paddle pots */
+      if (b & 0x80)
+	{
+	  /* Grounded ports */
+	  tiaRead[INPT0] = 0x00;
+	  tiaRead[INPT1] = 0x00;
+	}
+      else
+	{
+	  /* Processor now measures time for a logic 1 to appear
+	     at each paddle port */
+	  tiaRead[INPT0] = 0x80;
+	  tiaRead[INPT1] = 0x80;
+	  paddle[0].val = clk;
+	  paddle[1].val = clk;
+	}
+      /* Logic for dumped input ports */
+      if (b & 0x40)
+	{
+	  if (tiaWrite[VBLANK] & 0x40)
 	    {
-	      /* Grounded ports */
-	      tiaRead[INPT0] = 0x00;
-	      tiaRead[INPT1] = 0x00;
+	      tiaRead[INPT4] = 0x80;
+	      tiaRead[INPT5] = 0x80;
 	    }
 	  else
 	    {
-	      /* Processor now measures time for a logic 1 to appear
-	         at each paddle port */
-	      tiaRead[INPT0] = 0x80;
-	      tiaRead[INPT1] = 0x80;
-	      paddle[0].val = clk;
-	      paddle[1].val = clk;
-	    }
-	  /* Logic for dumped input ports */
-	  if (b & 0x40)
-	    {
-	      if (tiaWrite[VBLANK] & 0x40)
-		{
-		  tiaRead[INPT4] = 0x80;
-		  tiaRead[INPT5] = 0x80;
-		}
-	      else
-		{
-		  read_trigger ();
-		}
+	      read_trigger ();
 	    }
-	  tiaWrite[VBLANK] = b;
-	  break;
-	case WSYNC:
-	  /* Skip to HSYNC pulse */
-	  do_hsync ();
-	  break;
-	case RSYNC:
-	  /* used in chip testing */
+	}
+      tiaWrite[VBLANK] = b;
+      break;
+    case WSYNC:
+      /* Skip to HSYNC pulse */
+      do_hsync ();
+      break;
+    case RSYNC:
+      /* used in chip testing */
 #ifdef DEBUG
-	  dbg_message(DBG_LOTS,"ARGHH an undocumented RSYNC!\n");
+      dbg_message(DBG_LOTS,"ARGHH an undocumented RSYNC!\n");
 #endif
-	  break;
-	case NUSIZ0:
-	  /*
-	     printf("P0 nusize: ebeamx=%d, ebeamy=%d, nusize=%02x\n",
-	     ebeamx, ebeamy, (int)b);
-	   */
-	  pl[0].nusize = b & 0x07;
-	  ml[0].width = (b & 0x30) >> 4;
-	  break;
-	case NUSIZ1:
-	  /*
-	     printf("P1 nusize: ebeamx=%d, ebeamy=%d, nusize=%02x\n",
-	     ebeamx, ebeamy, (int)b);
-	   */
-	  pl[1].nusize = b & 0x07;
-	  ml[1].width = (b & 0x30) >> 4;
-	  break;
-	case COLUP0:
-	  do_unified_change (0, tv_color (b));
-	  break;
-	case COLUP1:
-	  do_unified_change (1, tv_color (b));
-	  break;
-	case COLUPF:
-	  do_unified_change (2, tv_color (b));
-	  break;
-	case COLUBK:
-	  /*printf("BKcolour = %d, line=%d\n", (int)(b>>1), ebeamy); */
-	  do_unified_change (3, tv_color (b));
-	  break;
-	case CTRLPF:
-	  tiaWrite[CTRLPF] = b & 0x37;	/* Bitmask 00110111 */
-	  do_pfraster_change (0, 3, b & 0x01);	/* Reflection */
-	  
-	  /* Normal/Alternate priority */
-	  do_unified_change(4, (b & 0x04));
-	  
-	  /* Scores/Not scores */
-	  do_unified_change(5, (b & 0x02));
+      break;
+    case NUSIZ0:
+      /*
+	 printf("P0 nusize: ebeamx=%d, ebeamy=%d, nusize=%02x\n",
+	 ebeamx, ebeamy, (int)b);
+       */
+      pl[0].nusize = b & 0x07;
+      ml[0].width = (b & 0x30) >> 4;
+      break;
+    case NUSIZ1:
+      /*
+	 printf("P1 nusize: ebeamx=%d, ebeamy=%d, nusize=%02x\n",
+	 ebeamx, ebeamy, (int)b);
+       */
+      pl[1].nusize = b & 0x07;
+      ml[1].width = (b & 0x30) >> 4;
+      break;
+    case COLUP0:
+      do_unified_change (0, tv_color (b));
+      break;
+    case COLUP1:
+      do_unified_change (1, tv_color (b));
+      break;
+    case COLUPF:
+      do_unified_change (2, tv_color (b));
+      break;
+    case COLUBK:
+      /*printf("BKcolour = %d, line=%d\n", (int)(b>>1), ebeamy); */
+      do_unified_change (3, tv_color (b));
+      break;
+    case CTRLPF:
+      tiaWrite[CTRLPF] = b & 0x37;  /* Bitmask 00110111 */
+      do_pfraster_change (0, 3, b & 0x01);  /* Reflection */
+      
+      /* Normal/Alternate priority */
+      do_unified_change(4, (b & 0x04));
+      
+      /* Scores/Not scores */
+      do_unified_change(5, (b & 0x02));
 
-	  break;
-	case REFP0:
-	  pl[0].reflect = (b & 0x08) >> 3;
-	  break;
-	case REFP1:
-	  pl[1].reflect = (b & 0x08) >> 3;
-	  break;
-	case PF0:
-	  do_pfraster_change (0, 0, b & 0xf0);
-	  break;
-	case PF1:
-	  do_pfraster_change (0, 1, b);
-	  break;
-	case PF2:
-	  do_pfraster_change (0, 2, b);
-	  break;
-	case RESP0:
-	  /* Ghost in pacman!
-	     if(beamadj == 0) {
-	     printf("RESP0: ebeamx=%d, ebeamy=%d\n",
-	     ebeamx, ebeamy); 
-	     show();
-	     } */
-	  pl[0].x = ebeamx + beamadj;
-	  /* As per page 20 Stella Programmers Guide */
-	  if (pl[0].x < 0)
-	    pl[0].x = 0;
-	  break;
-	case RESP1:
-	  /*if(beamadj == 0) {
-	     printf("RESP1: ebeamx=%d, ebeamy=%d\n",
-	     ebeamx, ebeamy);
-	     show(); 
-	     } */
-	  pl[1].x = ebeamx + beamadj;
-	  /* As per page 20 Stella Programmers Guide */
-	  if (pl[1].x < 0)
-	    pl[1].x = 0;
-	  break;
-	case RESM0:
-	  ml[0].x = ebeamx + beamadj;
-	  /* As per page 20 Stella Programmers Guide */
-	  if (ml[0].x < 0)
-	    ml[0].x = 0;
-	  break;
-	case RESM1:
-	  ml[1].x = ebeamx + beamadj;
-	  /* As per page 20 Stella Programmers Guide */
-	  if (ml[1].x < 0)
-	    ml[1].x = 0;
-	  break;
-	case RESBL:
-	  ml[2].x = ebeamx + beamadj;
-	  /* As per page 20 Stella Programmers Guide */
-	  if (ml[2].x < 0)
-	    ml[2].x = 0;
-	  break;
-	case AUDC0:
-	  sound_waveform (0, b & 0x0f);
-	  break;
-	case AUDC1:
-	  sound_waveform (1, b & 0x0f);
-	  break;
-	case AUDF0:
-	  sound_freq (0, b & 0x1f);
-	  break;
-	case AUDF1:
-	  sound_freq (1, b & 0x1f);
-	  break;
-	case AUDV0:
-	  sound_volume (0, b & 0x0f);
-	  break;
-	case AUDV1:
-	  sound_volume (1, b & 0x0f);
-	  break;
-	case GRP0:
-	  do_plraster_change (0, 0, b);
-	  do_plraster_change (1, 1, b);
-	  break;
-	case GRP1:
-	  do_plraster_change (1, 0, b);
-	  do_plraster_change (0, 1, b);
-	  ml[2].vdel = ml[2].enabled;
-	  break;
-	case ENAM0:
-	  ml[0].enabled = b & 0x02;
-	  if (tiaWrite[RESMP0])
-	    ml[0].enabled = 0;
-	  break;
-	case ENAM1:
-	  ml[1].enabled = b & 0x02;
-	  if (tiaWrite[RESMP1])
-	    ml[1].enabled = 0;
-	  break;
-	case ENABL:
-	  ml[2].enabled = b & 0x02;
-	  break;
-	case HMP0:
-	  pl[0].hmm = (b >> 4);
-	  break;
-	case HMP1:
-	  pl[1].hmm = (b >> 4);
-	  break;
-	case HMM0:
-	  ml[0].hmm = (b >> 4);
-	  break;
-	case HMM1:
-	  ml[1].hmm = (b >> 4);
-	  break;
-	case HMBL:
-	  ml[2].hmm = (b >> 4);
-	  break;
-	case VDELP0:
-	  pl[0].vdel_flag = b & 0x01;
-	  break;
-	case VDELP1:
-	  pl[1].vdel_flag = b & 0x01;
-	  break;
-	case VDELBL:
-	  ml[2].vdel_flag = b & 0x01;
-	  break;
-	case RESMP0:
-	  tiaWrite[RESMP0] = b & 0x02;
-	  if (b & 0x02)
-	    {
-	      ml[0].x = pl[0].x + 4;
-	      ml[0].enabled = 0;
-	    }
-	  break;
-	case RESMP1:
-	  tiaWrite[RESMP1] = b & 0x02;
-	  if (b & 0x02)
-	    {
-	      ml[1].x = pl[1].x + 4;
-	      ml[1].enabled = 0;
-	    }
-	  break;
-	case HMOVE:
-	  /* Player 0 */
-	  if (pl[0].hmm & 0x08)
-	    pl[0].x += ((pl[0].hmm ^ 0x0f) + 1);
-	  else
-	    pl[0].x -= pl[0].hmm;
-	  if (pl[0].x > 160)
-	    pl[0].x = -68;
-	  else if (pl[0].x < -68)
-	    pl[0].x = 160;
-
-	  /* Player 2 */
-	  if (pl[1].hmm & 0x08)
-	    pl[1].x += ((pl[1].hmm ^ 0x0f) + 1);
+      break;
+    case REFP0:
+      pl[0].reflect = (b & 0x08) >> 3;
+      break;
+    case REFP1:
+      pl[1].reflect = (b & 0x08) >> 3;
+      break;
+    case PF0:
+      do_pfraster_change (0, 0, b & 0xf0);
+      break;
+    case PF1:
+      do_pfraster_change (0, 1, b);
+      break;
+    case PF2:
+      do_pfraster_change (0, 2, b);
+      break;
+    case RESP0:
+      /* Ghost in pacman!
+	 if(beamadj == 0) {
+	 printf("RESP0: ebeamx=%d, ebeamy=%d\n",
+	 ebeamx, ebeamy); 
+	 show();
+	 } */
+      pl[0].x = ebeamx + beamadj;
+      /* As per page 20 Stella Programmers Guide */
+      if (pl[0].x < 0)
+	pl[0].x = 0;
+      break;
+    case RESP1:
+      /*if(beamadj == 0) {
+	 printf("RESP1: ebeamx=%d, ebeamy=%d\n",
+	 ebeamx, ebeamy);
+	 show(); 
+	 } */
+      pl[1].x = ebeamx + beamadj;
+      /* As per page 20 Stella Programmers Guide */
+      if (pl[1].x < 0)
+	pl[1].x = 0;
+      break;
+    case RESM0:
+      ml[0].x = ebeamx + beamadj;
+      /* As per page 20 Stella Programmers Guide */
+      if (ml[0].x < 0)
+	ml[0].x = 0;
+      break;
+    case RESM1:
+      ml[1].x = ebeamx + beamadj;
+      /* As per page 20 Stella Programmers Guide */
+      if (ml[1].x < 0)
+	ml[1].x = 0;
+      break;
+    case RESBL:
+      ml[2].x = ebeamx + beamadj;
+      /* As per page 20 Stella Programmers Guide */
+      if (ml[2].x < 0)
+	ml[2].x = 0;
+      break;
+    case AUDC0:
+      sound_waveform (0, b & 0x0f);
+      break;
+    case AUDC1:
+      sound_waveform (1, b & 0x0f);
+      break;
+    case AUDF0:
+      sound_freq (0, b & 0x1f);
+      break;
+    case AUDF1:
+      sound_freq (1, b & 0x1f);
+      break;
+    case AUDV0:
+      sound_volume (0, b & 0x0f);
+      break;
+    case AUDV1:
+      sound_volume (1, b & 0x0f);
+      break;
+    case GRP0:
+      do_plraster_change (0, 0, b);
+      do_plraster_change (1, 1, b);
+      break;
+    case GRP1:
+      do_plraster_change (1, 0, b);
+      do_plraster_change (0, 1, b);
+      ml[2].vdel = ml[2].enabled;
+      break;
+    case ENAM0:
+      ml[0].enabled = b & 0x02;
+      if (tiaWrite[RESMP0])
+	ml[0].enabled = 0;
+      break;
+    case ENAM1:
+      ml[1].enabled = b & 0x02;
+      if (tiaWrite[RESMP1])
+	ml[1].enabled = 0;
+      break;
+    case ENABL:
+      ml[2].enabled = b & 0x02;
+      break;
+    case HMP0:
+      pl[0].hmm = (b >> 4);
+      break;
+    case HMP1:
+      pl[1].hmm = (b >> 4);
+      break;
+    case HMM0:
+      ml[0].hmm = (b >> 4);
+      break;
+    case HMM1:
+      ml[1].hmm = (b >> 4);
+      break;
+    case HMBL:
+      ml[2].hmm = (b >> 4);
+      break;
+    case VDELP0:
+      pl[0].vdel_flag = b & 0x01;
+      break;
+    case VDELP1:
+      pl[1].vdel_flag = b & 0x01;
+      break;
+    case VDELBL:
+      ml[2].vdel_flag = b & 0x01;
+      break;
+    case RESMP0:
+      tiaWrite[RESMP0] = b & 0x02;
+      if (b & 0x02)
+	{
+	  ml[0].x = pl[0].x + 4;
+	  ml[0].enabled = 0;
+	}
+      break;
+    case RESMP1:
+      tiaWrite[RESMP1] = b & 0x02;
+      if (b & 0x02)
+	{
+	  ml[1].x = pl[1].x + 4;
+	  ml[1].enabled = 0;
+	}
+      break;
+    case HMOVE:
+      /* Player 0 */
+      if (pl[0].hmm & 0x08)
+	pl[0].x += ((pl[0].hmm ^ 0x0f) + 1);
+      else
+	pl[0].x -= pl[0].hmm;
+      if (pl[0].x > 160)
+	pl[0].x = -68;
+      else if (pl[0].x < -68)
+	pl[0].x = 160;
+
+      /* Player 2 */
+      if (pl[1].hmm & 0x08)
+	pl[1].x += ((pl[1].hmm ^ 0x0f) + 1);
+      else
+	pl[1].x -= pl[1].hmm;
+      if (pl[1].x > 160)
+	pl[1].x = -68;
+      else if (pl[1].x < -68)
+	pl[1].x = 160;
+
+      /* Missiles */
+      for (i = 0; i < 3; i++)
+	{
+	  if (ml[i].hmm & 0x08)
+	    ml[i].x += ((ml[i].hmm ^ 0x0f) + 1);
 	  else
-	    pl[1].x -= pl[1].hmm;
-	  if (pl[1].x > 160)
-	    pl[1].x = -68;
-	  else if (pl[1].x < -68)
-	    pl[1].x = 160;
-
-	  /* Missiles */
-	  for (i = 0; i < 3; i++)
-	    {
-	      if (ml[i].hmm & 0x08)
-		ml[i].x += ((ml[i].hmm ^ 0x0f) + 1);
-	      else
-		ml[i].x -= ml[i].hmm;
-	      if (ml[i].x > 160)
-		ml[i].x = -68;
-	      else if (ml[i].x < -68)
-		ml[i].x = 160;
-	    }
-	  break;
-	case HMCLR:
-	  pl[0].hmm = 0;
-	  pl[1].hmm = 0;
-	  for (i = 0; i < 3; i++)
-	    ml[i].hmm = 0;
-	  break;
-	case CXCLR:
-	  col_state=0;
-	  break;
+	    ml[i].x -= ml[i].hmm;
+	  if (ml[i].x > 160)
+	    ml[i].x = -68;
+	  else if (ml[i].x < -68)
+	    ml[i].x = 160;
 	}
+      break;
+    case HMCLR:
+      pl[0].hmm = 0;
+      pl[1].hmm = 0;
+      for (i = 0; i < 3; i++)
+	ml[i].hmm = 0;
+      break;
+    case CXCLR:
+      col_state=0;
+      break;
     }
-  else
+}
+
+/* Write to a RIOT page */
+/* a: address written to */
+/* b: byte value written */
+static void
+riot_write (ADDRESS a, BYTE b)
+{
+  switch (a & 0x2ff)
     {
-      switch (a & 0x2ff)
-	{
-	  /* RIOT I/O ports */
-	case SWCHA:
-	  riotWrite[SWCHA] = b;
-	  break;
-	case SWACNT:
-	  riotWrite[SWACNT] = b;
-	  break;
-	case SWCHB:
-	case SWBCNT:
-	  /* Do nothing */
-	  break;
+      /* RIOT I/O ports */
+    case SWCHA:
+      riotWrite[SWCHA] = b;
+      break;
+    case SWACNT:
+      riotWrite[SWACNT] = b;
+      break;
+    case SWCHB:
+    case SWBCNT:
+      /* Do nothing */
+      break;
 
-	  /* Timer ports */
-	case TIM1T:
-	  set_timer (0, b, clkcount);
-	  break;
-	case TIM8T:
-	  set_timer (3, b, clkcount);
-	  break;
-	case TIM64T:
-	  set_timer (6, b, clkcount);
-	  break;
-	case T1024T:
-	  set_timer (10, b, clkcount);
-	  break;
-	default:
-	  /*printf ("Unknown write %x\n", a);
-	  show ();*/
-	  break;
-	}
+      /* Timer ports */
+    case TIM1T:
+      set_timer (0, b, clkcount);
+      break;
+    case TIM8T:
+      set_timer (3, b, clkcount);
+      break;
+    case TIM64T:
+      set_timer (6, b, clkcount);
+      break;
+    case T1024T:
+      set_timer (10, b, clkcount);
+      break;
+    default:
+      /*printf ("Unknown write %x\n", a);
+      show ();*/
+      break;
     }
 }
 
-/* Decoded read from memory */
+/* Decoded write to memory */
+/* a: address written to */
+/* b: byte value written */
+void
+decWrite (ADDRESS a, BYTE b)
+{
+  memWrite (a, b);
+}
+
+/* Read from a TIA page */
 /* a: address to read */
 /* returns: byte value from address a */
-BYTE
-decRead (ADDRESS a)
+static BYTE
+tia_read (ADDRESS a)
 {
   BYTE res = 65;
 
-  if (a & 0x1000)
-    {
-      a = a & 0xfff;
-      if (base_opts.bank != 0)
-	res= bank_switch_read (a);
-      else
-	res = theRom[a];
-    }
-  else if ((a & 0x280) == 0x80)
-    {
-      res = theRam[a & 0x7f];
-    }
-  else if (!(a & 0x80))
+  switch (a & 0x0f)
     {
-      switch (a & 0x0f)
+      /* TIA */
+    case CXM0P:
+      res = (col_state & CXM0P_MASK) << 6;
+      break;
+    case CXM1P:
+      res = (col_state & CXM1P_MASK) << 4;
+      break;
+    case CXP0FB:
+      res = (col_state & CXP0FB_MASK) << 2;
+      break;
+    case CXP1FB:
+      res = (col_state & CXP1FB_MASK);
+      break;
+    case CXM0FB:
+      res = (col_state & CXM0FB_MASK) >> 2;
+      break;
+    case CXM1FB:
+      res = (col_state & CXM1FB_MASK) >> 4;
+      break;
+    case CXBLPF:
+      res = (col_state & CXBLPF_MASK) >> 5;
+      break;
+    case CXPPMM:
+      res = (col_state & CXPPMM_MASK) >> 7;
+      break;
+    case INPT0:
+      if (base_opts.lcon == PADDLE)
 	{
-	  /* TIA */
-	case CXM0P:
-	  res = (col_state & CXM0P_MASK) << 6;
-	  break;
-	case CXM1P:
-	  res = (col_state & CXM1P_MASK) << 4;
-	  break;
-	case CXP0FB:
-	  res = (col_state & CXP0FB_MASK) << 2;
-	  break;
-	case CXP1FB:
-	  res = (col_state & CXP1FB_MASK);
-	  break;
-	case CXM0FB:
-	  res = (col_state & CXM0FB_MASK) >> 2;
-	  break;
-	case CXM1FB:
-	  res = (col_state & CXM1FB_MASK) >> 4;
+	  tiaRead[INPT0] = do_paddle (0);
+	}
+      else if (base_opts.lcon == KEYPAD)
+	do_keypad (0, 0);
+      res = tiaRead[INPT0];
+      break;
+    case INPT1:
+      if (base_opts.lcon == PADDLE)
+	{
+	  tiaRead[INPT1] = do_paddle (1);
+	}
+      if (base_opts.lcon == KEYPAD)
+	tiaRead[INPT1]=do_keypad (0, 1);
+      res = tiaRead[INPT1];
+      break;
+    case INPT2:
+      if (base_opts.rcon == KEYPAD)
+	do_keypad (1, 0);
+      res = tiaRead[INPT2];
+      break;
+    case INPT3:
+      if (base_opts.rcon == KEYPAD)
+	 tiaRead[INPT3]=do_keypad ( 1, 1);
+      res = tiaRead[INPT3];
+      break;
+    case INPT4:
+      switch (base_opts.lcon)
+	{
+	case KEYPAD:
+	  tiaRead[INPT4]=do_keypad ( 0, 2);
 	  break;
-	case CXBLPF:
-	  res = (col_state & CXBLPF_MASK) >> 5;
+	case STICK:
+	  read_trigger ();
 	  break;
-	case CXPPMM:
-	  res = (col_state & CXPPMM_MASK) >> 7;
+	}
+      res =tiaRead[INPT4];
+      break;
+    case INPT5:
+      switch (base_opts.rcon)
+	{
+	case KEYPAD:
+	  tiaRead[INPT5]=do_keypad (1, 2);
 	  break;
-	case INPT0:
-	  if (base_opts.lcon == PADDLE)
-	    {
-	      tiaRead[INPT0] = do_paddle (0);
-	    }
-	  else if (base_opts.lcon == KEYPAD)
-	    do_keypad (0, 0);
-	  res = tiaRead[INPT0];
+	case STICK:
+	  read_trigger ();
 	  break;
-	case INPT1:
+	}
+      res = tiaRead[INPT5];
+      break;
+    case 0x0e:
+    case 0x0f:
+      res = 0x0f;
+      /* RAM, mapped to page 0 and 1 */
+    }
+  return res;
+}
+
+/* Read from a RIOT page */
+/* a: address to read */
+/* returns: byte value from address a */
+static BYTE
+riot_read (ADDRESS a)
+{
+  BYTE res;
+
+  switch (a & 0x2ff)
+    {
+      /* Timer output */
+    case INTIM:
+    case 0x285:
+    case 0x286:
+    case TIM1T:
+    case TIM8T:
+    case TIM64T:
+    case T1024T:
+      res = do_timer (clkcount);
+      /*printf("Timer is %d res is %d\n", res, timer_res); */
+      break;
+    case SWCHA:
+      switch (base_opts.lcon)
+	{
+	case PADDLE:
 	  if (base_opts.lcon == PADDLE)
 	    {
-	      tiaRead[INPT1] = do_paddle (1);
+	      if (mouse_button ())
+		riotRead[SWCHA] &= 0x7f;
+	      else
+		riotRead[SWCHA] |= 0x80;
 	    }
-	  if (base_opts.lcon == KEYPAD)
-	    tiaRead[INPT1]=do_keypad (0, 1);
-	  res = tiaRead[INPT1];
-	  break;
-	case INPT2:
-	  if (base_opts.rcon == KEYPAD)
-	    do_keypad (1, 0);
-	  res = tiaRead[INPT2];
-	  break;
-	case INPT3:
-	  if (base_opts.rcon == KEYPAD)
-	     tiaRead[INPT3]=do_keypad ( 1, 1);
-	  res = tiaRead[INPT3];
-	  break;
-	case INPT4:
-	  switch (base_opts.lcon)
+	  else if (base_opts.rcon == PADDLE)
 	    {
-	    case KEYPAD:
-	      tiaRead[INPT4]=do_keypad ( 0, 2);
-	      break;
-	    case STICK:
-	      read_trigger ();
-	      break;
+	      if (mouse_button ())
+		riotRead[SWCHA] &= 0xbf;
+	      else
+		riotRead[SWCHA] |= 0x40;
 	    }
-	  res =tiaRead[INPT4];
 	  break;
-	case INPT5:
-	  switch (base_opts.rcon)
-	    {
-	    case KEYPAD:
-	      tiaRead[INPT5]=do_keypad (1, 2);
-	      break;
-	    case STICK:
-	      read_trigger ();
-	      break;
-	    }
-	  res = tiaRead[INPT5];
+	case STICK:
+	  read_stick ();
 	  break;
-	case 0x0e:
-	case 0x0f:
-	  res = 0x0f;
-	  /* RAM, mapped to page 0 and 1 */
 	}
+      res = riotRead[SWCHA];
+      break;
+      /* Switch B is hardwired to input */
+    case SWCHB:
+    case SWCHB + 0x100:
+      read_console ();
+      res = riotRead[SWCHB];
+      break;
+    default:
+      /*printf ("Unknown read 0x%x\n", a & 0x2ff);
+      show ();*/
+      res = 65;
+      break;
     }
-  else
+  return res;
+}
+
+/* Decoded read from memory */
+/* a: address to read */
+/* returns: byte value from address a */
+BYTE
+decRead (ADDRESS a)
+{
+  return memRead (a);
+}
+
+/* Set up the RAM, TIA and RIOT pages */
+void
+mem_map_init (void)
+{
+  struct MemPage *p;
+  ADDRESS a;
+  int i;
+
+  for (i = 0; i < MEM_PAGES / 2; i++)
     {
-      switch (a & 0x2ff)
+      p = &mem_page[i];
+      a = i << MEM_PAGE_SHIFT;
+      /* Undecoded reads outside the ROM come from RAM */
+      p->exec = theRam;
+      if ((a & 0x280) == 0x80)
 	{
-	  /* Timer output */
-	case INTIM:
-	case 0x285:
-	case 0x286:
-	case TIM1T:
-	case TIM8T:
-	case TIM64T:
-	case T1024T:
-	  res = do_timer (clkcount);
-	  /*printf("Timer is %d res is %d\n", res, timer_res); */
-	  break;
-	case SWCHA:
-	  switch (base_opts.lcon)
-	    {
-	    case PADDLE:
-	      if (base_opts.lcon == PADDLE)
-		{
-		  if (mouse_button ())
-		    riotRead[SWCHA] &= 0x7f;
-		  else
-		    riotRead[SWCHA] |= 0x80;
-		}
-	      else if (base_opts.rcon == PADDLE)
-		{
-		  if (mouse_button ())
-		    riotRead[SWCHA] &= 0xbf;
-		  else
-		    riotRead[SWCHA] |= 0x40;
-		}
-	      break;
-	    case STICK:
-	      read_stick ();
-	      break;
-	    }
-	  res = riotRead[SWCHA];
-	  break;
-	  /* Switch B is hardwired to input */
-	case SWCHB:
-	case SWCHB + 0x100:
-	  read_console ();
-	  res = riotRead[SWCHB];
-	  break;
-	default:
-	  /*printf ("Unknown read 0x%x\n", a & 0x2ff);
-	  show ();*/
-	  res = 65;
-	  break;
+	  p->read = theRam;
+	  p->write = theRam;
+	  p->in = NULL;
+	  p->out = NULL;
+	}
+      else
+	{
+	  p->read = NULL;
+	  p->write = NULL;
+	  p->in = (a & 0x80) ? riot_read : tia_read;
+	  p->out = (a & 0x80) ? riot_write : tia_write;
 	}
     }
-  return res;
+}
+
+/* Point the ROM pages at theRom */
+void
+mem_map_rom (void)
+{
+  struct MemPage *p;
+  int i;
+
+  for (i = MEM_PAGES / 2; i < MEM_PAGES; i++)
+    {
+      p = &mem_page[i];
+      p->exec = &theRom[(i << MEM_PAGE_SHIFT) & 0xfff];
+      p->read = p->exec;
+      p->write = NULL;
+      p->in = bank_switch_read;
+      p->out = bank_switch_write;
+    }
+
+  /* Reading a hot spot switches banks, so those pages can't be direct */
+  switch (base_opts.bank)
+    {
+    case 0:
+      break;
+    case 1:
+      /* Atari 8k F8, hot spots at 0xff8 and 0xff9 */
+      mem_page[MEM_PAGES - 1].read = NULL;
+      break;
+    default:
+      for (i = MEM_PAGES / 2; i < MEM_PAGES; i++)
+	mem_page[i].read = NULL;
+      break;
+    }
 }
 
 
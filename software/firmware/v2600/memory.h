@@ -20,6 +20,70 @@
 #ifndef VCSMEMORY_H
 #define VCSMEMORY_H
 
+#include <stddef.h>
+#include "types.h"
+
+/*
+  The 2600 only decodes 13 address lines, and everything in that
+  space repeats on 128 byte boundaries, so the CPU sees memory as 64
+  pages of 128 bytes. RAM and ROM pages point straight at their
+  bytes. TIA, RIOT and bank switching pages have no pointer and call
+  their page's handler instead. Opcode fetches always use the exec
+  pointer, as undecRead() did.
+
+  mem_map_init() sets up the fixed pages and mem_map_rom() the ROM
+  ones; the latter must be called whenever theRom moves.
+  */
+
+#define MEM_PAGE_SHIFT 7
+#define MEM_PAGE_MASK ((1 << MEM_PAGE_SHIFT) - 1)
+#define MEM_PAGES (0x2000 >> MEM_PAGE_SHIFT)
+
+struct MemPage {
+  BYTE *read;			/* Bytes to read, or NULL to use in() */
+  BYTE *write;			/* Bytes to write, or NULL to use out() */
+  BYTE *exec;			/* Bytes to fetch opcodes from */
+  BYTE (*in) (ADDRESS a);
+  void (*out) (ADDRESS a, BYTE b);
+};
+
+extern struct MemPage mem_page[MEM_PAGES];
+
+#define MEM_PAGEOF(a) (&mem_page[((a) >> MEM_PAGE_SHIFT) & (MEM_PAGES - 1)])
+
+static inline BYTE
+memRead (ADDRESS a)
+{
+  struct MemPage *p = MEM_PAGEOF (a);
+
+  if (p->read != NULL)
+    return p->read[a & MEM_PAGE_MASK];
+  return p->in (a);
+}
+
+static inline void
+memWrite (ADDRESS a, BYTE b)
+{
+  struct MemPage *p = MEM_PAGEOF (a);
+
+  if (p->write != NULL)
+    p->write[a & MEM_PAGE_MASK] = b;
+  else
+    p->out (a, b);
+}
+
+static inline BYTE
+memExec (ADDRESS a)
+{
+  return MEM_PAGEOF (a)->exec[a & MEM_PAGE_MASK];
+}
+
+extern void
+mem_map_init (void);
+
+extern void
+mem_map_rom (void);
+
 extern BYTE 
 undecRead (ADDRESS a);
 
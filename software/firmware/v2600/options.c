@@ -67,7 +67,7 @@ printf("usage: v2600 [options] filename\n"
 "where options include:\n"
 "        -h --help           This information\n"
 "        -v --version        Show the current version/copyright info\n"
-"        -f --framerate int  Set the refresh rate (1)\n"
+"        -f --framerate int  Set the refresh rate (1, 0 for automatic)\n"
 "        -n --ntsc           Emulate an NTSC 2600 (default)\n"
 "        -p --pal            Emulate a PAL 2600\n"
 "        -l --lcon  <type>   Left controller, 0=JOY, 1=PADDLE, 2=KEYPAD.\n"
@@ -90,7 +90,7 @@ printf("usage: v2600 [options] filename\n"
 "where options include:\n"
 "        -h           This information\n"
 "        -v           Show the current version/copyright info\n"
-"        -f int       Set the refresh rate (1)\n"
+"        -f int       Set the refresh rate (1, 0 for automatic)\n"
 "        -n           Emulate an NTSC 2600 (default)\n"
 "        -p           Emulate a PAL 2600\n"
 "        -l <type>    Left controller, 0=JOY, 1=PADDLE, 2=KEYPAD.\n"
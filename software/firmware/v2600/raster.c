@@ -27,6 +27,7 @@
 #include "debug.h"
 #include "dbg_mess.h"
 #include "collision.h"
+#include "limiter.h"
 
 extern void tv_drawline (int line);
 extern void tv_drawpixel (uint16_t);
@@ -61,34 +62,116 @@ static unsigned int colour_altscoresr[64];
 static UINT32 *pf_pos;
 static BYTE *line_ptr;
 
+/*
+ * Lookup tables for the rasterizer. Graphics are expanded into the
+ * collision vector a 32-bit word (four pixels) at a time: each bit
+ * of a playfield register covers a whole word, and player graphics
+ * are expanded 4, 2 or 1 bits per word depending on their size.
+ * Reflected graphics are bit reversed first, so only the D7-first
+ * order needs tables. The tables are filled in a byte at a time, so
+ * they work either way round.
+ */
+
+/* GRP with the bits in the opposite order */
+static BYTE pl_reverse[256];
+
+/* Four bits, D3 on the left, to four pixels */
+static UINT32 pl_expand1[16];
+
+/* Two bits, D1 on the left, to four pixels */
+static UINT32 pl_expand2[4];
+
+/* Build the lookup tables */
+static void
+init_expand (void)
+{
+  int i, j;
+  BYTE b[4];
+
+  for (i = 0; i < 256; i++)
+    {
+      pl_reverse[i] = 0;
+      for (j = 0; j < 8; j++)
+	if (i & (1 << j))
+	  pl_reverse[i] |= 0x80 >> j;
+    }
+
+  for (i = 0; i < 16; i++)
+    {
+      for (j = 0; j < 4; j++)
+	b[j] = (i & (0x08 >> j)) ? 0xff : 0;
+      memcpy (&pl_expand1[i], b, sizeof(UINT32));
+    }
+
+  for (i = 0; i < 4; i++)
+    {
+      for (j = 0; j < 4; j++)
+	b[j] = (i & (0x02 >> (j / 2))) ? 0xff : 0;
+      memcpy (&pl_expand2[i], b, sizeof(UINT32));
+    }
+}
+
+/* OR four pixels into the collision vector */
+/* ptr: where in the collision vector, need not be aligned */
+/* bits: the pixels */
+static inline void
+colvect_or (BYTE *ptr, UINT32 bits)
+{
+  UINT32 w;
+
+  memcpy (&w, ptr, sizeof(w));
+  w |= bits;
+  memcpy (ptr, &w, sizeof(w));
+}
+
+/* OR a run of 1, 2, 4 or 8 pixels into the collision vector */
+/* ptr: where in the collision vector */
+/* len: the length of the run */
+/* mask: the collision mask to set */
+static inline void
+colvect_run (BYTE *ptr, int len, BYTE mask)
+{
+  UINT32 m = mask * 0x01010101;
+
+  switch (len)
+    {
+    case 8:
+      colvect_or (ptr + 4, m);
+      /* FALLTHROUGH */
+    case 4:
+      colvect_or (ptr, m);
+      break;
+    case 2:
+      ptr[1] |= mask;
+      /* FALLTHROUGH */
+    case 1:
+      ptr[0] |= mask;
+      break;
+    }
+}
+
+/* Draw playfield bits, one word each */
+/* bits: the bits to draw, leftmost in D0 */
+/* n: number of bits */
+static inline void
+draw_pf_bits (unsigned int bits, int n)
+{
+  /* The vector is clear, so the words for 0 bits can just be written */
+  for (; n > 0; n--, bits >>= 1)
+    *(pf_pos++) = PF_MASK32 & -(UINT32)(bits & 1);
+}
+
 /* Draw playfield register PF0 */
 /* pf: playfield structure */
 /* dir: 1=normal, 0=mirrored */
 void
 draw_pf0 (struct PlayField *pf, int dir)
 {
-  int pfm;			/* playfield mask */
-  /* 1=forward */
+  /* 1=forward, D4 on the left */
   if (dir)
-    {
-      for (pfm = 0x10; pfm < 0x100; pfm <<= 1)
-	{
-	  if (pf->pf0 & pfm)
-	    *(pf_pos++) = PF_MASK32;
-	  else
-	    pf_pos++;
-	}
-    }
+    draw_pf_bits (pf->pf0 >> 4, 4);
   else
-    {
-      for (pfm = 0x80; pfm > 0x08; pfm >>= 1)
-	{
-	  if (pf->pf0 & pfm)
-	    *(pf_pos++) = PF_MASK32;
-	  else
-	    pf_pos++;
-	}
-    }
+    draw_pf_bits (pl_reverse[pf->pf0], 4);
 }
 
 /* Draw playfield register PF1 */
@@ -97,30 +180,11 @@ draw_pf0 (struct PlayField *pf, int dir)
 void
 draw_pf1 (struct PlayField *pf, int dir)
 {
-  int pfm;			/* playfield mask */
-  /* 1=forward */
+  /* 1=forward, D7 on the left */
   if (dir)
-    {
-      /* do PF1 */
-      for (pfm = 0x80; pfm > 0; pfm >>= 1)
-	{
-	  if (pf->pf1 & pfm)
-	    *(pf_pos++) = PF_MASK32;
-	  else
-	    pf_pos ++;
-	}
-    }
+    draw_pf_bits (pl_reverse[pf->pf1], 8);
   else
-    {
-      /* do PF1 */
-      for (pfm = 0x01; pfm < 0x100; pfm <<= 1)
-	{
-	  if (pf->pf1 & pfm)
-	    *(pf_pos++) = PF_MASK32;
-	  else
-	    pf_pos ++;
-	}
-    }
+    draw_pf_bits (pf->pf1, 8);
 }
 
 /* Draw playfield register PF2 */
@@ -129,29 +193,11 @@ draw_pf1 (struct PlayField *pf, int dir)
 void
 draw_pf2 (struct PlayField *pf, int dir)
 {
-  int pfm;			/* playfield mask */
-  /* 1=forward */
+  /* 1=forward, D0 on the left */
   if (dir)
-    {
-      /* do PF2 */
-      for (pfm = 0x01; pfm < 0x100; pfm <<= 1)
-	{
-	  if (pf->pf2 & pfm)
-	    *(pf_pos++) = PF_MASK32;
-	  else
-	    pf_pos ++;
-	}
-    }
+    draw_pf_bits (pf->pf2, 8);
   else
-    {
-      for (pfm = 0x80; pfm > 0; pfm >>= 1)
-	{
-	  if (pf->pf2 & pfm)
-	    *(pf_pos++) = PF_MASK32;
-	  else
-	    pf_pos ++;
-	}
-    }
+    draw_pf_bits (pl_reverse[pf->pf2], 8);
 }
 
 /* Update from the playfield display list */
@@ -211,6 +257,25 @@ draw_playfield (void)
   pf_change_count[num] = 0;
 }
 
+/* Get the graphic to draw for a player, D7 on the left */
+/* p: the player */
+static inline BYTE
+pl_graphic (struct Player *p)
+{
+  BYTE gr;
+
+  if (p->vdel_flag)
+    gr = p->vdel;
+  else
+    gr = p->grp;
+
+  /* Reflected: start with D0 of GRP on left */
+  if (p->reflect)
+    gr = pl_reverse[gr];
+
+  return gr;
+}
+
 /* Draws a normal (8 clocks) sized player */
 /* p: the player to draw */
 /* x: the position to draw it */
@@ -219,40 +284,14 @@ pl_normal (struct Player *p, int x)
 {
   /* Set pointer to start of player graphic */
   BYTE *ptr = colvect + x;
-  BYTE mask;
-  BYTE gr;
+  BYTE gr = pl_graphic (p);
+  UINT32 m = p->mask * 0x01010101;
 
-  if (p->vdel_flag)
-    gr = p->vdel;
-  else
-    gr = p->grp;
+  if (gr == 0)
+    return;
 
-  if (p->reflect)
-    {
-      /* Reflected: start with D0 of GRP on left */
-      for (mask = 0x01; mask > 0; mask <<= 1)
-	{
-	  if (gr & mask)
-	    {
-	      *(ptr++) |= p->mask;
-	    }
-	  else
-	    ptr++;
-	}
-    }
-  else
-    {
-      /* Unreflected: start with D7 of GRP on left */
-      for (mask = 0x80; mask > 0; mask >>= 1)
-	{
-	  if (gr & mask)
-	    {
-	      *(ptr++) |= p->mask;
-	    }
-	  else
-	    ptr++;
-	}
-    }
+  colvect_or (ptr, pl_expand1[gr >> 4] & m);
+  colvect_or (ptr + 4, pl_expand1[gr & 0x0f] & m);
 }
 
 /* Draws a double width ( 16 clocks ) player */
@@ -263,40 +302,15 @@ pl_double (struct Player *p, int x)
 {
   /* Set pointer to start of player graphic */
   BYTE *ptr = colvect + (x);
-  BYTE mask;
-  BYTE gr;
+  BYTE gr = pl_graphic (p);
+  UINT32 m = p->mask * 0x01010101;
+  int i;
 
-  if (p->vdel_flag)
-    gr = p->vdel;
-  else
-    gr = p->grp;
+  if (gr == 0)
+    return;
 
-  if (p->reflect)
-    {
-      for (mask = 0x01; mask > 0; mask <<= 1)
-	{
-	  if (gr & mask)
-	    {
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	    }
-	  else
-	    ptr += 2;
-	}
-    }
-  else
-    {
-      for (mask = 0x80; mask > 0; mask >>= 1)
-	{
-	  if (gr & mask)
-	    {
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	    }
-	  else
-	    ptr += 2;
-	}
-    }
+  for (i = 6; i >= 0; i -= 2, ptr += 4)
+    colvect_or (ptr, pl_expand2[(gr >> i) & 0x03] & m);
 }
 
 /* Draws a quad sized ( 32 clocks) player */
@@ -307,43 +321,14 @@ pl_quad (struct Player *p, int x)
 {
   /* Set pointer to start of player graphic */
   BYTE *ptr = colvect + x;
+  BYTE gr = pl_graphic (p);
+  UINT32 m = p->mask * 0x01010101;
   BYTE mask;
-  BYTE gr;
-
-  if (p->vdel_flag)
-    gr = p->vdel;
-  else
-    gr = p->grp;
 
-  if (p->reflect)
-    {
-      for (mask = 0x01; mask > 0; mask <<= 1)
-	{
-	  if (gr & mask)
-	    {
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	    }
-	  else
-	    ptr += 4;
-	}
-    }
-  else
+  for (mask = 0x80; mask > 0; mask >>= 1, ptr += 4)
     {
-      for (mask = 0x80; mask > 0; mask >>= 1)
-	{
-	  if (gr & mask)
-	    {
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	      *(ptr++) |= p->mask;
-	    }
-	  else
-	    ptr += 4;
-	}
+      if (gr & mask)
+	colvect_or (ptr, m);
     }
 }
 
@@ -446,7 +431,6 @@ pl_draw (int num)
 static inline void
 draw_ball (void)
 {
-  int i;
   BYTE *blptr;
   BYTE e;
 
@@ -458,28 +442,8 @@ draw_ball (void)
   if (e && ml[2].x >= 0)
     {
       blptr = colvect + (ml[2].x);
-      switch (tiaWrite[CTRLPF] >> 4)
-	{
-	case 3:
-	  /* Eight clocks */
-	  for (i = 0; i < 8; i++)
-	    *(blptr++) |= BL_MASK;
-	  break;
-	case 2:
-	  /* Four clocks */
-	  for (i = 0; i < 4; i++)
-	    *(blptr++) |= BL_MASK;
-	  break;
-	case 1:
-	  /* Two clocks */
-	  for (i = 0; i < 2; i++)
-	    *(blptr++) |= BL_MASK;
-	  break;
-	case 0:
-	  /* One clock */
-	  *(blptr++) |= BL_MASK;
-	  break;
-	}
+      /* One, two, four or eight clocks */
+      colvect_run (blptr, 1 << (tiaWrite[CTRLPF] >> 4), BL_MASK);
     }
 }
 
@@ -488,30 +452,8 @@ draw_ball (void)
 static inline void
 do_missile (int num, BYTE * misptr)
 {
-  int i;
-
-  switch (ml[num].width)
-    {
-    case 0:
-      /* one clock */
-      *(misptr++) |= ml[num].mask;
-      break;
-    case 1:
-      /* two clocks */
-      for (i = 0; i < 2; i++)
-	*(misptr++) |= ml[num].mask;
-      break;
-    case 2:
-      /* four clocks */
-      for (i = 0; i < 4; i++)
-	*(misptr++) |= ml[num].mask;
-      break;
-    case 3:
-      /* Eight clocks */
-      for (i = 0; i < 8; i++)
-	*(misptr++) |= ml[num].mask;
-      break;
-    }				/* switch */
+  /* One, two, four or eight clocks */
+  colvect_run (misptr, 1 << ml[num].width, ml[num].mask);
 }
 
 /* Draw a missile taking into account the player's position. */
@@ -614,18 +556,35 @@ reset_vector (void)
 }
 
 
+/* Check whether four pixels of the collision vector are all the same
+   and no colour changes happen among them */
+/* i: the first of the four pixels */
+/* uct: the next colour change */
+/* w: returns the four pixels */
+static inline int
+colvect_span (int i, int uct, UINT32 *w)
+{
+  memcpy (w, colvect + i, sizeof(UINT32));
+
+  if (uct < unified_count && unified[uct].x < i + 4)
+    return 0;
+
+  return (*w == (*w & 0xff) * 0x01010101);
+}
+
 /* draw the collision vector */
 /* Quick version with no magnification */
+/* Runs of four pixels that are all the same, such as the playfield
+   and the background, are looked up and tested once */
 void
 draw_vector_q (void)
 {
-  int i;
+  int i, j;
   int uct = 0;
   int colind, colval;
   unsigned int pad;
-#ifdef notdef
-  unsigned short *tv_ptr = (unsigned short *) line_ptr;
-#endif
+  UINT32 w;
+
   /* Check for scores */
   if(scores_val ==2) 
     {
@@ -637,52 +596,101 @@ draw_vector_q (void)
   while (uct < unified_count && unified[uct].x < 0)
     use_unified_change (&unified[uct++]);
 
-  for (i = 0; i < 80; i++)
+  for (i = 0; i < 160; i += 4)
     {
-      if (uct < unified_count && unified[uct].x == i)
-	use_unified_change (&unified[uct++]);
+      /* Check for scores */
+      if (i == 80 && scores_val == 1)
+	{
+	  scores_val=2;
+	  colour_lookup=colour_ptrs[norm_val][scores_val];
+	}
 
-      if((colval=colvect[i])){
+      if (colvect_span (i, uct, &w))
+	{
+	  if((colval=(w & 0xff))){
+	    col_state|=col_table[colval];
+	    colind=colour_lookup[colval];
+	    pad=colour_table[colind];
+	  } else
+	    pad=colour_table[BK_COLOUR];
+
+	  tv_drawpixel (pad);
+	  tv_drawpixel (pad);
+	  tv_drawpixel (pad);
+	  tv_drawpixel (pad);
+	  continue;
+	}
+
+      for (j = i; j < i + 4; j++)
+	{
+	  if (uct < unified_count && unified[uct].x == j)
+	    use_unified_change (&unified[uct++]);
+
+	  if((colval=colvect[j])){
 	
-	/* Collision detection */
-	col_state|=col_table[colval];
+	    /* Collision detection */
+	    col_state|=col_table[colval];
 	
-	colind=colour_lookup[colval];
-	pad=colour_table[colind];
-      } else
-	pad=colour_table[BK_COLOUR];
+	    colind=colour_lookup[colval];
+	    pad=colour_table[colind];
+	  } else
+	    pad=colour_table[BK_COLOUR];
 
-#ifdef notdef
-      tv_ptr[i] = pad;
-#endif
-      tv_drawpixel (pad);
+	  tv_drawpixel (pad);
+	}
     }
 
+  while (uct < unified_count)
+    use_unified_change (&unified[uct++]);
+  unified_count = 0;
+}
+
+/* Run the collision vector of a line that isn't drawn */
+/* Does everything draw_vector_q() does except the pixels, so skipped
+   frames leave the same state behind as drawn ones */
+void
+draw_collisions (void)
+{
+  int i, j;
+  int uct = 0;
+  int colval;
+  UINT32 w;
+
   /* Check for scores */
-  if(scores_val ==1)
+  if(scores_val ==2) 
     {
-      scores_val=2;
+      scores_val=1;
       colour_lookup=colour_ptrs[norm_val][scores_val];
     }
-  for (i = 80; i < 160; i++)
+
+  /* Use starting changes */
+  while (uct < unified_count && unified[uct].x < 0)
+    use_unified_change (&unified[uct++]);
+
+  for (i = 0; i < 160; i += 4)
     {
-      if (uct < unified_count && unified[uct].x == i)
-	use_unified_change (&unified[uct++]);
-      
-      if((colval=colvect[i])){
-	
-	/* Collision detection */
-	col_state|=col_table[colval];
-	
-	colind=colour_lookup[colval];
-	pad=colour_table[colind];
-      } else
-	pad=colour_table[BK_COLOUR];
+      /* Check for scores */
+      if (i == 80 && scores_val == 1)
+	{
+	  scores_val=2;
+	  colour_lookup=colour_ptrs[norm_val][scores_val];
+	}
 
-      tv_drawpixel (pad);
-#ifdef notdef
-      tv_ptr[i] = pad;
-#endif
+      if (colvect_span (i, uct, &w))
+	{
+	  col_state|=col_table[w & 0xff];
+	  continue;
+	}
+
+      for (j = i; j < i + 4; j++)
+	{
+	  if (uct < unified_count && unified[uct].x == j)
+	    use_unified_change (&unified[uct++]);
+
+	  /* Collision detection */
+	  if((colval=colvect[j]))
+	    col_state|=col_table[colval];
+	}
     }
 
   while (uct < unified_count)
@@ -1018,10 +1026,17 @@ update_registers (void)
 void
 tv_raster (int line)
 {
-  if ((tv_counter % base_opts.rr != 0)  || (line > theight))
+  if (line > theight)
     {
       update_registers ();
     }
+  else if (limiter_skip ||
+	   (base_opts.rr > 1 && tv_counter % base_opts.rr != 0))
+    {
+      reset_vector ();
+      tv_rasterise (line);
+      draw_collisions ();
+    }
   else
     {
       reset_vector ();
@@ -1036,6 +1051,7 @@ init_raster (void)
   int i,val;
 
   init_collisions();
+  init_expand();
 
   /* Normal Priority */
   for (i=0; i<64; i++)
@@ -36,6 +36,7 @@
 #include "keyboard.h"
 #include "realjoy.h"
 #include "dbg_mess.h"
+#include "memory.h"
 
 /* The Rom define might need altering for paged carts */
 /* Enough for 16k carts */
@@ -90,6 +91,10 @@ int ebeamx, ebeamy, sbeamx;
 int vbeam_state;		/* 1 2 8 or 16 */
 int hbeam_state;		/* 4 8 or 16 */
 
+/* How far ebeamx can move before the beam changes state. Anything
+   else that moves the beam zeroes it, so do_screen() gets called. */
+int beam_slack;
+
 /* The tv size, varies with PAL/NTSC */
 int tv_width, tv_height, tv_vsync, tv_vblank, tv_overscan, tv_frame, tv_hertz,
   tv_hsync;
@@ -167,6 +172,7 @@ init_screen (void)
   sbeamx = 0;
   vbeam_state = VSYNCSTATE;
   hbeam_state = OVERSTATE;
+  beam_slack = 0;
 
   tv_vsync = 3;
   tv_hsync = 68;
@@ -295,6 +301,7 @@ init_memory(void)
 #endif
   for(i=0; i<128;i++)
     theRam[i]=0;
+  mem_map_init ();
 }
 
 void
@@ -323,6 +330,7 @@ init_banking (void)
       break;
     }
 #endif
+  mem_map_rom ();
 }
 
 extern void init_cpu( ADDRESS addr);
@@ -621,13 +629,14 @@ do_vblank (BYTE b)
     {
       /* Start vertical blank */
       vbeam_state = VBLANKSTATE;
+      beam_slack = 0;
       /* Also means we can update screen */
       sound_update ();
       update_realjoy ();
       tv_event ();
       tv_display ();
-      /* Only wait if we're on a faster display */
-      if (base_opts.rr == 1)
+      /* Only wait if we're on a faster display, or pacing ourselves */
+      if (base_opts.rr <= 1)
 	limiter_sync ();
     }
   else
@@ -637,6 +646,7 @@ do_vblank (BYTE b)
 
       vbeam_state = DRAWSTATE;
       hbeam_state = HSYNCSTATE;
+      beam_slack = 0;
       /* Set up the screen */
       for (i = 0; i < unified_count; i++)
 	use_unified_change (&unified[i]);
@@ -665,6 +675,7 @@ do_hsync (void)
   hbeam_state = HSYNCSTATE;
   ebeamx = -tv_hsync;
   sbeamx = 0;
+  beam_slack = 0;
 }
 
 /* Main screen logic */
@@ -733,4 +744,15 @@ do_screen (int clks)
     case OVERSTATE:
       break;
     }
+
+  /* Until the next state change, the CPU can just move ebeamx */
+  if (vbeam_state == OVERSTATE || hbeam_state == OVERSTATE)
+    beam_slack = 0;
+  else if (hbeam_state == HSYNCSTATE)
+    beam_slack = -ebeamx;
+  else if (vbeam_state == DRAWSTATE && ebeamy >= tv_height + tv_overscan)
+    /* A WSYNC took us past the bottom; the next call ends the frame */
+    beam_slack = 0;
+  else
+    beam_slack = tv_width - ebeamx;
 }
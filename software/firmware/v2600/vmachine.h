@@ -46,6 +46,9 @@ extern int ebeamx, ebeamy, sbeamx;
 
 extern int vbeam_state, hbeam_state;
 
+/* Colour clocks the beam can move before do_screen() has work to do */
+extern int beam_slack;
+
 extern int tv_width, tv_height, tv_vsync, tv_vblank,
     tv_overscan, tv_frame, tv_hertz, tv_hsync;
 
@@ -0,0 +1,46 @@
+#!/bin/sh
+
+# SPQR/Ides of March Asset Build System
+#
+# convert_to_led.sh
+#
+# Bake an LED animation for the badge's "config led play" command.
+# The image is one row per frame and one pixel per LED, starting at
+# D201, so a 31 pixel wide, 100 pixel tall image is 100 frames of
+# the whole ring. Requires ffmpeg, imagemagick, and ledhdr.
+#
+
+MYDIR=`dirname "$0"`
+
+FFMPEG=ffmpeg
+IDENTIFY=identify
+LEDHDR=${MYDIR}/../bin/ledhdr
+
+if [ "$1" == "" ]; then
+    echo "Usage: $0 filename [period_ms]"
+    exit
+fi
+
+filename=$1
+period=${2:-20}
+newfilename=${filename%.*}.led
+width=`${IDENTIFY} -format %w $filename`
+
+# create the animation header
+${LEDHDR} ${width} ${period} /tmp/hdr$$.led
+
+if [ $? != 0 ]; then
+    exit 1
+fi
+
+${FFMPEG} -loglevel panic -i $filename -vcodec rawvideo -f rawvideo -pix_fmt rgb24 /tmp/out$$.raw
+
+if [ $? != 0 ]; then
+    echo "FFMPEG failed to decode ${filename} !"
+    exit 1
+fi
+
+cat /tmp/hdr$$.led /tmp/out$$.raw > ${newfilename}
+
+rm -f /tmp/hdr$$.led
+rm -f /tmp/out$$.raw
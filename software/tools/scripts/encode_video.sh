@@ -13,7 +13,11 @@
 # and transfers it to the screen and DAC as fast as it can.
 #
 # Usage is:
-# encode_video.sh file.mp4 destination/directory/path
+# encode_video.sh file.mp4 destination/directory/path [vdz|vdz320]
+#
+# With the optional third argument, the output is a compressed .vdz
+# file instead (see videozip.c), either at the usual 160x120 or at the
+# full 320x240 resolution of the display.
 #
 # Required utilities:
 # ffmpeg
@@ -83,11 +87,22 @@ MYDIR=`dirname "$0"`
 
 filename=`basename "$1"`
 newfilename=${filename%.*}.vid
+size=160x120
+
+case "$3" in
+vdz)
+	newfilename=${filename%.*}.vdz
+	;;
+vdz320)
+	newfilename=${filename%.*}.vdz
+	size=320x240
+	;;
+esac
 
 rm -f $2/video.bin
 
 # Convert video to raw rgb565 pixel frames at 16.25 frames/sec
-ffmpeg -i "$1" -r 16.25 -s 160x120 -f rawvideo -pix_fmt rgb565be $2/video.bin
+ffmpeg -i "$1" -r 16.25 -s ${size} -f rawvideo -pix_fmt rgb565be $2/video.bin
 
 # Extract audio in stereo
 ffmpeg -i "$1" -ac 2 -ar 15600 $2/sample.wav
@@ -96,6 +111,11 @@ ffmpeg -i "$1" -ac 2 -ar 15600 $2/sample.wav
 sox $2/sample.wav $2/sample.s16 channels 2 rate 15600 loudness 12
 
 # Now merge the video and audio into a single file
-${MYDIR}/../bin/videomerge $2/video.bin $2/sample.s16 $2/${newfilename}
+if [ -z "$3" ]; then
+	${MYDIR}/../bin/videomerge $2/video.bin $2/sample.s16 $2/${newfilename}
+else
+	${MYDIR}/../bin/videozip -s ${size} $2/video.bin $2/sample.s16 \
+	    $2/${newfilename}
+fi
 
 rm -f $2/video.bin $2/sample.wav $2/sample.s16
@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ch.h"
+#include "ff.h"
+
+#include "async_io_lld.h"
+
+/*
+ * This runs the badge's async I/O queue (firmware/badge/async_io_lld.c)
+ * on a PC against a simulated SD card, to show how many reads need to
+ * be kept in flight to ride out the card's occasional long stalls.
+ *
+ * Usage: aiobench [-f frames] [-r record] [-p period] [-l latency]
+ *                 [-s every] [-t stall] [-d depth]
+ *
+ * A consumer wants one record of -r bytes every -p microseconds, the
+ * way the video player does. Each simulated read takes -l
+ * microseconds, and every -s'th read stalls for another -t, like a
+ * card doing housekeeping. For each queue depth from 1 to -d, the
+ * consumer keeps that many reads queued and we report how long it
+ * spent waiting for data, and how many records came late.
+ *
+ * Before that, a self test checks that a completion callback can
+ * resubmit its own request, and that asyncIoStop() lets go of
+ * anyone waiting on a request that never got serviced. It exits
+ * non-zero if either fails.
+ */
+
+pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t host_cond = PTHREAD_COND_INITIALIZER;
+thread_t host_waiter;
+
+static UINT sim_latency = 3000;
+static UINT sim_every = 16;
+static UINT sim_stall = 12000;
+static volatile UINT sim_reads;
+
+static uint64_t
+bench_micros (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static void
+bench_sleep (uint64_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+	nanosleep (&ts, NULL);
+
+	return;
+}
+
+/* Simulated card: every 32-bit word holds its own file offset */
+
+FRESULT
+f_read (FIL * f, void * buf, UINT btr, UINT * br)
+{
+	uint32_t * p;
+	UINT i;
+
+	sim_reads++;
+	bench_sleep (sim_latency);
+	if (sim_every && (sim_reads % sim_every) == 0)
+		bench_sleep (sim_stall);
+
+	if (btr > f->obj_size - f->fptr)
+		btr = f->obj_size - f->fptr;
+
+	p = buf;
+	for (i = 0; i < btr / sizeof(uint32_t); i++)
+		p[i] = f->fptr + (i * sizeof(uint32_t));
+
+	f->fptr += btr;
+	*br = btr;
+
+	return (FR_OK);
+}
+
+FRESULT
+f_lseek (FIL * f, FSIZE_t off)
+{
+	f->fptr = off;
+	return (FR_OK);
+}
+
+/* Self test */
+
+static int cb_count;
+
+static void
+selftest_cb (ASYNC_IO_REQ * r)
+{
+	if (++cb_count < 3)
+		asyncIoSubmit (r);
+	return;
+}
+
+static void *
+selftest_waiter (void * arg)
+{
+	asyncIoReqWait (arg);
+	return (NULL);
+}
+
+static int
+selftest (void)
+{
+	static uint32_t buf[4][256];
+	ASYNC_IO_REQ req[4];
+	pthread_t waiter;
+	FIL f;
+	int fail = 0;
+	int i;
+
+	sim_reads = 0;
+
+	/* A callback that resubmits: the waiter sees the third read */
+
+	f.fptr = 0;
+	f.obj_size = 1 << 20;
+	asyncIoStart ();
+	asyncIoReqInit (&req[0], &f, buf[0], sizeof(buf[0]));
+	req[0].aio_cb = selftest_cb;
+	cb_count = 0;
+	asyncIoSubmit (&req[0]);
+	asyncIoReqWait (&req[0]);
+	if (cb_count != 3 || req[0].aio_state != ASYNC_REQ_DONE ||
+	    buf[0][0] != 2 * sizeof(buf[0]) || asyncIoPending () != 0) {
+		printf ("self test: callback resubmit FAILED\n");
+		fail = 1;
+	}
+	asyncIoStop ();
+
+	/* Stopping with reads queued cancels them and wakes waiters */
+
+	f.fptr = 0;
+	asyncIoStart ();
+	for (i = 0; i < 4; i++) {
+		asyncIoReqInit (&req[i], &f, buf[i], sizeof(buf[i]));
+		asyncIoSubmit (&req[i]);
+	}
+	pthread_create (&waiter, NULL, selftest_waiter, &req[3]);
+	bench_sleep (sim_latency / 2);
+	asyncIoStop ();
+	pthread_join (waiter, NULL);
+
+	if (req[0].aio_state != ASYNC_REQ_DONE ||
+	    req[3].aio_state != ASYNC_REQ_CANCELLED ||
+	    asyncIoPending () != 0) {
+		printf ("self test: stop with requests queued FAILED\n");
+		fail = 1;
+	}
+
+	if (fail == 0)
+		printf ("self test: ok\n");
+
+	return (fail);
+}
+
+/* Play frames records with depth reads kept in flight */
+
+static void
+bench_run (int depth, int frames, UINT rec, UINT period)
+{
+	ASYNC_IO_REQ * req;
+	uint8_t * buf;
+	FIL f;
+	uint64_t next, t0, stall, total = 0, worst = 0;
+	int late = 0, bad = 0;
+	int n, k;
+
+	req = calloc (depth, sizeof(ASYNC_IO_REQ));
+	buf = malloc ((size_t)depth * rec);
+
+	f.fptr = 0;
+	f.obj_size = frames * rec;
+	sim_reads = 0;
+
+	asyncIoStart ();
+
+	for (k = 0; k < depth && k < frames; k++) {
+		asyncIoReqInit (&req[k], &f, buf + (k * rec), rec);
+		asyncIoSubmit (&req[k]);
+	}
+
+	next = bench_micros ();
+
+	for (n = 0; n < frames; n++) {
+		k = n % depth;
+
+		t0 = bench_micros ();
+		if (asyncIoReqWait (&req[k]) != rec ||
+		    *(uint32_t *)(buf + (k * rec)) != n * rec)
+			bad++;
+		stall = bench_micros () - t0;
+
+		total += stall;
+		if (stall > worst)
+			worst = stall;
+		if (stall > 500)
+			late++;
+
+		if (n + depth < frames)
+			asyncIoSubmit (&req[k]);
+
+		/* Show the frame, then wait for the next one to be due */
+
+		next += period;
+		t0 = bench_micros ();
+		if (next > t0)
+			bench_sleep (next - t0);
+		else
+			next = t0;
+	}
+
+	asyncIoStop ();
+
+	printf ("%5d %8d %12.1f %10.1f %8d%s\n", depth, frames,
+	    total / 1000.0, worst / 1000.0, late,
+	    bad ? "  DATA ERRORS" : "");
+
+	free (req);
+	free (buf);
+
+	return;
+}
+
+int
+main (int argc, char * argv[])
+{
+	int frames = 200;
+	int depth = 8;
+	UINT rec = 8192;
+	UINT period = 5000;
+	int i;
+
+	while ((i = getopt (argc, argv, "f:r:p:l:s:t:d:")) != -1) {
+		switch (i) {
+		case 'f':
+			frames = atoi (optarg);
+			break;
+		case 'r':
+			rec = atoi (optarg);
+			break;
+		case 'p':
+			period = atoi (optarg);
+			break;
+		case 'l':
+			sim_latency = atoi (optarg);
+			break;
+		case 's':
+			sim_every = atoi (optarg);
+			break;
+		case 't':
+			sim_stall = atoi (optarg);
+			break;
+		case 'd':
+			depth = atoi (optarg);
+			break;
+		default:
+			frames = 0;
+			break;
+		}
+	}
+
+	if (frames < 1 || depth < 1 || rec < sizeof(uint32_t)) {
+		fprintf (stderr, "Usage: aiobench [-f frames] [-r record] "
+		    "[-p period] [-l latency]\n"
+		    "                [-s every] [-t stall] [-d depth]\n");
+		exit (1);
+	}
+
+	if (selftest () != 0)
+		exit (1);
+
+	printf ("%u byte records every %uus, reads take %uus, "
+	    "every %u stalls %uus\n\n", rec, period, sim_latency,
+	    sim_every, sim_stall);
+	printf ("depth   frames   waited(ms)  worst(ms)     late\n");
+
+	for (i = 1; i <= depth; i++)
+		bench_run (i, frames, rec, period);
+
+	exit (0);
+}
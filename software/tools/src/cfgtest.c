@@ -0,0 +1,398 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "ch.h"
+
+#include "userconfig.h"
+#include "ships.h"
+
+/*
+ * This runs the badge's config log (firmware/badge/userconfig.c) on a
+ * PC against simulated flash, and pulls the power in the middle of
+ * flash writes to check that a reboot always gets a config back.
+ *
+ * Usage: cfgtest [-n saves] [-s seed] [-v]
+ *
+ * The flash is mapped at its real address, and like the real thing
+ * programming can only clear bits. Each save runs in a fresh child
+ * process, so every boot starts with nothing but what's in flash. The
+ * child boots, changes a few fields, saves and flushes. Half the saves
+ * are cut short at a random flash operation: a program stops partway
+ * through a word, or an erase leaves some words erased and some not.
+ * The next boot must come back with either the config from before
+ * that save or the new one, nothing else.
+ *
+ * In the other half, some saves change the config in place while the
+ * flash is busy, the way the game does without config_mutex, then
+ * save again. That change must survive the next boot too.
+ *
+ * It reports how often each log sector was erased, and exits non-zero
+ * if a boot ever comes back wrong or flash is programmed without being
+ * erased first.
+ */
+
+#define FLASH_BASE	(CONFIG_LOG_FIRST_SECTOR * FLASH_PAGE_SIZE)
+#define FLASH_SIZE	(CONFIG_LOG_SECTORS * FLASH_PAGE_SIZE)
+
+/* What a child tells the parent */
+
+typedef struct cfg_shared {
+	userconfig	loaded;		/* what the boot found */
+	userconfig	want;		/* what the save wrote */
+	int		erases[CONFIG_LOG_SECTORS];
+	int		programs;
+	int		overwrites;	/* bits programmed from 0 back to 1 */
+	int		misaligned;
+} cfg_shared;
+
+NRF52FLASHDriver FLASHD2;
+
+const ship_type_t shiptable[] = {
+	{ .type_name = "test", .max_hp = 100 },
+};
+
+static uint8_t * flash;
+static cfg_shared * sh;
+
+static uint32_t rnd_state = 1;
+static int flash_ops;
+static int crash_at = -1;
+static int edit_at = -1;
+
+static uint32_t
+rnd (uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+
+	return (rnd_state % n);
+}
+
+/* Stubs for the rest of what userconfig.c calls */
+
+void
+tonePlay (GWidgetObject * w, uint8_t b, uint32_t duration)
+{
+	(void)w;
+	(void)b;
+	(void)duration;
+	return;
+}
+
+uint8_t
+randRange (uint8_t min, uint8_t max)
+{
+	(void)max;
+	return (min);
+}
+
+/* Simulated flash */
+
+flash_error_t
+flashStartEraseSector (void * dev, flash_sector_t sector)
+{
+	uint32_t * p;
+	int i;
+
+	(void)dev;
+
+	if (sector < CONFIG_LOG_FIRST_SECTOR ||
+	    sector >= CONFIG_LOG_FIRST_SECTOR + CONFIG_LOG_SECTORS) {
+		fprintf (stderr, "erase of sector %u, outside the log\n",
+		    sector);
+		_exit (2);
+	}
+
+	p = (uint32_t *)(flash + (sector - CONFIG_LOG_FIRST_SECTOR) *
+	    FLASH_PAGE_SIZE);
+
+	sh->erases[sector - CONFIG_LOG_FIRST_SECTOR]++;
+
+	if (flash_ops++ == crash_at) {
+		/* the power goes with the erase half done */
+		for (i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+			if (rnd (2))
+				p[i] = 0xFFFFFFFF;
+		}
+		_exit (3);
+	}
+
+	memset (p, 0xFF, FLASH_PAGE_SIZE);
+
+	return (FLASH_NO_ERROR);
+}
+
+flash_error_t
+flashWaitErase (void * dev)
+{
+	(void)dev;
+	return (FLASH_NO_ERROR);
+}
+
+flash_error_t
+flashProgram (void * dev, flash_offset_t off, size_t n, const uint8_t * pp)
+{
+	uint32_t * dst;
+	uint32_t w;
+	size_t i, stop;
+
+	(void)dev;
+
+	if (off < FLASH_BASE || off + n > FLASH_BASE + FLASH_SIZE) {
+		fprintf (stderr, "program of %zu bytes at %x, outside the log\n",
+		    n, off);
+		_exit (2);
+	}
+	if ((off & 3) || (n & 3))
+		sh->misaligned++;
+
+	dst = (uint32_t *)(flash + (off - FLASH_BASE));
+	stop = n / 4;
+
+	sh->programs++;
+
+	if (flash_ops++ == crash_at)
+		stop = rnd (n / 4);
+
+	for (i = 0; i < stop; i++) {
+		memcpy (&w, pp + (i * 4), 4);
+		if ((dst[i] & w) != w)
+			sh->overwrites++;
+		dst[i] &= w;
+	}
+
+	if (stop < n / 4) {
+		/* and the word it was on gets some of its bits */
+		memcpy (&w, pp + (stop * 4), 4);
+		dst[stop] &= w | rnd_state;
+		_exit (3);
+	}
+
+	/* someone changes the config while the flash is busy */
+	if (flash_ops - 1 == edit_at)
+		getConfig ()->xp += 7;
+
+	return (FLASH_NO_ERROR);
+}
+
+/* The sort of thing a battle or the setup screen changes */
+
+static void
+mutate (userconfig * c)
+{
+	int i, n;
+
+	for (n = rnd (3) + 1; n > 0; n--) {
+		switch (rnd (8)) {
+		case 0:
+			c->xp += rnd (100);
+			break;
+		case 1:
+			c->won++;
+			c->level = rnd (LEVEL_CAP);
+			break;
+		case 2:
+			c->lost++;
+			c->hp = rnd (200);
+			break;
+		case 3:
+			c->last_x = rnd (320);
+			c->last_y = rnd (240);
+			break;
+		case 4:
+			c->energy = rnd (1000);
+			break;
+		case 5:
+			c->led_brightness = rnd (256);
+			c->led_pattern = rnd (16);
+			break;
+		case 6:
+			/* a new LED sign, big enough to need a full copy */
+			for (i = 0; i < CONFIG_LEDSIGN_MAXLEN - 1; i++)
+				c->led_string[i] = 'a' + rnd (26);
+			break;
+		default:
+			c->unlocks ^= 1 << rnd (11);
+			break;
+		}
+	}
+
+	return;
+}
+
+/* One boot and one save, in a child so the RAM state starts clean */
+
+static int
+run_save (int round, uint32_t seed, int crash, userconfig * persisted,
+    userconfig * pending, int verbose)
+{
+	userconfig * c;
+	pid_t pid;
+	int status;
+
+	fflush (stdout);
+	pid = fork ();
+	if (pid == -1) {
+		perror ("fork");
+		exit (1);
+	}
+
+	if (pid == 0) {
+		if (verbose == 0)
+			freopen ("/dev/null", "w", stdout);
+
+		rnd_state = seed;
+
+		configStart ();
+		c = getConfig ();
+		memcpy (&sh->loaded, c, sizeof(userconfig));
+
+		if (round > 0 && memcmp (c, persisted, sizeof(userconfig)) &&
+		    memcmp (c, pending, sizeof(userconfig)))
+			_exit (4);
+
+		flash_ops = 0;
+		if (crash)
+			crash_at = rnd (4);
+		else if (rnd (4) == 0)
+			edit_at = 0;
+
+		mutate (c);
+		memcpy (&sh->want, c, sizeof(userconfig));
+		configSave (c);
+		configFlush ();
+
+		if (edit_at != -1) {
+			/* the one who changed it saves it afterwards */
+			configSave (c);
+			configFlush ();
+			memcpy (&sh->want, c, sizeof(userconfig));
+		}
+
+		_exit (0);
+	}
+
+	waitpid (pid, &status, 0);
+
+	if (!WIFEXITED(status)) {
+		printf ("save %d: child died\n", round);
+		return (-1);
+	}
+
+	return (WEXITSTATUS(status));
+}
+
+int
+main (int argc, char * argv[])
+{
+	userconfig persisted, pending;
+	int saves = 5000;
+	int verbose = 0;
+	int torn = 0;
+	int fails = 0;
+	int i, r, max;
+
+	while ((i = getopt (argc, argv, "n:s:v")) != -1) {
+		switch (i) {
+		case 'n':
+			saves = atoi (optarg);
+			break;
+		case 's':
+			rnd_state = strtoul (optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			saves = 0;
+			break;
+		}
+	}
+
+	if (saves < 1 || rnd_state == 0) {
+		fprintf (stderr, "Usage: cfgtest [-n saves] [-s seed] [-v]\n");
+		exit (1);
+	}
+
+	flash = mmap ((void *)FLASH_BASE, FLASH_SIZE, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+	sh = mmap (NULL, sizeof(cfg_shared), PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (flash != (uint8_t *)FLASH_BASE || sh == MAP_FAILED) {
+		fprintf (stderr, "can't map the flash at %x\n", FLASH_BASE);
+		exit (1);
+	}
+
+	memset (flash, 0xFF, FLASH_SIZE);
+	memset (sh, 0, sizeof(cfg_shared));
+	memset (&persisted, 0, sizeof(persisted));
+	memset (&pending, 0, sizeof(pending));
+
+	/* one more round than saves, so the last save gets booted */
+
+	for (i = 0; i <= saves && fails < 10; i++) {
+		r = run_save (i, rnd (0xFFFFFFFE) + 1, i > 0 && rnd (2),
+		    &persisted, &pending, verbose);
+
+		switch (r) {
+		case 0:
+			memcpy (&persisted, &sh->want, sizeof(userconfig));
+			memcpy (&pending, &sh->want, sizeof(userconfig));
+			break;
+		case 3:
+			/* either of these is right at the next boot */
+			memcpy (&persisted, &sh->loaded, sizeof(userconfig));
+			memcpy (&pending, &sh->want, sizeof(userconfig));
+			torn++;
+			break;
+		case 4:
+			printf ("save %d: boot came back with the wrong "
+			    "config (xp %u, wanted %u or %u)\n", i,
+			    sh->loaded.xp, persisted.xp, pending.xp);
+			fails++;
+			/* carry on from what it did find */
+			memcpy (&persisted, &sh->loaded, sizeof(userconfig));
+			memcpy (&pending, &sh->loaded, sizeof(userconfig));
+			break;
+		default:
+			printf ("save %d: failed (%d)\n", i, r);
+			fails++;
+			break;
+		}
+	}
+
+	max = 0;
+	printf ("%d saves, %d cut short, %d programs; erases per sector:",
+	    saves, torn, sh->programs);
+	for (i = 0; i < CONFIG_LOG_SECTORS; i++) {
+		printf (" %d", sh->erases[i]);
+		if (sh->erases[i] > max)
+			max = sh->erases[i];
+	}
+	printf ("\n");
+
+	if (sh->overwrites) {
+		printf ("%d words programmed without an erase\n",
+		    sh->overwrites);
+		fails++;
+	}
+	if (sh->misaligned) {
+		printf ("%d programs not word aligned\n", sh->misaligned);
+		fails++;
+	}
+
+	if (fails) {
+		printf ("%d failures\n", fails);
+		exit (1);
+	}
+
+	printf ("ok\n");
+
+	exit (0);
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc32.h"
+
+/*
+ * This checks the badge's table driven CRC-32 (firmware/badge/crc32.c)
+ * against the bit at a time loop it replaced. The Makefile builds it
+ * once for each CRC32_SLICE setting: crc32test8, crc32test4 and
+ * crc32test0.
+ *
+ * Usage: crc32test8 (or 4, or 0)
+ *
+ * It checks the standard "123456789" check value (cbf43926 once the
+ * result is inverted; the badge doesn't invert it), random buffers at
+ * every alignment and a spread of lengths and initial values, and the
+ * streaming interface fed the same data in random sized pieces. Then
+ * it times both versions. It exits non-zero on any mismatch.
+ */
+
+#define     ETHER_CRC_POLY_LE       0xedb88320
+
+#define BUF_MAX		1024
+#define BENCH_LEN	(64 * 1024)
+#define BENCH_LOOPS	200
+
+static uint32_t rnd_state = 1;
+static int fails;
+static volatile uint32_t sink;
+
+/* The old crc32_le(), one bit at a time */
+
+static uint32_t
+crc32_bits(const uint8_t *buf, size_t len, uint32_t init)
+{
+	size_t i;
+	uint32_t crc, carry;
+	int bit;
+	uint8_t data;
+
+	crc = init;
+
+	for (i = 0; i < len; i++) {
+		for (data = *buf++, bit = 0; bit < 8; bit++, data >>= 1) {
+			carry = (crc ^ data) & 1;
+			crc >>= 1;
+			if (carry)
+				crc = (crc ^ ETHER_CRC_POLY_LE);
+		}
+	}
+
+	return (crc);
+}
+
+static uint32_t
+rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+
+	return (rnd_state);
+}
+
+static double
+test_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static void
+check(const char *what, size_t len, int off, uint32_t got, uint32_t want)
+{
+	if (got != want) {
+		if (fails < 10)
+			printf("%s: len %zu offset %d: got %08x, want %08x\n",
+			    what, len, off, got, want);
+		fails++;
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	static uint8_t buf[BUF_MAX + 8];
+	static uint8_t big[BENCH_LEN];
+	CRC32_CTX ctx;
+	uint32_t init, want;
+	size_t len, done, n;
+	double t0, t_table, t_bits;
+	int i, off, loop;
+
+	(void)argc;
+	(void)argv;
+
+	/* the standard check value */
+
+	check("check value", 9, 0,
+	    ~crc32_le((const uint8_t *)"123456789", 9, CRC_INIT), 0xcbf43926);
+	check("bit loop check value", 9, 0,
+	    ~crc32_bits((const uint8_t *)"123456789", 9, CRC_INIT), 0xcbf43926);
+
+	for (i = 0; i < (int)sizeof(buf); i++)
+		buf[i] = rnd();
+
+	/* every alignment, short lengths all the way and long ones at random */
+
+	for (loop = 0; loop < 2000; loop++) {
+		len = loop < 300 ? (size_t)loop : rnd() % (BUF_MAX + 1);
+		init = (loop & 1) ? CRC_INIT : rnd();
+		for (off = 0; off < 8; off++) {
+			want = crc32_bits(buf + off, len, init);
+			check("crc32_le", len, off,
+			    crc32_le(buf + off, len, init), want);
+
+			/* the same bytes in random sized pieces */
+
+			crc32_init(&ctx, init);
+			for (done = 0; done < len; done += n) {
+				n = rnd() % 40;
+				if (n > len - done)
+					n = len - done;
+				crc32_update(&ctx, buf + off + done, n);
+			}
+			check("crc32_final", len, off, crc32_final(&ctx), want);
+			check("CRC32_CTX len", len, off, ctx.len, len);
+		}
+	}
+
+	/* speed */
+
+	for (i = 0; i < BENCH_LEN; i++)
+		big[i] = rnd();
+
+	t0 = test_secs();
+	for (loop = 0; loop < BENCH_LOOPS; loop++)
+		sink = crc32_le(big, BENCH_LEN, CRC_INIT);
+	t_table = test_secs() - t0;
+
+	t0 = test_secs();
+	for (loop = 0; loop < BENCH_LOOPS / 10; loop++)
+		sink = crc32_bits(big, BENCH_LEN, CRC_INIT);
+	t_bits = (test_secs() - t0) * 10;
+
+	printf("CRC32_SLICE %d: %.0f MB/s, bit loop %.0f MB/s\n",
+	    CRC32_SLICE, BENCH_LOOPS * (BENCH_LEN / 1e6) / t_table,
+	    BENCH_LOOPS * (BENCH_LEN / 1e6) / t_bits);
+
+	if (fails) {
+		printf("%d mismatches\n", fails);
+		exit(1);
+	}
+
+	printf("ok\n");
+
+	exit(0);
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "dds.h"
+#include "fix_fft.h"
+
+/*
+ * This runs the badge's tone synthesizer (firmware/badge/dds.c) on a
+ * PC and checks what it makes with the badge's own fixed point FFT
+ * (firmware/badge/fix_fft.c).
+ *
+ * Usage: ddstest [-v]
+ *
+ * Every DTMF, blue box and 2600Hz button on the dialer is synthesized
+ * at the dialer's sample rate and at the mixer's. For each one, the
+ * two biggest peaks in a Hann windowed 1024 point spectrum must land
+ * on the bins of the button's two frequencies, and nothing else may
+ * come within SPUR_DB of them. It also checks that an envelope ends
+ * the tone on time, and that a stride of 2 only writes one channel.
+ *
+ * -v prints the peaks found for every tone. It exits non-zero on any
+ * failure.
+ */
+
+#define FFT_LOG2	10
+#define FFT_POINTS	(1 << FFT_LOG2)
+#define PEAK_WIDTH	5	/* bins either side that belong to a peak */
+#define SPUR_DB		-45.0
+
+/* as in app-dialer.c and nrf52i2s_lld.h */
+#define DIALER_SAMPLERATE	(30303 + 850)
+#define DIALER_AMP		(DDS_AMP_MAX / 2)
+#define I2S_RATE		15625
+
+static const uint16_t tones[][2] = {
+	/* DTMF */
+	{ 1209, 697 }, { 1336, 697 }, { 1477, 697 }, { 1633, 697 },
+	{ 1209, 770 }, { 1336, 770 }, { 1477, 770 }, { 1633, 770 },
+	{ 1209, 852 }, { 1336, 852 }, { 1477, 852 }, { 1633, 852 },
+	{ 1209, 941 }, { 1336, 941 }, { 1477, 941 }, { 1633, 941 },
+	/* blue box */
+	{ 700, 900 }, { 700, 1100 }, { 900, 1100 }, { 1100, 1700 },
+	{ 700, 1300 }, { 900, 1300 }, { 1100, 1300 }, { 1300, 1700 },
+	{ 700, 1500 }, { 900, 1500 }, { 1100, 1500 }, { 1500, 1700 },
+	{ 700, 1700 }, { 1300, 1500 }, { 900, 1700 },
+	/* trunk seize */
+	{ 2600, 2600 },
+};
+
+static const uint32_t rates[] = { DIALER_SAMPLERATE, I2S_RATE };
+
+static int verbose;
+static int fails;
+
+static void
+fail (const char * fmt, uint32_t rate, int fa, int fb, const char * why)
+{
+	printf (fmt, rate, fa, fb, why);
+	fails++;
+
+	return;
+}
+
+/* Power in each bin, from a Hann windowed fix_fft() */
+
+static void
+spectrum (int16_t * samples, double * power)
+{
+	static short re[FFT_POINTS], im[FFT_POINTS];
+	double w;
+	int i;
+
+	for (i = 0; i < FFT_POINTS; i++) {
+		w = 0.5 - 0.5 * cos (2 * M_PI * i / FFT_POINTS);
+		re[i] = (short)lrint (samples[i] * w);
+		im[i] = 0;
+	}
+
+	fix_fft (re, im, FFT_LOG2, 0);
+
+	for (i = 0; i < FFT_POINTS / 2; i++)
+		power[i] = (double)re[i] * re[i] + (double)im[i] * im[i];
+
+	return;
+}
+
+/* Biggest bin above DC that isn't within PEAK_WIDTH of one in skip */
+
+static int
+peak (double * power, int * skip, int nskip)
+{
+	int i, k, best = -1;
+
+	for (i = PEAK_WIDTH + 1; i < FFT_POINTS / 2; i++) {
+		for (k = 0; k < nskip; k++) {
+			if (abs (i - skip[k]) <= PEAK_WIDTH)
+				break;
+		}
+		if (k < nskip)
+			continue;
+		if (best == -1 || power[i] > power[best])
+			best = i;
+	}
+
+	return (best);
+}
+
+static int
+near_bin (int bin, uint32_t freq, uint32_t rate)
+{
+	return (fabs (bin - (double)freq * FFT_POINTS / rate) <= 1.0);
+}
+
+static void
+test_tone (uint32_t rate, int fa, int fb)
+{
+	static int16_t buf[FFT_POINTS];
+	double power[FFT_POINTS / 2];
+	DDS_TONE t;
+	int p[3];
+	int n;
+	double spur;
+
+	ddsInit (&t, rate, fa, fb, DIALER_AMP);
+	n = ddsFill (&t, buf, FFT_POINTS, 1);
+	if (n != FFT_POINTS) {
+		fail ("%uHz %d+%d: %s\n", rate, fa, fb, "tone ended early");
+		return;
+	}
+
+	spectrum (buf, power);
+
+	p[0] = peak (power, p, 0);
+	p[1] = peak (power, p, 1);
+
+	if (fa == fb) {
+		/* one tone: the second peak is really the biggest spur */
+		if (!near_bin (p[0], fa, rate))
+			fail ("%uHz %d+%d: %s\n", rate, fa, fb,
+			    "peak in the wrong bin");
+		spur = 10 * log10 (power[p[1]] / power[p[0]]);
+	} else {
+		if (!((near_bin (p[0], fa, rate) && near_bin (p[1], fb, rate)) ||
+		    (near_bin (p[0], fb, rate) && near_bin (p[1], fa, rate))))
+			fail ("%uHz %d+%d: %s\n", rate, fa, fb,
+			    "peaks in the wrong bins");
+		p[2] = peak (power, p, 2);
+		spur = 10 * log10 (power[p[2]] / power[p[0]]);
+	}
+
+	if (spur > SPUR_DB)
+		fail ("%uHz %d+%d: %s\n", rate, fa, fb, "spur too big");
+
+	if (verbose)
+		printf ("%5uHz %4d+%4d: peaks %6.1fHz %6.1fHz, "
+		    "spur %6.1fdBc\n", rate, fa, fb,
+		    (double)p[0] * rate / FFT_POINTS,
+		    (double)p[fa == fb ? 0 : 1] * rate / FFT_POINTS, spur);
+
+	return;
+}
+
+/* Envelope length, release, and stereo stride */
+
+static void
+test_envelope (void)
+{
+	static int16_t buf[2 * FFT_POINTS];
+	DDS_TONE t;
+	int i, n;
+
+	ddsInit (&t, DIALER_SAMPLERATE, 697, 1209, DIALER_AMP);
+	ddsEnvelope (&t, 500, 60, 60);
+	n = ddsFill (&t, buf, FFT_POINTS, 1);
+	if (n != 500 || buf[0] != 0) {
+		printf ("envelope: made %d samples, wanted 500\n", n);
+		fails++;
+	}
+
+	ddsInit (&t, DIALER_SAMPLERATE, 697, 1209, DIALER_AMP);
+	ddsEnvelope (&t, 0, 0, 64);
+	ddsFill (&t, buf, 100, 1);
+	ddsRelease (&t);
+	n = ddsFill (&t, buf, FFT_POINTS, 1);
+	if (n != 64) {
+		printf ("release: made %d more samples, wanted 64\n", n);
+		fails++;
+	}
+
+	memset (buf, 0x55, sizeof(buf));
+	ddsInit (&t, I2S_RATE, 2600, 2600, DDS_AMP_MAX);
+	ddsFill (&t, buf, FFT_POINTS, 2);
+	for (i = 1; i < 2 * FFT_POINTS; i += 2) {
+		if (buf[i] != 0x5555) {
+			printf ("stride: wrote the other channel\n");
+			fails++;
+			break;
+		}
+	}
+
+	return;
+}
+
+int
+main (int argc, char * argv[])
+{
+	unsigned int r, t;
+	int i;
+
+	while ((i = getopt (argc, argv, "v")) != -1) {
+		switch (i) {
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			fprintf (stderr, "Usage: ddstest [-v]\n");
+			exit (1);
+		}
+	}
+
+	for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+		for (t = 0; t < sizeof(tones) / sizeof(tones[0]); t++)
+			test_tone (rates[r], tones[t][0], tones[t][1]);
+	}
+
+	test_envelope ();
+
+	if (fails) {
+		printf ("%d failures\n", fails);
+		exit (1);
+	}
+
+	printf ("ok\n");
+
+	exit (0);
+}
@@ -0,0 +1,5 @@
+/*
+ * Stand-in for the badge headers that the v2600 emulator core pulls
+ * in, for building it on a PC. The core itself needs nothing from
+ * them.
+ */
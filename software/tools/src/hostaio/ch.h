@@ -0,0 +1,113 @@
+/*
+ * Stand-in for the ChibiOS kernel calls that async_io_lld.c uses,
+ * built on pthreads so the async I/O thread can run on a PC. There
+ * is one big lock in place of the ChibiOS system lock, and suspended
+ * threads wait on one condition variable.
+ */
+
+#ifndef _HOSTAIO_CH_H_
+#define _HOSTAIO_CH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef int32_t msg_t;
+typedef int tprio_t;
+
+#define MSG_OK		0
+#define NORMALPRIO	128
+
+typedef struct host_thread {
+	pthread_t	ht_pt;
+	void		(*ht_fn)(void *);
+	void *		ht_arg;
+} thread_t;
+
+typedef thread_t * thread_reference_t;
+
+#define THD_WORKING_AREA(s, n)	char s[n]
+#define THD_FUNCTION(tname, arg) void tname (void * arg)
+
+extern pthread_mutex_t host_lock;
+extern pthread_cond_t host_cond;
+extern thread_t host_waiter;
+
+static inline void
+osalSysLock (void)
+{
+	pthread_mutex_lock (&host_lock);
+}
+
+static inline void
+osalSysUnlock (void)
+{
+	pthread_mutex_unlock (&host_lock);
+}
+
+static inline msg_t
+osalThreadSuspendS (thread_reference_t * trp)
+{
+	*trp = &host_waiter;
+	while (*trp != NULL)
+		pthread_cond_wait (&host_cond, &host_lock);
+	return (MSG_OK);
+}
+
+static inline void
+osalThreadResumeS (thread_reference_t * trp, msg_t msg)
+{
+	(void) msg;
+
+	if (*trp != NULL) {
+		*trp = NULL;
+		pthread_cond_broadcast (&host_cond);
+	}
+}
+
+static inline void *
+host_thread_start (void * arg)
+{
+	thread_t * tp = arg;
+
+	tp->ht_fn (tp->ht_arg);
+
+	return (NULL);
+}
+
+static inline thread_t *
+chThdCreateStatic (void * wsp, size_t size, tprio_t prio,
+    void (*fn)(void *), void * arg)
+{
+	thread_t * tp;
+
+	(void) wsp;
+	(void) size;
+	(void) prio;
+
+	tp = malloc (sizeof(thread_t));
+	tp->ht_fn = fn;
+	tp->ht_arg = arg;
+	pthread_create (&tp->ht_pt, NULL, host_thread_start, tp);
+
+	return (tp);
+}
+
+static inline msg_t
+chThdWait (thread_t * tp)
+{
+	pthread_join (tp->ht_pt, NULL);
+	free (tp);
+	return (MSG_OK);
+}
+
+static inline void
+chThdExitS (msg_t msg)
+{
+	(void) msg;
+	pthread_exit (NULL);
+}
+
+#define chRegSetThreadName(n)
+
+#endif /* _HOSTAIO_CH_H_ */
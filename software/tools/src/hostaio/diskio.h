@@ -0,0 +1,3 @@
+/*
+ * Stand-in for the FatFs disk I/O header. See ff.h.
+ */
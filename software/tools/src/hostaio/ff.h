@@ -0,0 +1,29 @@
+/*
+ * Just enough of the FatFs API for async_io_lld.c. aiobench.c
+ * provides f_read() and f_lseek() on top of a simulated card.
+ */
+
+#ifndef _HOSTAIO_FF_H_
+#define _HOSTAIO_FF_H_
+
+#include <stdint.h>
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint32_t DWORD;
+typedef uint32_t FSIZE_t;
+
+typedef enum {
+	FR_OK = 0,
+	FR_DISK_ERR
+} FRESULT;
+
+typedef struct {
+	FSIZE_t		fptr;
+	FSIZE_t		obj_size;
+} FIL;
+
+FRESULT f_read (FIL *, void *, UINT, UINT *);
+FRESULT f_lseek (FIL *, FSIZE_t);
+
+#endif /* _HOSTAIO_FF_H_ */
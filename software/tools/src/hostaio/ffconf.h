@@ -0,0 +1,3 @@
+/*
+ * Stand-in for the FatFs configuration. See ff.h.
+ */
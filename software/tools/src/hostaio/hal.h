@@ -0,0 +1,4 @@
+/*
+ * Stand-in for the ChibiOS HAL header. The async I/O code needs
+ * nothing from it.
+ */
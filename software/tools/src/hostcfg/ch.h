@@ -0,0 +1,62 @@
+/*
+ * Stand-in for the ChibiOS, HAL and uGFX headers that userconfig.c
+ * pulls in, for running the config log on a PC. There's only one
+ * thread, so the locks and semaphores do nothing, and the config
+ * sync thread is never started. The test program supplies the flash
+ * and the other calls. Build with the include guards of the badge
+ * headers it replaces (joypad_lld.h, nrf52flash_lld.h, nrf52i2s_lld.h
+ * and badge.h) predefined.
+ */
+
+#ifndef _HOST_CH_H_
+#define _HOST_CH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int mutex_t;
+typedef int binary_semaphore_t;
+
+#define NORMALPRIO	128
+
+#define THD_WORKING_AREA(s, n)	char s[n]
+#define THD_FUNCTION(tname, arg) void tname (void * arg)
+
+#define osalMutexObjectInit(m)	((void)(m))
+#define osalMutexLock(m)	((void)(m))
+#define osalMutexUnlock(m)	((void)(m))
+#define chBSemObjectInit(s, t)	((void)(s))
+#define chBSemWait(s)		((void)(s))
+#define chBSemSignal(s)		((void)(s))
+#define chRegSetThreadName(n)	((void)(n))
+#define chThdSleepMilliseconds(n) ((void)(n))
+#define chThdCreateStatic(wa, size, prio, fn, arg) ((void)(fn))
+
+/* as in joypad_lld.h; nothing is ever pressed */
+#define BUTTON_A_ENTER_PORT	1
+#define BUTTON_A_ENTER_PIN	0
+#define BUTTON_B_ENTER_PORT	1
+#define BUTTON_B_ENTER_PIN	1
+#define palReadPad(port, pad)	1
+
+/* as in nrf52flash_lld.h, with the flash at its real address */
+#define FLASH_PAGE_SIZE		4096
+#define FLASH_NO_ERROR		0
+
+typedef uint32_t flash_offset_t;
+typedef uint32_t flash_sector_t;
+typedef int flash_error_t;
+typedef struct { int dummy; } NRF52FLASHDriver;
+
+extern NRF52FLASHDriver FLASHD2;
+
+extern flash_error_t flashStartEraseSector (void *, flash_sector_t);
+extern flash_error_t flashWaitErase (void *);
+extern flash_error_t flashProgram (void *, flash_offset_t, size_t,
+    const uint8_t *);
+
+typedef struct GWidgetObject GWidgetObject;
+
+#endif /* _HOST_CH_H_ */
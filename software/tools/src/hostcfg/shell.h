@@ -0,0 +1 @@
+/* Empty: everything the badge code needs is in ch.h. */
@@ -0,0 +1,5 @@
+/*
+ * Stand-in for the ChibiOS headers that FatFs's ffconf.h pulls in,
+ * for building FatFs on a PC. Build with -DUPDATER so FatFs doesn't
+ * expect any RTOS locking.
+ */
@@ -0,0 +1,46 @@
+/*
+ * Stand-in for the ChibiOS and uGFX headers that ides_sprite.c and
+ * entity.c pull in, for building the sprite, WMAP and entity code on
+ * a PC. Only the types and calls those files use are here; the test
+ * programs supply the calls. Build with the include guards of the
+ * badge headers they don't need (orchard-app.h, ides_gfx.h and so on)
+ * predefined.
+ */
+
+#ifndef _HOST_CH_H_
+#define _HOST_CH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint32_t systime_t;
+typedef uint32_t rtcnt_t;
+
+typedef char bool_t;
+#define TRUE	1
+#define FALSE	0
+
+typedef int16_t coord_t;
+typedef uint16_t color_t;
+typedef color_t pixel_t;
+
+#define HTML2COLOR(h)	((color_t)(h))
+
+#define Black		HTML2COLOR(0x0000)
+#define White		HTML2COLOR(0xffff)
+#define Red		HTML2COLOR(0xf800)
+#define Yellow		HTML2COLOR(0xffe0)
+
+#define NRF5_HFCLK_FREQUENCY	64000000
+#define RTC2US(f, n)		((uint32_t)(((uint64_t)(n) * 1000000) / (f)))
+
+extern systime_t chVTGetSystemTime (void);
+extern rtcnt_t chSysGetRealtimeCounterX (void);
+
+extern void gdispFillArea (coord_t, coord_t, coord_t, coord_t, color_t);
+extern void getPixelBlock (coord_t, coord_t, coord_t, coord_t, pixel_t *);
+extern void putPixelBlock (coord_t, coord_t, coord_t, coord_t, pixel_t *);
+
+#endif /* _HOST_CH_H_ */
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* this program outputs the 8 byte header for LED animation files */
+/* prepend this to raw rgb24 frames to play them with "config led play" */
+
+typedef struct led_anim_hdr {
+	char			lah_magic[4];
+	uint8_t			lah_leds;
+	uint8_t			lah_reserved;
+	uint8_t			lah_period_lo;
+	uint8_t			lah_period_hi;
+} LED_ANIM_HDR;
+
+int
+main (int argc, char * argv[])
+{
+	FILE *			fp;
+	LED_ANIM_HDR		hdr;
+	int			leds;
+	int			period;
+
+	if (argc < 4) {
+	  fprintf (stderr, "\nUsage: %s leds period_ms output_filename\n\n", argv[0]);
+	  exit (1);
+	}
+
+	leds = atoi(argv[1]);
+	period = atoi(argv[2]);
+
+	if (leds < 1 || leds > 31) {
+		fprintf (stderr, "The badge has 1 to 31 LEDs to animate.\n");
+		exit (1);
+	}
+
+	if (period < 1 || period > 65535) {
+		fprintf (stderr, "The period must be 1 to 65535 ms.\n");
+		exit (1);
+	}
+
+	hdr.lah_magic[0] = 'L';
+	hdr.lah_magic[1] = 'E';
+	hdr.lah_magic[2] = 'D';
+	hdr.lah_magic[3] = 'A';
+	hdr.lah_leds = leds;
+	hdr.lah_reserved = 0;
+	hdr.lah_period_lo = period & 0xFF;
+	hdr.lah_period_hi = period >> 8;
+
+	fp = fopen (argv[3], "w");
+
+	if (fp == NULL) {
+		perror ("Output file open failed.");
+		exit (1);
+	}
+
+	fwrite ((void *)&hdr, sizeof(hdr), 1, fp);
+
+	fclose (fp);
+
+	exit(0);
+}
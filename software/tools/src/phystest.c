@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "ch.h"
+
+#include "images.h"
+#include "ides_sprite.h"
+#include "entity.h"
+
+/*
+ * This runs the badge's Q16.16 entity physics (entity_physics() in
+ * firmware/badge/entity.c) on a PC side by side with the float code it
+ * replaced, and reports how far apart the two trajectories drift.
+ *
+ * Usage: phystest [-n runs] [-f frames] [-e max error] [-s seed]
+ *
+ * Half the runs are ships from the real ship table, with the goal
+ * velocity flipping between stopped and full speed on each axis at
+ * random, the way a player on the joypad does. A ship that leaves the
+ * screen is stopped where it was, as in the game. The other half are
+ * bullets, fired from a moving ship and followed until they reach
+ * their range or leave the screen.
+ *
+ * Both models start from the same state each run. It exits non-zero
+ * if any position ever differs by more than the -e limit, in pixels.
+ */
+
+/* as in battle.h */
+#define FRAME_DELAY	0.033f
+#define FRAME_DELAY_FX	FIX16_FROM_FLOAT(FRAME_DELAY)
+
+typedef struct fentity {
+	float px;
+	float py;
+	float vx;
+	float vy;
+	float gx;
+	float gy;
+	float grav;
+	int vapproach;
+	int vmult;
+	int size;
+} FENTITY;
+
+static uint32_t rnd_state = 1;
+static double worst;
+static long frames_run;
+static long pixels_off;
+
+/* Stubs for what entity_init() calls on the badge */
+
+ISPID
+isp_make_sprite (ISPRITESYS * iss)
+{
+	(void)iss;
+	return (0);
+}
+
+void
+isp_set_sprite_block (ISPRITESYS * iss, ISPID id, coord_t xs, coord_t ys,
+    pixel_t * buf)
+{
+	(void)iss;
+	(void)id;
+	(void)xs;
+	(void)ys;
+	(void)buf;
+	return;
+}
+
+pixel_t *
+boxmaker (coord_t x, coord_t y, color_t col)
+{
+	(void)x;
+	(void)y;
+	(void)col;
+	return (NULL);
+}
+
+uint16_t
+randUInt16 (void)
+{
+	return (0);
+}
+
+static uint32_t
+rnd (uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+
+	return (rnd_state % n);
+}
+
+static int
+rnd_range (int lo, int hi)
+{
+	return (lo + (int)rnd (hi - lo + 1));
+}
+
+/* The float code, as it was in app-battle.c */
+
+static float
+approach (float flGoal, float flCurrent, float dt)
+{
+	float flDifference = flGoal - flCurrent;
+
+	if (flDifference > dt)
+		return (flCurrent + dt);
+
+	if (flDifference < -dt)
+		return (flCurrent - dt);
+
+	return (flGoal);
+}
+
+static void
+float_physics (FENTITY * p, float dt)
+{
+	p->vx = approach (p->gx, p->vx, dt * p->vapproach);
+	p->vy = approach (p->gy, p->vy, dt * p->vapproach);
+
+	p->px = p->px + p->vx * dt * p->vmult;
+	p->py = p->py + p->vy * dt * p->vmult;
+
+	p->vx = p->vx + p->grav * dt;
+	p->vy = p->vy + p->grav * dt;
+
+	return;
+}
+
+/* Both models start from the fixed point state */
+
+static void
+float_from (FENTITY * f, ENTITY * e)
+{
+	f->px = FIX16_TO_FLOAT(e->vecPosition.x);
+	f->py = FIX16_TO_FLOAT(e->vecPosition.y);
+	f->vx = FIX16_TO_FLOAT(e->vecVelocity.x);
+	f->vy = FIX16_TO_FLOAT(e->vecVelocity.y);
+	f->gx = FIX16_TO_FLOAT(e->vecVelocityGoal.x);
+	f->gy = FIX16_TO_FLOAT(e->vecVelocityGoal.y);
+	f->grav = VDRAG;
+	f->vapproach = e->vapproach;
+	f->vmult = e->vmult;
+	f->size = e->size_x;
+
+	return;
+}
+
+static void
+compare (FENTITY * f, ENTITY * e)
+{
+	double dx, dy;
+
+	dx = fabs (f->px - FIX16_TO_FLOAT(e->vecPosition.x));
+	dy = fabs (f->py - FIX16_TO_FLOAT(e->vecPosition.y));
+	if (dx > worst)
+		worst = dx;
+	if (dy > worst)
+		worst = dy;
+
+	/* the sprite lands on a different pixel */
+	if ((int)f->px != FIX16_TO_INT(e->vecPosition.x) ||
+	    (int)f->py != FIX16_TO_INT(e->vecPosition.y))
+		pixels_off++;
+	frames_run++;
+
+	return;
+}
+
+/* entity_OOB(), on the float model */
+
+static int
+float_oob (FENTITY * f)
+{
+	return (f->px >= (SCREEN_W - 1) - f->size || f->px < 0 ||
+	    f->py < 0 || f->py >= (SCREEN_H - 1) - f->size);
+}
+
+static void
+run_ship (int frames)
+{
+	const ship_type_t * s;
+	ENTITY e;
+	FENTITY f;
+	fix16_t ox, oy;
+	float fox, foy;
+	int vgoal, n, k;
+
+	s = &shiptable[rnd (8)];
+	vgoal = s->vgoal;
+	if (rnd (2))
+		vgoal = (int)((float)vgoal * 1.2);
+
+	entity_init (&e, NULL, 40, 40, T_PLAYER);
+	e.vapproach = s->vapproach;
+	e.vmult = s->vmult;
+	e.vecPosition.x = FIX16_FROM_INT(rnd_range (0, SCREEN_W - 42));
+	e.vecPosition.y = FIX16_FROM_INT(rnd_range (0, SCREEN_H - 42));
+	float_from (&f, &e);
+
+	for (n = 0; n < frames; n++) {
+		if (rnd (10) == 0) {
+			k = rnd_range (-1, 1) * vgoal;
+			e.vecVelocityGoal.x = FIX16_FROM_INT(k);
+			f.gx = k;
+		}
+		if (rnd (10) == 0) {
+			k = rnd_range (-1, 1) * vgoal;
+			e.vecVelocityGoal.y = FIX16_FROM_INT(k);
+			f.gy = k;
+		}
+
+		ox = e.vecPosition.x;
+		oy = e.vecPosition.y;
+		fox = f.px;
+		foy = f.py;
+		entity_physics (&e, FRAME_DELAY_FX);
+		float_physics (&f, FRAME_DELAY);
+
+		/* aground: both stop where they were */
+		if (float_oob (&f)) {
+			e.vecPosition.x = ox;
+			e.vecPosition.y = oy;
+			e.vecVelocity.x = e.vecVelocity.y = 0;
+			e.vecVelocityGoal.x = e.vecVelocityGoal.y = 0;
+			f.px = fox;
+			f.py = foy;
+			f.vx = f.vy = f.gx = f.gy = 0;
+		}
+
+		compare (&f, &e);
+	}
+
+	return;
+}
+
+static void
+run_bullet (int frames)
+{
+	const ship_type_t * s;
+	ENTITY e;
+	FENTITY f;
+	float ox, oy, dx, dy;
+	int dir_x, dir_y, n;
+
+	s = &shiptable[rnd (8)];
+
+	do {
+		dir_x = rnd_range (-1, 1);
+		dir_y = rnd_range (-1, 1);
+	} while (dir_x == 0 && dir_y == 0);
+
+	entity_init (&e, NULL, s->shot_size, s->shot_size, T_PLAYER_BULLET);
+	e.vecPosition.x = FIX16_FROM_INT(rnd_range (0, SCREEN_W - 10));
+	e.vecPosition.y = FIX16_FROM_INT(rnd_range (0, SCREEN_H - 10));
+
+	/* the ship's own speed, somewhere up to full */
+	e.vecVelocity.x = rnd_range (-s->vgoal * 1000, s->vgoal * 1000) *
+	    (FIX16_ONE / 1000);
+	e.vecVelocity.y = rnd_range (-s->vgoal * 1000, s->vgoal * 1000) *
+	    (FIX16_ONE / 1000);
+	e.vecVelocityGoal.x = FIX16_FROM_INT(dir_x * s->shot_speed);
+	e.vecVelocityGoal.y = FIX16_FROM_INT(dir_y * s->shot_speed);
+	e.vecVelocity.x += FIX16_FROM_INT(dir_x * s->shot_speed);
+	e.vecVelocity.y += FIX16_FROM_INT(dir_y * s->shot_speed);
+	float_from (&f, &e);
+
+	ox = f.px;
+	oy = f.py;
+
+	for (n = 0; n < frames; n++) {
+		entity_physics (&e, FRAME_DELAY_FX);
+		float_physics (&f, FRAME_DELAY);
+		compare (&f, &e);
+
+		dx = ox - f.px;
+		dy = oy - f.py;
+		if (dx * dx + dy * dy > (float)(s->shot_range * s->shot_range) ||
+		    float_oob (&f))
+			break;
+	}
+
+	return;
+}
+
+int
+main (int argc, char * argv[])
+{
+	double limit = 0.25;
+	int runs = 2000;
+	int frames = 300;
+	int i;
+
+	while ((i = getopt (argc, argv, "n:f:e:s:")) != -1) {
+		switch (i) {
+		case 'n':
+			runs = atoi (optarg);
+			break;
+		case 'f':
+			frames = atoi (optarg);
+			break;
+		case 'e':
+			limit = atof (optarg);
+			break;
+		case 's':
+			rnd_state = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			runs = 0;
+			break;
+		}
+	}
+
+	if (runs < 1 || frames < 1 || rnd_state == 0) {
+		fprintf (stderr, "Usage: phystest [-n runs] [-f frames] "
+		    "[-e max error] [-s seed]\n");
+		exit (1);
+	}
+
+	for (i = 0; i < runs; i++) {
+		if (i & 1)
+			run_bullet (frames);
+		else
+			run_ship (frames);
+	}
+
+	printf ("%d runs, %ld frames: worst error %.3f px, "
+	    "%.2f%% of frames on a different pixel\n", runs, frames_run,
+	    worst, 100.0 * pixels_off / frames_run);
+
+	if (worst > limit) {
+		printf ("worst error is over %.3f px\n", limit);
+		exit (1);
+	}
+
+	printf ("ok\n");
+
+	exit (0);
+}
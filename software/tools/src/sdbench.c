@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "sdbench.h"
+
+/*
+ * This runs the badge's SD card benchmark (firmware/badge/sdbench.c)
+ * against a FAT card image on a PC, with the diskio layer below
+ * replaced by reads from the image file, so results can be compared
+ * with the badge's "sdbench" command and between builds of FatFs or
+ * the benchmark itself.
+ *
+ * Usage: sdbench [-v] image file
+ *
+ * The image may be a whole card with a partition table or a bare
+ * FAT volume; the file is a path inside it, e.g.
+ * videos/misc/rickroll.vid.
+ */
+
+static int disk_fd = -1;
+static DWORD disk_sectors;
+
+uint32_t
+sdbenchMicros (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return ((uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000));
+}
+
+DSTATUS
+disk_status (BYTE pdrv)
+{
+	if (pdrv != 0 || disk_fd == -1)
+		return (STA_NOINIT);
+
+	return (0);
+}
+
+DSTATUS
+disk_initialize (BYTE pdrv)
+{
+	return (disk_status (pdrv));
+}
+
+DRESULT
+disk_read (BYTE pdrv, BYTE * buff, DWORD sector, UINT count)
+{
+	if (disk_status (pdrv))
+		return (RES_NOTRDY);
+
+	if (pread (disk_fd, buff, count * 512, (off_t)sector * 512) !=
+	    (ssize_t)(count * 512))
+		return (RES_ERROR);
+
+	return (RES_OK);
+}
+
+DRESULT
+disk_write (BYTE pdrv, const BYTE * buff, DWORD sector, UINT count)
+{
+	(void)pdrv;
+	(void)buff;
+	(void)sector;
+	(void)count;
+
+	/* The image is opened read-only */
+
+	return (RES_WRPRT);
+}
+
+DRESULT
+disk_ioctl (BYTE pdrv, BYTE cmd, void * buff)
+{
+	if (disk_status (pdrv))
+		return (RES_NOTRDY);
+
+	switch (cmd) {
+		case CTRL_SYNC:
+			return (RES_OK);
+		case GET_SECTOR_COUNT:
+			*(DWORD *)buff = disk_sectors;
+			return (RES_OK);
+		case GET_BLOCK_SIZE:
+			*(DWORD *)buff = 1;
+			return (RES_OK);
+		default:
+			break;
+	}
+
+	return (RES_PARERR);
+}
+
+DWORD
+get_fattime (void)
+{
+	return (0);
+}
+
+int
+main (int argc, char * argv[])
+{
+	FATFS fs;
+	struct stat st;
+	uint32_t flags = 0;
+
+	if (argc > 1 && strcmp (argv[1], "-v") == 0) {
+		flags |= SDBENCH_VERBOSE;
+		argc--;
+		argv++;
+	}
+
+	if (argc != 3) {
+		fprintf (stderr, "Usage: sdbench [-v] image file\n");
+		exit (1);
+	}
+
+	disk_fd = open (argv[1], O_RDONLY);
+	if (disk_fd == -1 || fstat (disk_fd, &st) == -1) {
+		perror (argv[1]);
+		exit (1);
+	}
+	disk_sectors = st.st_size / 512;
+
+	if (f_mount (&fs, "0:", 1) != FR_OK) {
+		fprintf (stderr, "%s: no FAT volume found\n", argv[1]);
+		exit (1);
+	}
+
+	if (sdbenchRun (argv[2], flags) != 0)
+		exit (1);
+
+	close (disk_fd);
+
+	exit (0);
+}
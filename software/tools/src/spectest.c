@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "ch.h"
+
+#include "spectrum.h"
+
+/*
+ * This runs the badge's spectrum engine (firmware/badge/spectrum.c) on
+ * a PC and checks the bin magnitudes it makes against a plain DFT done
+ * in doubles.
+ *
+ * Usage: spectest [-v]
+ *
+ * spectrumRun() windows the samples, packs them two to a complex point
+ * for a half size fix_fft() and pulls the real spectrum back out with
+ * a split pass. Every bin from DC to just below Nyquist is compared
+ * with the DFT of the same samples under a Hann window, for noise,
+ * for a pair of tones, and for a tone on every bin in turn, so a
+ * split that picks the wrong mirror bin or twiddle shows up. The
+ * samples are read from interleaved stereo with the other channel
+ * full of junk, so the stride is checked too.
+ *
+ * The window is checked by its shape: DC must come out at 1/2 in bin
+ * 0 and 1/4 in bin 1 and nothing beyond, a tone on a bin at 1/4 with
+ * 1/8 either side, and a tone between bins must have its sidelobes
+ * down where a Hann window puts them.
+ *
+ * -v prints the worst error for each signal. It exits non-zero on any
+ * failure.
+ */
+
+#define POINTS		SPECTRUM_POINTS
+#define BINS		SPECTRUM_BINS
+#define AMP		12000
+#define MAG_TOL		0.005	/* of the biggest bin, plus... */
+#define MAG_SLOP	4	/* ...this many counts of rounding */
+#define SIDELOBE_DB	-31.0	/* a Hann window's first sidelobe */
+
+static SPECTRUM sp;
+static int16_t samples[POINTS * 2];
+static double ref[BINS];
+static uint32_t rnd_state = 1;
+static int verbose;
+static int fails;
+
+/* Stubs for what spectrum.c draws with on the badge */
+
+void
+putPixelBlock (coord_t x, coord_t y, coord_t cx, coord_t cy, pixel_t * buf)
+{
+	(void)x;
+	(void)y;
+	(void)cx;
+	(void)cy;
+	(void)buf;
+	return;
+}
+
+static uint32_t
+rnd (uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+
+	return (rnd_state % n);
+}
+
+/*
+ * The magnitudes spectrumRun() should come up with: a DFT of the left
+ * channel under a Hann window, scaled by 1/N like fix_fft(), and put
+ * through the same max + 3/8 min estimate of |x|.
+ */
+
+static void
+reference (void)
+{
+	double re, im, w, a, b;
+	int i, k;
+
+	for (k = 0; k < BINS; k++) {
+		re = im = 0;
+		for (i = 0; i < POINTS; i++) {
+			w = 0.5 - 0.5 * cos (2 * M_PI * i / POINTS);
+			re += samples[i * 2] * w *
+			    cos (2 * M_PI * k * i / POINTS);
+			im -= samples[i * 2] * w *
+			    sin (2 * M_PI * k * i / POINTS);
+		}
+		a = fabs (re) / POINTS;
+		b = fabs (im) / POINTS;
+		if (a < b) {
+			w = a;
+			a = b;
+			b = w;
+		}
+		ref[k] = a + b * 0.375;
+	}
+
+	return;
+}
+
+/* The right channel is junk that a wrong stride would pick up */
+
+static void
+junk (void)
+{
+	int i;
+
+	for (i = 0; i < POINTS; i++)
+		samples[(i * 2) + 1] = rnd (65536) - 32768;
+
+	return;
+}
+
+static void
+tone (double bin, double amp, double phase)
+{
+	int i;
+
+	for (i = 0; i < POINTS; i++)
+		samples[i * 2] = (int16_t)lrint (amp *
+		    cos ((2 * M_PI * bin * i / POINTS) + phase));
+
+	return;
+}
+
+/* Run the spectrum on what's in samples[] and compare every bin */
+
+static void
+check_bins (const char * name)
+{
+	double max, err, worst;
+	int k, at;
+
+	junk ();
+	spectrumRun (&sp, samples, 2);
+	reference ();
+
+	max = 0;
+	for (k = 0; k < BINS; k++) {
+		if (ref[k] > max)
+			max = ref[k];
+	}
+
+	worst = 0;
+	at = 0;
+	for (k = 0; k < BINS; k++) {
+		err = fabs (sp.sp_mag[k] - ref[k]);
+		if (err > worst) {
+			worst = err;
+			at = k;
+		}
+	}
+
+	if (worst > (max * MAG_TOL) + MAG_SLOP) {
+		printf ("%s: bin %d is %u, wanted %.1f\n", name, at,
+		    sp.sp_mag[at], ref[at]);
+		fails++;
+	}
+
+	if (verbose)
+		printf ("%-12s biggest bin %7.1f, worst error %5.1f "
+		    "in bin %d\n", name, max, worst, at);
+
+	return;
+}
+
+static void
+test_split (void)
+{
+	char name[32];
+	int i, k;
+
+	for (i = 0; i < POINTS; i++)
+		samples[i * 2] = rnd (2 * AMP) - AMP;
+	check_bins ("noise");
+
+	for (i = 0; i < POINTS; i++)
+		samples[i * 2] = (int16_t)lrint ((AMP / 2) *
+		    (cos (2 * M_PI * 37.3 * i / POINTS) +
+		    sin (2 * M_PI * 401.6 * i / POINTS)));
+	check_bins ("two tones");
+
+	/* Every bin, with a phase that moves so sin and cos both count */
+
+	for (k = 0; k < BINS; k++) {
+		tone (k, AMP, k * 0.7);
+		snprintf (name, sizeof(name), "bin %d", k);
+		check_bins (name);
+	}
+
+	return;
+}
+
+static void
+expect (const char * name, int bin, double want)
+{
+	if (fabs (sp.sp_mag[bin] - want) > (want * MAG_TOL) + MAG_SLOP) {
+		printf ("window, %s: bin %d is %u, wanted %.0f\n", name, bin,
+		    sp.sp_mag[bin], want);
+		fails++;
+	}
+
+	return;
+}
+
+static void
+test_window (void)
+{
+	double sl;
+	int k;
+
+	/* DC: the window's own spectrum */
+
+	for (k = 0; k < POINTS; k++)
+		samples[k * 2] = AMP;
+	junk ();
+	spectrumRun (&sp, samples, 2);
+
+	expect ("DC", 0, AMP / 2.0);
+	expect ("DC", 1, AMP / 4.0);
+	for (k = 2; k < BINS; k++)
+		expect ("DC", k, 0);
+
+	if (verbose)
+		printf ("window: DC %u %u %u\n", sp.sp_mag[0], sp.sp_mag[1],
+		    sp.sp_mag[2]);
+
+	/* a tone right on bin 100 */
+
+	tone (100, AMP, 0);
+	junk ();
+	spectrumRun (&sp, samples, 2);
+
+	expect ("bin 100", 100, AMP / 4.0);
+	expect ("bin 100", 99, AMP / 8.0);
+	expect ("bin 100", 101, AMP / 8.0);
+	for (k = 0; k < BINS; k++) {
+		if (k < 99 || k > 101)
+			expect ("bin 100", k, 0);
+	}
+
+	if (verbose)
+		printf ("window: bin 100 %u %u %u %u %u\n", sp.sp_mag[98],
+		    sp.sp_mag[99], sp.sp_mag[100], sp.sp_mag[101],
+		    sp.sp_mag[102]);
+
+	/*
+	 * Halfway between bins, where the sidelobes are highest. The
+	 * main lobe covers 199 to 202; everything else is measured
+	 * against what the tone makes when it's on a bin.
+	 */
+
+	tone (200.5, AMP, 0);
+	junk ();
+	spectrumRun (&sp, samples, 2);
+
+	for (k = 0; k < BINS; k++) {
+		if (k >= 199 && k <= 202)
+			continue;
+		sl = 20 * log10 ((sp.sp_mag[k] + 1.0) / (AMP / 4.0));
+		if (sl > SIDELOBE_DB) {
+			printf ("window: bin %d is %.1fdB, wanted below "
+			    "%.1fdB\n", k, sl, SIDELOBE_DB);
+			fails++;
+			break;
+		}
+	}
+
+	if (verbose)
+		printf ("window: bin 200.5 %u %u, first sidelobes %u %u\n",
+		    sp.sp_mag[200], sp.sp_mag[201], sp.sp_mag[198],
+		    sp.sp_mag[203]);
+
+	return;
+}
+
+int
+main (int argc, char * argv[])
+{
+	int i;
+
+	while ((i = getopt (argc, argv, "v")) != -1) {
+		switch (i) {
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			fprintf (stderr, "Usage: spectest [-v]\n");
+			exit (1);
+		}
+	}
+
+	spectrumInit (&sp, 16, 1, BINS);
+
+	test_window ();
+	test_split ();
+
+	if (fails) {
+		printf ("%d failures\n", fails);
+		exit (1);
+	}
+
+	printf ("ok\n");
+
+	exit (0);
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "vmachine.h"
+#include "display.h"
+#include "options.h"
+#include "keyboard.h"
+#include "collision.h"
+
+/*
+ * This runs the 2600 emulator core from firmware/v2600 on a PC with
+ * no display, sound or input, and reports how fast it goes in
+ * emulated CPU MHz (a real 2600 runs at 1.19MHz) and frames per
+ * second (60 is full speed), so changes to the CPU and memory code
+ * can be measured before they go on the badge.
+ *
+ * Usage: v2600bench [-n] [-f frames] [rom ...]
+ *
+ * Each ROM is run for the given number of frames (600 by default,
+ * ten seconds of NTSC). 8K ROMs use F8 bank switching, the same as
+ * the badge. With no ROMs, the built-in Okie Dokie ROM is used.
+ *
+ * Along with the speed, a checksum of every pixel drawn and one of
+ * the collision latches at the end of each frame are printed. They
+ * should not change when the emulator only gets faster. -n draws
+ * only the first frame, and runs the rest the way the badge runs the
+ * frames it skips, so the cycle count and collision sum should match
+ * a full run, and the pixel sum should match a full run of -f 1.
+ * "make v2600check" runs it on the ROMs from v2600roms.py and compares
+ * all three against v2600bench.sums.
+ */
+
+#include "okie.h"
+
+extern CLOCK clk;
+extern void mainloop (void);
+
+struct BaseOptions base_opts;
+
+BYTE * vscreen;
+int vwidth, vheight, theight;
+int tv_counter;
+int tv_depth = 8;
+int tv_bytes_pp = 2;
+
+static jmp_buf bench_done;
+static int bench_frames;
+static int bench_nodraw;
+static uint32_t bench_sum;
+static uint32_t bench_colsum;
+
+static uint8_t bench_cart[16384];
+static uint8_t bench_colvect[512];
+
+/* Display: count frames and checksum the pixels */
+
+int
+tv_on (int argc, char ** argv)
+{
+	(void)argc;
+	(void)argv;
+	return (1);
+}
+
+void
+tv_off (void)
+{
+	return;
+}
+
+unsigned int
+tv_color (BYTE b)
+{
+	return (b);
+}
+
+void
+tv_event (void)
+{
+	return;
+}
+
+void
+tv_display (void)
+{
+	tv_counter++;
+	bench_colsum = (bench_colsum * 31) + col_state;
+	if (tv_counter == bench_frames)
+		longjmp (bench_done, 1);
+	return;
+}
+
+void
+tv_drawpixel (uint16_t pixel)
+{
+	/* + 1 so that black pixels count too */
+	bench_sum = (bench_sum * 31) + pixel + 1;
+	return;
+}
+
+int
+fselLoad (void)
+{
+	return (0);
+}
+
+/* Nothing is ever pressed */
+
+int mouse_position (void) { return (0); }
+int mouse_button (void) { return (0); }
+void read_trigger (void) { }
+void read_stick (void) { }
+void read_keypad (int pad) { (void)pad; }
+void read_console (void) { }
+void update_realjoy (void) { }
+
+/* No sound, and no waiting for the real frame rate */
+
+void sound_freq (int channel, BYTE freq) { (void)channel; (void)freq; }
+void sound_volume (int channel, BYTE vol) { (void)channel; (void)vol; }
+void sound_waveform (int channel, BYTE value) { (void)channel; (void)value; }
+void sound_update (void) { }
+int limiter_skip;
+void limiter_init (void) { }
+void limiter_setFrameRate (int f) { (void)f; }
+long limiter_sync (void) { return (0); }
+
+static double
+bench_seconds (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec + (ts.tv_nsec / 1e9));
+}
+
+static int
+bench_load (const char * name)
+{
+	FILE * fp;
+	size_t len;
+
+	if (name == NULL) {
+		memcpy (bench_cart, okie_dokie_data, 2048);
+		memcpy (bench_cart + 2048, bench_cart, 2048);
+		rom_size = 4096;
+		base_opts.bank = 0;
+		return (0);
+	}
+
+	fp = fopen (name, "rb");
+	if (fp == NULL) {
+		perror (name);
+		return (-1);
+	}
+	len = fread (bench_cart, 1, sizeof(bench_cart), fp);
+	fclose (fp);
+
+	switch (len) {
+	case 2048:
+		memcpy (bench_cart + 2048, bench_cart, 2048);
+		len = 4096;
+		/* FALLTHROUGH */
+	case 4096:
+		base_opts.bank = 0;
+		break;
+	case 8192:
+		base_opts.bank = 1;
+		break;
+	default:
+		fprintf (stderr, "%s: %zu bytes, not a 2K, 4K or 8K ROM\n",
+		    name, len);
+		return (-1);
+	}
+
+	rom_size = len;
+
+	return (0);
+}
+
+static void
+bench_run (const char * name)
+{
+	double start, secs;
+
+	if (bench_load (name) != 0)
+		return;
+
+	theCart = bench_cart;
+	colvect = bench_colvect;
+
+	base_opts.rr = bench_nodraw ? bench_frames + 1 : 1;
+	base_opts.magstep = 1;
+	base_opts.tvtype = NTSC;
+	base_opts.lcon = STICK;
+	base_opts.rcon = STICK;
+
+	vwidth = 160;
+	theight = vheight = 192;
+	tv_counter = 0;
+	bench_sum = 0;
+	bench_colsum = 0;
+
+	start = bench_seconds ();
+	if (setjmp (bench_done) == 0)
+		mainloop ();
+	secs = bench_seconds () - start;
+
+	printf ("%-24s %5d frames %10lu cycles %7.3f s %8.2f MHz "
+	    "%7.1f fps  sum %08x col %08x\n",
+	    name == NULL ? "(okie dokie)" : name, tv_counter,
+	    (unsigned long)clk, secs, clk / secs / 1e6, tv_counter / secs,
+	    bench_sum, bench_colsum);
+
+	return;
+}
+
+int
+main (int argc, char * argv[])
+{
+	int i;
+
+	bench_frames = 600;
+
+	while ((i = getopt (argc, argv, "nf:")) != -1) {
+		switch (i) {
+		case 'n':
+			bench_nodraw = 1;
+			break;
+		case 'f':
+			bench_frames = atoi (optarg);
+			break;
+		default:
+			bench_frames = 0;
+			break;
+		}
+	}
+
+	if (bench_frames < 1) {
+		fprintf (stderr,
+		    "Usage: v2600bench [-n] [-f frames] [rom ...]\n");
+		exit (1);
+	}
+
+	if (optind == argc)
+		bench_run (NULL);
+
+	for (i = optind; i < argc; i++)
+		bench_run (argv[i]);
+
+	exit (0);
+}
@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+#
+# Builds the test ROMs that v2600bench checks the emulator core with
+# (see "make v2600check"). They're written into the directory given
+# on the command line, or the current one.
+#
+# kernel.bin	a 4K kernel that changes the playfield, a player and
+#		its colours on every line, and reads RAM, a ROM table
+#		and the RIOT timer every frame
+# banked.bin	the same kernel as an 8K F8 ROM, switching banks on
+#		every line
+# st_*.bin	4K ROMs that write random values to random TIA
+#		registers all frame, weighted towards sprites,
+#		playfield, or an even mix of everything, two seeds each
+#
+# The RIOT timer in the emulator counts up, so the stress ROMs count
+# their lines with WSYNC instead of waiting for it.
+#
+
+import os
+import random
+import struct
+import sys
+
+# Just enough of a 6502 assembler for these
+
+OP = {
+	('sei', None): 0x78, ('cld', None): 0xd8, ('txs', None): 0x9a,
+	('tya', None): 0x98, ('tax', None): 0xaa, ('dex', None): 0xca,
+	('dey', None): 0x88, ('clc', None): 0x18, ('inx', None): 0xe8,
+	('rts', None): 0x60,
+	('ldx', 'imm'): 0xa2, ('ldy', 'imm'): 0xa0, ('lda', 'imm'): 0xa9,
+	('and', 'imm'): 0x29, ('eor', 'imm'): 0x49, ('adc', 'imm'): 0x69,
+	('cmp', 'imm'): 0xc9, ('ora', 'imm'): 0x09,
+	('sta', 'zp'): 0x85, ('stx', 'zp'): 0x86, ('lda', 'zp'): 0xa5,
+	('asl', 'zp'): 0x06, ('rol', 'zp'): 0x26, ('eor', 'zp'): 0x45,
+	('adc', 'zp'): 0x65,
+	('sta', 'zpx'): 0x95, ('lda', 'zpx'): 0xb5, ('inc', 'zpx'): 0xf6,
+	('adc', 'zpx'): 0x75,
+	('sta', 'abs'): 0x8d, ('lda', 'abs'): 0xad, ('bit', 'abs'): 0x2c,
+	('jmp', 'abs'): 0x4c, ('jsr', 'abs'): 0x20,
+	('lda', 'absy'): 0xb9, ('lda', 'absx'): 0xbd, ('sta', 'absx'): 0x9d,
+	('lda', 'indy'): 0xb1,
+	('bne', 'rel'): 0xd0, ('bpl', 'rel'): 0x10, ('bcc', 'rel'): 0x90,
+}
+
+SIZE = { None: 1, 'imm': 2, 'zp': 2, 'zpx': 2, 'indy': 2, 'rel': 2,
+	'abs': 3, 'absx': 3, 'absy': 3 }
+
+# A program is a list of labels (strings) and instructions (tuples of
+# opcode, mode and argument, where the argument may be a label).
+# Two passes, so labels can be used before they're defined.
+
+def asm(prog, org):
+	labels = {}
+	for p in range(2):
+		pc = org
+		out = bytearray()
+		for ins in prog:
+			if isinstance(ins, str):
+				labels[ins] = pc
+				continue
+			if ins[0] == '.byte':
+				out += bytes(ins[1])
+				pc += len(ins[1])
+				continue
+			op = ins[0]
+			mode = ins[1] if len(ins) > 1 else None
+			arg = ins[2] if len(ins) > 2 else None
+			if isinstance(arg, str):
+				arg = labels.get(arg, pc)
+			out.append(OP[(op, mode)])
+			if mode == 'rel':
+				out.append((arg - (pc + 2)) & 0xff)
+			elif SIZE[mode] == 2:
+				out.append(arg & 0xff)
+			elif SIZE[mode] == 3:
+				out += struct.pack('<H', arg & 0xffff)
+			pc += SIZE[mode]
+	return out
+
+# 4K image at $F000 with both vectors pointing at the start
+
+def rom4k(code):
+	rom = bytearray(4096)
+	rom[:len(code)] = code
+	rom[0xffc:0xffe] = struct.pack('<H', 0xf000)
+	rom[0xffe:0x1000] = struct.pack('<H', 0xf000)
+	return rom
+
+# The kernel. With a bank, every line touches that bank's F8 hotspot.
+
+def kernel(bank = None):
+	p = [ 'start', ('sei',), ('cld',), ('ldx', 'imm', 0xff), ('txs',),
+	    ('lda', 'imm', 0),
+	    'clr', ('sta', 'zpx', 0), ('dex',), ('bne', 'rel', 'clr'),
+	    ('lda', 'imm', 0x00), ('sta', 'zp', 0xf0),
+	    ('lda', 'imm', 0xf8), ('sta', 'zp', 0xf1),
+
+	    # VSYNC, then set the timer for VBLANK
+	    'frame', ('lda', 'imm', 2), ('sta', 'zp', 0x00),
+	    ('sta', 'zp', 0x02), ('sta', 'zp', 0x02), ('sta', 'zp', 0x02),
+	    ('lda', 'imm', 0), ('sta', 'zp', 0x00),
+	    ('lda', 'imm', 43), ('sta', 'abs', 0x296),
+
+	    # stir RAM, and copy the ROM table over it
+	    ('ldx', 'imm', 0x6f),
+	    'ram', ('lda', 'zpx', 0x80), ('clc',), ('adc', 'imm', 3),
+	    ('adc', 'zpx', 0x81), ('sta', 'zpx', 0x80), ('dex',),
+	    ('bpl', 'rel', 'ram'),
+	    ('ldy', 'imm', 0),
+	    'rom', ('lda', 'indy', 0xf0), ('sta', 'absx', 0x80), ('inx',),
+	    ('dey',), ('bne', 'rel', 'rom'),
+	    'wait', ('lda', 'abs', 0x284), ('bne', 'rel', 'wait'),
+
+	    # 192 lines of playfield, player 0 and colours from RAM
+	    ('sta', 'zp', 0x02), ('lda', 'imm', 0), ('sta', 'zp', 0x01),
+	    ('ldy', 'imm', 192),
+	    'line', ('sta', 'zp', 0x02), ('tya',), ('and', 'imm', 0x3f),
+	    ('tax',), ('lda', 'zpx', 0x80), ('sta', 'zp', 0x0e),
+	    ('eor', 'imm', 0xff), ('sta', 'zp', 0x0f),
+	    ('stx', 'zp', 0x08), ('lda', 'zpx', 0x90), ('sta', 'zp', 0x1b),
+	    ('sta', 'zp', 0x1c), ('lda', 'zp', 0x82), ('sta', 'zp', 0x09) ]
+	if bank is not None:
+		p += [ ('bit', 'abs', 0x1ff8 + bank) ]
+	p += [ ('dey',), ('bne', 'rel', 'line'),
+
+	    # overscan
+	    ('lda', 'imm', 2), ('sta', 'zp', 0x01), ('ldx', 'imm', 30),
+	    'os', ('sta', 'zp', 0x02), ('dex',), ('bne', 'rel', 'os'),
+	    ('jmp', 'abs', 'frame') ]
+
+	rom = rom4k(asm(p, 0xf000))
+	for i in range(0x800, 0xf00):
+		rom[i] = (i * 7) & 0xff		# the table read through ($F0),Y
+	return rom
+
+# A stress ROM. Weights maps TIA register to how often it's picked.
+
+def stress(seed, weights):
+	r = random.Random(seed)
+	regs = []
+	for reg, w in weights.items():
+		regs += [ reg ] * w
+	r.shuffle(regs)
+	regs = (regs * 64)[:64]
+
+	p = [ 'start', ('sei',), ('cld',), ('ldx', 'imm', 0xff), ('txs',),
+	    ('lda', 'imm', 0),
+	    'clr', ('sta', 'zpx', 0), ('dex',), ('bne', 'rel', 'clr'),
+	    ('lda', 'imm', seed & 0xff | 1), ('sta', 'zp', 0x80),
+	    ('lda', 'imm', (seed >> 8) & 0xff | 0x40), ('sta', 'zp', 0x81),
+
+	    'frame', ('lda', 'imm', 2), ('sta', 'zp', 0x00),
+	    ('sta', 'zp', 0x02), ('sta', 'zp', 0x02), ('sta', 'zp', 0x02),
+	    ('lda', 'imm', 0), ('sta', 'zp', 0x00),
+
+	    # 37 lines of VBLANK
+	    ('ldy', 'imm', 37),
+	    'vb', ('sta', 'zp', 0x02), ('jsr', 'abs', 'step'), ('dey',),
+	    ('bne', 'rel', 'vb'),
+	    ('sta', 'zp', 0x02), ('lda', 'imm', 0), ('sta', 'zp', 0x01),
+
+	    # 100 visible lines, each written at a random point
+	    ('ldy', 'imm', 100),
+	    'vis', ('sta', 'zp', 0x02), ('jsr', 'abs', 'rnd'),
+	    ('and', 'imm', 7), ('tax',),
+	    'dl', ('dex',), ('bpl', 'rel', 'dl'),
+	    ('jsr', 'abs', 'step'), ('dey',), ('bne', 'rel', 'vis'),
+	    ('sta', 'zp', 0x02), ('lda', 'imm', 2), ('sta', 'zp', 0x01),
+
+	    # overscan
+	    ('ldy', 'imm', 15),
+	    'os', ('sta', 'zp', 0x02), ('jsr', 'abs', 'step'), ('dey',),
+	    ('bne', 'rel', 'os'),
+	    ('jmp', 'abs', 'frame'),
+
+	    # write something random to a register from the table
+	    'step', ('jsr', 'abs', 'rnd'), ('and', 'imm', 0x3f), ('tax',),
+	    ('lda', 'absx', 'regtab'), ('tax',),
+	    ('jsr', 'abs', 'rnd'), ('eor', 'zp', 0x82), ('sta', 'absx', 0x0000),
+	    ('and', 'imm', 7), ('tax',), ('lda', 'zpx', 0x00), ('clc',),
+	    ('adc', 'zp', 0x82), ('sta', 'zp', 0x82), ('rts',),
+
+	    # 16 bit LFSR in $80/$81
+	    'rnd', ('asl', 'zp', 0x80), ('rol', 'zp', 0x81),
+	    ('bcc', 'rel', 'nx'), ('lda', 'zp', 0x80), ('eor', 'imm', 0x2d),
+	    ('sta', 'zp', 0x80),
+	    'nx', ('lda', 'zp', 0x80), ('rts',),
+
+	    'regtab', ('.byte', regs) ]
+
+	return rom4k(asm(p, 0xf000))
+
+# Colours, positions, HMOVE, VDELs and the rest, once each
+BASE = { r: 1 for r in [ 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x20, 0x21, 0x22, 0x23, 0x24, 0x28, 0x29, 0x2a, 0x2b, 0x2c ] }
+
+SPRITES = dict(BASE)
+SPRITES.update({ 0x04: 5, 0x05: 5, 0x0b: 4, 0x0c: 4, 0x1b: 6, 0x1c: 6,
+    0x25: 2, 0x26: 2, 0x1d: 2, 0x1e: 2, 0x1f: 2, 0x27: 1, 0x0a: 2 })
+
+PFHEAVY = dict(BASE)
+PFHEAVY.update({ 0x0d: 6, 0x0e: 6, 0x0f: 6, 0x0a: 5, 0x1b: 2, 0x1c: 2,
+    0x04: 2, 0x05: 2, 0x0b: 1, 0x0c: 1 })
+
+MIXED = dict(BASE)
+MIXED.update({ r: 2 for r in range(0x04, 0x30) if r != 0x2c })
+
+def write(path, rom):
+	with open(path, 'wb') as f:
+		f.write(rom)
+
+if __name__ == '__main__':
+	out = sys.argv[1] if len(sys.argv) > 1 else '.'
+
+	write(os.path.join(out, 'kernel.bin'), kernel())
+	write(os.path.join(out, 'banked.bin'), kernel(1) + kernel(0))
+
+	for i, (name, w) in enumerate([ ('sprites', SPRITES),
+	    ('pfheavy', PFHEAVY), ('mixed', MIXED) ]):
+		for s in (1, 2):
+			write(os.path.join(out, 'st_%s%d.bin' % (name, s)),
+			    stress(0x1234 * (i + 1) + s * 0x777, w))
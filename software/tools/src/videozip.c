@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+/*
+ * This program merges a video and audio stream together into a single
+ * compressed .VDZ file for playback on the Nordic NRF52 using our video
+ * player. The inputs are the same as for videomerge: a file containing
+ * sequential frames in 16-bit RGB565 pixel format and a file containing
+ * 16-bit stereo audio samples encoded at a rate of 15600Hz. Unlike
+ * videomerge, the frame size isn't fixed at 160x120: clips can also be
+ * encoded at the full 320x240 resolution of the display, since the
+ * compressed stream needs a lot less SD card bandwidth.
+ *
+ * Each frame is split into 15 chunks, so that every chunk carries
+ * the same number of audio samples as a .VID chunk. The video data
+ * in each chunk is coded as the bounding rectangle of the pixels that
+ * changed since the previous frame (the badge leaves the rest of the
+ * display alone), run-length encoded if that makes it smaller. Every
+ * keyint frames we emit a keyframe which is coded in full, so that the
+ * player can start from the middle of a clip.
+ *
+ * Usage is:
+ *
+ * videozip [-s WxH] [-k keyint] [-g group] [-b] video.bin audio.s16 out.vdz
+ *
+ * With -b, the output file is read back and decoded once all the way
+ * through to measure how much work the decoder has to do per frame.
+ *
+ * The format definitions here must match the ones in video_lld.h.
+ */
+
+#define VID_FRAMES_PER_SEC		16.25
+
+#define VID_AUDIO_SAMPLES_PER_SCANLINE	16
+
+#define VID_AUDIO_SAMPLES_PER_CHUNK		\
+	(VID_AUDIO_SAMPLES_PER_SCANLINE * 8)
+
+#define VDZ_CHUNKS_PER_FRAME		15
+
+#define VDZ_MAGIC		0x315A4456	/* "VDZ1" */
+
+#define VDZ_CHUNK_SKIP		0
+#define VDZ_CHUNK_RAW		1
+#define VDZ_CHUNK_RLE		2
+
+#define VDZ_OP_RUN		0x8000
+#define VDZ_OP_CNT		0x7FFF
+
+typedef struct vdz_hdr {
+	uint32_t		vdz_magic;
+	uint16_t		vdz_width;
+	uint16_t		vdz_height;
+	uint16_t		vdz_chunk_lines;
+	uint16_t		vdz_group;
+	uint32_t		vdz_frames;
+	uint32_t		vdz_keycnt;
+	uint32_t		vdz_maxrec;
+	uint32_t		vdz_firstrec;
+} VDZ_HDR;
+
+typedef struct vdz_key {
+	uint32_t		vdz_frame;
+	uint32_t		vdz_off;
+	uint32_t		vdz_len;
+} VDZ_KEY;
+
+typedef struct vdz_rec {
+	uint16_t		vdz_chunks;
+	uint16_t		vdz_chunk0;
+	uint32_t		vdz_nextlen;
+} VDZ_REC;
+
+typedef struct vdz_chunk {
+	uint8_t			vdz_type;
+	uint8_t			vdz_pad;
+	uint16_t		vdz_len;
+	uint16_t		vdz_x;
+	uint16_t		vdz_y;
+	uint16_t		vdz_cx;
+	uint16_t		vdz_cy;
+	uint16_t		vdz_samples[VID_AUDIO_SAMPLES_PER_CHUNK];
+} VDZ_CHUNK;
+
+static int width = 160;
+static int height = 120;
+
+/*
+ * Run-length encode npix pixels from src into dst. Returns the
+ * number of 16-bit words used. Short runs aren't worth breaking a
+ * literal for, since a run costs two words.
+ */
+
+static int
+rle_encode (uint16_t * src, int npix, uint16_t * dst)
+{
+	uint16_t * op = NULL;
+	int words = 0;
+	int i, run;
+
+	i = 0;
+	while (i < npix) {
+		for (run = 1; i + run < npix && run < VDZ_OP_CNT; run++) {
+			if (src[i + run] != src[i])
+				break;
+		}
+
+		if (run > 2) {
+			dst[words++] = VDZ_OP_RUN | run;
+			dst[words++] = src[i];
+			op = NULL;
+			i += run;
+			continue;
+		}
+
+		if (op == NULL || (*op & VDZ_OP_CNT) == VDZ_OP_CNT) {
+			op = &dst[words++];
+			*op = 0;
+		}
+		dst[words++] = src[i];
+		(*op)++;
+		i++;
+	}
+
+	return (words);
+}
+
+static void
+rle_decode (const uint16_t * src, uint16_t * dst, int npix)
+{
+	uint16_t op, pix;
+	int n;
+
+	while (npix > 0) {
+		op = *src++;
+		n = op & VDZ_OP_CNT;
+		if (n > npix)
+			n = npix;
+		npix -= n;
+		if (op & VDZ_OP_RUN) {
+			pix = *src++;
+			while (n--)
+				*dst++ = pix;
+		} else {
+			memcpy (dst, src, n * sizeof(uint16_t));
+			dst += n;
+			src += n;
+		}
+	}
+
+	return;
+}
+
+/*
+ * Encode one chunk. Lines y0 through y0 + lines - 1 of cur are
+ * compared against prev to find the region that needs updating.
+ * Returns the number of payload bytes placed in out.
+ */
+
+static int
+chunk_encode (VDZ_CHUNK * c, uint16_t * cur, uint16_t * prev, int y0,
+    int lines, int key, uint16_t * out, uint16_t * tmp)
+{
+	int x, y;
+	int x1, y1, x2, y2;
+	int npix, words;
+	uint16_t * p;
+
+	x1 = width;
+	y1 = lines;
+	x2 = -1;
+	y2 = -1;
+
+	for (y = 0; y < lines; y++) {
+		p = cur + ((y0 + y) * width);
+		for (x = 0; x < width; x++) {
+			if (!key && p[x] == prev[((y0 + y) * width) + x])
+				continue;
+			if (x < x1)
+				x1 = x;
+			if (x > x2)
+				x2 = x;
+			if (y < y1)
+				y1 = y;
+			if (y > y2)
+				y2 = y;
+		}
+	}
+
+	if (x2 == -1) {
+		c->vdz_type = VDZ_CHUNK_SKIP;
+		c->vdz_len = 0;
+		c->vdz_x = c->vdz_y = c->vdz_cx = c->vdz_cy = 0;
+		return (0);
+	}
+
+	c->vdz_x = x1;
+	c->vdz_y = y1;
+	c->vdz_cx = x2 - x1 + 1;
+	c->vdz_cy = y2 - y1 + 1;
+
+	npix = c->vdz_cx * c->vdz_cy;
+	for (y = 0; y < c->vdz_cy; y++)
+		memcpy (tmp + (y * c->vdz_cx),
+		    cur + ((y0 + y1 + y) * width) + x1,
+		    c->vdz_cx * sizeof(uint16_t));
+
+	words = rle_encode (tmp, npix, out);
+
+	if (words >= npix) {
+		c->vdz_type = VDZ_CHUNK_RAW;
+		memcpy (out, tmp, npix * sizeof(uint16_t));
+		words = npix;
+	} else
+		c->vdz_type = VDZ_CHUNK_RLE;
+
+	/* Pad to a 32-bit boundary */
+
+	if (words & 1)
+		out[words++] = 0;
+
+	c->vdz_len = words * sizeof(uint16_t);
+
+	return (c->vdz_len);
+}
+
+/*
+ * Read back a .VDZ file and decode it into a frame buffer the same
+ * way the badge does. We report the time spent in the decoder only,
+ * not file I/O.
+ */
+
+static int
+vdz_bench (char * fname)
+{
+	FILE * f;
+	VDZ_HDR hdr;
+	VDZ_REC * rec;
+	VDZ_CHUNK * c;
+	uint8_t * buf;
+	uint8_t * p;
+	uint16_t * fb;
+	uint16_t * blk;
+	uint32_t len;
+	struct timespec t0, t1;
+	double ns = 0;
+	int frames = 0;
+	int i, y;
+
+	f = fopen (fname, "r");
+	if (f == NULL)
+		return (-1);
+
+	if (fread (&hdr, sizeof(hdr), 1, f) != 1 ||
+	    hdr.vdz_magic != VDZ_MAGIC) {
+		fclose (f);
+		return (-1);
+	}
+
+	fseek (f, sizeof(hdr) + (hdr.vdz_keycnt * sizeof(VDZ_KEY)), SEEK_SET);
+
+	buf = malloc (hdr.vdz_maxrec);
+	fb = malloc (hdr.vdz_width * hdr.vdz_height * sizeof(uint16_t));
+	blk = malloc (hdr.vdz_width * hdr.vdz_chunk_lines * sizeof(uint16_t));
+
+	len = hdr.vdz_firstrec;
+
+	while (len != 0 && fread (buf, len, 1, f) == 1) {
+		rec = (VDZ_REC *)buf;
+		p = buf + sizeof(VDZ_REC);
+
+		clock_gettime (CLOCK_MONOTONIC, &t0);
+		for (i = 0; i < rec->vdz_chunks; i++) {
+			c = (VDZ_CHUNK *)p;
+			p += sizeof(VDZ_CHUNK);
+			if (c->vdz_type == VDZ_CHUNK_RLE)
+				rle_decode ((uint16_t *)p, blk,
+				    c->vdz_cx * c->vdz_cy);
+			else if (c->vdz_type == VDZ_CHUNK_RAW)
+				memcpy (blk, p, c->vdz_cx * c->vdz_cy * 2);
+			for (y = 0; y < c->vdz_cy; y++) {
+				memcpy (fb + (((rec->vdz_chunk0 + i) *
+				    hdr.vdz_chunk_lines + c->vdz_y + y) *
+				    hdr.vdz_width) + c->vdz_x,
+				    blk + (y * c->vdz_cx),
+				    c->vdz_cx * sizeof(uint16_t));
+			}
+			p += c->vdz_len;
+		}
+		clock_gettime (CLOCK_MONOTONIC, &t1);
+
+		ns += (t1.tv_sec - t0.tv_sec) * 1e9 +
+		    (t1.tv_nsec - t0.tv_nsec);
+
+		if (rec->vdz_chunk0 + rec->vdz_chunks ==
+		    hdr.vdz_height / hdr.vdz_chunk_lines)
+			frames++;
+
+		len = rec->vdz_nextlen;
+	}
+
+	printf ("decoded %d frames, %.1f usec/frame\n", frames,
+	    frames ? ns / frames / 1000.0 : 0.0);
+
+	free (buf);
+	free (fb);
+	free (blk);
+	fclose (f);
+
+	return (0);
+}
+
+static void
+usage (void)
+{
+	fprintf (stderr, "usage: videozip [-s WxH] [-k keyint] [-g group] "
+	    "[-b] video.bin audio.s16 out.vdz\n");
+	exit (1);
+}
+
+int
+main (int argc, char * argv[])
+{
+	FILE * audio;
+	FILE * video;
+	FILE * out;
+	VDZ_HDR hdr;
+	VDZ_REC rec;
+	VDZ_CHUNK c;
+	VDZ_KEY * keys;
+	struct stat st;
+	uint16_t * cur;
+	uint16_t * prev;
+	uint16_t * tmp;
+	uint16_t * payload;
+	uint8_t * recbuf;
+	long recoff, prevoff = -1;
+	uint32_t reclen, total = 0;
+	int keyint = 32;
+	int group = 4;
+	int bench = 0;
+	int lines, frame, chunk, len;
+	int ch;
+
+	while ((ch = getopt (argc, argv, "s:k:g:b")) != -1) {
+		switch (ch) {
+		case 's':
+			if (sscanf (optarg, "%dx%d", &width, &height) != 2)
+				usage ();
+			break;
+		case 'k':
+			keyint = atoi (optarg);
+			break;
+		case 'g':
+			group = atoi (optarg);
+			break;
+		case 'b':
+			bench = 1;
+			break;
+		default:
+			usage ();
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc != 3 || keyint < 1 || group < 1 ||
+	    group > VDZ_CHUNKS_PER_FRAME || width < 1 || width > 320 ||
+	    height % VDZ_CHUNKS_PER_FRAME || height > 240)
+		usage ();
+
+	lines = height / VDZ_CHUNKS_PER_FRAME;
+
+	video = fopen (argv[0], "r");
+
+	if (video == NULL) {
+		fprintf (stderr, "[%s]: ", argv[0]);
+		perror ("file open failed");
+		exit (1);
+	}
+
+	audio = fopen (argv[1], "r");
+
+	if (audio == NULL) {
+		fprintf (stderr, "[%s]: ", argv[1]);
+		perror ("file open failed");
+		exit (1);
+	}
+
+	out = fopen (argv[2], "w+");
+
+	if (out == NULL) {
+		fprintf (stderr, "[%s]: ", argv[2]);
+		perror ("file open failed");
+		exit (1);
+	}
+
+	fstat (fileno (video), &st);
+
+	memset (&hdr, 0, sizeof(hdr));
+	hdr.vdz_magic = VDZ_MAGIC;
+	hdr.vdz_width = width;
+	hdr.vdz_height = height;
+	hdr.vdz_chunk_lines = lines;
+	hdr.vdz_group = group;
+	hdr.vdz_frames = st.st_size / (width * height * sizeof(uint16_t));
+	hdr.vdz_keycnt = (hdr.vdz_frames + keyint - 1) / keyint;
+
+	keys = calloc (hdr.vdz_keycnt + 1, sizeof(VDZ_KEY));
+	cur = malloc (width * height * sizeof(uint16_t));
+	prev = malloc (width * height * sizeof(uint16_t));
+	tmp = malloc (width * lines * sizeof(uint16_t));
+	payload = malloc ((width * lines + 2) * sizeof(uint16_t));
+	recbuf = malloc (sizeof(VDZ_REC) + group *
+	    (sizeof(VDZ_CHUNK) + (width * lines + 2) * sizeof(uint16_t)));
+
+	/* Header and index get rewritten once we know all the sizes */
+
+	fwrite (&hdr, sizeof(hdr), 1, out);
+	fwrite (keys, sizeof(VDZ_KEY), hdr.vdz_keycnt, out);
+
+	for (frame = 0; frame < (int)hdr.vdz_frames; frame++) {
+		if (fread (cur, width * height * sizeof(uint16_t),
+		    1, video) == 0)
+			break;
+
+		for (chunk = 0; chunk < VDZ_CHUNKS_PER_FRAME; chunk += group) {
+			memset (&rec, 0, sizeof(rec));
+			rec.vdz_chunk0 = chunk;
+			reclen = sizeof(VDZ_REC);
+
+			while (rec.vdz_chunks < group &&
+			    chunk + rec.vdz_chunks < VDZ_CHUNKS_PER_FRAME) {
+				memset (&c, 0, sizeof(c));
+				(void) fread (c.vdz_samples,
+				    sizeof(c.vdz_samples), 1, audio);
+				len = chunk_encode (&c, cur, prev,
+				    (chunk + rec.vdz_chunks) * lines, lines,
+				    (frame % keyint) == 0, payload, tmp);
+				memcpy (recbuf + reclen, &c, sizeof(c));
+				reclen += sizeof(c);
+				memcpy (recbuf + reclen, payload, len);
+				reclen += len;
+				rec.vdz_chunks++;
+			}
+
+			memcpy (recbuf, &rec, sizeof(rec));
+
+			recoff = ftell (out);
+			fwrite (recbuf, reclen, 1, out);
+
+			/* Patch the length into the previous record */
+
+			if (prevoff == -1)
+				hdr.vdz_firstrec = reclen;
+			else {
+				fseek (out, prevoff +
+				    offsetof(VDZ_REC, vdz_nextlen), SEEK_SET);
+				fwrite (&reclen, sizeof(reclen), 1, out);
+				fseek (out, 0, SEEK_END);
+			}
+
+			if (chunk == 0 && (frame % keyint) == 0) {
+				keys[frame / keyint].vdz_frame = frame;
+				keys[frame / keyint].vdz_off = recoff;
+				keys[frame / keyint].vdz_len = reclen;
+			}
+
+			if (reclen > hdr.vdz_maxrec)
+				hdr.vdz_maxrec = reclen;
+
+			prevoff = recoff;
+			total += reclen;
+		}
+
+		memcpy (prev, cur, width * height * sizeof(uint16_t));
+	}
+
+	hdr.vdz_frames = frame;
+
+	fseek (out, 0, SEEK_SET);
+	fwrite (&hdr, sizeof(hdr), 1, out);
+	fwrite (keys, sizeof(VDZ_KEY), hdr.vdz_keycnt, out);
+
+	fclose (video);
+	fclose (audio);
+	fclose (out);
+
+	printf ("%d frames at %dx%d, %u bytes (%.0f bytes/frame, "
+	    "%.1f%% of raw)\n", frame, width, height, total,
+	    frame ? (double)total / frame : 0.0,
+	    frame ? (100.0 * total) / ((double)frame *
+	    ((width * height * 2) + (VDZ_CHUNKS_PER_FRAME *
+	    VID_AUDIO_SAMPLES_PER_CHUNK * 2))) : 0.0);
+	printf ("largest record %u bytes, %.0f KB/sec at %g fps\n",
+	    hdr.vdz_maxrec, frame ? (double)total / frame *
+	    VID_FRAMES_PER_SEC / 1024.0 : 0.0, VID_FRAMES_PER_SEC);
+
+	free (keys);
+	free (cur);
+	free (prev);
+	free (tmp);
+	free (payload);
+	free (recbuf);
+
+	if (bench && vdz_bench (argv[2]) != 0)
+		exit (1);
+
+	exit (0);
+}
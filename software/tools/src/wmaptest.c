@@ -0,0 +1,600 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ch.h"
+
+#include "images.h"
+#include "ides_sprite.h"
+
+/*
+ * This runs the badge's WMAP collision tests (firmware/badge/ides_sprite.c)
+ * on a PC and checks the word-wide versions against a plain per-pixel
+ * reference, then times them.
+ *
+ * Usage: wmaptest [-n rounds] [-s seed]
+ *
+ * Each round draws a random land map on a simulated screen and builds
+ * its WMAP through wm_build_land_map_from_screen(), the way the game
+ * does, then checks:
+ *
+ * - first_px/last_px/notblank for every row, after wm_value() and
+ *   after wm_make_bounding_box() rescans them
+ * - wm_check_box_for_land_collision() on random boxes, including ones
+ *   hanging off the screen and invalid ones, and against the old way
+ *   of drawing the box into a scratch map for wm_collision_check_maps()
+ * - wm_collision_check_maps() against its word-granular definition
+ * - wm_collision_check_offset() on random sprite shapes at random
+ *   offsets from each other
+ * - isp_check_sprites_pixel_collision() with and without alpha maps,
+ *   for both settings of overlap, so that adjacent boxes still count
+ *   as a hit when overlap is FALSE
+ *
+ * It exits non-zero on any mismatch.
+ */
+
+#define BOXES		2000
+#define PAIRS		2000
+#define SPRITE_MAX	64
+
+#define WATER_PX	0x1f00
+#define LAND_PX		0x00f8
+
+extern RECT wm_make_bounding_box (WMAP *);
+extern bool_t wm_make_collision_box (WMAP *, RECT);
+extern void wm_destroy_wmap (WMAP *);
+
+static uint8_t land[SCREEN_H][SCREEN_W];
+static uint8_t other[SCREEN_H][SCREEN_W];
+static uint32_t rnd_state = 1;
+static int fails;
+static volatile bool_t sink;
+
+/* Stubs for what ides_sprite.c calls on the badge */
+
+systime_t
+chVTGetSystemTime (void)
+{
+	return (0);
+}
+
+rtcnt_t
+chSysGetRealtimeCounterX (void)
+{
+	return (0);
+}
+
+void
+gdispFillArea (coord_t x, coord_t y, coord_t cx, coord_t cy, color_t c)
+{
+	(void)x;
+	(void)y;
+	(void)cx;
+	(void)cy;
+	(void)c;
+	return;
+}
+
+void
+putPixelBlock (coord_t x, coord_t y, coord_t cx, coord_t cy, pixel_t * buf)
+{
+	(void)x;
+	(void)y;
+	(void)cx;
+	(void)cy;
+	(void)buf;
+	return;
+}
+
+/* The simulated screen: land is drawn red on blue water */
+
+void
+getPixelBlock (coord_t x, coord_t y, coord_t cx, coord_t cy, pixel_t * buf)
+{
+	coord_t i, j;
+
+	for (j = 0; j < cy; j++) {
+		for (i = 0; i < cx; i++) {
+			if (y + j < SCREEN_H && x + i < SCREEN_W &&
+			    land[y + j][x + i])
+				buf[(j * cx) + i] = LAND_PX;
+			else
+				buf[(j * cx) + i] = WATER_PX;
+		}
+	}
+
+	return;
+}
+
+void
+fx_init (ISPRITESYS * i)
+{
+	(void)i;
+	return;
+}
+
+ISPID
+fx_make_sizer_box (coord_t x, coord_t y, coord_t sz_s, coord_t sz_e,
+    color_t c_s, color_t c_e, int delay, int lifespan)
+{
+	(void)x;
+	(void)y;
+	(void)sz_s;
+	(void)sz_e;
+	(void)c_s;
+	(void)c_e;
+	(void)delay;
+	(void)lifespan;
+	return (0);
+}
+
+void
+fx_update (void)
+{
+	return;
+}
+
+static uint32_t
+rnd (uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+
+	return (rnd_state % n);
+}
+
+static int
+rnd_range (int lo, int hi)
+{
+	return (lo + (int)rnd (hi - lo + 1));
+}
+
+static uint64_t
+test_nanos (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+check (const char * what, int got, int want)
+{
+	if ((got != 0) != (want != 0)) {
+		if (fails < 10)
+			printf ("%s: got %d, want %d\n", what, got, want);
+		fails++;
+	}
+
+	return;
+}
+
+/* Islands, specks, and a few pixels right on the word and screen edges */
+
+static void
+draw_blobs (uint8_t m[SCREEN_H][SCREEN_W], int w, int h, int blobs, int specks)
+{
+	int i, x, y, cx, cy, r;
+
+	memset (m, 0, SCREEN_H * SCREEN_W);
+
+	for (i = 0; i < blobs; i++) {
+		cx = rnd (w);
+		cy = rnd (h);
+		r = rnd_range (1, w / 6 + 1);
+		for (y = cy - r; y <= cy + r; y++) {
+			for (x = cx - r; x <= cx + r; x++) {
+				if (x < 0 || y < 0 || x >= w || y >= h)
+					continue;
+				if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <=
+				    r * r)
+					m[y][x] = 1;
+			}
+		}
+	}
+
+	for (i = 0; i < specks; i++)
+		m[rnd (h)][rnd (w)] = 1;
+
+	for (i = 0; i < specks / 4; i++) {
+		x = (rnd (2) ? (int)rnd (w / 32 + 1) * 32 : w - 1);
+		if (x >= w)
+			x = w - 1;
+		m[rnd (h)][x] = 1;
+	}
+
+	return;
+}
+
+static WMAP *
+map_from (uint8_t m[SCREEN_H][SCREEN_W], int w, int h)
+{
+	WMAP * map;
+	int x, y;
+
+	map = wm_make_wmap_size (w, h);
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			if (m[y][x])
+				wm_value (map, x, y, 1);
+		}
+	}
+
+	return (map);
+}
+
+static void
+check_rows (WMAP * map, uint8_t m[SCREEN_H][SCREEN_W], const char * what)
+{
+	int x, y, first, last;
+	char s[64];
+
+	for (y = 0; y < map->h; y++) {
+		first = last = -1;
+		for (x = 0; x < map->w; x++) {
+			check ("wm_value get", wm_value (map, x, y, 2), m[y][x]);
+			if (m[y][x]) {
+				if (first == -1)
+					first = x;
+				last = x;
+			}
+		}
+		snprintf (s, sizeof(s), "%s row %d notblank", what, y);
+		check (s, map->map[y].notblank == TRUE, first != -1);
+		if (first != -1) {
+			snprintf (s, sizeof(s), "%s row %d first_px", what, y);
+			check (s, map->map[y].first_px == first, 1);
+			snprintf (s, sizeof(s), "%s row %d last_px", what, y);
+			check (s, map->map[y].last_px == last, 1);
+		}
+	}
+
+	return;
+}
+
+/* Reference: is any land pixel inside the box? */
+
+static bool_t
+ref_box (RECT r)
+{
+	int x, y;
+
+	if (!is_valid_rect (r))
+		return (FALSE);
+
+	for (y = (r.y > 0 ? r.y : 0); y < r.yb; y++) {
+		for (x = (r.x > 0 ? r.x : 0); x < r.xr; x++) {
+			if (land[y][x])
+				return (TRUE);
+		}
+	}
+
+	return (FALSE);
+}
+
+/* The old way: draw the box into a scratch map and AND the two */
+
+static bool_t
+scratch_box (WMAP * map, RECT r)
+{
+	WMAP * box;
+	bool_t ret = FALSE;
+
+	if (is_valid_rect (r)) {
+		box = wm_make_screensize_wmap ();
+		wm_make_collision_box (box, r);
+		ret = wm_collision_check_maps (map, box, r);
+		wm_destroy_wmap (box);
+	}
+
+	return (ret);
+}
+
+/* Reference: wm_collision_check_maps() works in whole words across */
+
+static bool_t
+ref_maps (RECT r)
+{
+	int x, y, x0 = 0, x1, y0 = 0, y1;
+
+	if (is_valid_rect (r)) {
+		x0 = (r.x > 0 ? WM_STEP(r.x) : 0) * 32;
+		x1 = WM_STEP(r.xr) * 32 + 31;
+		y0 = (r.y > 0 ? r.y : 0);
+		y1 = r.yb;
+	} else {
+		x1 = WM_STEP(SCREEN_W) * 32 + 31;
+		y1 = SCREEN_H;
+	}
+	if (x1 >= SCREEN_W)
+		x1 = SCREEN_W - 1;
+
+	for (y = y0; y < y1 && y < SCREEN_H; y++) {
+		for (x = x0; x <= x1; x++) {
+			if (land[y][x] && other[y][x])
+				return (TRUE);
+		}
+	}
+
+	return (FALSE);
+}
+
+static RECT
+rnd_rect (void)
+{
+	RECT r;
+
+	r.x = rnd_range (-40, SCREEN_W + 8);
+	r.y = rnd_range (-40, SCREEN_H + 8);
+	r.xr = r.x + rnd_range (-4, 80);
+	r.yb = r.y + rnd_range (-4, 80);
+
+	return (r);
+}
+
+static int
+test_land (void)
+{
+	RECT r[BOXES];
+	WMAP * map;
+	WMAP * map2;
+	uint64_t t0, t_word, t_pixel, t_scratch;
+	int i, hits = 0;
+
+	draw_blobs (land, SCREEN_W, SCREEN_H, rnd_range (0, 24),
+	    rnd_range (0, 400));
+	draw_blobs (other, SCREEN_W, SCREEN_H, rnd_range (0, 24),
+	    rnd_range (0, 400));
+
+	map = wm_build_land_map_from_screen ();
+	check_rows (map, land, "land map");
+	wm_make_bounding_box (map);
+	check_rows (map, land, "rescanned land map");
+
+	for (i = 0; i < BOXES; i++)
+		r[i] = rnd_rect ();
+
+	for (i = 0; i < BOXES; i++) {
+		hits += ref_box (r[i]);
+		check ("wm_check_box_for_land_collision",
+		    wm_check_box_for_land_collision (map, r[i]),
+		    ref_box (r[i]));
+		/* the old code can't take boxes off the left or top */
+		if (r[i].x >= 0 && r[i].y >= 0)
+			check ("scratch map box", scratch_box (map, r[i]),
+			    ref_box (r[i]));
+	}
+
+	map2 = map_from (other, SCREEN_W, SCREEN_H);
+	for (i = 0; i < BOXES; i++)
+		check ("wm_collision_check_maps",
+		    wm_collision_check_maps (map, map2, r[i]), ref_maps (r[i]));
+	wm_destroy_wmap (map2);
+
+	t0 = test_nanos ();
+	for (i = 0; i < BOXES; i++)
+		sink = wm_check_box_for_land_collision (map, r[i]);
+	t_word = test_nanos () - t0;
+
+	t0 = test_nanos ();
+	for (i = 0; i < BOXES; i++)
+		sink = ref_box (r[i]);
+	t_pixel = test_nanos () - t0;
+
+	t0 = test_nanos ();
+	for (i = 0; i < BOXES; i++) {
+		if (r[i].x >= 0 && r[i].y >= 0)
+			sink = scratch_box (map, r[i]);
+	}
+	t_scratch = test_nanos () - t0;
+
+	printf ("land %5d boxes %4d hits  word %7.1fns  pixel %7.1fns  "
+	    "scratch %8.1fns\n", BOXES, hits, (double)t_word / BOXES,
+	    (double)t_pixel / BOXES, (double)t_scratch / BOXES);
+
+	wm_destroy_wmap (map);
+
+	return (hits);
+}
+
+typedef struct sprite {
+	int x;
+	int y;
+	int w;
+	int h;
+	uint8_t px[SPRITE_MAX][SPRITE_MAX];
+	WMAP * map;
+} SPRITE;
+
+/* A ship-like shape: a filled ellipse with a few holes knocked out */
+
+static void
+make_sprite (SPRITE * s)
+{
+	int x, y, cx, cy, dx, dy;
+
+	s->w = rnd_range (1, SPRITE_MAX);
+	s->h = rnd_range (1, SPRITE_MAX);
+	memset (s->px, 0, sizeof(s->px));
+
+	cx = s->w / 2;
+	cy = s->h / 2;
+	for (y = 0; y < s->h; y++) {
+		for (x = 0; x < s->w; x++) {
+			dx = (x - cx) * s->h;
+			dy = (y - cy) * s->w;
+			if (dx * dx + dy * dy <= (s->w * s->h / 2) *
+			    (s->w * s->h / 2) && rnd (8) != 0)
+				s->px[y][x] = 1;
+		}
+	}
+
+	s->map = wm_make_wmap_size (s->w, s->h);
+	for (y = 0; y < s->h; y++) {
+		for (x = 0; x < s->w; x++) {
+			if (s->px[y][x])
+				wm_value (s->map, x, y, 1);
+		}
+	}
+
+	return;
+}
+
+/* Reference: any screen pixel solid in both sprites? */
+
+static bool_t
+ref_pixels (SPRITE * a, SPRITE * b)
+{
+	int x, y, bx, by;
+
+	for (y = 0; y < a->h; y++) {
+		for (x = 0; x < a->w; x++) {
+			if (!a->px[y][x])
+				continue;
+			bx = x + a->x - b->x;
+			by = y + a->y - b->y;
+			if (bx >= 0 && by >= 0 && bx < b->w && by < b->h &&
+			    b->px[by][bx])
+				return (TRUE);
+		}
+	}
+
+	return (FALSE);
+}
+
+/* Reference: the sprite boxes, counting touching edges if !overlap */
+
+static bool_t
+ref_boxes (SPRITE * a, SPRITE * b, bool_t overlap)
+{
+	int grow = overlap ? 0 : 1;
+
+	return (a->x < b->x + b->w + grow && b->x < a->x + a->w + grow &&
+	    a->y < b->y + b->h + grow && b->y < a->y + a->h + grow);
+}
+
+static void
+place (ISPRITESYS * iss, ISPID id, SPRITE * s, bool_t alpha)
+{
+	iss->list[id].active = TRUE;
+	iss->list[id].sp_buf.x = s->x;
+	iss->list[id].sp_buf.y = s->y;
+	iss->list[id].sp_buf.xs = s->w;
+	iss->list[id].sp_buf.ys = s->h;
+	iss->list[id].alphamap = alpha ? s->map : NULL;
+
+	return;
+}
+
+static int
+test_sprites (void)
+{
+	static SPRITE a[PAIRS], b[PAIRS];
+	static ISPRITESYS iss;
+	uint64_t t0, t_word, t_pixel;
+	bool_t want;
+	int i, k, hits = 0;
+
+	for (i = 0; i < PAIRS; i++) {
+		make_sprite (&a[i]);
+		make_sprite (&b[i]);
+		a[i].x = rnd_range (-SPRITE_MAX, SCREEN_W);
+		a[i].y = rnd_range (-SPRITE_MAX, SCREEN_H);
+		b[i].x = a[i].x + rnd_range (-b[i].w - 2, a[i].w + 2);
+		b[i].y = a[i].y + rnd_range (-b[i].h - 2, a[i].h + 2);
+	}
+
+	for (i = 0; i < PAIRS; i++) {
+		want = ref_pixels (&a[i], &b[i]);
+		hits += want;
+		check ("wm_collision_check_offset",
+		    wm_collision_check_offset (a[i].map, a[i].x, a[i].y,
+		    b[i].map, b[i].x, b[i].y), want);
+		check ("wm_collision_check_offset swapped",
+		    wm_collision_check_offset (b[i].map, b[i].x, b[i].y,
+		    a[i].map, a[i].x, a[i].y), want);
+
+		/*
+		 * Every mix of alpha maps, and both overlap settings.
+		 * Without both maps this is just the box test.
+		 */
+
+		for (k = 0; k < 8; k++) {
+			place (&iss, 0, &a[i], k & 1);
+			place (&iss, 1, &b[i], k & 2);
+			want = ref_boxes (&a[i], &b[i], (k & 4) != 0);
+			if ((k & 3) == 3)
+				want = want && ref_pixels (&a[i], &b[i]);
+			check ("isp_check_sprites_pixel_collision",
+			    isp_check_sprites_pixel_collision (&iss, 0, 1,
+			    (k & 4) != 0), want);
+		}
+	}
+
+	t0 = test_nanos ();
+	for (i = 0; i < PAIRS; i++)
+		sink = wm_collision_check_offset (a[i].map, a[i].x, a[i].y,
+		    b[i].map, b[i].x, b[i].y);
+	t_word = test_nanos () - t0;
+
+	t0 = test_nanos ();
+	for (i = 0; i < PAIRS; i++)
+		sink = ref_pixels (&a[i], &b[i]);
+	t_pixel = test_nanos () - t0;
+
+	printf ("sprite %3d pairs %4d hits  word %7.1fns  pixel %7.1fns\n",
+	    PAIRS, hits, (double)t_word / PAIRS, (double)t_pixel / PAIRS);
+
+	for (i = 0; i < PAIRS; i++) {
+		wm_destroy_wmap (a[i].map);
+		wm_destroy_wmap (b[i].map);
+	}
+
+	return (hits);
+}
+
+int
+main (int argc, char * argv[])
+{
+	int rounds = 8;
+	int i;
+
+	while ((i = getopt (argc, argv, "n:s:")) != -1) {
+		switch (i) {
+		case 'n':
+			rounds = atoi (optarg);
+			break;
+		case 's':
+			rnd_state = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			rounds = 0;
+			break;
+		}
+	}
+
+	if (rounds < 1 || rnd_state == 0) {
+		fprintf (stderr, "Usage: wmaptest [-n rounds] [-s seed]\n");
+		exit (1);
+	}
+
+	for (i = 0; i < rounds; i++) {
+		test_land ();
+		test_sprites ();
+	}
+
+	if (fails) {
+		printf ("%d mismatches\n", fails);
+		exit (1);
+	}
+
+	printf ("ok\n");
+
+	exit (0);
+}